@@ -0,0 +1,29 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilCompression.h                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a small LZ-style codec used for compressed container parts.      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace hlsl {
+
+/// Compresses srcSize bytes from pSrc, appending the encoded stream to dst.
+void CompressLZ(const uint8_t *pSrc, size_t srcSize, std::vector<uint8_t> &dst);
+
+/// Decodes an encoded stream into exactly dstSize bytes at pDst. Returns
+/// false if the stream is malformed or does not produce dstSize bytes; bytes
+/// after the last complete sequence (such as alignment padding) are ignored.
+bool DecompressLZ(const uint8_t *pSrc, size_t srcSize, uint8_t *pDst,
+                  size_t dstSize);
+
+} // namespace hlsl
@@ -71,11 +71,31 @@ enum DxilFourCC {
   DFCC_PatchConstantSignature   = DXIL_FOURCC('P', 'S', 'G', '1'),
   DFCC_ShaderStatistics         = DXIL_FOURCC('S', 'T', 'A', 'T'),
   DFCC_ShaderDebugInfoDXIL      = DXIL_FOURCC('I', 'L', 'D', 'B'),
+  DFCC_ShaderDebugName          = DXIL_FOURCC('I', 'L', 'D', 'N'),
   DFCC_FeatureInfo              = DXIL_FOURCC('S', 'F', 'I', '0'),
   DFCC_PrivateData              = DXIL_FOURCC('P', 'R', 'I', 'V'),
   DFCC_RootSignature            = DXIL_FOURCC('R', 'T', 'S', '0'),
   DFCC_DXIL                     = DXIL_FOURCC('D', 'X', 'I', 'L'),
   DFCC_PipelineStateValidation  = DXIL_FOURCC('P', 'S', 'V', '0'),
+  DFCC_CompressedPart           = DXIL_FOURCC('C', 'M', 'P', '0'),
+  DFCC_ShaderLibrary            = DXIL_FOURCC('L', 'I', 'B', '0'), // high-level bitcode for IDxcLinker
+};
+
+/// Use this type to describe a part stored with LZ compression. The part
+/// data of a DFCC_CompressedPart starts with this header.
+struct DxilCompressedPartHeader {
+  uint32_t  PartFourCC;       // Four char code of the original part.
+  uint32_t  UncompressedSize; // Byte count of the original part data.
+  // Structure is followed by the compressed stream, padded to 4 bytes.
+};
+
+/// Use this type to describe the name of the debug container split from a
+/// shader. Both the runtime and the debug container carry it.
+struct DxilShaderDebugName {
+  uint16_t  Flags;      // Reserved, must be zero.
+  uint16_t  NameLength; // Length of the name, not including the terminator.
+  // Structure is followed by NameLength chars, a null terminator and
+  // padding to 4 bytes.
 };
 
 #undef DXIL_FOURCC
@@ -257,6 +277,13 @@ const DxilContainerHeader *IsDxilContainerLike(const void *ptr, size_t length);
 /// Checks whether the DXIL container is valid and in-bounds.
 bool IsValidDxilContainer(const DxilContainerHeader *pHeader, size_t length);
 
+/// Checks whether the DXIL container stores any part compressed.
+bool HasCompressedDxilParts(const DxilContainerHeader *pHeader);
+
+/// Returns the null-terminated name of the split debug container, or nullptr
+/// if the container has no valid DFCC_ShaderDebugName part.
+const char *GetDxilShaderDebugName(const DxilContainerHeader *pHeader);
+
 /// Use this type as a unary predicate functor.
 struct DxilPartIsType {
   uint32_t IsFourCC;
@@ -369,9 +396,25 @@ inline uint32_t EncodeVersion(DXIL::ShaderKind shaderType, uint32_t major,
 }
 
 class AbstractMemoryStream;
+/// Writes the container for pModule to pStream. If pDebugStream is given and
+/// the module has debug info, the debug part is written to a separate
+/// container there instead, and both containers name it.
 void SerializeDxilContainerForModule(llvm::Module *pModule,
                                      AbstractMemoryStream *pModuleBitcode,
-                                     AbstractMemoryStream *pStream);
+                                     AbstractMemoryStream *pStream,
+                                     AbstractMemoryStream *pDebugStream = nullptr);
+/// Writes a library container for the high-level module pModule, whose
+/// bitcode is pModuleBitcode, to pStream.
+void SerializeDxilContainerForLibrary(llvm::Module *pModule,
+                                      AbstractMemoryStream *pModuleBitcode,
+                                      AbstractMemoryStream *pStream);
+/// Writes a copy of the container with its bitcode parts compressed.
+void CompressDxilContainer(const DxilContainerHeader *pHeader,
+                           AbstractMemoryStream *pStream);
+/// Writes a copy of the container with every compressed part expanded.
+/// Returns false if a compressed part is malformed.
+bool DecompressDxilContainer(const DxilContainerHeader *pHeader,
+                             AbstractMemoryStream *pStream);
 void CreateDxcContainerReflection(IDxcContainerReflection **ppResult);
 
 // Converts uint32_t partKind to char array object.
@@ -18,6 +18,8 @@
 #include "dxc/HLSL/DxilSignature.h"
 #include "dxc/HLSL/DxilConstants.h"
 #include "dxc/HLSL/DxilTypeSystem.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ErrorOr.h"
 #include <memory>
 #include <string>
 #include <vector>
@@ -289,4 +291,12 @@ private:
   void LoadDxilSignature(const llvm::MDTuple *pSigTuple, DxilSignature &Sig, bool bInput);
 };
 
+/// Reads DXIL bitcode in place with globals, function declarations and
+/// metadata loaded up front, and the DxilModule created when the bitcode has
+/// DXIL metadata. Each function body is only read when it is materialized,
+/// so consumers that visit one function at a time can release it afterwards.
+/// The bitcode must outlive the returned module.
+llvm::ErrorOr<std::unique_ptr<llvm::Module>>
+LoadLazyDxilModule(llvm::StringRef Bitcode, llvm::LLVMContext &Ctx);
+
 } // namespace hlsl
@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilShaderCost.h                                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a static cost estimate for DXIL shaders.                         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace llvm {
+class ModulePass;
+class PassRegistry;
+class raw_ostream;
+}
+
+namespace hlsl {
+class DxilModule;
+
+/// Instruction counts by category. Loop weighting can make these very large,
+/// so they saturate at UINT64_MAX instead of wrapping.
+struct DxilShaderCostCounts {
+  uint64_t ALU;
+  uint64_t Texture;
+  uint64_t Memory;
+  uint64_t Wave;
+
+  DxilShaderCostCounts() : ALU(0), Texture(0), Memory(0), Wave(0) {}
+  uint64_t Total() const;
+};
+
+/// A loop in the shader, with its trip count when it can be determined.
+struct DxilShaderCostLoop {
+  unsigned Depth;     // 1 for outermost loops
+  unsigned Line;      // source line of the loop header, 0 if unknown
+  unsigned TripCount; // 0 if unknown
+};
+
+/// A static estimate of the cost of running a shader, computed from the DXIL
+/// without any knowledge of the target hardware.
+struct DxilShaderCost {
+  /// Counts along the most expensive path through the entry point (and the
+  /// patch constant function for hull shaders). Blocks inside loops with a
+  /// known trip count are weighted by it; other loops count once.
+  DxilShaderCostCounts LongestPath;
+  /// Largest number of SSA values live at the same point; an indication of
+  /// register pressure.
+  unsigned PeakLiveValues;
+  /// Signature rows read and written, which bound the interpolators used
+  /// between stages.
+  unsigned InputRows;
+  unsigned OutputRows;
+  std::vector<DxilShaderCostLoop> Loops;
+
+  DxilShaderCost() : PeakLiveValues(0), InputRows(0), OutputRows(0) {}
+};
+
+void ComputeDxilShaderCost(DxilModule &DM, DxilShaderCost &Cost);
+void PrintDxilShaderCost(const DxilShaderCost &Cost, llvm::raw_ostream &OS);
+
+} // namespace hlsl
+
+namespace llvm {
+
+/// \brief Create an analysis pass that prints the static cost of the module.
+ModulePass *createDxilShaderCostPass();
+
+void initializeDxilShaderCostPassPass(llvm::PassRegistry&);
+
+}
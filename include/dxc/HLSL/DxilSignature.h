@@ -40,7 +40,8 @@ public:
   const std::vector<std::unique_ptr<DxilSignatureElement> > &GetElements() const;
 
   // Packs the signature elements per DXIL constraints and returns the number of rows used for the signature
-  unsigned PackElements();
+  // A non-zero searchBudget searches for the packing with the fewest rows (see DxilSignatureAllocator::PackMain)
+  unsigned PackElements(unsigned searchBudget = 0);
 
   // Returns true if all signature elements that should be allocated are allocated
   bool IsFullyAllocated();
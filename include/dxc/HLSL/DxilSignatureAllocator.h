@@ -78,8 +78,20 @@ public:
   unsigned PackGreedy(std::vector<DxilSignatureElement*> elements, unsigned startRow, unsigned numRows, unsigned startCol = 0);
 
   // Main packing algorithm
-  unsigned PackMain(std::vector<DxilSignatureElement*> elements, unsigned startRow, unsigned numRows);
-
+  // If searchBudget is non-zero, elements that don't take whole rows are then
+  // repacked by a search for the placement that uses the fewest rows, trying
+  // at most searchBudget placements. The greedy result is kept if the search
+  // runs out of budget first.
+  unsigned PackMain(std::vector<DxilSignatureElement*> elements, unsigned startRow, unsigned numRows, unsigned searchBudget = 0);
+
+private:
+  // Depth-first search used by PackMain to place items[index..] in rows
+  // [startRow, endRow). Returns false if no placement exists or the budget
+  // runs out.
+  bool PackSearch(const std::vector<DxilSignatureElement*> &items, unsigned index,
+                  unsigned startRow, unsigned endRow,
+                  std::vector<std::pair<unsigned, unsigned>> &placements,
+                  unsigned &budget);
 };
 
 
@@ -87,7 +87,7 @@ struct HLFunctionProps {
 struct HLOptions {
   HLOptions()
       : bDefaultRowMajor(false), bIEEEStrict(false), bDisableOptimizations(false),
-        bLegacyCBufferLoad(false), unused(0) {
+        bLegacyCBufferLoad(false), PackingBudget(0), unused(0) {
   }
   uint32_t GetHLOptionsRaw() const;
   void SetHLOptionsRaw(uint32_t data);
@@ -96,7 +96,8 @@ struct HLOptions {
   unsigned bAllResourcesBound      : 1;
   unsigned bDisableOptimizations   : 1;
   unsigned bLegacyCBufferLoad      : 1;
-  unsigned unused                  : 27;
+  unsigned PackingBudget           : 8; // signature packing search budget, in thousands of placements; 0 packs greedily
+  unsigned unused                  : 19;
 };
 
 /// Use this class to manipulate HLDXIR of a shader.
@@ -179,6 +180,13 @@ public:
   void LoadHLMetadata();
   /// Delete any HLDXIR from the specified module.
   static void ClearHLMetadata(llvm::Module &M);
+  /// Prepare the HLDXIR metadata of library LibIndex to be linked into the
+  /// library that provides the entry point; only that library keeps the
+  /// records describing the shader as a whole.
+  static void PrepareLibraryForLink(llvm::Module &M, bool IsEntryLibrary,
+                                    unsigned LibIndex);
+  /// Merge the per-library HLDXIR records appended by linking libraries.
+  static void MergeLinkedHLMetadata(llvm::Module &M);
 
   // Type related methods.
   static bool IsStreamOutputPtrType(llvm::Type *Ty);
@@ -89,6 +89,8 @@ public:
   llvm::opt::InputArgList Args = llvm::opt::InputArgList(nullptr, nullptr); // Original arguments.
 
   llvm::StringRef AssemblyCode; // OPT_Fc
+  llvm::StringRef CacheDir;     // OPT_cache_dir
+  llvm::StringRef CostReport;   // OPT_cost_report
   llvm::StringRef DebugFile;    // OPT_Fd
   llvm::StringRef EntryPoint;   // OPT_entrypoint
   llvm::StringRef ExternalFn;   // OPT_external_fn
@@ -101,14 +103,22 @@ public:
   llvm::StringRef OutputWarningsFile; // OPT_Fe
   llvm::StringRef Preprocess; // OPT_P
   llvm::StringRef TargetProfile; // OPT_target_profile
+  llvm::StringRef TimeTrace; // OPT_ftime_trace
+  llvm::StringRef TokenCache; // OPT_token_cache
   llvm::StringRef VariableName; // OPT_Vn
 
   bool AllResourcesBound; // OPT_all_resources_bound
   bool AstDump; // OPT_ast_dump
+  bool CheckPipelines; // OPT_check_pipelines
+  bool CompileCache; // OPT_cache (implied by OPT_cache_dir)
+  bool CachePreprocessed; // OPT_cache_preprocessed
+  bool CompressParts; // OPT_compress
   bool ColorCodeAssembly; // OPT_Cc
   bool CodeGenHighLevel; // OPT_fcgl
+  bool CompileLibrary; // OPT_library
   bool DebugInfo; // OPT__SLASH_Zi
   bool DumpBin;        // OPT_dumpbin
+  bool EmitTokenCache; // OPT_emit_token_cache
   bool EnableUnboundedDescriptorTables; // OPT_enable_unbounded_descriptor_tables
   bool WarningAsError; // OPT__SLASH_WX
   bool IEEEStrict;     // OPT_Gis
@@ -124,6 +134,8 @@ public:
   bool HLSL2016;  // OPT_hlsl_version (=2016)
   bool OptDump; // OPT_ODump - dump optimizer commands
   bool OutputWarnings = true; // OPT_no_warnings
+  bool PackOptimized; // OPT_pack_optimized
+  unsigned PackBudget; // OPT_pack_budget
   bool ShowHelp = false;  // OPT_help
   bool UseColor; // OPT_Cc
   bool UseHexLiterals; // OPT_Lx
@@ -132,6 +144,8 @@ public:
   bool NotUseLegacyCBufLoad;  // OPT_not_use_legacy_cbuf_load
   bool DisplayIncludeProcess; // OPT__vi
   bool RecompileFromBinary; // OPT _Recompile (Recompiling the DXBC binary file not .hlsl file)
+  bool ServerMode; // OPT_server
+  bool SplitDebugInfo; // OPT_Qsplit_debug
 };
 
 /// Use this class to capture, convert and handle the lifetime for the
@@ -32,7 +32,9 @@ public:
   }
 };
 
-class DxcOperationResult : public IDxcOperationResult {
+class DxcOperationResult : public IDxcOperationResult,
+                           public IDxcOperationResultTrace,
+                           public IDxcOperationResultDebugInfo {
 private:
   DXC_MICROCOM_REF_FIELD(m_dwRef)
 
@@ -47,8 +49,22 @@ public:
   HRESULT m_status;
   CComPtr<IDxcBlob> m_result;
   CComPtr<IDxcBlobEncoding> m_errors;
+  CComPtr<IDxcBlobEncoding> m_trace;
+  CComPtr<IDxcBlob> m_debugInfo;
+  CComPtr<IDxcBlobEncoding> m_debugName;
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
+    // Only results that carry a trace or split debug info expose them.
+    if (m_debugInfo != nullptr && ppvObject != nullptr &&
+        IsEqualIID(iid, __uuidof(IDxcOperationResultDebugInfo))) {
+      *ppvObject = static_cast<IDxcOperationResultDebugInfo *>(this);
+      AddRef();
+      return S_OK;
+    }
+    if (m_trace != nullptr)
+      return DoBasicQueryInterface2<IDxcOperationResult,
+                                    IDxcOperationResultTrace>(this, iid,
+                                                              ppvObject);
     return DoBasicQueryInterface<IDxcOperationResult>(this, iid, ppvObject);
   }
 
@@ -93,6 +109,59 @@ public:
     return CreateFromResultErrorStatus(resultBlob, errorBlob, status, pResult);
   }
 
+  // Creates a result with the same status, outputs, trace and debug info as
+  // pResult.
+  static HRESULT CreateCopy(_In_ IDxcOperationResult *pResult,
+                            _COM_Outptr_ DxcOperationResult **ppResult) {
+    *ppResult = nullptr;
+    HRESULT status;
+    CComPtr<IDxcBlob> resultBlob;
+    CComPtr<IDxcBlobEncoding> errorBlob;
+    IFR(pResult->GetStatus(&status));
+    IFR(pResult->GetResult(&resultBlob));
+    IFR(pResult->GetErrorBuffer(&errorBlob));
+    CComPtr<DxcOperationResult> result = new (std::nothrow) DxcOperationResult(resultBlob, errorBlob, status);
+    if (result.p == nullptr) return E_OUTOFMEMORY;
+    CComPtr<IDxcOperationResultTrace> pTraced;
+    if (SUCCEEDED(pResult->QueryInterface(&pTraced)))
+      IFR(pTraced->GetTrace(&result->m_trace));
+    CComPtr<IDxcOperationResultDebugInfo> pWithDebugInfo;
+    if (SUCCEEDED(pResult->QueryInterface(&pWithDebugInfo))) {
+      IFR(pWithDebugInfo->GetDebugInfo(&result->m_debugInfo));
+      IFR(pWithDebugInfo->GetDebugName(&result->m_debugName));
+    }
+    *ppResult = result.Detach();
+    return S_OK;
+  }
+
+  // Creates a result with the same status and outputs as pResult that also
+  // carries a trace.
+  static HRESULT CreateWithTrace(_In_ IDxcOperationResult *pResult,
+                                 _In_ IDxcBlobEncoding *pTrace,
+                                 _COM_Outptr_ IDxcOperationResult **ppResult) {
+    *ppResult = nullptr;
+    CComPtr<DxcOperationResult> result;
+    IFR(CreateCopy(pResult, &result));
+    result->m_trace = pTrace;
+    *ppResult = result.Detach();
+    return S_OK;
+  }
+
+  // Creates a result with the same status and outputs as pResult that also
+  // carries a split debug container and its name.
+  static HRESULT CreateWithDebugInfo(_In_ IDxcOperationResult *pResult,
+                                     _In_ IDxcBlob *pDebugInfo,
+                                     _In_ IDxcBlobEncoding *pDebugName,
+                                     _COM_Outptr_ IDxcOperationResult **ppResult) {
+    *ppResult = nullptr;
+    CComPtr<DxcOperationResult> result;
+    IFR(CreateCopy(pResult, &result));
+    result->m_debugInfo = pDebugInfo;
+    result->m_debugName = pDebugName;
+    *ppResult = result.Detach();
+    return S_OK;
+  }
+
   __override HRESULT STDMETHODCALLTYPE GetStatus(_Out_ HRESULT *pStatus) {
     if (pStatus == nullptr)
       return E_INVALIDARG;
@@ -110,6 +179,27 @@ public:
     GetErrorBuffer(_COM_Outptr_result_maybenull_ IDxcBlobEncoding **ppErrors) {
     return m_errors.CopyTo(ppErrors);
   }
+
+  __override HRESULT STDMETHODCALLTYPE
+    GetTrace(_COM_Outptr_ IDxcBlobEncoding **ppTrace) {
+    if (ppTrace == nullptr)
+      return E_INVALIDARG;
+    return m_trace.CopyTo(ppTrace);
+  }
+
+  __override HRESULT STDMETHODCALLTYPE
+    GetDebugInfo(_COM_Outptr_ IDxcBlob **ppDebugInfo) {
+    if (ppDebugInfo == nullptr)
+      return E_INVALIDARG;
+    return m_debugInfo.CopyTo(ppDebugInfo);
+  }
+
+  __override HRESULT STDMETHODCALLTYPE
+    GetDebugName(_COM_Outptr_ IDxcBlobEncoding **ppName) {
+    if (ppName == nullptr)
+      return E_INVALIDARG;
+    return m_debugName.CopyTo(ppName);
+  }
 };
 
 #endif
@@ -72,6 +72,10 @@ public:
     return m_dll != nullptr;
   }
 
+  HMODULE GetModule() const {
+    return m_dll;
+  }
+
   void Cleanup() {
     if (m_dll != nullptr) {
       m_createFn = nullptr;
@@ -114,6 +114,26 @@ IDxcOperationResult : public IUnknown {
   virtual HRESULT STDMETHODCALLTYPE GetErrorBuffer(_COM_Outptr_result_maybenull_ IDxcBlobEncoding **pErrors) = 0;
 };
 
+// Implemented by the results of compilations run with -ftime-trace.
+struct __declspec(uuid("5a7c3e91-84d2-4f6b-a0c8-1e9d2b67f354"))
+IDxcOperationResultTrace : public IUnknown {
+  // Wall time and heap growth of each compilation phase and pass, in the
+  // Chrome trace event format (UTF-8 JSON, viewable in chrome://tracing).
+  virtual HRESULT STDMETHODCALLTYPE GetTrace(_COM_Outptr_ IDxcBlobEncoding **ppTrace) = 0;
+};
+
+// Implemented by the results of compilations run with /Zi /Qsplit_debug.
+struct __declspec(uuid("b3f1d2a7-6c4e-4e0b-9d85-2a71c0e9f6d3"))
+IDxcOperationResultDebugInfo : public IUnknown {
+  // Container holding the debug info split from the result, which
+  // IDiaDataSource::loadDataFromIStream accepts.
+  virtual HRESULT STDMETHODCALLTYPE GetDebugInfo(_COM_Outptr_ IDxcBlob **ppDebugInfo) = 0;
+  // Name of the debug container (UTF-8), derived from a hash of the shader
+  // and recorded in both containers. IDiaDataSource::loadDataForExe looks
+  // for a file with this name next to the shader or on the search path.
+  virtual HRESULT STDMETHODCALLTYPE GetDebugName(_COM_Outptr_ IDxcBlobEncoding **ppName) = 0;
+};
+
 struct __declspec(uuid("7f61fc7d-950d-467f-b3e3-3c02fb49187c"))
 IDxcIncludeHandler : public IUnknown {
   virtual HRESULT STDMETHODCALLTYPE LoadSource(
@@ -122,6 +142,20 @@ IDxcIncludeHandler : public IUnknown {
     ) = 0;
 };
 
+// Keeps the UTF-8 contents of every file loaded through it, so that they can
+// be shared by any number of compilations. Objects created with
+// CLSID_DxcIncludeCache also implement IDxcIncludeHandler and are passed to
+// the compiler in place of the handler they wrap. The cache is thread-safe;
+// calls to the wrapped handler are serialized.
+struct __declspec(uuid("3f5c8a1e-6f0b-4d52-9c77-2b1e04a9d6c3"))
+IDxcIncludeCache : public IUnknown {
+  // Sets the handler used to load files that aren't in the cache yet.
+  virtual HRESULT STDMETHODCALLTYPE SetIncludeHandler(
+    _In_ IDxcIncludeHandler *pHandler) = 0;
+  // Drops all cached files, for example after they have changed.
+  virtual HRESULT STDMETHODCALLTYPE Clear() = 0;
+};
+
 struct DxcDefine {
   LPCWSTR Name;
   _Maybenull_ LPCWSTR Value;
@@ -161,6 +195,112 @@ IDxcCompiler : public IUnknown {
     ) = 0;
 };
 
+// A single compilation in a batch; fields match the IDxcCompiler::Compile arguments.
+struct DxcCompileJob {
+  IDxcBlob *pSource;                  // Source text to compile
+  LPCWSTR pSourceName;                // Optional file name for pSource. Used in errors and include handlers.
+  LPCWSTR pEntryPoint;                // entry point name
+  LPCWSTR pTargetProfile;             // shader profile to compile
+  const DxcDefine *pDefines;          // Array of defines
+  UINT32 defineCount;                 // Number of defines
+};
+
+struct __declspec(uuid("e6730281-b40d-4485-96ef-fd42dd0e368b"))
+IDxcCompilerBatch : public IUnknown {
+  // Compile a number of entry points concurrently. Arguments and the include
+  // handler are shared by all jobs; the include handler is never called
+  // concurrently and is queried at most once per file name.
+  // On success, every element of ppResults receives a result, even if the
+  // job itself failed.
+  virtual HRESULT STDMETHODCALLTYPE CompileBatch(
+    _In_count_(jobCount) const DxcCompileJob *pJobs, // Jobs to compile
+    _In_ UINT32 jobCount,                            // Number of jobs
+    _In_count_(argCount) LPCWSTR *pArguments,        // Array of pointers to arguments, shared by all jobs
+    _In_ UINT32 argCount,                            // Number of arguments
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,    // user-provided interface to handle #include directives (optional)
+    _Out_writes_(jobCount) IDxcOperationResult **ppResults // One compiler output per job
+  ) = 0;
+
+  // Compile several entry points of the same source, parsing it only once.
+  // Diagnostics from the shared parse are reported in every result; those of
+  // an entry point's code generation and validation only in its own.
+  virtual HRESULT STDMETHODCALLTYPE CompileEntryPoints(
+    _In_ IDxcBlob *pSource,                          // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                    // Optional file name for pSource. Used in errors and include handlers.
+    _In_count_(entryCount) LPCWSTR *pEntryPoints,    // entry point names
+    _In_count_(entryCount) LPCWSTR *pTargetProfiles, // shader profile to compile each entry point to
+    _In_ UINT32 entryCount,                          // Number of entry points
+    _In_count_(argCount) LPCWSTR *pArguments,        // Array of pointers to arguments
+    _In_ UINT32 argCount,                            // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines, // Array of defines
+    _In_ UINT32 defineCount,                         // Number of defines
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,    // user-provided interface to handle #include directives (optional)
+    _Out_writes_(entryCount) IDxcOperationResult **ppResults // One compiler output per entry point
+  ) = 0;
+};
+
+// Links libraries compiled with /library into a shader, so that code shared
+// by many shaders is compiled once rather than once per shader.
+struct __declspec(uuid("10433019-8980-49df-9789-cdbde80f5356"))
+IDxcLinker : public IUnknown {
+  // Register a library with name to reference it later.
+  virtual HRESULT STDMETHODCALLTYPE RegisterLibrary(
+    _In_ LPCWSTR pLibName,          // Name of the library.
+    _In_ IDxcBlob *pLib             // Library container to add.
+  ) = 0;
+
+  // Link the entry point from one of the libraries with the functions it
+  // calls from the others, then lower the result to DXIL. All libraries
+  // must have been compiled for pTargetProfile. Only the library that
+  // defines the entry point may declare resources or constant buffers.
+  virtual HRESULT STDMETHODCALLTYPE Link(
+    _In_ LPCWSTR pEntryName,                        // Entry point name, as passed to /E when compiling its library
+    _In_ LPCWSTR pTargetProfile,                    // shader profile to link
+    _In_count_(libCount) const LPCWSTR *pLibNames,  // Array of library names to link
+    _In_ UINT32 libCount,                           // Number of libraries to link
+    _In_count_(argCount) const LPCWSTR *pArguments, // Array of pointers to arguments, e.g. /Od, /Vd
+    _In_ UINT32 argCount,                           // Number of arguments
+    _COM_Outptr_ IDxcOperationResult **ppResult     // Linker output status, buffer, and errors
+  ) = 0;
+};
+
+// The stage containers of a graphics pipeline. Stages the pipeline doesn't
+// use are null; a vertex shader is required, and hull and domain shaders are
+// used together.
+struct DxcPipelineStages {
+  IDxcBlob *pVS;                      // Vertex shader
+  IDxcBlob *pHS;                      // Hull shader (optional)
+  IDxcBlob *pDS;                      // Domain shader (optional)
+  IDxcBlob *pGS;                      // Geometry shader (optional)
+  IDxcBlob *pPS;                      // Pixel shader (optional)
+};
+
+// Checks that the stages of pipelines link, reading only the signature
+// (ISG1, OSG1, PSG1) and pipeline state validation (PSV0) parts of each
+// container; no bitcode is loaded. A pipeline links when every input a stage
+// reads is written by the previous stage at the same register and
+// components with the same type, hull and domain shaders agree on control
+// points and domain, and no register is bound to different kinds of
+// resources by different stages.
+struct __declspec(uuid("4a7fa856-c52b-484d-8c03-a9962a51a011"))
+IDxcPipelineChecker : public IUnknown {
+  // Check a single pipeline. The result fails with every mismatch listed in
+  // its error buffer.
+  virtual HRESULT STDMETHODCALLTYPE CheckPipeline(
+    _In_ const DxcPipelineStages *pStages,        // Stages of the pipeline
+    _COM_Outptr_ IDxcOperationResult **ppResult   // Check status and errors
+  ) = 0;
+
+  // Check a number of pipelines concurrently. Containers shared between
+  // pipelines are read once. On success, every element of ppResults
+  // receives a result, even if the pipeline doesn't link.
+  virtual HRESULT STDMETHODCALLTYPE CheckPipelines(
+    _In_count_(pipelineCount) const DxcPipelineStages *pPipelines, // Pipelines to check
+    _In_ UINT32 pipelineCount,                                     // Number of pipelines
+    _Out_writes_(pipelineCount) IDxcOperationResult **ppResults    // One check result per pipeline
+  ) = 0;
+};
+
 static const UINT32 DxcValidatorFlags_Default = 0;
 static const UINT32 DxcValidatorFlags_InPlaceEdit = 1;  // Validator is allowed to update shader blob in-place.
 static const UINT32 DxcValidatorFlags_ValidMask = 0x1;
@@ -213,6 +353,30 @@ IDxcOptimizer : public IUnknown {
     _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText) = 0;
 };
 
+// Keeps a parsed module alive across several optimizer, validator and
+// disassembler calls, so that running a pipeline one pass at a time doesn't
+// parse and serialize the module for every step.
+struct __declspec(uuid("8e4b1c62-27d5-4a0f-b9e3-5f60c7d2a481"))
+IDxcModuleSession : public IUnknown {
+  // Load a module from a DXIL container, a DXIL program part, LLVM bitcode
+  // or LLVM assembly, replacing any module loaded previously.
+  virtual HRESULT STDMETHODCALLTYPE Load(_In_ IDxcBlob *pModule) = 0;
+  // Run passes over the loaded module in place. Options are as for
+  // IDxcOptimizer::RunOptimizer.
+  virtual HRESULT STDMETHODCALLTYPE RunOptimizer(
+    _In_count_(optionCount) LPCWSTR *ppOptions, UINT32 optionCount,
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText) = 0;
+  // Validate the loaded module.
+  virtual HRESULT STDMETHODCALLTYPE Validate(
+    _COM_Outptr_ IDxcOperationResult **ppResult) = 0;
+  // Disassemble the loaded module.
+  virtual HRESULT STDMETHODCALLTYPE Disassemble(
+    _COM_Outptr_ IDxcBlobEncoding **ppDisassembly) = 0;
+  // Serialize the loaded module as bitcode.
+  virtual HRESULT STDMETHODCALLTYPE GetModule(
+    _COM_Outptr_ IDxcBlob **ppModule) = 0;
+};
+
 static const UINT32 DxcVersionInfoFlags_None = 0;
 static const UINT32 DxcVersionInfoFlags_Debug = 1; // Matches VS_FF_DEBUG
 
@@ -278,4 +442,36 @@ __declspec(selectany) extern const GUID CLSID_DxcOptimizer = {
     {0x9b, 0x6b, 0xb1, 0x24, 0xe7, 0xa5, 0x20, 0x4c}
 };
 
+// {1d7f3a05-94c2-4e6b-8a1f-c3b52e9d7064}
+__declspec(selectany) extern const GUID CLSID_DxcModuleSession = {
+  0x1d7f3a05,
+  0x94c2,
+  0x4e6b,
+  { 0x8a, 0x1f, 0xc3, 0xb5, 0x2e, 0x9d, 0x70, 0x64 }
+};
+
+// {5c2b7e49-0d8a-4f1e-a3b6-92c4d18e7f05}
+__declspec(selectany) extern const GUID CLSID_DxcIncludeCache = {
+  0x5c2b7e49,
+  0x0d8a,
+  0x4f1e,
+  { 0xa3, 0xb6, 0x92, 0xc4, 0xd1, 0x8e, 0x7f, 0x05 }
+};
+
+// {5200d019-7e23-4b91-95c5-97530ef896e6}
+__declspec(selectany) extern const GUID CLSID_DxcLinker = {
+  0x5200d019,
+  0x7e23,
+  0x4b91,
+  { 0x95, 0xc5, 0x97, 0x53, 0x0e, 0xf8, 0x96, 0xe6 }
+};
+
+// {75faf49c-a941-4f21-9c7d-25a4220553d3}
+__declspec(selectany) extern const GUID CLSID_DxcPipelineChecker = {
+  0x75faf49c,
+  0xa941,
+  0x4f21,
+  { 0x9c, 0x7d, 0x25, 0xa4, 0x22, 0x05, 0x53, 0xd3 }
+};
+
 #endif
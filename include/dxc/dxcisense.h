@@ -561,6 +561,50 @@ enum DxcCursorKindFlags
   DxcCursorKind_Unexposed = 0x100,
 };
 
+// Options to control code completion.
+typedef enum DxcCodeCompleteFlags
+{
+  DxcCodeCompleteFlags_None = 0x0,
+
+  // Include macros in the completion results.
+  DxcCodeCompleteFlags_IncludeMacros = 0x1,
+
+  // Include code patterns for language constructs, such as 'for' loops.
+  DxcCodeCompleteFlags_IncludeCodePatterns = 0x2,
+
+  // Include brief documentation comments in the completion results.
+  DxcCodeCompleteFlags_IncludeBriefComments = 0x4,
+} DxcCodeCompleteFlags;
+
+// Describes a single piece of text within a completion string.
+typedef enum DxcCompletionChunkKind
+{
+  DxcCompletionChunk_Optional = 0,          // Optional part of the completion, such as a default argument.
+  DxcCompletionChunk_TypedText = 1,         // Text that the user would be expected to type to get this result.
+  DxcCompletionChunk_Text = 2,              // Text to insert as part of the completion.
+  DxcCompletionChunk_Placeholder = 3,       // Placeholder for an argument the user should fill in.
+  DxcCompletionChunk_Informative = 4,       // Informative text that is not inserted.
+  DxcCompletionChunk_CurrentParameter = 5,  // Parameter at the current position in a call.
+  DxcCompletionChunk_LeftParen = 6,
+  DxcCompletionChunk_RightParen = 7,
+  DxcCompletionChunk_LeftBracket = 8,
+  DxcCompletionChunk_RightBracket = 9,
+  DxcCompletionChunk_LeftBrace = 10,
+  DxcCompletionChunk_RightBrace = 11,
+  DxcCompletionChunk_LeftAngle = 12,
+  DxcCompletionChunk_RightAngle = 13,
+  DxcCompletionChunk_Comma = 14,
+  DxcCompletionChunk_ResultType = 15,       // Type of the completed entity; not inserted.
+  DxcCompletionChunk_Colon = 16,
+  DxcCompletionChunk_SemiColon = 17,
+  DxcCompletionChunk_Equal = 18,
+  DxcCompletionChunk_HorizontalSpace = 19,
+  DxcCompletionChunk_VerticalSpace = 20,
+} DxcCompletionChunkKind;
+
+struct IDxcCodeCompleteResults;
+struct IDxcCompletionResult;
+struct IDxcCompletionString;
 struct IDxcCursor;
 struct IDxcDiagnostic;
 struct IDxcFile;
@@ -739,6 +783,34 @@ IDxcTranslationUnit : public IUnknown
     _Out_ unsigned* errorLength,
     _Out_ BSTR* errorMessage) = 0;
   virtual HRESULT STDMETHODCALLTYPE GetInclusionList(_Out_ unsigned* pResultCount, _Outptr_result_buffer_(*pResultCount) IDxcInclusion*** pResult) = 0;
+  virtual HRESULT STDMETHODCALLTYPE CodeCompleteAt(
+    _In_ const char* fileName, unsigned line, unsigned column,
+    _In_count_(numUnsavedFiles) IDxcUnsavedFile** pUnsavedFiles,
+    unsigned numUnsavedFiles,
+    DxcCodeCompleteFlags options,
+    _Outptr_result_nullonfailure_ IDxcCodeCompleteResults** pResult) = 0;
+};
+
+struct __declspec(uuid("1e06466a-fd8b-45f3-a78f-07eed0ff4cf0"))
+IDxcCodeCompleteResults : public IUnknown
+{
+  virtual HRESULT STDMETHODCALLTYPE GetNumResults(_Out_ unsigned* pResult) = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetResultAt(unsigned index, _Outptr_result_nullonfailure_ IDxcCompletionResult** pResult) = 0;
+};
+
+struct __declspec(uuid("943c0588-22d0-4784-86fc-701f802ac2b6"))
+IDxcCompletionResult : public IUnknown
+{
+  virtual HRESULT STDMETHODCALLTYPE GetCursorKind(_Out_ DxcCursorKind* pResult) = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetCompletionString(_Outptr_result_nullonfailure_ IDxcCompletionString** pResult) = 0;
+};
+
+struct __declspec(uuid("06b51e0f-a605-4c69-a110-cd6e14b58eec"))
+IDxcCompletionString : public IUnknown
+{
+  virtual HRESULT STDMETHODCALLTYPE GetNumCompletionChunks(_Out_ unsigned* pResult) = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetCompletionChunkKind(unsigned chunkNumber, _Out_ DxcCompletionChunkKind* pResult) = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetCompletionChunkText(unsigned chunkNumber, _Outptr_result_maybenull_ LPSTR* pResult) = 0;
 };
 
 struct __declspec(uuid("2ec912fd-b144-4a15-ad0d-1c5439c81e46"))
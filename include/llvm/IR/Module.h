@@ -660,6 +660,16 @@ public:
   void print(raw_ostream &OS, AssemblyAnnotationWriter *AAW,
              bool ShouldPreserveUseListOrder = false) const;
 
+  // HLSL Change start
+  /// Print the module like print(), but read each lazily loaded function body
+  /// just before it is printed and release it afterwards, so that only one
+  /// body is resident at a time. Bodies are also read once beforehand to find
+  /// the struct types they use, so the output matches print() on the fully
+  /// loaded module.
+  std::error_code printMaterializingFunctions(raw_ostream &OS,
+                                              AssemblyAnnotationWriter *AAW);
+  // HLSL Change end
+
   /// Dump the module to stderr (for debugging).
   void dump() const;
   
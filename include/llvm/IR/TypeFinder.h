@@ -40,7 +40,12 @@ class TypeFinder {
 public:
   TypeFinder() : OnlyNamed(false) {}
 
-  void run(const Module &M, bool onlyNamed);
+  // HLSL Change start
+  /// If materializeFunctions is set, each materializable function body is
+  /// read while its types are collected and released again afterwards, so
+  /// the types are found in the same order as in a fully loaded module.
+  void run(const Module &M, bool onlyNamed, bool materializeFunctions = false);
+  // HLSL Change end
   void clear();
 
   typedef std::vector<StructType*>::iterator iterator;
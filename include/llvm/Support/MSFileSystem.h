@@ -69,6 +69,13 @@ public:
     _In_  DWORD dwFileOffsetLow,
     _In_  SIZE_T dwNumberOfBytesToMap) throw() = 0;
   virtual BOOL UnmapViewOfFile(_In_ LPCVOID lpBaseAddress) throw() = 0;
+
+  // Returns the contents of an open file if the file system holds them in
+  // memory for as long as it exists, followed by a null terminator that isn't
+  // part of the contents. Lets readers use the contents in place.
+  virtual bool GetPinnedBuffer(int fd, _Outptr_ const char **ppData, _Out_ size_t *pSize) throw() {
+    return false;
+  }
   
   // Console APIs.
   virtual bool FileDescriptorIsDisplayed(int fd) throw() = 0;
@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// TimeProfiler.h                                                            //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Records nested compilation phases as a Chrome trace.                      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LLVM_SUPPORT_TIMEPROFILER_H
+#define LLVM_SUPPORT_TIMEPROFILER_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class raw_ostream;
+
+/// Records the wall time of nested, named intervals on one thread, and writes
+/// them in the Chrome trace event format that can be loaded in
+/// chrome://tracing. Heap growth is recorded for outermost intervals only:
+/// sampling the heap can walk all of it, which would distort the timing of
+/// short nested intervals.
+///
+/// A profiler only records the intervals of the thread it is active on; see
+/// TimeTraceProfilerActivation. Code that wants to be traced opens a
+/// TimeTraceScope, which does nothing when no profiler is active.
+class TimeTraceProfiler {
+public:
+  struct Entry {
+    std::string Name;
+    std::string Detail;
+    int64_t Start;     // microseconds since the profiler was created
+    int64_t Duration;  // microseconds
+    int64_t HeapDelta; // growth of the heap in bytes, may be negative
+    bool HasHeapDelta; // only set for outermost intervals
+  };
+
+  TimeTraceProfiler();
+
+  void begin(StringRef Name, StringRef Detail);
+  void end();
+
+  /// Completed intervals, in the order in which they ended.
+  const std::vector<Entry> &entries() const { return Entries; }
+
+  /// Writes the completed intervals as a JSON object.
+  void write(raw_ostream &OS) const;
+
+  /// Returns the profiler active on the calling thread, if any.
+  static TimeTraceProfiler *getCurrent();
+
+private:
+  typedef std::chrono::steady_clock ClockType;
+
+  struct OpenEntry {
+    Entry E;
+    ClockType::time_point StartTime;
+    size_t HeapStart;
+  };
+
+  ClockType::time_point BeginTime;
+  std::vector<OpenEntry> Stack;
+  std::vector<Entry> Entries;
+
+  friend class TimeTraceProfilerActivation;
+};
+
+/// Makes a profiler active on the calling thread for the lifetime of this
+/// object, restoring the previously active profiler afterwards.
+class TimeTraceProfilerActivation {
+  TimeTraceProfiler *Previous;
+public:
+  explicit TimeTraceProfilerActivation(TimeTraceProfiler *P);
+  ~TimeTraceProfilerActivation();
+};
+
+/// Records an interval with the active profiler for the lifetime of this
+/// object.
+class TimeTraceScope {
+  TimeTraceProfiler *Profiler;
+  TimeTraceScope(const TimeTraceScope &) = delete;
+  void operator=(const TimeTraceScope &) = delete;
+public:
+  explicit TimeTraceScope(StringRef Name, StringRef Detail = StringRef())
+      : Profiler(TimeTraceProfiler::getCurrent()) {
+    if (Profiler)
+      Profiler->begin(Name, Detail);
+  }
+  ~TimeTraceScope() {
+    if (Profiler)
+      Profiler->end();
+  }
+};
+
+} // end namespace llvm
+
+#endif
@@ -235,6 +235,7 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   // AssemblyCodeHex not supported (Fx)
   // OutputLibrary not supported (Fl)
   opts.AssemblyCode = Args.getLastArgValue(OPT_Fc);
+  opts.CostReport = Args.getLastArgValue(OPT_cost_report);
   opts.DebugFile = Args.getLastArgValue(OPT_Fd);
   opts.ExtractRootSignatureFile = Args.getLastArgValue(OPT_extractrootsignature);
   opts.OutputObject = Args.getLastArgValue(OPT_Fo);
@@ -280,10 +281,27 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   opts.DisableValidation = Args.hasFlag(OPT_VD, OPT_INVALID, false);
 
   opts.AllResourcesBound = Args.hasFlag(OPT_all_resources_bound, OPT_INVALID, false);
+  opts.PackOptimized = Args.hasFlag(OPT_pack_optimized, OPT_INVALID, false);
+  opts.CompressParts = Args.hasFlag(OPT_compress, OPT_INVALID, false);
+  opts.SplitDebugInfo = Args.hasFlag(OPT_Qsplit_debug, OPT_INVALID, false);
+  opts.CompileLibrary = Args.hasFlag(OPT_library, OPT_INVALID, false);
+  opts.PackBudget = 64;
+  if (Arg *A = Args.getLastArg(OPT_pack_budget)) {
+    if (llvm::StringRef(A->getValue()).getAsInteger(10, opts.PackBudget) ||
+        opts.PackBudget == 0 || opts.PackBudget > 255) {
+      errors << "/pack_budget must be a number from 1 to 255";
+      return 1;
+    }
+    if (!opts.PackOptimized) {
+      errors << "/pack_budget requires /pack_optimized";
+      return 1;
+    }
+  }
   opts.ColorCodeAssembly = Args.hasFlag(OPT_Cc, OPT_INVALID, false);
   opts.DefaultRowMajor = Args.hasFlag(OPT_Zpr, OPT_INVALID, false);
   opts.DefaultColMajor = Args.hasFlag(OPT_Zpc, OPT_INVALID, false);
   opts.DumpBin = Args.hasFlag(OPT_dumpbin, OPT_INVALID, false);
+  opts.CheckPipelines = Args.hasFlag(OPT_check_pipelines, OPT_INVALID, false);
   opts.EnableUnboundedDescriptorTables = Args.hasFlag(OPT_enable_unbounded_descriptor_tables, OPT_INVALID, false);
   opts.NotUseLegacyCBufLoad = Args.hasFlag(OPT_not_use_legacy_cbuf_load, OPT_INVALID, false);
   opts.DisplayIncludeProcess = Args.hasFlag(OPT_H, OPT_INVALID, false);
@@ -291,6 +309,14 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   opts.AvoidFlowControl = Args.hasFlag(OPT_Gfa, OPT_INVALID, false);
   opts.PreferFlowControl = Args.hasFlag(OPT_Gfp, OPT_INVALID, false);
   opts.RecompileFromBinary = Args.hasFlag(OPT_recompile, OPT_INVALID, false);
+  opts.ServerMode = Args.hasFlag(OPT_server, OPT_INVALID, false);
+  opts.CacheDir = Args.getLastArgValue(OPT_cache_dir);
+  opts.CachePreprocessed = Args.hasFlag(OPT_cache_preprocessed, OPT_INVALID, false);
+  opts.CompileCache = Args.hasFlag(OPT_cache, OPT_INVALID, false) ||
+                      !opts.CacheDir.empty() || opts.CachePreprocessed;
+  opts.EmitTokenCache = Args.hasFlag(OPT_emit_token_cache, OPT_INVALID, false);
+  opts.TokenCache = Args.getLastArgValue(OPT_token_cache);
+  opts.TimeTrace = Args.getLastArgValue(OPT_ftime_trace);
   if (opts.DefaultColMajor && opts.DefaultRowMajor) {
     errors << "Cannot specify /Zpr and /Zpc together, use /? to get usage information";
     return 1;
@@ -299,6 +325,14 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
     errors << "Cannot specify /Gfa and /Gfp together, use /? to get usage information";
     return 1;
   }
+  if (opts.EmitTokenCache && !opts.TokenCache.empty()) {
+    errors << "Cannot specify /emit-token-cache and /token-cache together.";
+    return 1;
+  }
+  if (opts.CompileLibrary && (opts.CodeGenHighLevel || opts.SplitDebugInfo)) {
+    errors << "Cannot specify /fcgl or /Qsplit_debug with /library.";
+    return 1;
+  }
   // TODO: more fxc option check.
   // ERR_RES_MAY_ALIAS_ONLY_IN_CS_5
   // ERR_NOT_ABLE_TO_FLATTEN on if that contain side effects
@@ -309,11 +343,27 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   // ERR_TEMPLATE_VAR_CONFLICT
   // ERR_ATTRIBUTE_PARAM_SIDE_EFFECT
 
+  if (opts.ServerMode) {
+    // Each request supplies its own input file and options.
+    if (!opts.InputFile.empty() || !opts.Preprocess.empty() || opts.DumpBin ||
+        opts.RecompileFromBinary || opts.CheckPipelines) {
+      errors << "Server mode cannot be specified with other actions.";
+      return 1;
+    }
+    opts.Args = std::move(Args);
+    return 0;
+  }
+
   if ((flagsToInclude & hlsl::options::DriverOption) && opts.InputFile.empty()) {
     // Input file is required in arguments only for drivers; APIs take this through an argument.
     errors << "Required input file argument is missing.";
     return 1;
   }
+  if ((flagsToInclude & hlsl::options::DriverOption) && opts.EmitTokenCache &&
+      opts.OutputObject.empty()) {
+    errors << "A header token cache can only be written to a file; specify /Fo.";
+    return 1;
+  }
   if (opts.OutputHeader.empty() && !opts.VariableName.empty()) {
     errors << "Cannot specify a header variable name when not writing a header.";
     return 1;
@@ -342,8 +392,16 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
     }
   }
 
+  if (opts.CheckPipelines &&
+      (opts.DumpBin || !opts.Preprocess.empty() || opts.RecompileFromBinary ||
+       !opts.TargetProfile.empty() || !opts.OutputObject.empty())) {
+    errors << "Cannot specify other actions or compilation options when checking pipelines.";
+    return 1;
+  }
+
   if ((flagsToInclude & hlsl::options::DriverOption) &&
-      opts.TargetProfile.empty() && !opts.DumpBin && opts.Preprocess.empty() && !opts.RecompileFromBinary) {
+      opts.TargetProfile.empty() && !opts.DumpBin && opts.Preprocess.empty() && !opts.RecompileFromBinary &&
+      !opts.EmitTokenCache && !opts.CheckPipelines) {
     // Target profile is required in arguments only for drivers when compiling;
     // APIs take this through an argument.
     errors << "Target profile argument is missing";
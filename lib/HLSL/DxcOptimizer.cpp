@@ -19,6 +19,7 @@
 #include "dxc/HLSL/ReducibilityAnalysis.h"
 #include "dxc/HLSL/HLMatrixLowerPass.h"
 #include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/HLSL/DxilShaderCost.h"
 #include "dxc/Support/dxcapi.impl.h"
 
 #include "llvm/Pass.h"
@@ -76,6 +77,7 @@ HRESULT SetupRegistryPassForHLSL() {
     initializeDxilEmitMetadataPass(Registry);
     initializeDxilGenerationPassPass(Registry);
     initializeDxilPrecisePropagatePassPass(Registry);
+    initializeDxilShaderCostPassPass(Registry);
     initializeDynamicIndexingVectorToArrayPass(Registry);
     initializeEarlyCSELegacyPassPass(Registry);
     initializeEliminateAvailableExternallyPass(Registry);
@@ -428,6 +430,10 @@ public:
     _In_count_(optionCount) LPCWSTR *ppOptions, UINT32 optionCount,
     _COM_Outptr_ IDxcBlob **ppOutputModule,
     _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText);
+  // Runs the passes named by the options over M in place, writing any text
+  // output to outStream.
+  HRESULT RunPasses(Module &M, _In_count_(optionCount) LPCWSTR *ppOptions,
+                    UINT32 optionCount, raw_ostream &outStream);
 };
 
 class CapturePassManager : public llvm::legacy::PassManagerBase {
@@ -489,6 +495,22 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::GetAvailablePass(
       GetPassArgDescriptions(m_passes[index]->getPassArgument()), ppResult);
 }
 
+static std::unique_ptr<Module> ParseModuleBlob(IDxcBlob *pBlob,
+                                               LLVMContext &Context) {
+  // The assembly parser requires the buffer to be null terminated, which the
+  // blob may not be, so text is copied. Bitcode is read in place.
+  StringRef bufStrRef(reinterpret_cast<const char *>(pBlob->GetBufferPointer()),
+                      pBlob->GetBufferSize());
+  std::unique_ptr<MemoryBuffer> memBuf;
+  if (isBitcode(bufStrRef.bytes_begin(), bufStrRef.bytes_end()))
+    memBuf = MemoryBuffer::getMemBuffer(bufStrRef, "", false);
+  else
+    memBuf = MemoryBuffer::getMemBufferCopy(bufStrRef);
+
+  SMDiagnostic Err;
+  return parseIR(memBuf->getMemBufferRef(), Err, Context);
+}
+
 HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
     IDxcBlob *pBlob, _In_count_(optionCount) LPCWSTR *ppOptions,
     UINT32 optionCount, _COM_Outptr_ IDxcBlob **ppOutputModule,
@@ -500,30 +522,13 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
   if (optionCount > 0 && ppOptions == nullptr)
     return E_POINTER;
 
-  // Setup input buffer.
-  // The ir parsing requires the buffer to be null terminated. We deal with
-  // both source and bitcode input, so the input buffer may not be null
-  // terminated.
-  // Create a new membuf that copies the buffer and adds a null terminator.
-  StringRef bufStrRef(reinterpret_cast<const char *>(pBlob->GetBufferPointer()),
-                      pBlob->GetBufferSize());
-  std::unique_ptr<MemoryBuffer> memBuf =
-      MemoryBuffer::getMemBufferCopy(bufStrRef);
-
   // Parse IR
   LLVMContext Context;
-  SMDiagnostic Err;
-  std::unique_ptr<Module> M = parseIR(memBuf->getMemBufferRef(), Err, Context);
+  std::unique_ptr<Module> M = ParseModuleBlob(pBlob, Context);
   if (!M) {
-    //Err.print(argv[0], errs());
     return E_INVALIDARG;
   }
 
-
-  legacy::PassManager ModulePasses;
-  legacy::FunctionPassManager FunctionPasses(M.get());
-  legacy::PassManagerBase *pPassManager = &ModulePasses;
-
   try {
     CComPtr<IMalloc> pMalloc;
     CComPtr<AbstractMemoryStream> pOutputStream;
@@ -534,179 +539,225 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
     IFT(pOutputStream.QueryInterface(&pOutputBlob));
 
     raw_stream_ostream outStream(pOutputStream.p);
+    IFR(RunPasses(*M.get(), ppOptions, optionCount, outStream));
 
-    //
-    // Consider some differences from opt.exe:
-    //
-    // Create a new optimization pass for each one specified on the command line
-    // as in StandardLinkOpts, OptLevelO1, etc.
-    // No target machine, and so no passes get their target machine ctor called.
-    // No print-after-each-pass option.
-    // No printing of the pass options.
-    // No StripDebug support.
-    // No verifyModule before starting.
-    // Use of PassPipeline for new manager.
-    // No TargetInfo.
-    // No DataLayout.
-    //
-    bool OutputAssembly = false;
-    bool AnalyzeOnly = false;
-
-    // First gather flags, wherever they may be.
-    SmallVector<UINT32, 2> handled;
-    for (UINT32 i = 0; i < optionCount; ++i) {
-      if (wcseq(L"-S", ppOptions[i])) {
-        OutputAssembly = true;
-        handled.push_back(i);
-        continue;
-      }
-      if (wcseq(L"-analyze", ppOptions[i])) {
-        AnalyzeOnly = true;
-        handled.push_back(i);
-        continue;
+    outStream.flush();
+    if (ppOutputText != nullptr) {
+      IFT(DxcCreateBlobWithEncodingSet(pOutputBlob, CP_UTF8, ppOutputText));
+    }
+    if (ppOutputModule != nullptr) {
+      CComPtr<AbstractMemoryStream> pProgramStream;
+      IFT(CreateMemoryStream(pMalloc, &pProgramStream));
+      {
+        raw_stream_ostream outStream(pProgramStream.p);
+        WriteBitcodeToFile(M.get(), outStream, true);
       }
+      IFT(pProgramStream.QueryInterface(ppOutputModule));
     }
+  }
+  CATCH_CPP_RETURN_HRESULT();
 
-    // TODO: should really use string_table for this once that's available
-    std::list<std::string> optionsAnsi;
-    SmallVector<PassOption, 2> options;
-    for (UINT32 i = 0; i < optionCount; ++i) {
-      if (std::find(handled.begin(), handled.end(), i) != handled.end()) {
-        continue;
-      }
+  return S_OK;
+}
 
-      // Handle some special cases where we can inject a redirected output stream.
-      if (wcseq(ppOptions[i], L"-print-module")) {
-        pPassManager->add(llvm::createPrintModulePass(outStream));
-        continue;
-      }
+HRESULT DxcOptimizer::RunPasses(Module &M,
+                                 _In_count_(optionCount) LPCWSTR *ppOptions,
+                                 UINT32 optionCount, raw_ostream &outStream) {
+  legacy::PassManager ModulePasses;
+  legacy::FunctionPassManager FunctionPasses(&M);
+  legacy::PassManagerBase *pPassManager = &ModulePasses;
 
-      // Handle special switches to toggle per-function prepasses vs. module passes.
-      if (wcseq(ppOptions[i], L"-opt-fn-passes")) {
-        pPassManager = &FunctionPasses;
-        continue;
-      }
-      if (wcseq(ppOptions[i], L"-opt-mod-passes")) {
-        pPassManager = &ModulePasses;
-        continue;
-      }
+  //
+  // Consider some differences from opt.exe:
+  //
+  // Create a new optimization pass for each one specified on the command line
+  // as in StandardLinkOpts, OptLevelO1, etc.
+  // No target machine, and so no passes get their target machine ctor called.
+  // No print-after-each-pass option.
+  // No printing of the pass options.
+  // No StripDebug support.
+  // No verifyModule before starting.
+  // Use of PassPipeline for new manager.
+  // No TargetInfo.
+  // No DataLayout.
+  //
+  bool OutputAssembly = false;
+  bool AnalyzeOnly = false;
+
+  // First gather flags, wherever they may be.
+  SmallVector<UINT32, 2> handled;
+  for (UINT32 i = 0; i < optionCount; ++i) {
+    if (wcseq(L"-S", ppOptions[i])) {
+      OutputAssembly = true;
+      handled.push_back(i);
+      continue;
+    }
+    if (wcseq(L"-analyze", ppOptions[i])) {
+      AnalyzeOnly = true;
+      handled.push_back(i);
+      continue;
+    }
+  }
 
-      CW2A optName(ppOptions[i], CP_UTF8);
-      // The option syntax is
-      const char ArgDelim = ',';
-      // '-' OPTION_NAME (',' ARG_NAME ('=' ARG_VALUE)?)*
-      char *pCursor = optName.m_psz;
-      const char *pEnd = optName.m_psz + strlen(optName.m_psz);
-      if (*pCursor != '-' && *pCursor != '/') {
+  // TODO: should really use string_table for this once that's available
+  std::list<std::string> optionsAnsi;
+  SmallVector<PassOption, 2> options;
+  for (UINT32 i = 0; i < optionCount; ++i) {
+    if (std::find(handled.begin(), handled.end(), i) != handled.end()) {
+      continue;
+    }
+
+    // Handle some special cases where we can inject a redirected output stream.
+    if (wcseq(ppOptions[i], L"-print-module")) {
+      pPassManager->add(llvm::createPrintModulePass(outStream));
+      continue;
+    }
+
+    // Handle special switches to toggle per-function prepasses vs. module passes.
+    if (wcseq(ppOptions[i], L"-opt-fn-passes")) {
+      pPassManager = &FunctionPasses;
+      continue;
+    }
+    if (wcseq(ppOptions[i], L"-opt-mod-passes")) {
+      pPassManager = &ModulePasses;
+      continue;
+    }
+
+    CW2A optName(ppOptions[i], CP_UTF8);
+    // The option syntax is
+    const char ArgDelim = ',';
+    // '-' OPTION_NAME (',' ARG_NAME ('=' ARG_VALUE)?)*
+    char *pCursor = optName.m_psz;
+    const char *pEnd = optName.m_psz + strlen(optName.m_psz);
+    if (*pCursor != '-' && *pCursor != '/') {
+      return E_INVALIDARG;
+    }
+    ++pCursor;
+    const char *pOptionNameStart = pCursor;
+    while (*pCursor && *pCursor != ArgDelim) {
+      ++pCursor;
+    }
+    *pCursor = '\0';
+    const llvm::PassInfo *PassInf = getPassByName(pOptionNameStart);
+    if (!PassInf) {
+      return E_INVALIDARG;
+    }
+    while (pCursor < pEnd) {
+      // *pCursor is '\0' when we overwrite ',' to get a null-terminated string
+      if (*pCursor && *pCursor != ArgDelim) {
         return E_INVALIDARG;
       }
       ++pCursor;
-      const char *pOptionNameStart = pCursor;
+      const char *pArgStart = pCursor;
       while (*pCursor && *pCursor != ArgDelim) {
         ++pCursor;
       }
-      *pCursor = '\0';
-      const llvm::PassInfo *PassInf = getPassByName(pOptionNameStart);
-      if (!PassInf) {
+      StringRef argString = StringRef(pArgStart, pCursor - pArgStart);
+      std::pair<StringRef, StringRef> nameValue = argString.split('=');
+      if (!IsPassOptionName(nameValue.first)) {
         return E_INVALIDARG;
       }
-      while (pCursor < pEnd) {
-        // *pCursor is '\0' when we overwrite ',' to get a null-terminated string
-        if (*pCursor && *pCursor != ArgDelim) {
-          return E_INVALIDARG;
-        }
-        ++pCursor;
-        const char *pArgStart = pCursor;
-        while (*pCursor && *pCursor != ArgDelim) {
-          ++pCursor;
-        }
-        StringRef argString = StringRef(pArgStart, pCursor - pArgStart);
-        std::pair<StringRef, StringRef> nameValue = argString.split('=');
-        if (!IsPassOptionName(nameValue.first)) {
-          return E_INVALIDARG;
-        }
 
-        PassOption *OptionPos = std::lower_bound(options.begin(), options.end(), nameValue, PassOptionsCompare());
-        // If empty, remove if available; otherwise upsert.
-        if (nameValue.second.empty()) {
-          if (OptionPos != options.end() && OptionPos->first == nameValue.first) {
-            options.erase(OptionPos);
-          }
+      PassOption *OptionPos = std::lower_bound(options.begin(), options.end(), nameValue, PassOptionsCompare());
+      // If empty, remove if available; otherwise upsert.
+      if (nameValue.second.empty()) {
+        if (OptionPos != options.end() && OptionPos->first == nameValue.first) {
+          options.erase(OptionPos);
+        }
+      }
+      else {
+        if (OptionPos != options.end() && OptionPos->first == nameValue.first) {
+          OptionPos->second = nameValue.second;
         }
         else {
-          if (OptionPos != options.end() && OptionPos->first == nameValue.first) {
-            OptionPos->second = nameValue.second;
-          }
-          else {
-            options.insert(OptionPos, nameValue);
-          }
+          options.insert(OptionPos, nameValue);
         }
       }
+    }
 
-      DXASSERT(PassInf->getNormalCtor(), "else pass with no default .ctor was added");
-      Pass *pass = PassInf->getNormalCtor()();
-      pass->setOSOverride(&outStream);
-      pass->applyOptions(options);
-      options.clear();
-      pPassManager->add(pass);
-      if (AnalyzeOnly) {
-        const bool Quiet = false;
-        PassKind Kind = pass->getPassKind();
-        switch (Kind) {
-        case PT_BasicBlock:
-          pPassManager->add(createBasicBlockPassPrinter(PassInf, outStream, Quiet));
-          break;
-        case PT_Region:
-          pPassManager->add(createRegionPassPrinter(PassInf, outStream, Quiet));
-          break;
-        case PT_Loop:
-          pPassManager->add(createLoopPassPrinter(PassInf, outStream, Quiet));
-          break;
-        case PT_Function:
-          pPassManager->add(createFunctionPassPrinter(PassInf, outStream, Quiet));
-          break;
-        case PT_CallGraphSCC:
-          pPassManager->add(createCallGraphPassPrinter(PassInf, outStream, Quiet));
-          break;
-        default:
-          pPassManager->add(createModulePassPrinter(PassInf, outStream, Quiet));
-          break;
-        }
+    DXASSERT(PassInf->getNormalCtor(), "else pass with no default .ctor was added");
+    Pass *pass = PassInf->getNormalCtor()();
+    pass->setOSOverride(&outStream);
+    pass->applyOptions(options);
+    options.clear();
+    pPassManager->add(pass);
+    if (AnalyzeOnly) {
+      const bool Quiet = false;
+      PassKind Kind = pass->getPassKind();
+      switch (Kind) {
+      case PT_BasicBlock:
+        pPassManager->add(createBasicBlockPassPrinter(PassInf, outStream, Quiet));
+        break;
+      case PT_Region:
+        pPassManager->add(createRegionPassPrinter(PassInf, outStream, Quiet));
+        break;
+      case PT_Loop:
+        pPassManager->add(createLoopPassPrinter(PassInf, outStream, Quiet));
+        break;
+      case PT_Function:
+        pPassManager->add(createFunctionPassPrinter(PassInf, outStream, Quiet));
+        break;
+      case PT_CallGraphSCC:
+        pPassManager->add(createCallGraphPassPrinter(PassInf, outStream, Quiet));
+        break;
+      default:
+        pPassManager->add(createModulePassPrinter(PassInf, outStream, Quiet));
+        break;
       }
     }
+  }
 
-    ModulePasses.add(createVerifierPass());
+  ModulePasses.add(createVerifierPass());
 
-    if (OutputAssembly) {
-      ModulePasses.add(llvm::createPrintModulePass(outStream));
-    }
+  if (OutputAssembly) {
+    ModulePasses.add(llvm::createPrintModulePass(outStream));
+  }
 
-    // Now that we have all of the passes ready, run them.
-    {
-      raw_ostream *err_ostream = &outStream;
-      ScopedFatalErrorHandler errHandler(FatalErrorHandlerStreamWrite, err_ostream);
-
-      FunctionPasses.doInitialization();
-      for (Function &F : *M.get())
-        if (!F.isDeclaration())
-          FunctionPasses.run(F);
-      FunctionPasses.doFinalization();
-      ModulePasses.run(*M.get());
-    }
+  // Now that we have all of the passes ready, run them.
+  {
+    raw_ostream *err_ostream = &outStream;
+    ScopedFatalErrorHandler errHandler(FatalErrorHandlerStreamWrite, err_ostream);
+
+    FunctionPasses.doInitialization();
+    for (Function &F : M)
+      if (!F.isDeclaration())
+        FunctionPasses.run(F);
+    FunctionPasses.doFinalization();
+    ModulePasses.run(M);
+  }
+  return S_OK;
+}
+
+// Runs optimizer passes over a module that has already been loaded, as done
+// by IDxcModuleSession.
+HRESULT RunInternalOptimizer(_In_ IDxcOptimizer *pOptimizer,
+                             _In_ llvm::Module *pModule,
+                             _In_count_(optionCount) LPCWSTR *ppOptions,
+                             UINT32 optionCount,
+                             _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText) {
+  DXASSERT_NOMSG(pOptimizer != nullptr);
+  DXASSERT_NOMSG(pModule != nullptr);
+  AssignToOutOpt(nullptr, ppOutputText);
+  if (optionCount > 0 && ppOptions == nullptr)
+    return E_POINTER;
+
+  DxcOptimizer *pInternalOptimizer = (DxcOptimizer *)pOptimizer;
+  try {
+    CComPtr<IMalloc> pMalloc;
+    CComPtr<AbstractMemoryStream> pOutputStream;
+    CComPtr<IDxcBlob> pOutputBlob;
+
+    IFT(CoGetMalloc(1, &pMalloc));
+    IFT(CreateMemoryStream(pMalloc, &pOutputStream));
+    IFT(pOutputStream.QueryInterface(&pOutputBlob));
 
+    raw_stream_ostream outStream(pOutputStream.p);
+    IFR(pInternalOptimizer->RunPasses(*pModule, ppOptions, optionCount,
+                                      outStream));
     outStream.flush();
     if (ppOutputText != nullptr) {
       IFT(DxcCreateBlobWithEncodingSet(pOutputBlob, CP_UTF8, ppOutputText));
     }
-    if (ppOutputModule != nullptr) {
-      CComPtr<AbstractMemoryStream> pProgramStream;
-      IFT(CreateMemoryStream(pMalloc, &pProgramStream));
-      {
-        raw_stream_ostream outStream(pProgramStream.p);
-        WriteBitcodeToFile(M.get(), outStream, true);
-      }
-      IFT(pProgramStream.QueryInterface(ppOutputModule));
-    }
   }
   CATCH_CPP_RETURN_HRESULT();
 
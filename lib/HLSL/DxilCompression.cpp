@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilCompression.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a small LZ-style codec used for compressed container parts.      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilCompression.h"
+#include <string.h>
+
+// The encoded stream is a sequence of:
+//   token     - high nibble is the literal count, low nibble is the match
+//               length minus MinMatch; 15 in either means extension bytes
+//               follow (each adds its value, 255 means another byte follows)
+//   literals  - literal length extension bytes, then the literal bytes
+//   offset    - little-endian uint16, distance back to the match start
+//   matchlen  - match length extension bytes
+// The final sequence carries only literals and ends the stream.
+
+namespace {
+
+const unsigned MinMatch = 4;
+const unsigned HashBits = 14;
+const size_t MaxOffset = 0xFFFF;
+// Leave room at the end of the input so the last sequence is literals only.
+const size_t EndLiterals = 5;
+
+inline uint32_t Read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint32_t HashSequence(uint32_t v) {
+  return (v * 2654435761u) >> (32 - HashBits);
+}
+
+void WriteLength(std::vector<uint8_t> &dst, size_t len) {
+  while (len >= 255) {
+    dst.push_back(255);
+    len -= 255;
+  }
+  dst.push_back((uint8_t)len);
+}
+
+void WriteSequence(std::vector<uint8_t> &dst, const uint8_t *pLiterals,
+                   size_t literalCount, size_t offset, size_t matchLen) {
+  size_t matchCode = matchLen ? matchLen - MinMatch : 0;
+  uint8_t token = (uint8_t)((literalCount < 15 ? literalCount : 15) << 4);
+  token |= (uint8_t)(matchCode < 15 ? matchCode : 15);
+  dst.push_back(token);
+  if (literalCount >= 15)
+    WriteLength(dst, literalCount - 15);
+  dst.insert(dst.end(), pLiterals, pLiterals + literalCount);
+  if (matchLen == 0)
+    return;
+  dst.push_back((uint8_t)(offset & 0xFF));
+  dst.push_back((uint8_t)(offset >> 8));
+  if (matchCode >= 15)
+    WriteLength(dst, matchCode - 15);
+}
+
+bool ReadLength(const uint8_t *&ip, const uint8_t *ipEnd, size_t &len) {
+  uint8_t b;
+  do {
+    if (ip == ipEnd)
+      return false;
+    b = *ip++;
+    len += b;
+  } while (b == 255);
+  return true;
+}
+
+} // namespace
+
+namespace hlsl {
+
+void CompressLZ(const uint8_t *pSrc, size_t srcSize,
+                std::vector<uint8_t> &dst) {
+  dst.reserve(dst.size() + srcSize / 2 + 16);
+  const uint8_t *anchor = pSrc;
+  if (srcSize > MinMatch + EndLiterals) {
+    std::vector<uint32_t> table(1u << HashBits, 0);
+    const uint8_t *ip = pSrc;
+    const uint8_t *matchLimit = pSrc + srcSize - EndLiterals;
+    // Positions are stored off by one so zero marks an empty slot.
+    while (ip + MinMatch <= matchLimit) {
+      uint32_t seq = Read32(ip);
+      uint32_t &slot = table[HashSequence(seq)];
+      const uint8_t *ref = slot ? pSrc + slot - 1 : nullptr;
+      slot = (uint32_t)(ip - pSrc) + 1;
+      if (!ref || (size_t)(ip - ref) > MaxOffset || Read32(ref) != seq) {
+        ++ip;
+        continue;
+      }
+      const uint8_t *matchEnd = ip + MinMatch;
+      const uint8_t *refEnd = ref + MinMatch;
+      while (matchEnd < matchLimit && *matchEnd == *refEnd) {
+        ++matchEnd;
+        ++refEnd;
+      }
+      WriteSequence(dst, anchor, ip - anchor, ip - ref, matchEnd - ip);
+      ip = anchor = matchEnd;
+    }
+  }
+  WriteSequence(dst, anchor, pSrc + srcSize - anchor, 0, 0);
+}
+
+bool DecompressLZ(const uint8_t *pSrc, size_t srcSize, uint8_t *pDst,
+                  size_t dstSize) {
+  const uint8_t *ip = pSrc;
+  const uint8_t *ipEnd = pSrc + srcSize;
+  size_t op = 0;
+  do {
+    if (ip == ipEnd)
+      return false;
+    uint8_t token = *ip++;
+    size_t literalCount = token >> 4;
+    if (literalCount == 15 && !ReadLength(ip, ipEnd, literalCount))
+      return false;
+    if (literalCount > (size_t)(ipEnd - ip) || literalCount > dstSize - op)
+      return false;
+    memcpy(pDst + op, ip, literalCount);
+    ip += literalCount;
+    op += literalCount;
+    if (op == dstSize)
+      return true;
+
+    if (ipEnd - ip < 2)
+      return false;
+    size_t offset = ip[0] | ((size_t)ip[1] << 8);
+    ip += 2;
+    size_t matchLen = token & 0xF;
+    if (matchLen == 15 && !ReadLength(ip, ipEnd, matchLen))
+      return false;
+    matchLen += MinMatch;
+    if (offset == 0 || offset > op || matchLen > dstSize - op)
+      return false;
+    // Matches may overlap their own output, so copy byte by byte.
+    const uint8_t *ref = pDst + op - offset;
+    for (size_t i = 0; i < matchLen; ++i)
+      pDst[op + i] = ref[i];
+    op += matchLen;
+  } while (op < dstSize);
+  // A stream always ends with a literal-only sequence.
+  return false;
+}
+
+} // namespace hlsl
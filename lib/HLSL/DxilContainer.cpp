@@ -83,6 +83,27 @@ bool IsValidDxilContainer(const DxilContainerHeader *pHeader, size_t length) {
   return true;
 }
 
+bool HasCompressedDxilParts(const DxilContainerHeader *pHeader) {
+  return std::any_of(begin(pHeader), end(pHeader),
+                     DxilPartIsType(DFCC_CompressedPart));
+}
+
+const char *GetDxilShaderDebugName(const DxilContainerHeader *pHeader) {
+  const DxilPartHeader *pPart =
+      GetDxilPartByType(pHeader, DFCC_ShaderDebugName);
+  if (pPart == nullptr || pPart->PartSize < sizeof(DxilShaderDebugName))
+    return nullptr;
+  const DxilShaderDebugName *pDebugName =
+      reinterpret_cast<const DxilShaderDebugName *>(GetDxilPartData(pPart));
+  if (pDebugName->NameLength + 1 >
+      pPart->PartSize - sizeof(DxilShaderDebugName))
+    return nullptr;
+  const char *pName = reinterpret_cast<const char *>(pDebugName + 1);
+  if (pName[pDebugName->NameLength] != '\0')
+    return nullptr;
+  return pName;
+}
+
 const DxilPartHeader *GetDxilPartByType(const DxilContainerHeader *pHeader, DxilFourCC fourCC) {
   if (!IsDxilContainerLike(pHeader, pHeader->ContainerSizeInBytes)) {
     return nullptr;
@@ -13,8 +13,11 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/MD5.h"
 #include "dxc/HLSL/DxilContainer.h"
+#include "dxc/HLSL/DxilCompression.h"
 #include "dxc/HLSL/DxilModule.h"
+#include "dxc/HLSL/HLModule.h"
 #include "dxc/HLSL/DxilShaderModel.h"
 #include "dxc/HLSL/DxilRootSignature.h"
 #include "dxc/Support/Global.h"
@@ -25,6 +28,7 @@
 #include "dxc/HLSL/DxilPipelineStateValidation.h"
 #include <algorithm>
 #include <functional>
+#include <vector>
 
 using namespace llvm;
 using namespace hlsl;
@@ -499,12 +503,15 @@ private:
   };
 
   llvm::SmallVector<DxilPart, 8> m_Parts;
+  DxilContainerHash m_Hash = {};
 
 public:
   void AddPart(uint32_t FourCC, uint32_t Size, WriteFn Write) {
     m_Parts.emplace_back(FourCC, Size, Write);
   }
 
+  void SetHash(const DxilContainerHash &Hash) { m_Hash = Hash; }
+
   void write(AbstractMemoryStream *pStream) {
     DxilContainerHeader header;
     const uint32_t PartCount = (uint32_t)m_Parts.size();
@@ -516,6 +523,7 @@ public:
       containerSizeInBytes += part.Header.PartSize;
     }
     InitDxilContainer(&header, PartCount, containerSizeInBytes);
+    header.Hash = m_Hash;
     IFT(pStream->Reserve(header.ContainerSizeInBytes));
     IFT(WriteStreamValue(pStream, header));
     uint32_t offset = sizeof(header) + OffsetTableSize;
@@ -575,9 +583,31 @@ static void WriteProgramPart(const ShaderModel *pModel,
   }
 }
 
+static uint32_t GetDebugNamePartSize(const std::string &name) {
+  // Header, name and terminator, padded to 4 bytes.
+  return (sizeof(DxilShaderDebugName) + (uint32_t)name.size() + 1 + 3) & ~3u;
+}
+
+static void WriteDebugNamePart(const std::string &name,
+                               AbstractMemoryStream *pStream) {
+  DxilShaderDebugName header;
+  header.Flags = 0;
+  header.NameLength = (uint16_t)name.size();
+  uint32_t nameBytes = (uint32_t)name.size() + 1;
+  uint32_t paddingBytes =
+      GetDebugNamePartSize(name) - sizeof(header) - nameBytes;
+  uint32_t padding = 0;
+  ULONG cbWritten;
+  IFT(WriteStreamValue(pStream, header));
+  IFT(pStream->Write(name.c_str(), nameBytes, &cbWritten));
+  if (paddingBytes)
+    IFT(pStream->Write(&padding, paddingBytes, &cbWritten));
+}
+
 void hlsl::SerializeDxilContainerForModule(Module *pModule,
                                            AbstractMemoryStream *pModuleBitcode,
-                                           AbstractMemoryStream *pFinalStream) {
+                                           AbstractMemoryStream *pFinalStream,
+                                           AbstractMemoryStream *pDebugStream) {
   // TODO: add a flag to update the module and remove information that is not part
   // of DXIL proper and is used only to assemble the container.
 
@@ -637,11 +667,15 @@ void hlsl::SerializeDxilContainerForModule(Module *pModule,
   }
 
   // If we have debug information present, serialize it to a debug part, then use the stripped version as the canonical program version.
+  // When splitting, the debug part goes into its own container.
   pProgramStream = pModuleBitcode;
+  bool splitDebugInfo = false;
+  DxilContainerWriter debugWriter;
   if (HasDebugInfo(*pModule)) {
     uint32_t debugInUInt32, debugPaddingBytes;
     GetPaddedProgramPartSize(pModuleBitcode, debugInUInt32, debugPaddingBytes);
-    writer.AddPart(DFCC_ShaderDebugInfoDXIL, debugInUInt32 * sizeof(uint32_t) + sizeof(DxilProgramHeader), [&](AbstractMemoryStream *pStream) {
+    splitDebugInfo = pDebugStream != nullptr;
+    (splitDebugInfo ? debugWriter : writer).AddPart(DFCC_ShaderDebugInfoDXIL, debugInUInt32 * sizeof(uint32_t) + sizeof(DxilProgramHeader), [&](AbstractMemoryStream *pStream) {
       WriteProgramPart(dxilModule.GetShaderModel(), pModuleBitcode, pStream);
     });
 
@@ -666,5 +700,134 @@ void hlsl::SerializeDxilContainerForModule(Module *pModule,
     WriteProgramPart(dxilModule.GetShaderModel(), pProgramStream, pStream);
   });
 
+  // Name the debug container after the stripped program, so that a runtime
+  // container leads to the debug container it was split from.
+  std::string debugName;
+  if (splitDebugInfo) {
+    MD5 programHash;
+    programHash.update(ArrayRef<uint8_t>(pProgramStream->GetPtr(),
+                                         pProgramStream->GetPtrSize()));
+    MD5::MD5Result digest;
+    programHash.final(digest);
+    SmallString<32> hex;
+    MD5::stringifyResult(digest, hex);
+    debugName = hex.str().str() + ".ildb";
+    auto writeDebugName = [&](AbstractMemoryStream *pStream) {
+      WriteDebugNamePart(debugName, pStream);
+    };
+    writer.AddPart(DFCC_ShaderDebugName, GetDebugNamePartSize(debugName),
+                   writeDebugName);
+    debugWriter.AddPart(DFCC_ShaderDebugName, GetDebugNamePartSize(debugName),
+                        writeDebugName);
+    debugWriter.write(pDebugStream);
+  }
+
+  writer.write(pFinalStream);
+}
+
+void hlsl::SerializeDxilContainerForLibrary(Module *pModule,
+                                            AbstractMemoryStream *pModuleBitcode,
+                                            AbstractMemoryStream *pFinalStream) {
+  DXASSERT_NOMSG(pModule != nullptr);
+  DXASSERT_NOMSG(pModuleBitcode != nullptr);
+  DXASSERT_NOMSG(pFinalStream != nullptr);
+
+  // The bitcode keeps its high-level metadata, debug info included; the
+  // linker rebuilds the signatures and other parts for the linked shader.
+  const ShaderModel *pSM = pModule->GetOrCreateHLModule().GetShaderModel();
+  uint32_t programInUInt32, programPaddingBytes;
+  GetPaddedProgramPartSize(pModuleBitcode, programInUInt32, programPaddingBytes);
+
+  DxilContainerWriter writer;
+  writer.AddPart(DFCC_ShaderLibrary, programInUInt32 * sizeof(uint32_t) + sizeof(DxilProgramHeader), [&](AbstractMemoryStream *pStream) {
+    WriteProgramPart(pSM, pModuleBitcode, pStream);
+  });
+  writer.write(pFinalStream);
+}
+
+static bool IsCompressiblePart(uint32_t fourCC) {
+  // Only bitcode parts are large enough to be worth the decode cost; the
+  // small fixed-layout parts stay raw so the runtime can read them directly.
+  return fourCC == DFCC_DXIL || fourCC == DFCC_ShaderDebugInfoDXIL ||
+         fourCC == DFCC_ShaderLibrary;
+}
+
+void hlsl::CompressDxilContainer(const DxilContainerHeader *pHeader,
+                                 AbstractMemoryStream *pFinalStream) {
+  DxilContainerWriter writer;
+  // Compressed streams must outlive the writer's callbacks.
+  std::vector<std::vector<uint8_t>> compressed;
+  compressed.reserve(pHeader->PartCount);
+  for (DxilPartIterator it = begin(pHeader), e = end(pHeader); it != e;
+       ++it) {
+    const DxilPartHeader *pPart = *it;
+    const uint8_t *pData =
+        reinterpret_cast<const uint8_t *>(GetDxilPartData(pPart));
+    if (IsCompressiblePart(pPart->PartFourCC)) {
+      compressed.emplace_back();
+      std::vector<uint8_t> &data = compressed.back();
+      DxilCompressedPartHeader partHeader = {pPart->PartFourCC,
+                                             pPart->PartSize};
+      data.resize(sizeof(partHeader));
+      memcpy(data.data(), &partHeader, sizeof(partHeader));
+      CompressLZ(pData, pPart->PartSize, data);
+      data.resize((data.size() + 3) & ~(size_t)3, 0);
+      if (data.size() < pPart->PartSize) {
+        writer.AddPart(DFCC_CompressedPart, (uint32_t)data.size(),
+                       [&data](AbstractMemoryStream *pStream) {
+          ULONG cbWritten;
+          IFT(pStream->Write(data.data(), (ULONG)data.size(), &cbWritten));
+        });
+        continue;
+      }
+    }
+    writer.AddPart(pPart->PartFourCC, pPart->PartSize,
+                   [pPart, pData](AbstractMemoryStream *pStream) {
+      ULONG cbWritten;
+      IFT(pStream->Write(pData, pPart->PartSize, &cbWritten));
+    });
+  }
+  writer.SetHash(pHeader->Hash);
+  writer.write(pFinalStream);
+}
+
+bool hlsl::DecompressDxilContainer(const DxilContainerHeader *pHeader,
+                                   AbstractMemoryStream *pFinalStream) {
+  DxilContainerWriter writer;
+  std::vector<std::vector<uint8_t>> expanded;
+  expanded.reserve(pHeader->PartCount);
+  for (DxilPartIterator it = begin(pHeader), e = end(pHeader); it != e;
+       ++it) {
+    const DxilPartHeader *pPart = *it;
+    const uint8_t *pData =
+        reinterpret_cast<const uint8_t *>(GetDxilPartData(pPart));
+    if (pPart->PartFourCC != DFCC_CompressedPart) {
+      writer.AddPart(pPart->PartFourCC, pPart->PartSize,
+                     [pPart, pData](AbstractMemoryStream *pStream) {
+        ULONG cbWritten;
+        IFT(pStream->Write(pData, pPart->PartSize, &cbWritten));
+      });
+      continue;
+    }
+    DxilCompressedPartHeader partHeader;
+    if (pPart->PartSize < sizeof(partHeader))
+      return false;
+    memcpy(&partHeader, pData, sizeof(partHeader));
+    if (partHeader.UncompressedSize > DxilContainerMaxSize)
+      return false;
+    expanded.emplace_back(partHeader.UncompressedSize);
+    std::vector<uint8_t> &data = expanded.back();
+    if (!DecompressLZ(pData + sizeof(partHeader),
+                      pPart->PartSize - sizeof(partHeader), data.data(),
+                      data.size()))
+      return false;
+    writer.AddPart(partHeader.PartFourCC, partHeader.UncompressedSize,
+                   [&data](AbstractMemoryStream *pStream) {
+      ULONG cbWritten;
+      IFT(pStream->Write(data.data(), (ULONG)data.size(), &cbWritten));
+    });
+  }
+  writer.SetHash(pHeader->Hash);
   writer.write(pFinalStream);
+  return true;
 }
@@ -12,6 +12,8 @@
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
 #include "dxc/HLSL/DxilContainer.h"
 #include "dxc/HLSL/DxilModule.h"
 #include "dxc/HLSL/DxilShaderModel.h"
@@ -80,7 +82,22 @@ private:
   std::vector<D3D12_SIGNATURE_PARAMETER_DESC>     m_OutputSignature;
   std::vector<D3D12_SIGNATURE_PARAMETER_DESC>     m_PatchConstantSignature;
   std::vector<std::unique_ptr<char[]>>            m_UpperCaseNames;
+  bool m_bUsageLoaded;
+  // Instruction counts, gathered from the function bodies on first use. Only
+  // the statistics fields of the description are set, and they are only
+  // reported once a pass over every body has succeeded.
+  D3D12_SHADER_DESC m_InstructionStats;
+  UINT m_MovInstructionCount;
+  UINT m_MovcInstructionCount;
+  UINT m_ConversionInstructionCount;
+  UINT m_BitwiseInstructionCount;
+  bool m_bInstructionStatsLoaded;
   void CreateReflectionObjects();
+  HRESULT EnsureUsageLoaded();
+  HRESULT EnsureInstructionStatsLoaded();
+  void CollectInstructionStats();
+  void CountInstructions(Function &F);
+  void CountDxilOpInstruction(OP::OpCode opcode);
   void SetCBufferUsage();
   void CreateReflectionObjectForResource(DxilResourceBase *R);
   void CreateReflectionObjectsForSignature(
@@ -117,7 +134,13 @@ public:
     return hr;
   }
 
-  DxilShaderReflection() : m_dwRef(0), m_pDxilModule(nullptr) { }
+  DxilShaderReflection()
+      : m_dwRef(0), m_pDxilModule(nullptr), m_bUsageLoaded(false),
+        m_MovInstructionCount(0), m_MovcInstructionCount(0),
+        m_ConversionInstructionCount(0), m_BitwiseInstructionCount(0),
+        m_bInstructionStatsLoaded(false) {
+    ZeroMemory(&m_InstructionStats, sizeof(m_InstructionStats));
+  }
   HRESULT Load(IDxcBlob *pBlob, const DxilPartHeader *pPart);
 
   // ID3D12ShaderReflection
@@ -179,6 +202,26 @@ HRESULT DxilContainerReflection::Load(IDxcBlob *pContainer) {
     return E_INVALIDARG;
   }
 
+  // Expand compressed parts up front so parts can be handed out as
+  // sub-blobs of the container.
+  CComPtr<IDxcBlob> pExpanded;
+  if (HasCompressedDxilParts(pHeader)) {
+    try {
+      CComPtr<IMalloc> pMalloc;
+      CComPtr<AbstractMemoryStream> pStream;
+      IFT(CoGetMalloc(1, &pMalloc));
+      IFT(CreateMemoryStream(pMalloc, &pStream));
+      if (!DecompressDxilContainer(pHeader, pStream))
+        return DXC_E_CONTAINER_INVALID;
+      IFT(pStream.QueryInterface(&pExpanded));
+    }
+    CATCH_CPP_RETURN_HRESULT();
+    pContainer = pExpanded;
+    bufLen = pContainer->GetBufferSize();
+    pHeader = reinterpret_cast<const DxilContainerHeader *>(
+        pContainer->GetBufferPointer());
+  }
+
   m_container = pContainer;
   m_headerLen = bufLen;
   m_pHeader = pHeader;
@@ -881,14 +924,13 @@ void DxilShaderReflection::SetCBufferUsage() {
 void DxilShaderReflection::CreateReflectionObjects() {
   DXASSERT_NOMSG(m_pDxilModule != nullptr);
 
-  // Create constant buffers, resources and signatures.
+  // Create constant buffers, resources and signatures. Everything here comes
+  // from metadata; usage is filled in by EnsureUsageLoaded.
   for (auto && cb : m_pDxilModule->GetCBuffers()) {
     CShaderReflectionConstantBuffer rcb;
     rcb.Initialize(*m_pDxilModule, *(cb.get()));
     m_CBs.push_back(std::move(rcb));
   }
-  // Set cbuf usage.
-  SetCBufferUsage();
 
   // TODO: add tbuffers into m_CBs
   for (auto && uav : m_pDxilModule->GetUAVs()) {
@@ -926,7 +968,270 @@ void DxilShaderReflection::CreateReflectionObjects() {
   CreateReflectionObjectsForSignature(m_pDxilModule->GetInputSignature(), m_InputSignature);
   CreateReflectionObjectsForSignature(m_pDxilModule->GetOutputSignature(), m_OutputSignature);
   CreateReflectionObjectsForSignature(m_pDxilModule->GetPatchConstantSignature(), m_PatchConstantSignature);
-  MarkUsedSignatureElements();
+}
+
+// Function bodies are only needed to tell which constant buffer variables and
+// signature elements are used, so they are materialized the first time any
+// of those is queried.
+HRESULT DxilShaderReflection::EnsureUsageLoaded() {
+  if (m_bUsageLoaded)
+    return S_OK;
+  try {
+    IFTLLVM(m_pModule->materializeAllPermanently());
+    SetCBufferUsage();
+    MarkUsedSignatureElements();
+    m_bUsageLoaded = true;
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+// Reading every function body is the expensive part of reflection, so the
+// statistics are only gathered once something asks for them. Bodies that
+// weren't already loaded for usage are released again after being counted.
+HRESULT DxilShaderReflection::EnsureInstructionStatsLoaded() {
+  if (m_bInstructionStatsLoaded)
+    return S_OK;
+  try {
+    CollectInstructionStats();
+    m_bInstructionStatsLoaded = true;
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+void DxilShaderReflection::CountDxilOpInstruction(OP::OpCode opcode) {
+  D3D12_SHADER_DESC &Stats = m_InstructionStats;
+  switch (opcode) {
+  case OP::OpCode::Sample:
+  case OP::OpCode::SampleLevel:
+  case OP::OpCode::TextureGather:
+    Stats.TextureNormalInstructions++;
+    break;
+  case OP::OpCode::SampleBias:
+    Stats.TextureBiasInstructions++;
+    break;
+  case OP::OpCode::SampleGrad:
+    Stats.TextureGradientInstructions++;
+    break;
+  case OP::OpCode::SampleCmp:
+  case OP::OpCode::SampleCmpLevelZero:
+  case OP::OpCode::TextureGatherCmp:
+    Stats.TextureCompInstructions++;
+    break;
+  case OP::OpCode::TextureLoad:
+  case OP::OpCode::BufferLoad:
+    Stats.TextureLoadInstructions++;
+    break;
+  case OP::OpCode::TextureStore:
+  case OP::OpCode::BufferStore:
+    Stats.cTextureStoreInstructions++;
+    break;
+  case OP::OpCode::Barrier:
+    Stats.cBarrierInstructions++;
+    break;
+  case OP::OpCode::AtomicBinOp:
+  case OP::OpCode::AtomicCompareExchange:
+  case OP::OpCode::BufferUpdateCounter:
+    Stats.cInterlockedInstructions++;
+    break;
+  case OP::OpCode::CutStream:
+    Stats.CutInstructionCount++;
+    break;
+  case OP::OpCode::EmitStream:
+    Stats.EmitInstructionCount++;
+    break;
+  case OP::OpCode::EmitThenCutStream:
+    Stats.EmitInstructionCount++;
+    Stats.CutInstructionCount++;
+    break;
+  case OP::OpCode::UAddc:
+  case OP::OpCode::USubc:
+  case OP::OpCode::UMul:
+  case OP::OpCode::UDiv:
+  case OP::OpCode::UMax:
+  case OP::OpCode::UMin:
+  case OP::OpCode::UMad:
+    Stats.UintInstructionCount++;
+    break;
+  case OP::OpCode::IAddc:
+  case OP::OpCode::ISubc:
+  case OP::OpCode::IMul:
+  case OP::OpCode::IMax:
+  case OP::OpCode::IMin:
+  case OP::OpCode::IMad:
+  case OP::OpCode::Msad:
+    Stats.IntInstructionCount++;
+    break;
+  case OP::OpCode::FMax:
+  case OP::OpCode::FMin:
+  case OP::OpCode::FMad:
+  case OP::OpCode::Fma:
+    Stats.FloatInstructionCount++;
+    break;
+  case OP::OpCode::Ibfe:
+  case OP::OpCode::Ubfe:
+  case OP::OpCode::Bfi:
+    m_BitwiseInstructionCount++;
+    break;
+  default:
+    switch (OP::GetOpCodeClass(opcode)) {
+    case OP::OpCodeClass::Unary:
+    case OP::OpCodeClass::IsSpecialFloat:
+    case OP::OpCodeClass::Dot2:
+    case OP::OpCodeClass::Dot3:
+    case OP::OpCodeClass::Dot4:
+      Stats.FloatInstructionCount++;
+      break;
+    case OP::OpCodeClass::UnaryBits:
+      m_BitwiseInstructionCount++;
+      break;
+    case OP::OpCodeClass::BitcastF16toI16:
+    case OP::OpCodeClass::BitcastF32toI32:
+    case OP::OpCodeClass::BitcastF64toI64:
+    case OP::OpCodeClass::BitcastI16toF16:
+    case OP::OpCodeClass::BitcastI32toF32:
+    case OP::OpCodeClass::BitcastI64toF64:
+    case OP::OpCodeClass::LegacyDoubleToFloat:
+    case OP::OpCodeClass::LegacyDoubleToSInt32:
+    case OP::OpCodeClass::LegacyDoubleToUInt32:
+    case OP::OpCodeClass::LegacyF16ToF32:
+    case OP::OpCodeClass::LegacyF32ToF16:
+    case OP::OpCodeClass::MakeDouble:
+    case OP::OpCodeClass::SplitDouble:
+      m_ConversionInstructionCount++;
+      break;
+    default:
+      break;
+    }
+    break;
+  }
+}
+
+// Gathers the instruction statistics in a single pass over every function
+// body. DXIL has no registers, so the counts are approximations of what the
+// equivalent DXBC would report: phi nodes stand in for moves, selects for
+// conditional moves, and loads and stores through an element pointer for
+// indexed temporary accesses.
+void DxilShaderReflection::CollectInstructionStats() {
+  // Start from zero so that a retry after a failed pass does not count the
+  // instructions seen by that pass twice.
+  ZeroMemory(&m_InstructionStats, sizeof(m_InstructionStats));
+  m_MovInstructionCount = 0;
+  m_MovcInstructionCount = 0;
+  m_ConversionInstructionCount = 0;
+  m_BitwiseInstructionCount = 0;
+  for (Function &F : *m_pModule) {
+    // Load one body at a time and release it once counted, so that asking
+    // for statistics doesn't keep the whole module in memory.
+    bool ReleaseBody = F.isMaterializable();
+    if (ReleaseBody)
+      IFTLLVM(F.materialize());
+    CountInstructions(F);
+    if (ReleaseBody)
+      F.dematerialize();
+  }
+}
+
+void DxilShaderReflection::CountInstructions(Function &F) {
+  D3D12_SHADER_DESC &Stats = m_InstructionStats;
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      if (CallInst *CI = dyn_cast<CallInst>(&I)) {
+        // Other calls are debug information and lifetime markers.
+        if (OP::IsDxilOpFuncCallInst(CI)) {
+          Stats.InstructionCount++;
+          CountDxilOpInstruction(OP::GetDxilOpFuncCallInst(CI));
+        }
+        continue;
+      }
+
+      switch (I.getOpcode()) {
+      case Instruction::Alloca:
+        if (cast<AllocaInst>(I).getAllocatedType()->isArrayTy())
+          Stats.TempArrayCount++;
+        // Not an instruction of its own.
+        continue;
+      case Instruction::GetElementPtr:
+        // Folded into the load or store that uses it.
+        continue;
+      case Instruction::FAdd:
+      case Instruction::FSub:
+      case Instruction::FMul:
+      case Instruction::FDiv:
+      case Instruction::FRem:
+      case Instruction::FCmp:
+        Stats.FloatInstructionCount++;
+        break;
+      case Instruction::Add:
+      case Instruction::Sub:
+      case Instruction::Mul:
+      case Instruction::SDiv:
+      case Instruction::SRem:
+        Stats.IntInstructionCount++;
+        break;
+      case Instruction::UDiv:
+      case Instruction::URem:
+        Stats.UintInstructionCount++;
+        break;
+      case Instruction::ICmp:
+        if (cast<ICmpInst>(I).isUnsigned())
+          Stats.UintInstructionCount++;
+        else
+          Stats.IntInstructionCount++;
+        break;
+      case Instruction::And:
+      case Instruction::Or:
+      case Instruction::Xor:
+      case Instruction::Shl:
+      case Instruction::LShr:
+      case Instruction::AShr:
+        m_BitwiseInstructionCount++;
+        break;
+      case Instruction::Trunc:
+      case Instruction::ZExt:
+      case Instruction::SExt:
+      case Instruction::FPToUI:
+      case Instruction::FPToSI:
+      case Instruction::UIToFP:
+      case Instruction::SIToFP:
+      case Instruction::FPTrunc:
+      case Instruction::FPExt:
+      case Instruction::BitCast:
+        m_ConversionInstructionCount++;
+        break;
+      case Instruction::Select:
+        m_MovcInstructionCount++;
+        break;
+      case Instruction::PHI:
+        m_MovInstructionCount++;
+        break;
+      case Instruction::Load:
+        if (isa<GEPOperator>(cast<LoadInst>(I).getPointerOperand()))
+          Stats.ArrayInstructionCount++;
+        break;
+      case Instruction::Store:
+        if (isa<GEPOperator>(cast<StoreInst>(I).getPointerOperand()))
+          Stats.ArrayInstructionCount++;
+        break;
+      case Instruction::Br:
+        if (cast<BranchInst>(I).isConditional())
+          Stats.DynamicFlowControlCount++;
+        else
+          Stats.StaticFlowControlCount++;
+        break;
+      case Instruction::Switch:
+        Stats.DynamicFlowControlCount++;
+        break;
+      case Instruction::Ret:
+        Stats.StaticFlowControlCount++;
+        break;
+      default:
+        break;
+      }
+      Stats.InstructionCount++;
+    }
+  }
 }
 
 static D3D_REGISTER_COMPONENT_TYPE CompTypeToRegisterComponentType(CompType CT) {
@@ -1111,15 +1416,10 @@ HRESULT DxilShaderReflection::Load(IDxcBlob *pBlob,
     const char *pBitcode;
     uint32_t bitcodeLength;
     GetDxilProgramBitcode((DxilProgramHeader *)pData, &pBitcode, &bitcodeLength);
-    std::unique_ptr<MemoryBuffer> pMemBuffer =
-        MemoryBuffer::getMemBufferCopy(StringRef(pBitcode, bitcodeLength));
-#if 0 // We materialize eagerly, because we'll need to walk instructions to look for usage information.
-    ErrorOr<std::unique_ptr<Module>> module =
-        getLazyBitcodeModule(std::move(pMemBuffer), Context);
-#else
+    // The container is kept alive for as long as the module, so the bitcode
+    // can be read in place. Function bodies are materialized on demand.
     ErrorOr<std::unique_ptr<Module>> module =
-      parseBitcodeFile(pMemBuffer->getMemBufferRef(), Context, nullptr);
-#endif
+        LoadLazyDxilModule(StringRef(pBitcode, bitcodeLength), Context);
     if (!module) {
       return E_INVALIDARG;
     }
@@ -1147,37 +1447,55 @@ HRESULT DxilShaderReflection::GetDesc(D3D12_SHADER_DESC *pDesc) {
   pDesc->OutputParameters = m_OutputSignature.size();
   pDesc->PatchConstantParameters = m_PatchConstantSignature.size();
 
-  // Unset:  UINT                    InstructionCount;            // Number of emitted instructions
-  // Unset:  UINT                    TempRegisterCount;           // Number of temporary registers used 
-  // Unset:  UINT                    TempArrayCount;              // Number of temporary arrays used
-  // Unset:  UINT                    DefCount;                    // Number of constant defines 
-  // Unset:  UINT                    DclCount;                    // Number of declarations (input + output)
-  // Unset:  UINT                    TextureNormalInstructions;   // Number of non-categorized texture instructions
-  // Unset:  UINT                    TextureLoadInstructions;     // Number of texture load instructions
-  // Unset:  UINT                    TextureCompInstructions;     // Number of texture comparison instructions
-  // Unset:  UINT                    TextureBiasInstructions;     // Number of texture bias instructions
-  // Unset:  UINT                    TextureGradientInstructions; // Number of texture gradient instructions
-  // Unset:  UINT                    FloatInstructionCount;       // Number of floating point arithmetic instructions used
-  // Unset:  UINT                    IntInstructionCount;         // Number of signed integer arithmetic instructions used
-  // Unset:  UINT                    UintInstructionCount;        // Number of unsigned integer arithmetic instructions used
-  // Unset:  UINT                    StaticFlowControlCount;      // Number of static flow control instructions used
-  // Unset:  UINT                    DynamicFlowControlCount;     // Number of dynamic flow control instructions used
-  // Unset:  UINT                    MacroInstructionCount;       // Number of macro instructions used
-  // Unset:  UINT                    ArrayInstructionCount;       // Number of array instructions used
-  // Unset:  UINT                    CutInstructionCount;         // Number of cut instructions used
-  // Unset:  UINT                    EmitInstructionCount;        // Number of emit instructions used
-  // Unset:  D3D_PRIMITIVE_TOPOLOGY  GSOutputTopology;            // Geometry shader output topology
-  // Unset:  UINT                    GSMaxOutputVertexCount;      // Geometry shader maximum output vertex count
-  // Unset:  D3D_PRIMITIVE           InputPrimitive;              // GS/HS input primitive
-  // Unset:  UINT                    cGSInstanceCount;            // Number of Geometry shader instances
-  // Unset:  UINT                    cControlPoints;              // Number of control points in the HS->DS stage
-  // Unset:  D3D_TESSELLATOR_OUTPUT_PRIMITIVE HSOutputPrimitive;  // Primitive output by the tessellator
-  // Unset:  D3D_TESSELLATOR_PARTITIONING HSPartitioning;         // Partitioning mode of the tessellator
-  // Unset:  D3D_TESSELLATOR_DOMAIN  TessellatorDomain;           // Domain of the tessellator (quad, tri, isoline)
+  // The statistics read every function body the first time they are needed;
+  // if the bodies can't be read, they are left at zero rather than failing
+  // the rest of the description.
+  if (SUCCEEDED(EnsureInstructionStatsLoaded())) {
+    const D3D12_SHADER_DESC &Stats = m_InstructionStats;
+    pDesc->InstructionCount = Stats.InstructionCount;
+    // Unset:  UINT                    TempRegisterCount;           // Number of temporary registers used 
+    pDesc->TempArrayCount = Stats.TempArrayCount;
+    // Unset:  UINT                    DefCount;                    // Number of constant defines 
+    // Unset:  UINT                    DclCount;                    // Number of declarations (input + output)
+    pDesc->TextureNormalInstructions = Stats.TextureNormalInstructions;
+    pDesc->TextureLoadInstructions = Stats.TextureLoadInstructions;
+    pDesc->TextureCompInstructions = Stats.TextureCompInstructions;
+    pDesc->TextureBiasInstructions = Stats.TextureBiasInstructions;
+    pDesc->TextureGradientInstructions = Stats.TextureGradientInstructions;
+    pDesc->FloatInstructionCount = Stats.FloatInstructionCount;
+    pDesc->IntInstructionCount = Stats.IntInstructionCount;
+    pDesc->UintInstructionCount = Stats.UintInstructionCount;
+    pDesc->StaticFlowControlCount = Stats.StaticFlowControlCount;
+    pDesc->DynamicFlowControlCount = Stats.DynamicFlowControlCount;
+    // Unset:  UINT                    MacroInstructionCount;       // Number of macro instructions used
+    pDesc->ArrayInstructionCount = Stats.ArrayInstructionCount;
+    pDesc->CutInstructionCount = Stats.CutInstructionCount;
+    pDesc->EmitInstructionCount = Stats.EmitInstructionCount;
+  }
+
+  if (pSM->IsGS()) {
+    pDesc->GSOutputTopology = (D3D_PRIMITIVE_TOPOLOGY)M.GetStreamPrimitiveTopology();
+    pDesc->GSMaxOutputVertexCount = M.GetMaxVertexCount();
+    pDesc->InputPrimitive = (D3D_PRIMITIVE)M.GetInputPrimitive();
+    pDesc->cGSInstanceCount = M.GetGSInstanceCount();
+  }
+  if (pSM->IsHS() || pSM->IsDS()) {
+    pDesc->cControlPoints = pSM->IsHS() ? M.GetOutputControlPointCount()
+                                        : M.GetInputControlPointCount();
+    pDesc->TessellatorDomain = (D3D_TESSELLATOR_DOMAIN)M.GetTessellatorDomain();
+  }
+  if (pSM->IsHS()) {
+    if (M.GetInputControlPointCount() != 0)
+      pDesc->InputPrimitive = (D3D_PRIMITIVE)(D3D_PRIMITIVE_1_CONTROL_POINT_PATCH +
+                                              M.GetInputControlPointCount() - 1);
+    pDesc->HSOutputPrimitive = (D3D_TESSELLATOR_OUTPUT_PRIMITIVE)M.GetTessellatorOutputPrimitive();
+    pDesc->HSPartitioning = (D3D_TESSELLATOR_PARTITIONING)M.GetTessellatorPartitioning();
+  }
+
   // instruction counts
-  // Unset:  UINT cBarrierInstructions;                           // Number of barrier instructions in a compute shader
-  // Unset:  UINT cInterlockedInstructions;                       // Number of interlocked instructions
-  // Unset:  UINT cTextureStoreInstructions;                      // Number of texture writes
+  pDesc->cBarrierInstructions = Stats.cBarrierInstructions;
+  pDesc->cInterlockedInstructions = Stats.cInterlockedInstructions;
+  pDesc->cTextureStoreInstructions = Stats.cTextureStoreInstructions;
   return S_OK;
 }
 
@@ -1258,6 +1576,8 @@ ID3D12ShaderReflectionConstantBuffer* DxilShaderReflection::GetConstantBufferByI
   if (Index >= m_CBs.size()) {
     return &g_InvalidSRConstantBuffer;
   }
+  // Variables are reported as used if usage can't be determined.
+  EnsureUsageLoaded();
   return &m_CBs[Index];
 }
 
@@ -1266,6 +1586,7 @@ ID3D12ShaderReflectionConstantBuffer* DxilShaderReflection::GetConstantBufferByN
   if (!Name) {
     return &g_InvalidSRConstantBuffer;
   }
+  EnsureUsageLoaded();
   for (UINT index = 0; index < m_CBs.size(); ++index) {
     if (0 == strcmp(m_CBs[index].GetName(), Name)) {
       return &m_CBs[index];
@@ -1293,6 +1614,7 @@ HRESULT DxilShaderReflection::GetInputParameterDesc(UINT ParameterIndex,
   _Out_ D3D12_SIGNATURE_PARAMETER_DESC *pDesc) {
   IFRBOOL(pDesc != nullptr, E_INVALIDARG);
   IFRBOOL(ParameterIndex < m_InputSignature.size(), E_INVALIDARG);
+  IFR(EnsureUsageLoaded());
   if (m_PublicAPI != PublicAPI::D3D11_43)
     *pDesc = m_InputSignature[ParameterIndex];
   else
@@ -1308,6 +1630,7 @@ HRESULT DxilShaderReflection::GetOutputParameterDesc(UINT ParameterIndex,
   D3D12_SIGNATURE_PARAMETER_DESC *pDesc) {
   IFRBOOL(pDesc != nullptr, E_INVALIDARG);
   IFRBOOL(ParameterIndex < m_OutputSignature.size(), E_INVALIDARG);
+  IFR(EnsureUsageLoaded());
   if (m_PublicAPI != PublicAPI::D3D11_43)
     *pDesc = m_OutputSignature[ParameterIndex];
   else
@@ -1323,6 +1646,7 @@ HRESULT DxilShaderReflection::GetPatchConstantParameterDesc(UINT ParameterIndex,
   D3D12_SIGNATURE_PARAMETER_DESC *pDesc) {
   IFRBOOL(pDesc != nullptr, E_INVALIDARG);
   IFRBOOL(ParameterIndex < m_PatchConstantSignature.size(), E_INVALIDARG);
+  IFR(EnsureUsageLoaded());
   if (m_PublicAPI != PublicAPI::D3D11_43)
     *pDesc = m_PatchConstantSignature[ParameterIndex];
   else
@@ -1336,6 +1660,7 @@ HRESULT DxilShaderReflection::GetPatchConstantParameterDesc(UINT ParameterIndex,
 _Use_decl_annotations_
 ID3D12ShaderReflectionVariable* DxilShaderReflection::GetVariableByName(LPCSTR Name) {
   if (Name != nullptr) {
+    EnsureUsageLoaded();
     // Iterate through all cbuffers to find the variable.
     for (UINT i = 0; i < m_CBs.size(); i++) {
       ID3D12ShaderReflectionVariable *pVar = m_CBs[i].GetVariableByName(Name);
@@ -1369,10 +1694,27 @@ HRESULT DxilShaderReflection::GetResourceBindingDescByName(LPCSTR Name,
   return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
 }
 
-UINT DxilShaderReflection::GetMovInstructionCount() { return 0; }
-UINT DxilShaderReflection::GetMovcInstructionCount() { return 0; }
-UINT DxilShaderReflection::GetConversionInstructionCount() { return 0; }
-UINT DxilShaderReflection::GetBitwiseInstructionCount() { return 0; }
+// Counts are reported as zero if the function bodies can't be loaded.
+UINT DxilShaderReflection::GetMovInstructionCount() {
+  if (FAILED(EnsureInstructionStatsLoaded()))
+    return 0;
+  return m_MovInstructionCount;
+}
+UINT DxilShaderReflection::GetMovcInstructionCount() {
+  if (FAILED(EnsureInstructionStatsLoaded()))
+    return 0;
+  return m_MovcInstructionCount;
+}
+UINT DxilShaderReflection::GetConversionInstructionCount() {
+  if (FAILED(EnsureInstructionStatsLoaded()))
+    return 0;
+  return m_ConversionInstructionCount;
+}
+UINT DxilShaderReflection::GetBitwiseInstructionCount() {
+  if (FAILED(EnsureInstructionStatsLoaded()))
+    return 0;
+  return m_BitwiseInstructionCount;
+}
 
 D3D_PRIMITIVE DxilShaderReflection::GetGSInputPrimitive() {
   return (D3D_PRIMITIVE)m_pDxilModule->GetInputPrimitive();
@@ -22,6 +22,8 @@
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/DebugInfo.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 #include <unordered_set>
 
@@ -1188,6 +1190,17 @@ DebugInfoFinder &DxilModule::GetOrCreateDebugInfoFinder() {
   }
   return *m_pDebugInfoFinder;
 }
+
+ErrorOr<std::unique_ptr<Module>> LoadLazyDxilModule(StringRef Bitcode,
+                                                    LLVMContext &Ctx) {
+  std::unique_ptr<MemoryBuffer> pBuffer =
+      MemoryBuffer::getMemBuffer(Bitcode, "", false);
+  ErrorOr<std::unique_ptr<Module>> pModule =
+      getLazyBitcodeModule(std::move(pBuffer), Ctx);
+  if (pModule && (*pModule)->getNamedMetadata("dx.version"))
+    (*pModule)->GetOrCreateDxilModule();
+  return pModule;
+}
 } // namespace hlsl
 
 namespace llvm {
@@ -0,0 +1,455 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilShaderCost.cpp                                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a static cost estimate for DXIL shaders.                         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilShaderCost.h"
+#include "dxc/HLSL/DxilModule.h"
+#include "dxc/HLSL/DxilOperations.h"
+#include "dxc/HLSL/DxilSignature.h"
+#include "dxc/HLSL/DxilSignatureElement.h"
+#include "dxc/Support/Global.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+// Loops that run longer than this are reported as having an unknown count.
+static const unsigned MaxSimulatedTripCount = 4096;
+
+///////////////////////////////////////////////////////////////////////////////
+// Instruction classification.
+
+namespace {
+enum class CostCategory { None, ALU, Texture, Memory, Wave };
+}
+
+static CostCategory ClassifyDxilOp(OP::OpCode opcode) {
+  if (OP::IsDxilOpWave(opcode))
+    return CostCategory::Wave;
+
+  switch (opcode) {
+  case OP::OpCode::BufferLoad:
+  case OP::OpCode::BufferStore:
+  case OP::OpCode::BufferUpdateCounter:
+  case OP::OpCode::CBufferLoad:
+  case OP::OpCode::CBufferLoadLegacy:
+  case OP::OpCode::AtomicBinOp:
+  case OP::OpCode::AtomicCompareExchange:
+    return CostCategory::Memory;
+  default:
+    break;
+  }
+
+  switch (OP::GetOpCodeClass(opcode)) {
+  case OP::OpCodeClass::Sample:
+  case OP::OpCodeClass::SampleBias:
+  case OP::OpCodeClass::SampleCmp:
+  case OP::OpCodeClass::SampleCmpLevelZero:
+  case OP::OpCodeClass::SampleGrad:
+  case OP::OpCodeClass::SampleLevel:
+  case OP::OpCodeClass::TextureGather:
+  case OP::OpCodeClass::TextureGatherCmp:
+  case OP::OpCodeClass::TextureLoad:
+  case OP::OpCodeClass::TextureStore:
+  case OP::OpCodeClass::CalculateLOD:
+  case OP::OpCodeClass::GetDimensions:
+  case OP::OpCodeClass::Texture2DMSGetSamplePosition:
+    return CostCategory::Texture;
+  case OP::OpCodeClass::Unary:
+  case OP::OpCodeClass::UnaryBits:
+  case OP::OpCodeClass::IsSpecialFloat:
+  case OP::OpCodeClass::Binary:
+  case OP::OpCodeClass::BinaryWithCarry:
+  case OP::OpCodeClass::BinaryWithTwoOuts:
+  case OP::OpCodeClass::Tertiary:
+  case OP::OpCodeClass::Quaternary:
+  case OP::OpCodeClass::Dot2:
+  case OP::OpCodeClass::Dot3:
+  case OP::OpCodeClass::Dot4:
+  case OP::OpCodeClass::BitcastF16toI16:
+  case OP::OpCodeClass::BitcastF32toI32:
+  case OP::OpCodeClass::BitcastF64toI64:
+  case OP::OpCodeClass::BitcastI16toF16:
+  case OP::OpCodeClass::BitcastI32toF32:
+  case OP::OpCodeClass::BitcastI64toF64:
+  case OP::OpCodeClass::LegacyDoubleToFloat:
+  case OP::OpCodeClass::LegacyDoubleToSInt32:
+  case OP::OpCodeClass::LegacyDoubleToUInt32:
+  case OP::OpCodeClass::LegacyF16ToF32:
+  case OP::OpCodeClass::LegacyF32ToF16:
+  case OP::OpCodeClass::MakeDouble:
+  case OP::OpCodeClass::SplitDouble:
+    return CostCategory::ALU;
+  default:
+    // Input/output, handle creation and system values.
+    return CostCategory::None;
+  }
+}
+
+static CostCategory ClassifyInstruction(const Instruction &I) {
+  if (const CallInst *CI = dyn_cast<CallInst>(&I)) {
+    if (!OP::IsDxilOpFuncCallInst(CI))
+      return CostCategory::None;
+    return ClassifyDxilOp(OP::GetDxilOpFuncCallInst(CI));
+  }
+  if (I.isBinaryOp() || I.isCast() || isa<CmpInst>(I) || isa<SelectInst>(I))
+    return CostCategory::ALU;
+  if (isa<LoadInst>(I) || isa<StoreInst>(I) || isa<AtomicRMWInst>(I) ||
+      isa<AtomicCmpXchgInst>(I))
+    return CostCategory::Memory;
+  return CostCategory::None;
+}
+
+static uint64_t SaturatingAdd(uint64_t A, uint64_t B) {
+  return A > UINT64_MAX - B ? UINT64_MAX : A + B;
+}
+
+static uint64_t SaturatingMultiply(uint64_t A, uint64_t B) {
+  return B != 0 && A > UINT64_MAX / B ? UINT64_MAX : A * B;
+}
+
+uint64_t DxilShaderCostCounts::Total() const {
+  return SaturatingAdd(SaturatingAdd(ALU, Texture), SaturatingAdd(Memory, Wave));
+}
+
+static void AddCount(DxilShaderCostCounts &Counts, CostCategory Category,
+                     uint64_t Amount) {
+  uint64_t *pCount = nullptr;
+  switch (Category) {
+  case CostCategory::ALU: pCount = &Counts.ALU; break;
+  case CostCategory::Texture: pCount = &Counts.Texture; break;
+  case CostCategory::Memory: pCount = &Counts.Memory; break;
+  case CostCategory::Wave: pCount = &Counts.Wave; break;
+  case CostCategory::None: return;
+  }
+  *pCount = SaturatingAdd(*pCount, Amount);
+}
+
+static void AddCounts(DxilShaderCostCounts &Counts,
+                      const DxilShaderCostCounts &Other) {
+  AddCount(Counts, CostCategory::ALU, Other.ALU);
+  AddCount(Counts, CostCategory::Texture, Other.Texture);
+  AddCount(Counts, CostCategory::Memory, Other.Memory);
+  AddCount(Counts, CostCategory::Wave, Other.Wave);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Loop trip counts.
+
+static bool EvaluateICmp(CmpInst::Predicate Pred, const APInt &LHS,
+                         const APInt &RHS) {
+  switch (Pred) {
+  case CmpInst::ICMP_EQ: return LHS.eq(RHS);
+  case CmpInst::ICMP_NE: return LHS.ne(RHS);
+  case CmpInst::ICMP_UGT: return LHS.ugt(RHS);
+  case CmpInst::ICMP_UGE: return LHS.uge(RHS);
+  case CmpInst::ICMP_ULT: return LHS.ult(RHS);
+  case CmpInst::ICMP_ULE: return LHS.ule(RHS);
+  case CmpInst::ICMP_SGT: return LHS.sgt(RHS);
+  case CmpInst::ICMP_SGE: return LHS.sge(RHS);
+  case CmpInst::ICMP_SLT: return LHS.slt(RHS);
+  case CmpInst::ICMP_SLE: return LHS.sle(RHS);
+  default: return false;
+  }
+}
+
+// Recognizes loops controlled by a single induction variable that starts at a
+// constant and is stepped by a constant until a comparison against a constant
+// exits the loop, and returns the number of iterations, that is the number of
+// times the body runs. Returns 0 for any other loop.
+static unsigned GetConstantTripCount(Loop *L) {
+  BasicBlock *Header = L->getHeader();
+  BasicBlock *Preheader = L->getLoopPreheader();
+  BasicBlock *Latch = L->getLoopLatch();
+  BasicBlock *Exiting = L->getExitingBlock();
+  if (!Preheader || !Latch || !Exiting || (Exiting != Header && Exiting != Latch))
+    return 0;
+
+  BranchInst *BI = dyn_cast<BranchInst>(Exiting->getTerminator());
+  if (!BI || !BI->isConditional())
+    return 0;
+  ICmpInst *Cmp = dyn_cast<ICmpInst>(BI->getCondition());
+  if (!Cmp)
+    return 0;
+  CmpInst::Predicate Pred = Cmp->getPredicate();
+  Value *Tested = Cmp->getOperand(0);
+  ConstantInt *Bound = dyn_cast<ConstantInt>(Cmp->getOperand(1));
+  if (!Bound) {
+    Tested = Cmp->getOperand(1);
+    Bound = dyn_cast<ConstantInt>(Cmp->getOperand(0));
+    Pred = CmpInst::getSwappedPredicate(Pred);
+  }
+  if (!Bound)
+    return 0;
+  // The loop exits when the comparison has this value.
+  bool ExitWhen = !L->contains(BI->getSuccessor(0));
+
+  // The tested value is either the induction variable or its next value.
+  PHINode *IV = dyn_cast<PHINode>(Tested);
+  bool TestsNext = false;
+  if (!IV) {
+    BinaryOperator *Step = dyn_cast<BinaryOperator>(Tested);
+    if (!Step)
+      return 0;
+    IV = dyn_cast<PHINode>(Step->getOperand(0));
+    TestsNext = true;
+  }
+  if (!IV || IV->getParent() != Header || IV->getNumIncomingValues() != 2)
+    return 0;
+
+  ConstantInt *Start = dyn_cast<ConstantInt>(IV->getIncomingValueForBlock(Preheader));
+  BinaryOperator *Next = dyn_cast<BinaryOperator>(IV->getIncomingValueForBlock(Latch));
+  if (!Start || !Next || Next->getOperand(0) != IV || (TestsNext && Tested != Next))
+    return 0;
+  ConstantInt *Step = dyn_cast<ConstantInt>(Next->getOperand(1));
+  if (!Step || (Next->getOpcode() != Instruction::Add &&
+                Next->getOpcode() != Instruction::Sub))
+    return 0;
+
+  // Count how many times the exiting block runs. When that is the header
+  // but not the latch, it runs once more than the body, to take the exit.
+  unsigned HeaderExit = Exiting == Header && Exiting != Latch ? 1 : 0;
+  APInt Value = Start->getValue();
+  const APInt &StepValue = Step->getValue();
+  bool IsAdd = Next->getOpcode() == Instruction::Add;
+  for (unsigned Count = 1; Count <= MaxSimulatedTripCount + HeaderExit;
+       ++Count) {
+    APInt NextValue = IsAdd ? Value + StepValue : Value - StepValue;
+    const APInt &Compared = TestsNext ? NextValue : Value;
+    if (EvaluateICmp(Pred, Compared, Bound->getValue()) == ExitWhen)
+      return Count - HeaderExit;
+    Value = NextValue;
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Register pressure.
+
+static bool IsRegisterValue(const Value *V, const Type *HandleTy) {
+  if (!isa<Instruction>(V) && !isa<Argument>(V))
+    return false;
+  Type *Ty = V->getType();
+  return !Ty->isVoidTy() && !Ty->isPointerTy() && !Ty->isLabelTy() &&
+         Ty != HandleTy;
+}
+
+// Computes SSA liveness per block and returns the largest number of values
+// live at any point in the function.
+static unsigned ComputePeakLiveValues(Function &F, const Type *HandleTy) {
+  typedef DenseSet<const Value *> ValueSet;
+  DenseMap<const BasicBlock *, ValueSet> LiveIn;
+  DenseMap<const BasicBlock *, ValueSet> LiveOut;
+
+  // Walks a block backwards from its live-out set, tracking the largest
+  // number of values live at any point if pPeak is set. Returns the live-in
+  // set.
+  auto WalkBlock = [&](BasicBlock &BB, ValueSet Live,
+                       unsigned *pPeak) -> ValueSet {
+    for (auto It = BB.rbegin(), End = BB.rend(); It != End; ++It) {
+      Instruction &I = *It;
+      if (pPeak)
+        *pPeak = std::max(*pPeak, (unsigned)Live.size());
+      Live.erase(&I);
+      // Phi operands are live at the end of the predecessor instead.
+      if (isa<PHINode>(I))
+        continue;
+      for (Value *Op : I.operands()) {
+        if (IsRegisterValue(Op, HandleTy))
+          Live.insert(Op);
+      }
+    }
+    return Live;
+  };
+
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (auto BBIt = F.rbegin(), End = F.rend(); BBIt != End; ++BBIt) {
+      BasicBlock &BB = *BBIt;
+      ValueSet Out;
+      for (BasicBlock *Succ : successors(&BB)) {
+        for (const Value *V : LiveIn[Succ])
+          Out.insert(V);
+        for (Instruction &I : *Succ) {
+          PHINode *Phi = dyn_cast<PHINode>(&I);
+          if (!Phi)
+            break;
+          Out.erase(Phi);
+          Value *Incoming = Phi->getIncomingValueForBlock(&BB);
+          if (IsRegisterValue(Incoming, HandleTy))
+            Out.insert(Incoming);
+        }
+      }
+      ValueSet In = WalkBlock(BB, Out, nullptr);
+      if (In.size() != LiveIn[&BB].size() || Out.size() != LiveOut[&BB].size()) {
+        // Sets only grow, so comparing sizes is enough.
+        LiveIn[&BB] = std::move(In);
+        LiveOut[&BB] = std::move(Out);
+        Changed = true;
+      }
+    }
+  }
+
+  unsigned Peak = 0;
+  for (BasicBlock &BB : F)
+    WalkBlock(BB, LiveOut[&BB], &Peak);
+  return Peak;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Path costs.
+
+static void AnalyzeFunction(Function &F, const Type *HandleTy,
+                            DxilShaderCost &Cost) {
+  DominatorTreeAnalysis DTA;
+  DominatorTree DT = DTA.run(F);
+  LoopInfo LI;
+  LI.Analyze(DT);
+
+  DenseMap<const Loop *, unsigned> TripCounts;
+  SmallVector<Loop *, 8> Worklist(LI.begin(), LI.end());
+  while (!Worklist.empty()) {
+    Loop *L = Worklist.pop_back_val();
+    DxilShaderCostLoop Entry;
+    Entry.Depth = L->getLoopDepth();
+    Entry.Line = 0;
+    if (const DebugLoc &DL = L->getHeader()->getFirstNonPHI()->getDebugLoc())
+      Entry.Line = DL.getLine();
+    Entry.TripCount = GetConstantTripCount(L);
+    TripCounts[L] = Entry.TripCount;
+    Cost.Loops.push_back(Entry);
+    Worklist.append(L->begin(), L->end());
+  }
+
+  // The CFG is reducible, so every edge to a block earlier in reverse
+  // post-order is a loop back edge; ignoring those leaves a DAG.
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  DenseMap<const BasicBlock *, unsigned> Order;
+  DenseMap<const BasicBlock *, DxilShaderCostCounts> Best;
+  DxilShaderCostCounts Longest;
+  for (BasicBlock *BB : RPOT) {
+    unsigned Index = Order.size();
+    Order[BB] = Index;
+
+    DxilShaderCostCounts Counts;
+    for (BasicBlock *Pred : predecessors(BB)) {
+      auto PredOrder = Order.find(Pred);
+      if (PredOrder == Order.end() || PredOrder->second >= Index)
+        continue;
+      const DxilShaderCostCounts &PredCounts = Best[Pred];
+      if (PredCounts.Total() > Counts.Total())
+        Counts = PredCounts;
+    }
+
+    uint64_t Weight = 1;
+    for (Loop *L = LI.getLoopFor(BB); L; L = L->getParentLoop()) {
+      if (unsigned TripCount = TripCounts[L])
+        Weight = SaturatingMultiply(Weight, TripCount);
+    }
+    for (Instruction &I : *BB)
+      AddCount(Counts, ClassifyInstruction(I), Weight);
+
+    Best[BB] = Counts;
+    if (isa<ReturnInst>(BB->getTerminator()) && Counts.Total() > Longest.Total())
+      Longest = Counts;
+  }
+
+  AddCounts(Cost.LongestPath, Longest);
+  Cost.PeakLiveValues =
+      std::max(Cost.PeakLiveValues, ComputePeakLiveValues(F, HandleTy));
+}
+
+static unsigned CountSignatureRows(const DxilSignature &Sig) {
+  unsigned Rows = 0;
+  for (auto &E : Sig.GetElements()) {
+    if (E->IsAllocated())
+      Rows = std::max(Rows, E->GetStartRow() + E->GetRows());
+  }
+  return Rows;
+}
+
+void hlsl::ComputeDxilShaderCost(DxilModule &DM, DxilShaderCost &Cost) {
+  Cost = DxilShaderCost();
+  const Type *HandleTy = DM.GetOP()->GetHandleType();
+  if (Function *F = DM.GetEntryFunction())
+    AnalyzeFunction(*F, HandleTy, Cost);
+  if (Function *F = DM.GetPatchConstantFunction())
+    AnalyzeFunction(*F, HandleTy, Cost);
+  Cost.InputRows = CountSignatureRows(DM.GetInputSignature());
+  Cost.OutputRows = CountSignatureRows(DM.GetOutputSignature());
+}
+
+void hlsl::PrintDxilShaderCost(const DxilShaderCost &Cost, raw_ostream &OS) {
+  const DxilShaderCostCounts &Path = Cost.LongestPath;
+  OS << "Longest path: " << Path.Total() << " instructions ("
+     << Path.ALU << " ALU, " << Path.Texture << " texture, "
+     << Path.Memory << " memory, " << Path.Wave << " wave)\n";
+  OS << "Peak live values: " << Cost.PeakLiveValues << "\n";
+  OS << "Signature rows: " << Cost.InputRows << " input, " << Cost.OutputRows
+     << " output\n";
+  OS << "Loops: " << Cost.Loops.size() << "\n";
+  for (const DxilShaderCostLoop &L : Cost.Loops) {
+    OS.indent(2 * L.Depth) << "depth " << L.Depth;
+    if (L.Line != 0)
+      OS << ", line " << L.Line;
+    if (L.TripCount != 0)
+      OS << ": " << L.TripCount << " iterations\n";
+    else
+      OS << ": unknown trip count\n";
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Pass.
+
+namespace {
+class DxilShaderCostPass : public ModulePass {
+private:
+  DxilShaderCost m_cost;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilShaderCostPass() : ModulePass(ID) {}
+  const char *getPassName() const override { return "DXIL Shader Cost"; }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
+  bool runOnModule(Module &M) override {
+    ComputeDxilShaderCost(M.GetOrCreateDxilModule(), m_cost);
+    return false;
+  }
+
+  void print(raw_ostream &OS, const Module *) const override {
+    PrintDxilShaderCost(m_cost, OS);
+  }
+};
+}
+
+char DxilShaderCostPass::ID = 0;
+
+ModulePass *llvm::createDxilShaderCostPass() {
+  return new DxilShaderCostPass();
+}
+
+INITIALIZE_PASS(DxilShaderCostPass, "hlsl-dxil-cost", "DXIL Shader Cost", false, true)
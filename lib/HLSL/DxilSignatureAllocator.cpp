@@ -210,6 +210,14 @@ struct {
   }
 } CmpElementsLess;
 
+// Elements that can swap places without changing the packed registers.
+bool IsInterchangeable(const DxilSignatureElement* left, const DxilSignatureElement* right) {
+  return left->GetRows() == right->GetRows() &&
+         left->GetCols() == right->GetCols() &&
+         left->GetInterpolationMode()->GetKind() == right->GetInterpolationMode()->GetKind() &&
+         DxilSignatureAllocator::GetElementFlags(left) == DxilSignatureAllocator::GetElementFlags(right);
+}
+
 } // anonymous namespace
 
 
@@ -248,7 +256,46 @@ unsigned DxilSignatureAllocator::PackGreedy(std::vector<DxilSignatureElement*> e
   return rowsUsed;
 }
 
-unsigned DxilSignatureAllocator::PackMain(std::vector<DxilSignatureElement*> elements, unsigned startRow, unsigned numRows) {
+bool DxilSignatureAllocator::PackSearch(const std::vector<DxilSignatureElement*> &items, unsigned index,
+                                        unsigned startRow, unsigned endRow,
+                                        std::vector<std::pair<unsigned, unsigned>> &placements,
+                                        unsigned &budget) {
+  if (index == items.size())
+    return true;
+
+  DxilSignatureElement *SE = items[index];
+  unsigned rows = SE->GetRows();
+  unsigned cols = SE->GetCols();
+
+  // Place interchangeable neighbors in increasing order, so that packings
+  // which only swap them aren't searched again.
+  unsigned firstSlot = 0;
+  if (index > 0 && IsInterchangeable(items[index - 1], SE))
+    firstSlot = placements[index - 1].first * 4 + placements[index - 1].second + 1;
+
+  for (unsigned row = startRow; row + rows <= endRow; ++row) {
+    if (DetectRowConflict(SE, row))
+      continue;
+    for (unsigned col = 0; col <= 4 - cols; ++col) {
+      if (row * 4 + col < firstSlot)
+        continue;
+      if (DetectColConflict(SE, row, col))
+        continue;
+      if (budget == 0)
+        return false;
+      --budget;
+      std::vector<PackedRegister> saved(Registers.begin() + row, Registers.begin() + row + rows);
+      PlaceElement(SE, row, col);
+      placements[index] = std::make_pair(row, col);
+      if (PackSearch(items, index + 1, startRow, endRow, placements, budget))
+        return true;
+      std::copy(saved.begin(), saved.end(), Registers.begin() + row);
+    }
+  }
+  return false;
+}
+
+unsigned DxilSignatureAllocator::PackMain(std::vector<DxilSignatureElement*> elements, unsigned startRow, unsigned numRows, unsigned searchBudget) {
   unsigned rowsUsed = startRow;
 
   // Clip/Cull needs special handling due to limitations unique to these.
@@ -276,6 +323,8 @@ unsigned DxilSignatureAllocator::PackMain(std::vector<DxilSignatureElement*> ele
   //      When found, allocate original sub-elements associated with temp element.
   //  - next, pack system value elements
   //  - finally, pack SGV elements
+  //  - with a search budget, look for a packing of everything after the
+  //    indexed tessfactors that uses fewer rows than the greedy one
 
   // ==========
   // Group elements
@@ -373,6 +422,12 @@ unsigned DxilSignatureAllocator::PackMain(std::vector<DxilSignatureElement*> ele
       rowsUsed = used;
   }
 
+  // The search starts over from here.
+  std::vector<PackedRegister> fixedRegisters;
+  unsigned fixedRowsUsed = rowsUsed;
+  if (searchBudget)
+    fixedRegisters = Registers;
+
   // ==========
   // Allocate arbitrary
   if (!arbElements.empty()) {
@@ -427,6 +482,74 @@ unsigned DxilSignatureAllocator::PackMain(std::vector<DxilSignatureElement*> ele
       rowsUsed = used;
   }
 
+  // ==========
+  // Search for a packing in fewer rows
+  if (searchBudget) {
+    // Items are searched in the order they were allocated above, with each
+    // clip/cull row represented by its temp element.
+    std::vector<DxilSignatureElement*> items;
+    items.insert(items.end(), arbElements.begin(), arbElements.end());
+    items.insert(items.end(), svElements.begin(), svElements.end());
+    for (unsigned i = 0; i < clipcullRegUsed; ++i)
+      items.push_back(&clipcullTempElements[i]);
+    items.insert(items.end(), sgvElements.begin(), sgvElements.end());
+
+    // An incomplete greedy packing doesn't bound the search.
+    bool bGreedyComplete = true;
+    for (unsigned i = 0; i < clipcullRegUsed; ++i)
+      bGreedyComplete &= clipcullElementsByRow[i][0]->IsAllocated();
+    unsigned components = 0;
+    unsigned minRows = std::max(fixedRowsUsed, startRow);
+    for (auto &SE : items) {
+      if (SE < clipcullTempElements || SE >= clipcullTempElements + 2)
+        bGreedyComplete &= SE->IsAllocated();
+      components += SE->GetRows() * SE->GetCols();
+      minRows = std::max(minRows, startRow + SE->GetRows());
+    }
+    minRows = std::max(minRows, startRow + (components + 3) / 4);
+    unsigned bestRows = bGreedyComplete ? rowsUsed : startRow + numRows + 1;
+
+    std::vector<PackedRegister> greedyRegisters(Registers);
+    std::vector<std::pair<unsigned, unsigned>> placements(items.size());
+    unsigned budget = searchBudget;
+    bool bFound = false;
+    for (unsigned endRow = minRows; endRow < bestRows && budget; ++endRow) {
+      Registers = fixedRegisters;
+      if (PackSearch(items, 0, startRow, endRow, placements, budget)) {
+        bFound = true;
+        break;
+      }
+    }
+
+    if (bFound) {
+      Registers = fixedRegisters;
+      rowsUsed = fixedRowsUsed;
+      for (unsigned i = 0; i < items.size(); ++i) {
+        DxilSignatureElement *item = items[i];
+        unsigned row = placements[i].first;
+        unsigned col = placements[i].second;
+        if (item >= clipcullTempElements && item < clipcullTempElements + 2) {
+          for (auto &SE : clipcullElementsByRow[item - clipcullTempElements]) {
+            PlaceElement(SE, row, col);
+            SE->SetStartRow((int)row);
+            SE->SetStartCol((int)col);
+            col += SE->GetCols();
+          }
+        }
+        else {
+          PlaceElement(item, row, col);
+          item->SetStartRow((int)row);
+          item->SetStartCol((int)col);
+        }
+        if (rowsUsed < row + item->GetRows())
+          rowsUsed = row + item->GetRows();
+      }
+    }
+    else {
+      Registers.swap(greedyRegisters);
+    }
+  }
+
   return rowsUsed;
 }
 
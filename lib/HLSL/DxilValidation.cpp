@@ -30,6 +30,7 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/TypeFinder.h"
 #include "llvm/ADT/BitVector.h"
 #include <winerror.h>
 #include "llvm/Support/raw_ostream.h"
@@ -39,6 +40,10 @@
 #include "dxc/HLSL/DxilSpanAllocator.h"
 #include "dxc/HLSL/DxilSignatureAllocator.h"
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 
 using namespace llvm;
@@ -288,6 +293,9 @@ struct ValidationContext {
   const unsigned kDxilPreciseMDKind;
   const unsigned kLLVMLoopMDKind;
   bool m_bCoverageIn, m_bInnerCoverageIn;
+  // Serializes lazy type creation in hlsl::OP when functions are validated
+  // concurrently; null otherwise.
+  std::mutex *pOPLock;
 
   ValidationContext(Module &llvmModule, Module *DebugModule,
                     DxilModule &dxilModule,
@@ -300,7 +308,7 @@ struct ValidationContext {
             DxilMDHelper::kDxilPreciseAttributeMDName)),
         kLLVMLoopMDKind(llvmModule.getContext().getMDKindID("llvm.loop")),
         DiagPrinter(DiagPrn), LastRuleEmit((ValidationRule)-1),
-        m_bCoverageIn(false), m_bInnerCoverageIn(false) {
+        m_bCoverageIn(false), m_bInnerCoverageIn(false), pOPLock(nullptr) {
     for (unsigned i = 0; i < DXIL::kNumOutputStreams; i++) {
       hasOutputPosition[i] = false;
       OutputPositionMask[i] = 0;
@@ -309,6 +317,23 @@ struct ValidationContext {
     patchConstCols.resize(DxilMod.GetPatchConstantSignature().GetElements().size(), 0);
   }
 
+  // Creates a context for validating a single function body on its own
+  // thread. Only state that function bodies read is carried over.
+  ValidationContext(const ValidationContext &Parent,
+                    DiagnosticPrinterRawOStream &DiagPrn, std::mutex *OPLock)
+      : M(Parent.M), pDebugModule(Parent.pDebugModule),
+        DxilMod(Parent.DxilMod), DL(Parent.DL), DiagPrinter(DiagPrn),
+        LastRuleEmit((ValidationRule)-1),
+        kDxilControlFlowHintMDKind(Parent.kDxilControlFlowHintMDKind),
+        kDxilPreciseMDKind(Parent.kDxilPreciseMDKind),
+        kLLVMLoopMDKind(Parent.kLLVMLoopMDKind), m_bCoverageIn(false),
+        m_bInnerCoverageIn(false), pOPLock(OPLock) {
+    for (unsigned i = 0; i < DXIL::kNumOutputStreams; i++) {
+      hasOutputPosition[i] = false;
+      OutputPositionMask[i] = 0;
+    }
+  }
+
   // Provide direct access to the raw_ostream in DiagPrinter.
   raw_ostream &DiagStream() {
     struct DiagnosticPrinterRawOStream_Pub : public DiagnosticPrinterRawOStream {
@@ -1982,6 +2007,14 @@ static bool IsDxilBuiltinStructType(StructType *ST, hlsl::OP *hlslOP) {
   }
 }
 
+static bool IsDxilBuiltinStructType(StructType *ST, ValidationContext &ValCtx) {
+  hlsl::OP *hlslOP = ValCtx.DxilMod.GetOP();
+  if (ValCtx.pOPLock == nullptr)
+    return IsDxilBuiltinStructType(ST, hlslOP);
+  std::lock_guard<std::mutex> lock(*ValCtx.pOPLock);
+  return IsDxilBuiltinStructType(ST, hlslOP);
+}
+
 static bool ValidateType(Type *Ty, ValidationContext &ValCtx) {
   DXASSERT_NOMSG(Ty != nullptr);
   if (Ty->isPointerTy()) {
@@ -2001,8 +2034,7 @@ static bool ValidateType(Type *Ty, ValidationContext &ValCtx) {
 
     StringRef Name = ST->getName();
     if (Name.startswith("dx.")) {
-      hlsl::OP *hlslOP = ValCtx.DxilMod.GetOP();
-      if (IsDxilBuiltinStructType(ST, hlslOP))
+      if (IsDxilBuiltinStructType(ST, ValCtx))
         return true;
 
       ValCtx.EmitTypeError(Ty, ValidationRule::DeclDxilNsReserved);
@@ -2056,7 +2088,8 @@ static bool GetNodeOperandAsInt(ValidationContext &ValCtx, MDNode *pMD, unsigned
 }
 
 static bool IsPrecise(Instruction &I, ValidationContext &ValCtx) {
-  MDNode *pMD = I.getMetadata(DxilMDHelper::kDxilPreciseAttributeMDName);
+  // Look up by kind rather than by name, which may touch the LLVMContext.
+  MDNode *pMD = I.getMetadata(ValCtx.kDxilPreciseMDKind);
   if (pMD == nullptr) {
     return false;
   }
@@ -2387,7 +2420,7 @@ static void ValidateFunctionBody(Function *F, ValidationContext &ValCtx) {
         if (StructType *ST = dyn_cast<StructType>(Ty)) {
           Value *Agg = EV->getAggregateOperand();
           if (!isa<AtomicCmpXchgInst>(Agg) &&
-              !IsDxilBuiltinStructType(ST, ValCtx.DxilMod.GetOP())) {
+              !IsDxilBuiltinStructType(ST, ValCtx)) {
             ValCtx.EmitInstrError(EV, ValidationRule::InstrExtractValue);
           }
         } else {
@@ -3909,6 +3942,83 @@ static void ValidateUninitializedOutput(ValidationContext &ValCtx) {
   }
 }
 
+// Function bodies don't depend on each other, so when a module has several
+// they are validated concurrently, each into its own diagnostic buffer.
+// External functions walk call sites across the whole module and accumulate
+// state in ValCtx, so they are validated afterwards on this thread, with the
+// buffered diagnostics of each body emitted in between in module order.
+// Bodies are buffered the same way when there is only one thread, so the
+// output doesn't depend on the number of cores.
+static void ValidateFunctions(ValidationContext &ValCtx) {
+  std::vector<Function *> bodies;
+  for (Function &F : ValCtx.M.functions()) {
+    if (!F.isDeclaration())
+      bodies.push_back(&F);
+  }
+  unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+  threadCount = std::min<unsigned>(threadCount, bodies.size());
+
+  if (threadCount > 1) {
+    // DataLayout computes struct layouts on first use; do so up front so
+    // worker threads only read its cache.
+    TypeFinder structTypes;
+    structTypes.run(ValCtx.M, /*onlyNamed*/ false);
+    for (StructType *ST : structTypes) {
+      if (!ST->isOpaque() && ST->isSized())
+        ValCtx.DL.getStructLayout(ST);
+    }
+  }
+
+  struct BodyResult {
+    std::string Diag;
+    bool Failed = false;
+    std::exception_ptr Exception;
+  };
+  std::vector<BodyResult> results(bodies.size());
+  std::atomic<unsigned> nextBody(0);
+  std::mutex opLock;
+  auto worker = [&]() {
+    for (unsigned i = nextBody++; i < bodies.size(); i = nextBody++) {
+      BodyResult &result = results[i];
+      try {
+        raw_string_ostream diagStream(result.Diag);
+        DiagnosticPrinterRawOStream diagPrinter(diagStream);
+        ValidationContext bodyCtx(ValCtx, diagPrinter, &opLock);
+        ValidateFunction(*bodies[i], bodyCtx);
+        diagStream.flush();
+        result.Failed = bodyCtx.Failed;
+      } catch (...) {
+        result.Exception = std::current_exception();
+      }
+    }
+  };
+
+  // The calling thread validates bodies too.
+  std::vector<std::thread> threads;
+  try {
+    for (unsigned i = 1; i < threadCount; ++i)
+      threads.emplace_back(worker);
+  } catch (const std::system_error &) {
+    // Continue with the threads that could be started.
+  }
+  worker();
+  for (std::thread &t : threads)
+    t.join();
+
+  unsigned bodyIndex = 0;
+  for (Function &F : ValCtx.M.functions()) {
+    if (F.isDeclaration()) {
+      ValidateFunction(F, ValCtx);
+      continue;
+    }
+    BodyResult &result = results[bodyIndex++];
+    if (result.Exception)
+      std::rethrow_exception(result.Exception);
+    ValCtx.DiagStream() << result.Diag;
+    ValCtx.Failed |= result.Failed;
+  }
+}
+
 void GetValidationVersion(_Out_ unsigned *pMajor, _Out_ unsigned *pMinor) {
   // Bump these versions after 1.0 to account for additional validation rules.
   *pMajor = 1;
@@ -3922,6 +4032,15 @@ ValidateDxilModule(llvm::Module *pModule, llvm::Module *pDebugModule) {
   raw_string_ostream diagStream(diagStr);
   DiagnosticPrinterRawOStream DiagPrinter(diagStream);
 
+  // Rules follow use lists and the call graph across functions, and bodies
+  // are validated concurrently while the bitcode reader materializes on one
+  // thread only, so a lazily loaded module is read completely up front.
+  if (pModule->materializeAll() ||
+      (pDebugModule != nullptr && pDebugModule->materializeAll())) {
+    emitDxilDiag(Ctx, "load function bodies failed.\n");
+    return std::error_code(ERROR_INVALID_DATA, std::system_category());
+  }
+
   DxilModule *pDxilModule;
   // TODO: add detail error in DxilMDHelper.
   try {
@@ -3960,9 +4079,7 @@ ValidateDxilModule(llvm::Module *pModule, llvm::Module *pDebugModule) {
   ValidateFlowControl(ValCtx);
 
   // Validate functions.
-  for (Function &F : pModule->functions()) {
-    ValidateFunction(F, ValCtx);
-  }
+  ValidateFunctions(ValCtx);
 
   ValidateUninitializedOutput(ValCtx);
 
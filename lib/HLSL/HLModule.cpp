@@ -25,6 +25,7 @@
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/DIBuilder.h"
 #include "llvm/Support/raw_ostream.h"
+#include <unordered_set>
 
 using namespace llvm;
 using std::string;
@@ -567,6 +568,107 @@ void HLModule::ClearHLMetadata(llvm::Module &M) {
   }
 }
 
+void HLModule::PrepareLibraryForLink(llvm::Module &M, bool IsEntryLibrary,
+                                     unsigned LibIndex) {
+  if (!IsEntryLibrary) {
+    const StringRef names[] = {
+        DxilMDHelper::kDxilVersionMDName, DxilMDHelper::kDxilShaderModelMDName,
+        DxilMDHelper::kDxilEntryPointsMDName,
+        DxilMDHelper::kDxilResourcesMDName, kHLDxilOptionsMDName};
+    for (StringRef name : names) {
+      if (NamedMDNode *pNode = M.getNamedMetadata(name))
+        M.eraseNamedMetadata(pNode);
+    }
+  }
+
+  // Type system helper variables are declarations; name them apart so that
+  // the linker doesn't resolve those of different libraries to each other.
+  const StringRef prefix = DxilMDHelper::kDxilTypeSystemHelperVariablePrefix;
+  for (GlobalVariable &GV : M.globals()) {
+    if (GV.getName().startswith(prefix))
+      GV.setName(prefix + Twine(LibIndex) + "." +
+                 GV.getName().substr(prefix.size()));
+  }
+}
+
+void HLModule::MergeLinkedHLMetadata(llvm::Module &M) {
+  LLVMContext &Ctx = M.getContext();
+
+  // Type annotations: one struct tuple and one function tuple. A type or
+  // function shared by several libraries keeps its first annotation.
+  if (NamedMDNode *pTypes =
+          M.getNamedMetadata(DxilMDHelper::kDxilTypeSystemMDName)) {
+    vector<Metadata *> structVals, funcVals;
+    std::unordered_set<Type *> structTypes;
+    std::unordered_set<Value *> funcs;
+    for (unsigned i = 0; i < pTypes->getNumOperands(); ++i) {
+      const MDTuple *pTupleMD = dyn_cast<MDTuple>(pTypes->getOperand(i));
+      IFTBOOL(pTupleMD != nullptr && pTupleMD->getNumOperands() > 0,
+              DXC_E_INCORRECT_DXIL_METADATA);
+      bool isStruct = DxilMDHelper::ConstMDToUint32(pTupleMD->getOperand(0)) ==
+                      DxilMDHelper::kDxilTypeSystemStructTag;
+      vector<Metadata *> &MDVals = isStruct ? structVals : funcVals;
+      if (MDVals.empty())
+        MDVals.emplace_back(pTupleMD->getOperand(0).get());
+      for (unsigned j = 1; j + 1 < pTupleMD->getNumOperands(); j += 2) {
+        Value *V = DxilMDHelper::ValueMDToValue(pTupleMD->getOperand(j));
+        bool isNew;
+        if (isStruct)
+          isNew = isa<GlobalVariable>(V) &&
+                  structTypes.insert(V->getType()->getPointerElementType())
+                      .second;
+        else
+          isNew = isa<Function>(V) && funcs.insert(V).second;
+        if (isNew) {
+          MDVals.emplace_back(pTupleMD->getOperand(j).get());
+          MDVals.emplace_back(pTupleMD->getOperand(j + 1).get());
+        }
+      }
+    }
+    pTypes->dropAllReferences();
+    if (structVals.size() > 1)
+      pTypes->addOperand(MDNode::get(Ctx, structVals));
+    if (funcVals.size() > 1)
+      pTypes->addOperand(MDNode::get(Ctx, funcVals));
+  }
+
+  // Function properties, one record per function.
+  if (NamedMDNode *pFnProps =
+          M.getNamedMetadata(kHLDxilFunctionPropertiesMDName)) {
+    vector<MDNode *> props;
+    std::unordered_set<Value *> funcs;
+    for (unsigned i = 0; i < pFnProps->getNumOperands(); ++i) {
+      MDNode *pProps = pFnProps->getOperand(i);
+      if (funcs.insert(DxilMDHelper::ValueMDToValue(pProps->getOperand(0))).second)
+        props.emplace_back(pProps);
+    }
+    pFnProps->dropAllReferences();
+    for (MDNode *pProps : props)
+      pFnProps->addOperand(pProps);
+  }
+
+  // Resource type annotations, as a single list of triples.
+  if (NamedMDNode *pResTy =
+          M.getNamedMetadata(kHLDxilResourceTypeAnnotationMDName)) {
+    vector<Metadata *> MDVals;
+    std::unordered_set<Type *> types;
+    for (unsigned i = 0; i < pResTy->getNumOperands(); ++i) {
+      const MDNode *pTupleMD = pResTy->getOperand(i);
+      IFTBOOL(pTupleMD->getNumOperands() % 3 == 0,
+              DXC_E_INCORRECT_DXIL_METADATA);
+      for (unsigned j = 0; j < pTupleMD->getNumOperands(); j += 3) {
+        Value *V = DxilMDHelper::ValueMDToValue(pTupleMD->getOperand(j));
+        if (!types.insert(V->getType()).second)
+          continue;
+        for (unsigned k = j; k < j + 3; ++k)
+          MDVals.emplace_back(pTupleMD->getOperand(k).get());
+      }
+    }
+    pResTy->dropAllReferences();
+    pResTy->addOperand(MDNode::get(Ctx, MDVals));
+  }
+}
+
 MDTuple *HLModule::EmitHLResources() {
   // Emit SRV records.
   MDTuple *pTupleSRVs = nullptr;
@@ -409,7 +409,8 @@ public:
 
   TypePrinting() = default;
 
-  void incorporateTypes(const Module &M);
+  void incorporateTypes(const Module &M,
+                        bool MaterializeFunctions = false); // HLSL Change
 
   void print(Type *Ty, raw_ostream &OS);
 
@@ -417,8 +418,9 @@ public:
 };
 } // namespace
 
-void TypePrinting::incorporateTypes(const Module &M) {
-  NamedTypes.run(M, false);
+void TypePrinting::incorporateTypes(const Module &M,
+                                    bool MaterializeFunctions) { // HLSL Change
+  NamedTypes.run(M, false, MaterializeFunctions); // HLSL Change
 
   // The list of struct types we got back includes all the struct types, split
   // the unnamed ones out to a numbering and remove the anonymous structs.
@@ -1999,12 +2001,15 @@ class AssemblyWriter {
   bool ShouldPreserveUseListOrder;
   UseListOrderStack UseListOrders;
   SmallVector<StringRef, 8> MDNames;
+  bool ShouldMaterializeFunctions;  // HLSL Change
+  std::error_code MaterializeError; // HLSL Change
 
 public:
   /// Construct an AssemblyWriter with an external SlotTracker
   AssemblyWriter(formatted_raw_ostream &o, SlotTracker &Mac, const Module *M,
                  AssemblyAnnotationWriter *AAW,
-                 bool ShouldPreserveUseListOrder = false);
+                 bool ShouldPreserveUseListOrder = false,
+                 bool ShouldMaterializeFunctions = false); // HLSL Change
 
   /// Construct an AssemblyWriter with an internally allocated SlotTracker
   AssemblyWriter(formatted_raw_ostream &o, const Module *M,
@@ -2016,6 +2021,11 @@ public:
 
   void printModule(const Module *M);
 
+  // HLSL Change start
+  /// The error from reading a function body when printing materializes them.
+  std::error_code getMaterializeError() const { return MaterializeError; }
+  // HLSL Change end
+
   void writeOperand(const Value *Op, bool PrintType);
   void writeParamOperand(const Value *Operand, AttributeSet Attrs,unsigned Idx);
   void writeAtomic(AtomicOrdering Ordering, SynchronizationScope SynchScope);
@@ -2061,7 +2071,8 @@ private:
 void AssemblyWriter::init() {
   if (!TheModule)
     return;
-  TypePrinter.incorporateTypes(*TheModule);
+  TypePrinter.incorporateTypes(*TheModule,
+                               ShouldMaterializeFunctions); // HLSL Change
   for (const Function &F : *TheModule)
     if (const Comdat *C = F.getComdat())
       Comdats.insert(C);
@@ -2072,9 +2083,11 @@ void AssemblyWriter::init() {
 
 AssemblyWriter::AssemblyWriter(formatted_raw_ostream &o, SlotTracker &Mac,
                                const Module *M, AssemblyAnnotationWriter *AAW,
-                               bool ShouldPreserveUseListOrder)
+                               bool ShouldPreserveUseListOrder,
+                               bool ShouldMaterializeFunctions) // HLSL Change
     : Out(o), TheModule(M), Machine(Mac), AnnotationWriter(AAW),
-      ShouldPreserveUseListOrder(ShouldPreserveUseListOrder) {
+      ShouldPreserveUseListOrder(ShouldPreserveUseListOrder),
+      ShouldMaterializeFunctions(ShouldMaterializeFunctions) { // HLSL Change
   init();
 }
 
@@ -2083,7 +2096,8 @@ AssemblyWriter::AssemblyWriter(formatted_raw_ostream &o, const Module *M,
                                bool ShouldPreserveUseListOrder)
     : Out(o), TheModule(M), SlotTrackerStorage(createSlotTracker(M)),
       Machine(*SlotTrackerStorage), AnnotationWriter(AAW),
-      ShouldPreserveUseListOrder(ShouldPreserveUseListOrder) {
+      ShouldPreserveUseListOrder(ShouldPreserveUseListOrder),
+      ShouldMaterializeFunctions(false) { // HLSL Change
   init();
 }
 
@@ -2229,8 +2243,23 @@ void AssemblyWriter::printModule(const Module *M) {
   printUseLists(nullptr);
 
   // Output all of the functions.
-  for (const Function &F : *M)
+  for (const Function &F : *M) {
+    // HLSL Change start
+    if (ShouldMaterializeFunctions && F.isMaterializable()) {
+      // Metadata slots are assigned as each function is incorporated and the
+      // nodes outlive the function body, so releasing it is safe.
+      Function &MF = const_cast<Function &>(F);
+      if (std::error_code EC = MF.materialize()) {
+        MaterializeError = EC;
+        return;
+      }
+      printFunction(&F);
+      MF.dematerialize();
+      continue;
+    }
+    // HLSL Change end
     printFunction(&F);
+  }
   assert(UseListOrders.empty() && "All use-lists should have been consumed");
 
   // Output all attribute groups.
@@ -3151,6 +3180,20 @@ void Module::print(raw_ostream &ROS, AssemblyAnnotationWriter *AAW,
   W.printModule(this);
 }
 
+// HLSL Change start
+std::error_code
+Module::printMaterializingFunctions(raw_ostream &ROS,
+                                    AssemblyAnnotationWriter *AAW) {
+  SlotTracker SlotTable(this);
+  formatted_raw_ostream OS(ROS);
+  AssemblyWriter W(OS, SlotTable, this, AAW,
+                   /*ShouldPreserveUseListOrder*/ false,
+                   /*ShouldMaterializeFunctions*/ true);
+  W.printModule(this);
+  return W.getMaterializeError();
+}
+// HLSL Change end
+
 void NamedMDNode::print(raw_ostream &ROS) const {
   SlotTracker SlotTable(getParent());
   formatted_raw_ostream OS(ROS);
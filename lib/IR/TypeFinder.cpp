@@ -20,7 +20,8 @@
 #include "llvm/IR/Module.h"
 using namespace llvm;
 
-void TypeFinder::run(const Module &M, bool onlyNamed) {
+void TypeFinder::run(const Module &M, bool onlyNamed,
+                     bool materializeFunctions) { // HLSL Change
   OnlyNamed = onlyNamed;
 
   // Get types from global variables.
@@ -44,6 +45,16 @@ void TypeFinder::run(const Module &M, bool onlyNamed) {
   for (Module::const_iterator FI = M.begin(), E = M.end(); FI != E; ++FI) {
     incorporateType(FI->getType());
 
+    // HLSL Change start
+    // A body that fails to read is skipped; whoever reads it next reports it.
+    Function *MF = nullptr;
+    if (materializeFunctions && FI->isMaterializable()) {
+      MF = const_cast<Function *>(&*FI);
+      if (MF->materialize())
+        MF = nullptr;
+    }
+    // HLSL Change end
+
     if (FI->hasPrefixData())
       incorporateValue(FI->getPrefixData());
 
@@ -81,6 +92,11 @@ void TypeFinder::run(const Module &M, bool onlyNamed) {
 
         MDForInst.clear();
       }
+
+    // HLSL Change start
+    if (MF)
+      MF->dematerialize();
+    // HLSL Change end
   }
 
   for (Module::const_named_metadata_iterator I = M.named_metadata_begin(),
@@ -356,6 +356,21 @@ getOpenFileImpl(int FD, const Twine &Filename, uint64_t FileSize,
     MapSize = FileSize;
   }
 
+  // HLSL Change Starts - use contents held in memory by the file system in place.
+  {
+    const char *PinnedData;
+    size_t PinnedSize;
+    if (Offset == 0 && MapSize == FileSize &&
+        sys::fs::msf_get_pinned_buffer(FD, &PinnedData, &PinnedSize) &&
+        PinnedSize == FileSize) {
+      SmallString<256> NameBuf;
+      return MemoryBuffer::getMemBuffer(StringRef(PinnedData, PinnedSize),
+                                        Filename.toStringRef(NameBuf),
+                                        RequiresNullTerminator);
+    }
+  }
+  // HLSL Change Ends
+
   if (shouldUseMmap(FD, FileSize, MapSize, Offset, RequiresNullTerminator,
                     PageSize, IsVolatileSize)) {
     std::error_code EC;
@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// TimeProfiler.cpp                                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Records nested compilation phases as a Chrome trace.                      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cassert>
+
+using namespace llvm;
+
+static LLVM_THREAD_LOCAL TimeTraceProfiler *CurrentProfiler = nullptr;
+
+TimeTraceProfiler *TimeTraceProfiler::getCurrent() {
+  return CurrentProfiler;
+}
+
+TimeTraceProfilerActivation::TimeTraceProfilerActivation(TimeTraceProfiler *P)
+    : Previous(CurrentProfiler) {
+  CurrentProfiler = P;
+}
+
+TimeTraceProfilerActivation::~TimeTraceProfilerActivation() {
+  CurrentProfiler = Previous;
+}
+
+TimeTraceProfiler::TimeTraceProfiler() : BeginTime(ClockType::now()) {}
+
+void TimeTraceProfiler::begin(StringRef Name, StringRef Detail) {
+  Stack.emplace_back();
+  OpenEntry &Open = Stack.back();
+  Open.E.Name = Name;
+  Open.E.Detail = Detail;
+  Open.E.HeapDelta = 0;
+  // Only outermost intervals sample the heap, as the sample can be as slow as
+  // walking the whole heap. It is taken before the clock so that its cost
+  // isn't counted as part of the interval; end() does the opposite.
+  Open.E.HasHeapDelta = Stack.size() == 1;
+  Open.HeapStart = Open.E.HasHeapDelta ? sys::Process::GetMallocUsage() : 0;
+  Open.StartTime = ClockType::now();
+}
+
+void TimeTraceProfiler::end() {
+  assert(!Stack.empty() && "end() without a matching begin()");
+  ClockType::time_point EndTime = ClockType::now();
+
+  OpenEntry &Open = Stack.back();
+  Open.E.Start = std::chrono::duration_cast<std::chrono::microseconds>(
+                     Open.StartTime - BeginTime).count();
+  Open.E.Duration = std::chrono::duration_cast<std::chrono::microseconds>(
+                        EndTime - Open.StartTime).count();
+  if (Open.E.HasHeapDelta) {
+    size_t HeapEnd = sys::Process::GetMallocUsage();
+    Open.E.HeapDelta = (int64_t)HeapEnd - (int64_t)Open.HeapStart;
+  }
+  Entries.emplace_back(std::move(Open.E));
+  Stack.pop_back();
+}
+
+static void writeJSONString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (char C : Str) {
+    switch (C) {
+    case '"':  OS << "\\\""; break;
+    case '\\': OS << "\\\\"; break;
+    case '\n': OS << "\\n"; break;
+    case '\r': OS << "\\r"; break;
+    case '\t': OS << "\\t"; break;
+    default:
+      if ((unsigned char)C < 0x20)
+        OS << format("\\u%04x", (unsigned)C);
+      else
+        OS << C;
+    }
+  }
+  OS << '"';
+}
+
+void TimeTraceProfiler::write(raw_ostream &OS) const {
+  OS << "{\"traceEvents\":[";
+  bool First = true;
+  for (const Entry &E : Entries) {
+    if (!First)
+      OS << ',';
+    First = false;
+    OS << "\n{\"pid\":1,\"tid\":0,\"ph\":\"X\",\"name\":";
+    writeJSONString(OS, E.Name);
+    OS << ",\"ts\":" << E.Start << ",\"dur\":" << E.Duration
+       << ",\"args\":{";
+    const char *Separator = "";
+    if (!E.Detail.empty()) {
+      OS << "\"detail\":";
+      writeJSONString(OS, E.Detail);
+      Separator = ",";
+    }
+    if (E.HasHeapDelta)
+      OS << Separator << "\"heap-delta\":" << E.HeapDelta;
+    OS << "}}";
+  }
+  OS << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
@@ -139,6 +139,15 @@ long msf_lseek(int fd, long offset, int origin)
   return fsr->lseek(fd, offset, origin);
 }
 
+bool msf_get_pinned_buffer(int fd, const char **ppData, size_t *pSize)
+{
+  MSFileSystemRef fsr = GetCurrentThreadFileSystem();
+  if (fsr == nullptr) {
+    return false;
+  }
+  return fsr->GetPinnedBuffer(fd, ppData, pSize);
+}
+
 int msf_setmode(int fd, int mode)
 {
   MSFileSystemRef fsr = GetCurrentThreadFileSystem();
@@ -10,16 +10,20 @@
 #ifndef LLVM_CLANG_CODEGEN_CODEGENACTION_H
 #define LLVM_CLANG_CODEGEN_CODEGENACTION_H
 
+#include "clang/Frontend/CodeGenOptions.h" // HLSL Change
 #include "clang/Frontend/FrontendAction.h"
 #include <memory>
+#include <vector> // HLSL Change
 
 namespace llvm {
   class LLVMContext;
   class Module;
+  class raw_pwrite_stream; // HLSL Change
 }
 
 namespace clang {
 class BackendConsumer;
+class DiagnosticConsumer; // HLSL Change
 
 class CodeGenAction : public ASTFrontendAction {
 private:
@@ -104,6 +108,40 @@ class EmitOptDumpAction : public CodeGenAction {
 public:
   EmitOptDumpAction(llvm::LLVMContext *_VMContext = nullptr);
 };
+
+/// Emits bitcode for several HLSL entry points from a single parse of the
+/// source. Each entry point is generated by its own code generator, with its
+/// own options and output stream; the modules share the given LLVM context.
+///
+/// Diagnostics reported while an entry point's code generator runs go to that
+/// entry point's client, if it has one; the compiler's client receives those
+/// of the shared parse.
+///
+/// Code generation stops at the first error reported, so once an entry point
+/// fails, the entry points after it are left without a module.
+class EmitBCForEntryPointsAction : public ASTFrontendAction {
+public:
+  struct EntryPoint {
+    CodeGenOptions CodeGenOpts;               // Includes HLSLEntryFunction and HLSLProfile.
+    llvm::raw_pwrite_stream *OS = nullptr;    // Receives the bitcode.
+    DiagnosticConsumer *DiagClient = nullptr; // Receives this entry point's diagnostics, if set.
+    std::unique_ptr<llvm::Module> Module;     // Set when the action ends.
+    bool HasErrors = false;                   // Errors were reported while generating this entry point.
+  };
+
+  EmitBCForEntryPointsAction(llvm::LLVMContext &VMContext,
+                             std::vector<EntryPoint> &EntryPoints);
+
+protected:
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
+                                                 StringRef InFile) override;
+  void EndSourceFileAction() override;
+
+private:
+  llvm::LLVMContext &VMContext;
+  std::vector<EntryPoint> &EntryPoints;
+  std::vector<BackendConsumer *> BEConsumers;
+};
 // HLSL Change Ends
 
 }
@@ -62,6 +62,7 @@ class FileEntry;
 class FileManager;
 class HeaderSearch;
 class Preprocessor;
+class PreprocessorOptions; // HLSL Change
 class PCHContainerOperations;
 class PCHContainerReader;
 class SourceManager;
@@ -280,6 +281,19 @@ private:
   /// the preamble must be thrown away.
   llvm::StringMap<PreambleFileHash> FilesInPreamble;
 
+  // HLSL Change Starts - header token cache
+  /// \brief When non-NULL, a token cache for the files included by the main
+  /// file.
+  ///
+  /// Precompiled preambles aren't supported, so when one is requested the
+  /// reparses read the tokens of included files from this cache instead.
+  std::unique_ptr<llvm::MemoryBuffer> HeaderTokenCache;
+
+  /// \brief The files in \c HeaderTokenCache, with their buffer size and
+  /// modification time when the cache was built.
+  llvm::StringMap<PreambleFileHash> FilesInHeaderTokenCache;
+  // HLSL Change Ends
+
   /// \brief When non-NULL, this is the buffer used to store the contents of
   /// the main file when it has been padded for use with the precompiled
   /// preamble.
@@ -460,6 +474,13 @@ private:
       unsigned MaxLines = 0);
   void RealizeTopLevelDeclsFromPreamble();
 
+  // HLSL Change Starts - header token cache
+  void buildHeaderTokenCache(const CompilerInvocation &InvocationIn);
+  bool isHeaderTokenCacheValid(const PreprocessorOptions &PPOpts,
+                               FileManager &FileMgr);
+  void useHeaderTokenCache(PreprocessorOptions &PPOpts);
+  // HLSL Change Ends
+
   /// \brief Transfers ownership of the objects (like SourceManager) from
   /// \param CI to this ASTUnit.
   void transferASTDataFromCompilerInstance(CompilerInstance &CI);
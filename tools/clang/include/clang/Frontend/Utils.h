@@ -161,7 +161,11 @@ void AttachHeaderIncludeGen(Preprocessor &PP, bool ShowAllHeaders = false,
                             bool ShowDepth = true, bool MSStyle = false);
 
 /// Cache tokens for use with PCH. Note that this requires a seekable stream.
-void CacheTokens(Preprocessor &PP, raw_pwrite_stream *OS);
+/// HLSL Change - with HeadersOnly, the tokens of the main file and the stats
+/// of directories and missing files are left out, so the cache stays usable
+/// while the main file is edited.
+void CacheTokens(Preprocessor &PP, raw_pwrite_stream *OS,
+                 bool HeadersOnly = false);
 
 /// The ChainedIncludesSource class converts headers to chained PCHs in
 /// memory, mainly for testing.
@@ -986,6 +986,12 @@ public:
   /// which implicitly adds the builtin defines etc.
   void EnterMainSourceFile();
 
+  // HLSL Change Starts
+  /// \brief Whether the main source file has been entered, for clients that
+  /// lex it before handing the tokens to the parser.
+  bool hasEnteredMainSourceFile() const { return NumEnteredSourceFiles != 0; }
+  // HLSL Change Ends
+
   /// \brief Inform the preprocessor callbacks that processing is complete.
   void EndSourceFile();
 
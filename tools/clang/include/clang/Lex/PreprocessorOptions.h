@@ -89,6 +89,12 @@ public:
   /// If given, a PTH cache file to use for speeding up header parsing.
   std::string TokenCache;
 
+  // HLSL Change Starts
+  /// If not empty, the contents of the TokenCache file, which is then not
+  /// read from the file system. The memory must outlive the preprocessor.
+  StringRef TokenCacheData;
+  // HLSL Change Ends
+
   /// \brief True if the SourceManager should report the original file name for
   /// contents of files that were remapped to other files. Defaults to true.
   bool RemappedFilesKeepOriginalName;
@@ -174,6 +180,7 @@ public:
     ImplicitPCHInclude.clear();
     ImplicitPTHInclude.clear();
     TokenCache.clear();
+    TokenCacheData = StringRef(); // HLSL Change
     RetainRemappedFileBuffers = true;
     PrecompiledPreambleBytes.first = 0;
     PrecompiledPreambleBytes.second = 0;
@@ -299,6 +299,7 @@ CGMSHLSLRuntime::CGMSHLSLRuntime(CodeGenModule &CGM)
   opts.bDisableOptimizations = CGM.getCodeGenOpts().DisableLLVMOpts;
   opts.bLegacyCBufferLoad = !CGM.getCodeGenOpts().HLSLNotUseLegacyCBufLoad;
   opts.bAllResourcesBound = CGM.getCodeGenOpts().HLSLAllResourcesBound;
+  opts.PackingBudget = CGM.getCodeGenOpts().HLSLSignaturePackingBudget;
   m_pHLModule->SetHLOptions(opts);
 
   m_bDebugInfo = CGM.getCodeGenOpts().getDebugInfo() == CodeGenOptions::FullDebugInfo;
@@ -2246,6 +2247,9 @@ bool CGMSHLSLRuntime::IsPatchConstantFunction(const Function *F) {
 
 void CGMSHLSLRuntime::SetEntryFunction() {
   if (EntryFunc == nullptr) {
+    // A library doesn't need an entry point; it is chosen at link time.
+    if (CGM.getCodeGenOpts().HLSLLibrary)
+      return;
     DiagnosticsEngine &Diags = CGM.getDiags();
     unsigned DiagID = Diags.getCustomDiagID(DiagnosticsEngine::Error,
                                             "cannot find entry function %0");
@@ -3531,7 +3535,8 @@ void CGMSHLSLRuntime::FinishCodeGen() {
   SetEntryFunction();
 
   // If at this point we haven't determined the entry function it's an error.
-  if (m_pHLModule->GetEntryFunction() == nullptr) {
+  if (m_pHLModule->GetEntryFunction() == nullptr &&
+      !CGM.getCodeGenOpts().HLSLLibrary) {
     assert(CGM.getDiags().hasErrorOccurred() &&
            "else SetEntryFunction should have reported this condition");
     return;
@@ -3646,17 +3651,25 @@ void CGMSHLSLRuntime::FinishCodeGen() {
     }
   };
   // need this for "llvm.global_dtors"?
-  AddGlobalCall("llvm.global_ctors",
-                EntryFunc->getEntryBlock().getFirstInsertionPt());
+  // Libraries keep their initializers; the linker calls them from the entry.
+  if (!CGM.getCodeGenOpts().HLSLLibrary)
+    AddGlobalCall("llvm.global_ctors",
+                  EntryFunc->getEntryBlock().getFirstInsertionPt());
 
   // translate opcode into parameter for intrinsic functions
   AddOpcodeParamForIntrinsics(*m_pHLModule, m_IntrinsicMap);
 
   // Pin entry point and constant buffers, mark everything else internal.
+  // Libraries also export every function that isn't static. Several libraries
+  // may define the same helper from a shared header, so these are linkonce_odr
+  // and the linker keeps one definition.
+  const bool isLibrary = CGM.getCodeGenOpts().HLSLLibrary;
   for (Function &f : m_pHLModule->GetModule()->functions()) {
     if (&f == m_pHLModule->GetEntryFunction() || IsPatchConstantFunction(&f) ||
         f.isDeclaration()) {
       f.setLinkage(GlobalValue::LinkageTypes::ExternalLinkage);
+    } else if (isLibrary && !f.hasLocalLinkage()) {
+      f.setLinkage(GlobalValue::LinkageTypes::LinkOnceODRLinkage);
     } else {
       f.setLinkage(GlobalValue::LinkageTypes::InternalLinkage);
     }
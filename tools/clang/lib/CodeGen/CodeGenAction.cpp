@@ -20,6 +20,7 @@
 #include "clang/CodeGen/ModuleBuilder.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendDiagnostic.h"
+#include "clang/Frontend/MultiplexConsumer.h" // HLSL Change
 #include "clang/Lex/Preprocessor.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Bitcode/ReaderWriter.h"
@@ -33,6 +34,7 @@
 #include "llvm/Pass.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TimeProfiler.h" // HLSL Change
 #include "llvm/Support/Timer.h"
 #include <memory>
 using namespace clang;
@@ -132,6 +134,7 @@ namespace clang {
     void HandleTranslationUnit(ASTContext &C) override {
       {
         PrettyStackTraceString CrashInfo("Per-file LLVM IR generation");
+        llvm::TimeTraceScope TraceScope("CodeGen"); // HLSL Change
         if (llvm::TimePassesIsEnabled)
           LLVMIRGeneration.startTimer();
 
@@ -179,9 +182,12 @@ namespace clang {
       void *OldDiagnosticContext = Ctx.getDiagnosticContext();
       Ctx.setDiagnosticHandler(DiagnosticHandler, this);
 
-      EmitBackendOutput(Diags, CodeGenOpts, TargetOpts, LangOpts,
-                        C.getTargetInfo().getTargetDescription(),
-                        TheModule.get(), Action, AsmOutStream);
+      {
+        llvm::TimeTraceScope TraceScope("Optimize"); // HLSL Change
+        EmitBackendOutput(Diags, CodeGenOpts, TargetOpts, LangOpts,
+                          C.getTargetInfo().getTargetDescription(),
+                          TheModule.get(), Action, AsmOutStream);
+      }
 
       Ctx.setInlineAsmDiagnosticHandler(OldHandler, OldContext);
 
@@ -776,4 +782,166 @@ EmitObjAction::EmitObjAction(llvm::LLVMContext *_VMContext)
 void EmitOptDumpAction::anchor() { }
 EmitOptDumpAction::EmitOptDumpAction(llvm::LLVMContext *_VMContext)
   : CodeGenAction(Backend_EmitPasses, _VMContext) {}
+
+namespace {
+/// Sends the diagnostics reported while it is alive to an entry point's
+/// client, and records whether any of them were errors.
+class EntryPointDiagScope {
+  DiagnosticsEngine &Diags;
+  EmitBCForEntryPointsAction::EntryPoint &Entry;
+  DiagnosticConsumer *PrevClient;
+  std::unique_ptr<DiagnosticConsumer> OwnedPrevClient;
+  unsigned PrevErrors;
+public:
+  EntryPointDiagScope(DiagnosticsEngine &Diags,
+                      EmitBCForEntryPointsAction::EntryPoint &Entry)
+      : Diags(Diags), Entry(Entry), PrevClient(Diags.getClient()) {
+    if (Entry.DiagClient != nullptr) {
+      OwnedPrevClient = Diags.takeClient();
+      Diags.setClient(Entry.DiagClient, /*ShouldOwnClient*/ false);
+    }
+    PrevErrors = Diags.getClient()->getNumErrors();
+  }
+  ~EntryPointDiagScope() {
+    if (Diags.getClient()->getNumErrors() != PrevErrors)
+      Entry.HasErrors = true;
+    if (Entry.DiagClient != nullptr) {
+      bool OwnsPrevClient = OwnedPrevClient != nullptr;
+      OwnedPrevClient.release();
+      Diags.setClient(PrevClient, OwnsPrevClient);
+    }
+  }
+};
+
+/// Runs an entry point's code generator, attributing the diagnostics it
+/// reports to that entry point. Code generation happens as declarations are
+/// parsed as well as at the end of the translation unit, so every callback is
+/// wrapped.
+class EntryPointConsumer : public ASTConsumer {
+  DiagnosticsEngine &Diags;
+  EmitBCForEntryPointsAction::EntryPoint &Entry;
+  std::unique_ptr<ASTConsumer> Consumer;
+public:
+  EntryPointConsumer(DiagnosticsEngine &Diags,
+                     EmitBCForEntryPointsAction::EntryPoint &Entry,
+                     std::unique_ptr<ASTConsumer> Consumer)
+      : Diags(Diags), Entry(Entry), Consumer(std::move(Consumer)) {}
+
+  void Initialize(ASTContext &Context) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->Initialize(Context);
+  }
+  bool HandleTopLevelDecl(DeclGroupRef D) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    return Consumer->HandleTopLevelDecl(D);
+  }
+  void HandleInlineMethodDefinition(CXXMethodDecl *D) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->HandleInlineMethodDefinition(D);
+  }
+  void HandleInterestingDecl(DeclGroupRef D) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->HandleInterestingDecl(D);
+  }
+  void HandleTranslationUnit(ASTContext &Ctx) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->HandleTranslationUnit(Ctx);
+  }
+  void HandleTagDeclDefinition(TagDecl *D) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->HandleTagDeclDefinition(D);
+  }
+  void HandleTagDeclRequiredDefinition(const TagDecl *D) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->HandleTagDeclRequiredDefinition(D);
+  }
+  void HandleCXXImplicitFunctionInstantiation(FunctionDecl *D) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->HandleCXXImplicitFunctionInstantiation(D);
+  }
+  void HandleTopLevelDeclInObjCContainer(DeclGroupRef D) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->HandleTopLevelDeclInObjCContainer(D);
+  }
+  void HandleImplicitImportDecl(ImportDecl *D) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->HandleImplicitImportDecl(D);
+  }
+  void HandleLinkerOptionPragma(llvm::StringRef Opts) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->HandleLinkerOptionPragma(Opts);
+  }
+  void HandleDetectMismatch(llvm::StringRef Name,
+                            llvm::StringRef Value) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->HandleDetectMismatch(Name, Value);
+  }
+  void HandleDependentLibrary(llvm::StringRef Lib) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->HandleDependentLibrary(Lib);
+  }
+  void CompleteTentativeDefinition(VarDecl *D) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->CompleteTentativeDefinition(D);
+  }
+  void HandleCXXStaticMemberVarInstantiation(VarDecl *D) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->HandleCXXStaticMemberVarInstantiation(D);
+  }
+  void HandleVTable(CXXRecordDecl *RD) override {
+    EntryPointDiagScope Scope(Diags, Entry);
+    Consumer->HandleVTable(RD);
+  }
+  ASTMutationListener *GetASTMutationListener() override {
+    return Consumer->GetASTMutationListener();
+  }
+  ASTDeserializationListener *GetASTDeserializationListener() override {
+    return Consumer->GetASTDeserializationListener();
+  }
+  void PrintStats() override { Consumer->PrintStats(); }
+  bool shouldSkipFunctionBody(Decl *D) override {
+    return Consumer->shouldSkipFunctionBody(D);
+  }
+};
+}
+
+EmitBCForEntryPointsAction::EmitBCForEntryPointsAction(
+    llvm::LLVMContext &VMContext, std::vector<EntryPoint> &EntryPoints)
+    : VMContext(VMContext), EntryPoints(EntryPoints) {}
+
+std::unique_ptr<ASTConsumer>
+EmitBCForEntryPointsAction::CreateASTConsumer(CompilerInstance &CI,
+                                              StringRef InFile) {
+  std::vector<std::unique_ptr<ASTConsumer>> Consumers;
+  BEConsumers.clear();
+  for (EntryPoint &Entry : EntryPoints) {
+    Entry.HasErrors = false;
+    if (Entry.DiagClient != nullptr)
+      Entry.DiagClient->BeginSourceFile(CI.getLangOpts(),
+                                        &CI.getPreprocessor());
+    std::unique_ptr<BackendConsumer> BE(new BackendConsumer(
+        Backend_EmitBC, CI.getDiagnostics(), CI.getHeaderSearchOpts(),
+        CI.getPreprocessorOpts(), Entry.CodeGenOpts, CI.getTargetOpts(),
+        CI.getLangOpts(), CI.getFrontendOpts().ShowTimers, InFile, nullptr,
+        Entry.OS, VMContext));
+    BEConsumers.push_back(BE.get());
+    Consumers.push_back(llvm::make_unique<EntryPointConsumer>(
+        CI.getDiagnostics(), Entry, std::move(BE)));
+  }
+  return llvm::make_unique<MultiplexConsumer>(std::move(Consumers));
+}
+
+void EmitBCForEntryPointsAction::EndSourceFileAction() {
+  for (EntryPoint &Entry : EntryPoints) {
+    if (Entry.DiagClient != nullptr)
+      Entry.DiagClient->EndSourceFile();
+  }
+
+  // If the consumer creation failed, do nothing.
+  if (!getCompilerInstance().hasASTConsumer())
+    return;
+
+  for (size_t i = 0; i < EntryPoints.size(); ++i)
+    EntryPoints[i].Module = BEConsumers[i]->takeModule();
+}
 // HLSL Change Ends
@@ -1164,6 +1164,10 @@ bool ASTUnit::Parse(std::shared_ptr<PCHContainerOperations> PCHContainerOps,
     SavedMainFileBuffer = std::move(OverrideMainBuffer);
   }
 
+  // HLSL Change - read the tokens of included files from the header cache.
+  if (HeaderTokenCache)
+    useHeaderTokenCache(PreprocessorOpts);
+
   std::unique_ptr<TopLevelDeclTrackerAction> Act(
       new TopLevelDeclTrackerAction(*this));
 
@@ -1677,6 +1681,139 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
 #endif // HLSL Change Ends - no support for PCH
 }
 
+// HLSL Change Starts - header token cache in place of a precompiled preamble
+namespace {
+/// \brief Writes a token cache for the files included by the main file, and
+/// records those files so the cache can be checked for staleness.
+class HeaderTokenCacheAction : public PreprocessorFrontendAction {
+public:
+  SmallVector<char, 0> TokenCache;
+  llvm::StringMap<ASTUnit::PreambleFileHash> Files;
+
+protected:
+  void ExecuteAction() override {
+    CompilerInstance &CI = getCompilerInstance();
+    raw_svector_ostream OS(TokenCache);
+    CacheTokens(CI.getPreprocessor(), &OS, /*HeadersOnly=*/true);
+    OS.flush();
+
+    SourceManager &SM = CI.getSourceManager();
+    const FileEntry *MainFile = SM.getFileEntryForID(SM.getMainFileID());
+    for (SourceManager::fileinfo_iterator I = SM.fileinfo_begin(),
+                                          E = SM.fileinfo_end();
+         I != E; ++I) {
+      const FileEntry *File = I->first;
+      if (File == MainFile)
+        continue;
+      if (time_t ModTime = File->getModificationTime())
+        Files[File->getName()] =
+            ASTUnit::PreambleFileHash::createForFile(File->getSize(), ModTime);
+      else
+        Files[File->getName()] = ASTUnit::PreambleFileHash::
+            createForMemoryBuffer(SM.getMemoryBufferForFile(File));
+    }
+  }
+};
+} // namespace
+
+/// \brief Preprocess the main file once more to build a token cache for the
+/// files it includes. Diagnostics were already reported by the parse, so
+/// those of this pass are dropped.
+void ASTUnit::buildHeaderTokenCache(const CompilerInvocation &InvocationIn) {
+  HeaderTokenCache.reset();
+  FilesInHeaderTokenCache.clear();
+
+  IntrusiveRefCntPtr<CompilerInvocation>
+    CacheInvocation(new CompilerInvocation(InvocationIn));
+  PreprocessorOptions &PPOpts = CacheInvocation->getPreprocessorOpts();
+  PPOpts.TokenCache.clear();
+  PPOpts.TokenCacheData = StringRef();
+
+  std::unique_ptr<CompilerInstance> Clang(new CompilerInstance());
+
+  // Recover resources if we crash before exiting this method.
+  llvm::CrashRecoveryContextCleanupRegistrar<CompilerInstance>
+    CICleanup(Clang.get());
+
+  Clang->HlslLangExtensions = HlslLangExtensions;
+  Clang->setInvocation(CacheInvocation.get());
+  Clang->createDiagnostics(new IgnoringDiagConsumer());
+
+  Clang->setTarget(TargetInfo::CreateTargetInfo(
+      Clang->getDiagnostics(), Clang->getInvocation().TargetOpts));
+  if (!Clang->hasTarget())
+    return;
+  Clang->getTarget().adjust(Clang->getLangOpts());
+
+  IntrusiveRefCntPtr<vfs::FileSystem> VFS =
+      createVFSFromCompilerInvocation(Clang->getInvocation(),
+                                      Clang->getDiagnostics());
+  if (!VFS)
+    return;
+  Clang->setFileManager(new FileManager(Clang->getFileSystemOpts(), VFS));
+  Clang->setSourceManager(new SourceManager(Clang->getDiagnostics(),
+                                            Clang->getFileManager()));
+
+  HeaderTokenCacheAction Act;
+  if (!Act.BeginSourceFile(*Clang.get(), Clang->getFrontendOpts().Inputs[0]))
+    return;
+  Act.Execute();
+  Act.EndSourceFile();
+
+  // Without includes there is nothing to cache.
+  if (Clang->getDiagnostics().hasFatalErrorOccurred() || Act.Files.empty())
+    return;
+
+  HeaderTokenCache = llvm::MemoryBuffer::getMemBufferCopy(
+      StringRef(Act.TokenCache.data(), Act.TokenCache.size()),
+      getMainFileName() + ".pth");
+  FilesInHeaderTokenCache.swap(Act.Files);
+}
+
+/// \brief Whether the header token cache exists and none of the files it
+/// covers has changed, on disk or through the given remappings.
+bool ASTUnit::isHeaderTokenCacheValid(const PreprocessorOptions &PPOpts,
+                                      FileManager &FileMgr) {
+  if (!HeaderTokenCache)
+    return false;
+
+  llvm::StringMap<PreambleFileHash> OverriddenFiles;
+  for (const auto &R : PPOpts.RemappedFiles) {
+    vfs::Status Status;
+    if (FileMgr.getNoncachedStatValue(R.second, Status))
+      return false;
+    OverriddenFiles[R.first] = PreambleFileHash::createForFile(
+        Status.getSize(), Status.getLastModificationTime().toEpochTime());
+  }
+  for (const auto &RB : PPOpts.RemappedFileBuffers)
+    OverriddenFiles[RB.first] =
+        PreambleFileHash::createForMemoryBuffer(RB.second);
+
+  for (const auto &F : FilesInHeaderTokenCache) {
+    llvm::StringMap<PreambleFileHash>::iterator Overridden =
+        OverriddenFiles.find(F.first());
+    if (Overridden != OverriddenFiles.end()) {
+      if (Overridden->second != F.second)
+        return false;
+      continue;
+    }
+
+    vfs::Status Status;
+    if (FileMgr.getNoncachedStatValue(F.first(), Status) ||
+        Status.getSize() != uint64_t(F.second.Size) ||
+        Status.getLastModificationTime().toEpochTime() !=
+            uint64_t(F.second.ModTime))
+      return false;
+  }
+  return true;
+}
+
+void ASTUnit::useHeaderTokenCache(PreprocessorOptions &PPOpts) {
+  PPOpts.TokenCache = HeaderTokenCache->getBufferIdentifier();
+  PPOpts.TokenCacheData = HeaderTokenCache->getBuffer();
+}
+// HLSL Change Ends
+
 void ASTUnit::RealizeTopLevelDeclsFromPreamble() {
   std::vector<Decl *> Resolved;
   Resolved.reserve(TopLevelDeclsInPreamble.size());
@@ -2126,6 +2263,18 @@ bool ASTUnit::Reparse(std::shared_ptr<PCHContainerOperations> PCHContainerOps,
     OverrideMainBuffer =
         getMainBufferWithPrecompiledPreamble(PCHContainerOps, *Invocation);
 
+  // HLSL Change Starts - a precompiled preamble was requested, so build the
+  // header token cache if there is none or an included file has changed.
+  // The previous preprocessor still refers to the old cache, so keep it
+  // alive until the parse has replaced that preprocessor.
+  std::unique_ptr<llvm::MemoryBuffer> PreviousHeaderTokenCache;
+  if (PreambleRebuildCounter > 0 && FileMgr &&
+      !isHeaderTokenCacheValid(PPOpts, *FileMgr)) {
+    PreviousHeaderTokenCache = std::move(HeaderTokenCache);
+    buildHeaderTokenCache(*Invocation);
+  }
+  // HLSL Change Ends
+
   // Clear out the diagnostics state.
   getDiagnostics().Reset();
   ProcessWarningOptions(getDiagnostics(), Invocation->getDiagnosticOpts());
@@ -2523,6 +2672,13 @@ void ASTUnit::CodeComplete(
     PreprocessorOpts.PrecompiledPreambleBytes.second = false;
   }
 
+  // HLSL Change Starts - use the header token cache, unless completing in a
+  // file it covers; the completion point must be lexed from source.
+  if (HeaderTokenCache && !FilesInHeaderTokenCache.count(File) &&
+      isHeaderTokenCacheValid(PreprocessorOpts, FileMgr))
+    useHeaderTokenCache(PreprocessorOpts);
+  // HLSL Change Ends
+
   // Disable the preprocessing record if modules are not enabled.
   if (!Clang->getLangOpts().Modules)
     PreprocessorOpts.DetailedRecord = false;
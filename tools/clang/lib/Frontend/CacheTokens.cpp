@@ -240,7 +240,8 @@ public:
       : Out(out), PP(pp), idcount(0), CurStrOffset(0) {}
 
   PTHMap &getPM() { return PM; }
-  void GeneratePTH(const std::string &MainFile);
+  void GeneratePTH(const std::string &MainFile,
+                   const FileEntry *SkipFile = nullptr); // HLSL Change
 };
 } // end anonymous namespace
 
@@ -478,7 +479,8 @@ static void pwrite32le(raw_pwrite_stream &OS, uint32_t Val, uint64_t &Off) {
   Off += 4;
 }
 
-void PTHWriter::GeneratePTH(const std::string &MainFile) {
+void PTHWriter::GeneratePTH(const std::string &MainFile,
+                            const FileEntry *SkipFile) { // HLSL Change
   // Generate the prologue.
   Out << "cfe-pth" << '\0';
   Emit32(PTHManager::Version);
@@ -506,9 +508,12 @@ void PTHWriter::GeneratePTH(const std::string &MainFile) {
        E = SM.fileinfo_end(); I != E; ++I) {
     const SrcMgr::ContentCache &C = *I->second;
     const FileEntry *FE = C.OrigEntry;
+    if (FE == SkipFile) continue; // HLSL Change
 
     // FIXME: Handle files with non-absolute paths.
-    if (llvm::sys::path::is_relative(FE->getName()))
+    // HLSL Change - the HLSL compiler file system has no current directory,
+    // so relative names are as stable as absolute ones there.
+    if (!LOpts.HLSL && llvm::sys::path::is_relative(FE->getName()))
       continue;
 
     const llvm::MemoryBuffer *B = C.getBuffer(PP.getDiagnostics(), SM);
@@ -569,7 +574,8 @@ public:
 };
 } // end anonymous namespace
 
-void clang::CacheTokens(Preprocessor &PP, raw_pwrite_stream *OS) {
+void clang::CacheTokens(Preprocessor &PP, raw_pwrite_stream *OS,
+                        bool HeadersOnly) { // HLSL Change
   // Get the name of the main file.
   const SourceManager &SrcMgr = PP.getSourceManager();
   const FileEntry *MainFile = SrcMgr.getFileEntryForID(SrcMgr.getMainFileID());
@@ -581,10 +587,15 @@ void clang::CacheTokens(Preprocessor &PP, raw_pwrite_stream *OS) {
   PTHWriter PW(*OS, PP);
 
   // Install the 'stat' system call listener in the FileManager.
-  auto StatCacheOwner = llvm::make_unique<StatListener>(PW.getPM());
-  StatListener *StatCache = StatCacheOwner.get();
-  PP.getFileManager().addStatCache(std::move(StatCacheOwner),
-                                   /*AtBeginning=*/true);
+  // HLSL Change - a headers-only cache doesn't record directory and missing
+  // file stats, which go stale as files are added.
+  StatListener *StatCache = nullptr;
+  if (!HeadersOnly) {
+    auto StatCacheOwner = llvm::make_unique<StatListener>(PW.getPM());
+    StatCache = StatCacheOwner.get();
+    PP.getFileManager().addStatCache(std::move(StatCacheOwner),
+                                     /*AtBeginning=*/true);
+  }
 
   // Lex through the entire file.  This will populate SourceManager with
   // all of the header information.
@@ -593,8 +604,10 @@ void clang::CacheTokens(Preprocessor &PP, raw_pwrite_stream *OS) {
   do { PP.Lex(Tok); } while (Tok.isNot(tok::eof));
 
   // Generate the PTH file.
-  PP.getFileManager().removeStatCache(StatCache);
-  PW.GeneratePTH(MainFilePath.str());
+  if (StatCache) // HLSL Change
+    PP.getFileManager().removeStatCache(StatCache);
+  PW.GeneratePTH(MainFilePath.str(),
+                 HeadersOnly ? MainFile : nullptr); // HLSL Change
 }
 
 //===----------------------------------------------------------------------===//
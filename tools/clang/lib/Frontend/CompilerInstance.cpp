@@ -306,6 +306,14 @@ void CompilerInstance::createPreprocessor(TranslationUnitKind TUKind) {
 
   // Create a PTH manager if we are using some form of a token cache.
   PTHManager *PTHMgr = nullptr;
+  // HLSL Change Starts - the token cache may be supplied in memory.
+  if (!PPOpts.TokenCacheData.empty())
+    PTHMgr = PTHManager::Create(
+        llvm::MemoryBuffer::getMemBuffer(PPOpts.TokenCacheData,
+                                         PPOpts.TokenCache, false),
+        PPOpts.TokenCache, getDiagnostics());
+  else
+  // HLSL Change Ends
   if (!PPOpts.TokenCache.empty())
     PTHMgr = PTHManager::Create(PPOpts.TokenCache, getDiagnostics());
 
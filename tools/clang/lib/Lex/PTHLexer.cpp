@@ -441,8 +441,12 @@ PTHManager *PTHManager::Create(StringRef file, DiagnosticsEngine &Diags) {
     Diags.Report(diag::err_invalid_pth_file) << file;
     return nullptr;
   }
-  std::unique_ptr<llvm::MemoryBuffer> File = std::move(FileOrErr.get());
+  return Create(std::move(FileOrErr.get()), file, Diags); // HLSL Change
+}
 
+// HLSL Change - allow the PTH file to be supplied in memory.
+PTHManager *PTHManager::Create(std::unique_ptr<llvm::MemoryBuffer> File,
+                               StringRef file, DiagnosticsEngine &Diags) {
   using namespace llvm::support;
 
   // Get the buffer ranges and check if there are at least three 32-bit
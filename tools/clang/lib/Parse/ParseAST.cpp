@@ -23,6 +23,7 @@
 #include "clang/Sema/Sema.h"
 #include "clang/Sema/SemaConsumer.h"
 #include "llvm/Support/CrashRecoveryContext.h"
+#include "llvm/Support/TimeProfiler.h" // HLSL Change
 #include <cstdio>
 #include <memory>
 
@@ -119,7 +120,11 @@ void clang::ParseAST(Sema &S, bool PrintStats, bool SkipFunctionBodies) {
   llvm::CrashRecoveryContextCleanupRegistrar<Parser>
     CleanupParser(ParseOP.get());
 
-  S.getPreprocessor().EnterMainSourceFile();
+  // HLSL Change Starts - the main file may already have been lexed, with its
+  // tokens entered as a stream for the parser.
+  if (!S.getPreprocessor().hasEnteredMainSourceFile())
+    S.getPreprocessor().EnterMainSourceFile();
+  // HLSL Change Ends
   P.Initialize();
 
   // C11 6.9p1 says translation units must have at least one top-level
@@ -132,6 +137,11 @@ void clang::ParseAST(Sema &S, bool PrintStats, bool SkipFunctionBodies) {
     External->StartTranslationUnit(Consumer);
 
   if (!S.getDiagnostics().hasUnrecoverableErrorOccurred()) {  // HLSL Change: Skip if fatal error already occurred
+    // HLSL Change Starts - the parser pulls tokens from the preprocessor and
+    // hands declarations to the consumer as it goes, so preprocessing, Sema
+    // and IR generation of top-level declarations are all traced here.
+    llvm::TimeTraceScope TraceScope("Frontend");
+    // HLSL Change Ends
     if (P.ParseTopLevelDecl(ADecl)) {
       if (!External && !S.getLangOpts().CPlusPlus)
         P.Diag(diag::ext_empty_translation_unit);
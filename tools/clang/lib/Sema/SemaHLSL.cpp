@@ -19,6 +19,7 @@
 #include "clang/AST/ExternalASTSource.h"
 #include "clang/AST/TypeLoc.h"
 #include "clang/AST/HlslTypes.h"
+#include "clang/Lex/Preprocessor.h"
 #include "clang/Sema/Overload.h"
 #include "clang/Sema/SemaDiagnostic.h"
 #include "clang/Sema/Initialization.h"
@@ -27,6 +28,9 @@
 #include "clang/Sema/Template.h"
 #include "clang/Sema/TemplateDeduction.h"
 #include "clang/Sema/SemaHLSL.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
 #include <map>
 #include "dxc/Support/Global.h"
 #include "dxc/Support/WinIncludes.h"
@@ -2040,78 +2044,178 @@ bool TemplateHasDefaultType(ArBasicKind kind)
 }
 
 /// <summary>
-/// Use this class to iterate over intrinsic definitions that come from an external source.
+/// Indexes the built-in intrinsic tables by name and argument count, so that
+/// call sites don't scan the tables linearly. Each table is indexed on first use.
+/// </summary>
+class IntrinsicTableIndex
+{
+private:
+  // For each name, the signature sizes present in the table (including the
+  // return value) and the index of the first intrinsic with that size.
+  typedef llvm::StringMap<llvm::SmallVector<std::pair<UINT, unsigned>, 2> > NameIndex;
+  std::map<const HLSL_INTRINSIC*, NameIndex> _indexes;
+
+  const NameIndex& GetIndex(_In_count_(tableSize) const HLSL_INTRINSIC* table, size_t tableSize)
+  {
+    std::pair<std::map<const HLSL_INTRINSIC*, NameIndex>::iterator, bool> inserted =
+      _indexes.insert(std::make_pair(table, NameIndex()));
+    NameIndex& index = inserted.first->second;
+    if (inserted.second) {
+      for (unsigned i = 0; i < tableSize; i++) {
+        auto& sizes = index[table[i].pArgs[0].pName];
+        auto match = std::find_if(sizes.begin(), sizes.end(),
+          [&](const std::pair<UINT, unsigned>& entry) { return entry.first == table[i].uNumArgs; });
+        if (match == sizes.end()) {
+          sizes.push_back(std::make_pair(table[i].uNumArgs, i));
+        }
+      }
+    }
+    return index;
+  }
+
+public:
+  /// <summary>Finds the first intrinsic with the given name and argument count.</summary>
+  /// <returns>The intrinsic found, or table + tableSize if there is none.</returns>
+  const HLSL_INTRINSIC* Find(
+    _In_count_(tableSize) const HLSL_INTRINSIC* table,
+    size_t tableSize,
+    StringRef nameIdentifier,
+    size_t argumentCount)
+  {
+    const NameIndex& index = GetIndex(table, tableSize);
+    NameIndex::const_iterator sizes = index.find(nameIdentifier);
+    if (sizes != index.end()) {
+      for (const std::pair<UINT, unsigned>& entry : sizes->second) {
+        if (entry.first == 1 + argumentCount) {
+          return table + entry.second;
+        }
+      }
+    }
+    return table + tableSize;
+  }
+};
+
+/// <summary>
+/// Caches the intrinsics returned by the registered extension tables for each
+/// type and function name, so each table is only queried once per name.
+/// </summary>
+class IntrinsicTableLookupCache
+{
+public:
+  typedef std::vector<const HLSL_INTRINSIC*> IntrinsicList;
+
+private:
+  llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& _tables;
+  // Per table, keyed by the type name and function name.
+  std::vector<llvm::StringMap<IntrinsicList> > _lookups;
+
+public:
+  IntrinsicTableLookupCache(llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& tables) :
+    _tables(tables)
+  {
+  }
+
+  llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& GetTables() { return _tables; }
+
+  const IntrinsicList& Lookup(unsigned tableIndex, StringRef typeName, StringRef functionName)
+  {
+    DXASSERT_NOMSG(tableIndex < _tables.size());
+    if (_lookups.size() < _tables.size()) {
+      _lookups.resize(_tables.size());
+    }
+
+    llvm::SmallString<128> key(typeName);
+    key.push_back('\0');
+    key.append(functionName);
+    std::pair<llvm::StringMap<IntrinsicList>::iterator, bool> inserted =
+      _lookups[tableIndex].insert(std::make_pair(key.str(), IntrinsicList()));
+    IntrinsicList& intrinsics = inserted.first->second;
+    if (inserted.second) {
+      CA2WEX<> wideTypeName(typeName.str().c_str(), CP_UTF8);
+      CA2WEX<> wideFunctionName(functionName.str().c_str(), CP_UTF8);
+      UINT64 lookupCookie = 0;
+      for (;;) {
+        const HLSL_INTRINSIC* pIntrinsic = nullptr;
+        if (FAILED(_tables[tableIndex]->LookupIntrinsic(
+                wideTypeName, wideFunctionName, &pIntrinsic, &lookupCookie)) ||
+            pIntrinsic == nullptr) {
+          break;
+        }
+        // Tables that don't advance the cookie return the same intrinsic again.
+        if (std::find(intrinsics.begin(), intrinsics.end(), pIntrinsic) != intrinsics.end()) {
+          break;
+        }
+        intrinsics.push_back(pIntrinsic);
+      }
+    }
+    return intrinsics;
+  }
+};
+
+/// <summary>
+/// Use this class to iterate over intrinsic definitions from the extension
+/// tables that have the same name and parameter count.
 /// </summary>
 class IntrinsicTableDefIter
 {
 private:
   StringRef _typeName;
   StringRef _functionName;
-  llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& _tables;
-  const HLSL_INTRINSIC* _tableIntrinsic;
-  UINT64 _tableLookupCookie;
+  IntrinsicTableLookupCache& _cache;
+  const IntrinsicTableLookupCache::IntrinsicList* _tableIntrinsics;
   unsigned _tableIndex;
+  unsigned _intrinsicIndex;
   unsigned _argCount;
   bool _firstChecked;
 
   IntrinsicTableDefIter(
-    llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& tables,
+    IntrinsicTableLookupCache& cache,
     StringRef typeName,
     StringRef functionName,
     unsigned argCount) :
-    _tables(tables), _typeName(typeName), _functionName(functionName), _argCount(argCount),
-    _tableIndex(0), _tableLookupCookie(0), _tableIntrinsic(nullptr), _firstChecked(false)
+    _cache(cache), _typeName(typeName), _functionName(functionName), _argCount(argCount),
+    _tableIndex(0), _intrinsicIndex(0), _tableIntrinsics(nullptr), _firstChecked(false)
   {
   }
 
-  void CheckForIntrinsic() {
-    if (_tableIndex >= _tables.size()) {
-      return;
+  void MoveToNext() {
+    size_t tableCount = _cache.GetTables().size();
+    if (_firstChecked) {
+      _intrinsicIndex++;
     }
-
     _firstChecked = true;
 
-    // TODO: review this - this will allocate at least once per string
-    CA2WEX<> typeName(_typeName.str().c_str(), CP_UTF8);
-    CA2WEX<> functionName(_functionName.str().c_str(), CP_UTF8);
-
-    if (FAILED(_tables[_tableIndex]->LookupIntrinsic(
-            typeName, functionName, &_tableIntrinsic, &_tableLookupCookie))) {
-      _tableLookupCookie = 0;
-      _tableIntrinsic = nullptr;
+    for (; _tableIndex < tableCount; _tableIndex++, _intrinsicIndex = 0, _tableIntrinsics = nullptr) {
+      if (_tableIntrinsics == nullptr) {
+        _tableIntrinsics = &_cache.Lookup(_tableIndex, _typeName, _functionName);
+      }
+      for (; _intrinsicIndex < _tableIntrinsics->size(); _intrinsicIndex++) {
+        if ((*_tableIntrinsics)[_intrinsicIndex]->uNumArgs == _argCount + 1) // uNumArgs includes return
+          return;
+      }
     }
   }
 
-  void MoveToNext() {
-    for (;;) {
-      // If we don't have an intrinsic, try the following table.
-      if (_firstChecked && _tableIntrinsic == nullptr) {
-        _tableIndex++;
-      }
-
-      CheckForIntrinsic();
-      if (_tableIndex == _tables.size() ||
-          (_tableIntrinsic != nullptr &&
-           _tableIntrinsic->uNumArgs ==
-               (_argCount + 1))) // uNumArgs includes return
-        break;
-    }
+  const HLSL_INTRINSIC* GetTableIntrinsic()
+  {
+    return (*_tableIntrinsics)[_intrinsicIndex];
   }
 
 public:
-  static IntrinsicTableDefIter CreateStart(llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& tables,
+  static IntrinsicTableDefIter CreateStart(IntrinsicTableLookupCache& cache,
     StringRef typeName,
     StringRef functionName,
     unsigned argCount)
   {
-    IntrinsicTableDefIter result(tables, typeName, functionName, argCount);
+    IntrinsicTableDefIter result(cache, typeName, functionName, argCount);
     return result;
   }
 
-  static IntrinsicTableDefIter CreateEnd(llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& tables)
+  static IntrinsicTableDefIter CreateEnd(IntrinsicTableLookupCache& cache)
   {
-    IntrinsicTableDefIter result(tables, StringRef(), StringRef(), 0);
-    result._tableIndex = tables.size();
+    IntrinsicTableDefIter result(cache, StringRef(), StringRef(), 0);
+    result._tableIndex = cache.GetTables().size();
+    result._firstChecked = true;
     return result;
   }
 
@@ -2126,13 +2230,13 @@ public:
   const HLSL_INTRINSIC* operator*()
   {
     DXASSERT(_firstChecked, "otherwise deref without comparing to end");
-    return _tableIntrinsic;
+    return GetTableIntrinsic();
   }
 
   LPCSTR GetTableName()
   {
     LPCSTR tableName = nullptr;
-    if (FAILED(_tables[_tableIndex]->GetTableName(&tableName))) {
+    if (FAILED(_cache.GetTables()[_tableIndex]->GetTableName(&tableName))) {
       return nullptr;
     }
     return tableName;
@@ -2141,7 +2245,7 @@ public:
   LPCSTR GetLoweringStrategy()
   {
     LPCSTR lowering = nullptr;
-    if (FAILED(_tables[_tableIndex]->GetLoweringStrategy(_tableIntrinsic->Op, &lowering))) {
+    if (FAILED(_cache.GetTables()[_tableIndex]->GetLoweringStrategy(GetTableIntrinsic()->Op, &lowering))) {
       return nullptr;
     }
     return lowering;
@@ -2248,6 +2352,10 @@ private:
 
   // Intrinsic tables available externally.
   llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2> m_intrinsicTables;
+  // Results of looking up intrinsics in m_intrinsicTables.
+  IntrinsicTableLookupCache m_intrinsicTableLookups;
+  // Name index of the built-in intrinsic tables.
+  IntrinsicTableIndex m_intrinsicIndex;
 
   // Scalar types indexed by HLSLScalarType.
   QualType m_scalarTypes[HLSLScalarTypeCount];
@@ -2263,10 +2371,13 @@ private:
   TypedefDecl* m_vectorTypedefs[HLSLScalarTypeCount][4];
 
   // Built-in object types declarations, indexed by basic kind constant.
+  // Declarations are created the first time their name is looked up.
   CXXRecordDecl* m_objectTypeDecls[_countof(g_ArBasicKindsAsTypes)];
-  // Map from object decl to the object index.
-  using ObjectTypeDeclMapType = std::array<std::pair<CXXRecordDecl*,unsigned>, _countof(g_ArBasicKindsAsTypes)+_countof(g_DeprecatedEffectObjectNames)>;
-  ObjectTypeDeclMapType m_objectTypeDeclsMap;
+  // Deprecated effect object declarations, and the 'sampler' alias.
+  CXXRecordDecl* m_effectObjectDecls[_countof(g_DeprecatedEffectObjectNames)];
+  TypedefDecl* m_samplerTypedef;
+  // Map from object decl (including effect objects) to the object index.
+  llvm::DenseMap<const CXXRecordDecl*, unsigned> m_objectTypeDeclsMap;
   // Mask for object which not has methods created.
   uint64_t m_objectTypeLazyInitMask;
 
@@ -2632,93 +2743,153 @@ private:
     }
   }
 
-  static bool ObjectTypeDeclMapTypeCmp(const std::pair<CXXRecordDecl*,unsigned> &a,
-                           const std::pair<CXXRecordDecl*,unsigned> &b) {
-    return a.first < b.first;
-  };
-
   int FindObjectBasicKindIndex(const CXXRecordDecl* recordDecl) {
-    auto begin = m_objectTypeDeclsMap.begin();
-    auto end = m_objectTypeDeclsMap.end();
-    auto val = std::make_pair(const_cast<CXXRecordDecl*>(recordDecl), 0);
-    auto low = std::lower_bound(begin, end, val, ObjectTypeDeclMapTypeCmp);
-    if (low == end)
-      return -1;
-    if (recordDecl == low->first)
-      return low->second;
-    else
+    auto found = m_objectTypeDeclsMap.find(recordDecl);
+    if (found == m_objectTypeDeclsMap.end())
       return -1;
+    return found->second;
   }
 
-  // Adds all built-in HLSL object types.
-  void AddObjectTypes()
+  // Built-in type names are looked up in a single table that is shared by all
+  // instances; each name maps to a slot. Slots below the number of object
+  // kinds are indices into g_ArBasicKindsAsTypes, followed by the deprecated
+  // effect object names and the 'sampler' alias.
+  static const unsigned EffectObjectSlotBase = _countof(g_ArBasicKindsAsTypes);
+  static const unsigned SamplerAliasSlot = EffectObjectSlotBase + _countof(g_DeprecatedEffectObjectNames);
+
+  static const llvm::StringMap<unsigned>& GetBuiltinTypeNameSlots()
+  {
+    static const llvm::StringMap<unsigned> slots = []() {
+      llvm::StringMap<unsigned> result;
+      for (unsigned i = 0; i < _countof(g_ArBasicKindsAsTypes); i++) {
+        ArBasicKind kind = g_ArBasicKindsAsTypes[i];
+        if (kind == AR_OBJECT_WAVE) // wave objects are currently unused
+          continue;
+        result.insert(std::make_pair(g_ArBasicTypeNames[kind], i));
+      }
+      for (unsigned i = 0; i < _countof(g_DeprecatedEffectObjectNames); i++)
+        result.insert(std::make_pair(g_DeprecatedEffectObjectNames[i], EffectObjectSlotBase + i));
+      result.insert(std::make_pair("sampler", SamplerAliasSlot));
+      return result;
+    }();
+    return slots;
+  }
+
+  static unsigned GetObjectKindIndex(ArBasicKind kind)
+  {
+    const ArBasicKind* match = std::find(g_ArBasicKindsAsTypes, &g_ArBasicKindsAsTypes[_countof(g_ArBasicKindsAsTypes)], kind);
+    DXASSERT(match != &g_ArBasicKindsAsTypes[_countof(g_ArBasicKindsAsTypes)], "otherwise can't find constant in basic kinds");
+    return match - g_ArBasicKindsAsTypes;
+  }
+
+  // Adds the built-in HLSL object type at the given index in g_ArBasicKindsAsTypes.
+  CXXRecordDecl* AddObjectType(unsigned i)
   {
     DXASSERT(m_context != nullptr, "otherwise caller hasn't initialized context yet");
 
-    QualType float4Type = LookupVectorType(HLSLScalarType_float, 4);
-    TypeSourceInfo *float4TypeSourceInfo = m_context->getTrivialTypeSourceInfo(float4Type, NoLoc);
-    m_objectTypeLazyInitMask = 0;
-    unsigned effectKindIndex = 0;
-    for (int i = 0; i < _countof(g_ArBasicKindsAsTypes); i++)
+    ArBasicKind kind = g_ArBasicKindsAsTypes[i];
+    DXASSERT(kind != AR_OBJECT_WAVE, "wave objects are currently unused");
+    DXASSERT(kind < _countof(g_ArBasicTypeNames), "g_ArBasicTypeNames has the wrong number of entries");
+    _Analysis_assume_(kind < _countof(g_ArBasicTypeNames));
+    const char* typeName = g_ArBasicTypeNames[kind];
+    uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
+    CXXRecordDecl* recordDecl = nullptr;
+    if (templateArgCount == 0)
     {
-      ArBasicKind kind = g_ArBasicKindsAsTypes[i];
-      if (kind == AR_OBJECT_WAVE) { // wave objects are currently unused
-        continue;
-      }
-      if (kind == AR_OBJECT_LEGACY_EFFECT)
-        effectKindIndex = i;
+      AddRecordTypeWithHandle(*m_context, &recordDecl, typeName);
+      DXASSERT(recordDecl != nullptr, "AddRecordTypeWithHandle failed to return the object declaration");
+      recordDecl->setImplicit(true);
+    }
+    else
+    {
+      DXASSERT(templateArgCount == 1 || templateArgCount == 2, "otherwise a new case has been added");
+
+      ClassTemplateDecl* typeDecl = nullptr;
+      TypeSourceInfo* typeDefault = nullptr;
+      if (TemplateHasDefaultType(kind)) {
+        QualType float4Type = LookupVectorType(HLSLScalarType_float, 4);
+        typeDefault = m_context->getTrivialTypeSourceInfo(float4Type, NoLoc);
+      }
+      AddTemplateTypeWithHandle(*m_context, &typeDecl, &recordDecl, typeName, templateArgCount, typeDefault);
+      DXASSERT(typeDecl != nullptr, "AddTemplateTypeWithHandle failed to return the object declaration");
+      typeDecl->setImplicit(true);
+      recordDecl->setImplicit(true);
+    }
+    m_objectTypeDecls[i] = recordDecl;
+    m_objectTypeDeclsMap[recordDecl] = i;
+    m_objectTypeLazyInitMask |= ((uint64_t)1)<<i;
+    return recordDecl;
+  }
 
-      DXASSERT(kind < _countof(g_ArBasicTypeNames), "g_ArBasicTypeNames has the wrong number of entries");
-      _Analysis_assume_(kind < _countof(g_ArBasicTypeNames));
-      const char* typeName = g_ArBasicTypeNames[kind];
-      uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
-      CXXRecordDecl* recordDecl = nullptr;
-      if (templateArgCount == 0)
-      {
-        AddRecordTypeWithHandle(*m_context, &recordDecl, typeName);
-        DXASSERT(recordDecl != nullptr, "AddRecordTypeWithHandle failed to return the object declaration");
-        recordDecl->setImplicit(true);
-      }
-      else
-      {
-        DXASSERT(templateArgCount == 1 || templateArgCount == 2, "otherwise a new case has been added");
+  CXXRecordDecl* GetObjectTypeDecl(unsigned i)
+  {
+    CXXRecordDecl* recordDecl = m_objectTypeDecls[i];
+    return recordDecl != nullptr ? recordDecl : AddObjectType(i);
+  }
 
-        ClassTemplateDecl* typeDecl = nullptr;
-        TypeSourceInfo* typeDefault = TemplateHasDefaultType(kind) ? float4TypeSourceInfo : nullptr;
-        AddTemplateTypeWithHandle(*m_context, &typeDecl, &recordDecl, typeName, templateArgCount, typeDefault);
-        DXASSERT(typeDecl != nullptr, "AddTemplateTypeWithHandle failed to return the object declaration");
-        typeDecl->setImplicit(true);
-        recordDecl->setImplicit(true);
-      }
-      m_objectTypeDecls[i] = recordDecl;
-      m_objectTypeDeclsMap[i] = std::make_pair(recordDecl, i);
-      m_objectTypeLazyInitMask |= ((uint64_t)1)<<i;
-    }
+  // Adds the deprecated effect object type at the given index in g_DeprecatedEffectObjectNames.
+  CXXRecordDecl* GetEffectObjectDecl(unsigned i)
+  {
+    if (m_effectObjectDecls[i] != nullptr)
+      return m_effectObjectDecls[i];
 
-    // Create an alias for SamplerState. 'sampler' is very commonly used.
-    {
-      DeclContext* currentDeclContext = m_context->getTranslationUnitDecl();
-      IdentifierInfo& samplerId = m_context->Idents.get(StringRef("sampler"), tok::TokenKind::identifier);
-      TypeSourceInfo* samplerTypeSource = m_context->getTrivialTypeSourceInfo(GetBasicKindType(AR_OBJECT_SAMPLER));
-      TypedefDecl* samplerDecl = TypedefDecl::Create(*m_context, currentDeclContext, NoLoc, NoLoc, &samplerId, samplerTypeSource);
-      currentDeclContext->addDecl(samplerDecl);
-      samplerDecl->setImplicit(true);
+    DeclContext* currentDeclContext = m_context->getTranslationUnitDecl();
+    IdentifierInfo& idInfo = m_context->Idents.get(StringRef(g_DeprecatedEffectObjectNames[i]), tok::TokenKind::identifier);
+    CXXRecordDecl *effectObjDecl = CXXRecordDecl::Create(*m_context, TagTypeKind::TTK_Struct, currentDeclContext, NoLoc, NoLoc, &idInfo);
+    currentDeclContext->addDecl(effectObjDecl);
+    effectObjDecl->setImplicit(true);
+    m_effectObjectDecls[i] = effectObjDecl;
+    m_objectTypeDeclsMap[effectObjDecl] = GetObjectKindIndex(AR_OBJECT_LEGACY_EFFECT);
+    return effectObjDecl;
+  }
 
-      // Create decls for each deprecated effect object type:
-      unsigned effectObjBase = _countof(g_ArBasicKindsAsTypes);
-      // TypeSourceInfo* effectObjTypeSource = m_context->getTrivialTypeSourceInfo(GetBasicKindType(AR_OBJECT_LEGACY_EFFECT));
-      for (int i = 0; i < _countof(g_DeprecatedEffectObjectNames); i++) {
-        IdentifierInfo& idInfo = m_context->Idents.get(StringRef(g_DeprecatedEffectObjectNames[i]), tok::TokenKind::identifier);
-        //TypedefDecl* effectObjDecl = TypedefDecl::Create(*m_context, currentDeclContext, NoLoc, NoLoc, &idInfo, effectObjTypeSource);
-        CXXRecordDecl *effectObjDecl = CXXRecordDecl::Create(*m_context, TagTypeKind::TTK_Struct, currentDeclContext, NoLoc, NoLoc, &idInfo);
-        currentDeclContext->addDecl(effectObjDecl);
-        effectObjDecl->setImplicit(true);
-        m_objectTypeDeclsMap[i+effectObjBase] = std::make_pair(effectObjDecl, effectKindIndex);
-      }
-    }
+  // Creates an alias for SamplerState. 'sampler' is very commonly used.
+  TypedefDecl* GetSamplerTypedef()
+  {
+    if (m_samplerTypedef != nullptr)
+      return m_samplerTypedef;
+
+    DeclContext* currentDeclContext = m_context->getTranslationUnitDecl();
+    IdentifierInfo& samplerId = m_context->Idents.get(StringRef("sampler"), tok::TokenKind::identifier);
+    TypeSourceInfo* samplerTypeSource = m_context->getTrivialTypeSourceInfo(GetBasicKindType(AR_OBJECT_SAMPLER));
+    TypedefDecl* samplerDecl = TypedefDecl::Create(*m_context, currentDeclContext, NoLoc, NoLoc, &samplerId, samplerTypeSource);
+    currentDeclContext->addDecl(samplerDecl);
+    samplerDecl->setImplicit(true);
+    m_samplerTypedef = samplerDecl;
+    return samplerDecl;
+  }
 
-    // Make sure it's in order.
-    std::sort(m_objectTypeDeclsMap.begin(), m_objectTypeDeclsMap.end(), ObjectTypeDeclMapTypeCmp);
+  // Declares the built-in type with the given name, if there is one.
+  // Returns false if the name doesn't refer to a built-in object type.
+  bool DeclareBuiltinTypeForName(StringRef name)
+  {
+    const llvm::StringMap<unsigned>& slots = GetBuiltinTypeNameSlots();
+    llvm::StringMap<unsigned>::const_iterator found = slots.find(name);
+    if (found == slots.end())
+      return false;
+
+    unsigned slot = found->second;
+    if (slot < EffectObjectSlotBase)
+      GetObjectTypeDecl(slot);
+    else if (slot < SamplerAliasSlot)
+      GetEffectObjectDecl(slot - EffectObjectSlotBase);
+    else
+      GetSamplerTypedef();
+    return true;
+  }
+
+  // Adds all built-in HLSL object types. Most compilations only reference a
+  // few of them and have them declared on lookup instead; this is used when
+  // all of them need to be visible, for example for code completion.
+  void AddObjectTypes()
+  {
+    for (unsigned i = 0; i < _countof(g_ArBasicKindsAsTypes); i++) {
+      if (g_ArBasicKindsAsTypes[i] != AR_OBJECT_WAVE)
+        GetObjectTypeDecl(i);
+    }
+    GetSamplerTypedef();
+    for (unsigned i = 0; i < _countof(g_DeprecatedEffectObjectNames); i++)
+      GetEffectObjectDecl(i);
   }
 
   FunctionDecl* AddSubscriptSpecialization(
@@ -2740,8 +2911,13 @@ public:
     m_context(nullptr),
     m_sema(nullptr),
     m_vectorTemplateDecl(nullptr),
-    m_matrixTemplateDecl(nullptr)
+    m_matrixTemplateDecl(nullptr),
+    m_intrinsicTableLookups(m_intrinsicTables),
+    m_samplerTypedef(nullptr),
+    m_objectTypeLazyInitMask(0)
   {
+    memset(m_objectTypeDecls, 0, sizeof(m_objectTypeDecls));
+    memset(m_effectObjectDecls, 0, sizeof(m_effectObjectDecls));
     memset(m_matrixTypes, 0, sizeof(m_matrixTypes));
     memset(m_matrixShorthandTypes, 0, sizeof(m_matrixShorthandTypes));
     memset(m_vectorTypes, 0, sizeof(m_vectorTypes));
@@ -2766,7 +2942,9 @@ public:
     m_sema = &S;
     S.addExternalSource(this);
 
-    AddObjectTypes();
+    // Code completion lists the types in scope, so it needs all of them.
+    if (S.getPreprocessor().isCodeCompletionEnabled())
+      AddObjectTypes();
     AddStdIsEqualImplementation(S.getASTContext(), S);
     for (auto && intrinsic : m_intrinsicTables) {
       AddIntrinsicTableMethods(intrinsic);
@@ -2846,6 +3024,9 @@ public:
 
       R.addDecl(qts);
       return true;
+    } else if (DeclareBuiltinTypeForName(nameIdentifier)) {
+      // The declaration was just added to the translation unit.
+      return m_sema->LookupQualifiedName(R, m_context->getTranslationUnitDecl());
     }
 
     return false;
@@ -3055,18 +3236,16 @@ public:
 
     // Function intrinsics are added on-demand, objects get template methods.
     for (int i = 0; i < _countof(g_ArBasicKindsAsTypes); i++) {
-      // Grab information already processed by AddObjectTypes.
       ArBasicKind kind = g_ArBasicKindsAsTypes[i];
+      if (kind == AR_OBJECT_WAVE) { // wave objects are currently unused
+        continue;
+      }
       const char *typeName = g_ArBasicTypeNames[kind];
       uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
       DXASSERT(0 <= templateArgCount && templateArgCount <= 2,
         "otherwise a new case has been added");
       int startDepth = (templateArgCount == 0) ? 0 : 1;
-      CXXRecordDecl *recordDecl = m_objectTypeDecls[i];
-      if (recordDecl == nullptr) {
-        DXASSERT(kind == AR_OBJECT_WAVE, "else objects other than reserved not initialized");
-        continue;
-      }
+      CXXRecordDecl *recordDecl = GetObjectTypeDecl(i);
 
       // This is a variation of AddObjectMethods using the new table.
       const HLSL_INTRINSIC *pIntrinsic = nullptr;
@@ -3194,10 +3373,7 @@ public:
     case AR_OBJECT_CONSUME_STRUCTURED_BUFFER:
     case AR_OBJECT_WAVE:
     {
-        const ArBasicKind* match = std::find(g_ArBasicKindsAsTypes, &g_ArBasicKindsAsTypes[_countof(g_ArBasicKindsAsTypes)], kind);
-        DXASSERT(match != &g_ArBasicKindsAsTypes[_countof(g_ArBasicKindsAsTypes)], "otherwise can't find constant in basic kinds");
-        size_t index = match - g_ArBasicKindsAsTypes;
-        return m_context->getTagDeclType(this->m_objectTypeDecls[index]);
+        return m_context->getTagDeclType(GetObjectTypeDecl(GetObjectKindIndex(kind)));
     }
 
     case AR_OBJECT_SAMPLER1D:
@@ -3315,24 +3491,9 @@ public:
     StringRef nameIdentifier,
     size_t argumentCount)
   {
-    // TODO: avoid linear scan
-    for (unsigned int i = 0; i < tableSize; i++) {
-      const HLSL_INTRINSIC* pIntrinsic = &table[i];
-
-      // Do some quick checks to verify size and name.
-      if (pIntrinsic->uNumArgs != 1 + argumentCount) {
-        continue;
-      }
-      if (!nameIdentifier.equals(StringRef(pIntrinsic->pArgs[0].pName))) {
-        continue;
-      }
-
-      return IntrinsicDefIter::CreateStart(table, tableSize, pIntrinsic,
-        IntrinsicTableDefIter::CreateStart(m_intrinsicTables, typeName, nameIdentifier, argumentCount));
-    }
-
-    return IntrinsicDefIter::CreateStart(table, tableSize, table + tableSize,
-      IntrinsicTableDefIter::CreateStart(m_intrinsicTables, typeName, nameIdentifier, argumentCount));
+    const HLSL_INTRINSIC* pIntrinsic = m_intrinsicIndex.Find(table, tableSize, nameIdentifier, argumentCount);
+    return IntrinsicDefIter::CreateStart(table, tableSize, pIntrinsic,
+      IntrinsicTableDefIter::CreateStart(m_intrinsicTableLookups, typeName, nameIdentifier, argumentCount));
   }
 
   bool AddOverloadedCallCandidates(
@@ -3355,7 +3516,7 @@ public:
     IntrinsicDefIter cursor = FindIntrinsicByNameAndArgCount(
       g_Intrinsics, _countof(g_Intrinsics), StringRef(), nameIdentifier, Args.size());
     IntrinsicDefIter end = IntrinsicDefIter::CreateEnd(
-      g_Intrinsics, _countof(g_Intrinsics), IntrinsicTableDefIter::CreateEnd(m_intrinsicTables));
+      g_Intrinsics, _countof(g_Intrinsics), IntrinsicTableDefIter::CreateEnd(m_intrinsicTableLookups));
     while (cursor != end)
     {
       // If this is the intrinsic we're interested in, build up a representation
@@ -7781,7 +7942,7 @@ Sema::TemplateDeductionResult HLSLExternalSource::DeduceTemplateArgumentsForHLSL
   QualType argTypes[g_MaxIntrinsicParamCount + 1];
   StringRef nameIdentifier = FunctionTemplate->getName();
   IntrinsicDefIter cursor = FindIntrinsicByNameAndArgCount(intrinsics, intrinsicCount, objectName, nameIdentifier, Args.size());
-  IntrinsicDefIter end = IntrinsicDefIter::CreateEnd(intrinsics, intrinsicCount, IntrinsicTableDefIter::CreateEnd(m_intrinsicTables));
+  IntrinsicDefIter end = IntrinsicDefIter::CreateEnd(intrinsics, intrinsicCount, IntrinsicTableDefIter::CreateEnd(m_intrinsicTableLookups));
 
   while (cursor != end)
   {
@@ -0,0 +1,17 @@
+// RUN: %dxc -E main -T ps_6_0 %s | %opt -analyze -hlsl-dxil-cost | FileCheck %s
+
+// CHECK: Longest path: {{[0-9]+}} instructions ({{[0-9]+}} ALU, 1 texture, {{[0-9]+}} memory, 0 wave)
+// CHECK: Signature rows: 1 input, 1 output
+// CHECK: Loops: 1
+// CHECK: depth 1: unknown trip count
+
+Texture2D t;
+SamplerState s;
+cbuffer C { uint n; };
+
+float4 main(float2 uv : TEXCOORD) : SV_Target {
+  float4 c = 0;
+  for (uint i = 0; i < n; ++i)
+    c += t.Sample(s, uv + i);
+  return c;
+}
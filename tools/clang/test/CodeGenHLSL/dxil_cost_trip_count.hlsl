@@ -0,0 +1,17 @@
+// RUN: %dxc -E main -T ps_6_0 %s | %opt -analyze -hlsl-dxil-cost | FileCheck %s
+
+// The sample in the loop body is weighted by the trip count.
+// CHECK: Longest path: {{[0-9]+}} instructions ({{[0-9]+}} ALU, 16 texture, {{[0-9]+}} memory, 0 wave)
+// CHECK: Loops: 1
+// CHECK: depth 1: 16 iterations
+
+Texture2D t;
+SamplerState s;
+
+float4 main(float2 uv : TEXCOORD) : SV_Target {
+  float4 c = 0;
+  [loop]
+  for (uint i = 0; i < 16; ++i)
+    c += t.Sample(s, uv + i);
+  return c;
+}
@@ -0,0 +1,18 @@
+// RUN: %dxc -E main -T ps_6_0 -Od %s | %opt -mem2reg -analyze -hlsl-dxil-cost | FileCheck %s
+
+// Without optimizations the loop isn't rotated, so it exits from the header,
+// which runs once more than the body.
+// CHECK: Longest path: {{[0-9]+}} instructions ({{[0-9]+}} ALU, 16 texture, {{[0-9]+}} memory, 0 wave)
+// CHECK: Loops: 1
+// CHECK: depth 1: 16 iterations
+
+Texture2D t;
+SamplerState s;
+
+float4 main(float2 uv : TEXCOORD) : SV_Target {
+  float4 c = 0;
+  [loop]
+  for (uint i = 0; i < 16; ++i)
+    c += t.Sample(s, uv + i);
+  return c;
+}
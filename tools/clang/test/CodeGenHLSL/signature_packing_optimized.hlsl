@@ -0,0 +1,36 @@
+// RUN: %dxc -E main -T vs_6_0 -pack_optimized %s | FileCheck %s
+
+// Packed greedily, D would go to a sixth row (register 5).
+
+// CHECK: ; Output signature:
+// CHECK: ; SV_Position 0 xyzw 0 POS float
+// CHECK: ; C 0 x 1 NONE float
+// CHECK: ; C 1 x 2 NONE float
+// CHECK: ; C 2 x 3 NONE float
+// CHECK: ; B 0 yzw 1 NONE float
+// CHECK: ; B 1 yzw 2 NONE float
+// CHECK: ; A 0 w 3 NONE float
+// CHECK: ; A 1 w 4 NONE float
+// CHECK: ; D 0 xyz 4 NONE float
+
+struct VSOut {
+  float4 pos : SV_Position;
+  float c[3] : C;
+  float3 b[2] : B;
+  float a[2] : A;
+  float3 d : D;
+};
+
+VSOut main(float4 p : P) {
+  VSOut o;
+  o.pos = p;
+  o.c[0] = p.x;
+  o.c[1] = p.y;
+  o.c[2] = p.z;
+  o.b[0] = p.xyz;
+  o.b[1] = p.yzw;
+  o.a[0] = p.w;
+  o.a[1] = p.x;
+  o.d = p.zyx;
+  return o;
+}
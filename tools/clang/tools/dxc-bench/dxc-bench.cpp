@@ -0,0 +1,515 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxc-bench.cpp                                                             //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the entry point for the dxc-bench console program, which         //
+// measures compile, optimize, validate and reflection latency and           //
+// multi-threaded compile throughput over a fixed corpus of shaders.         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/Global.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/WinIncludes.h"
+#include <vector>
+#include <string>
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/dxcapi.use.h"
+#include "dxc/Support/HLSLOptions.h"
+#include "dxc/HLSL/DxilContainer.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/microcom.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "d3d12shader.h"
+#include <psapi.h>
+#include <comdef.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace llvm;
+
+inline bool wcsieq(LPCWSTR a, LPCWSTR b) { return _wcsicmp(a, b) == 0; }
+inline bool wcsistarts(LPCWSTR text, LPCWSTR prefix) {
+  return wcslen(text) >= wcslen(prefix) && _wcsnicmp(text, prefix, wcslen(prefix)) == 0;
+}
+
+enum BenchStage {
+  BenchStage_Compile,
+  BenchStage_Optimize,
+  BenchStage_Validate,
+  BenchStage_Reflect,
+  BenchStage_Count
+};
+
+static const char *BenchStageNames[BenchStage_Count] = {
+  "compile", "optimize", "validate", "reflect"
+};
+
+typedef std::chrono::steady_clock BenchClock;
+
+// A corpus entry, with everything that is computed once up front so that only
+// the stage being measured falls inside each timed interval.
+struct BenchShader {
+  std::string Name;                     // Name as listed in the corpus file.
+  std::wstring Path;                    // Full path to the source.
+  std::wstring EntryPoint;
+  std::wstring TargetProfile;
+  std::vector<std::wstring> ArgStrings; // Arguments from the RUN line.
+  std::vector<LPCWSTR> Args;
+  std::vector<std::wstring> PassStrings; // Optimizer passes for the RUN line arguments.
+  std::vector<LPCWSTR> Passes;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pHighLevel;         // Module as produced by -fcgl.
+  std::vector<double> Samples[BenchStage_Count]; // Milliseconds.
+};
+
+// The instances used by a single thread.
+struct BenchContext {
+  CComPtr<IDxcLibrary> pLibrary;
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOptimizer> pOptimizer;
+  CComPtr<IDxcValidator> pValidator;
+  CComPtr<IDxcContainerReflection> pReflection;
+  CComPtr<IDxcIncludeHandler> pIncludeHandler;
+
+  BenchContext() {
+    IFT(DxcCreateInstance(CLSID_DxcLibrary, IID_PPV_ARGS(&pLibrary)));
+    IFT(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&pCompiler)));
+    IFT(DxcCreateInstance(CLSID_DxcOptimizer, IID_PPV_ARGS(&pOptimizer)));
+    IFT(DxcCreateInstance(CLSID_DxcValidator, IID_PPV_ARGS(&pValidator)));
+    IFT(DxcCreateInstance(CLSID_DxcContainerReflection, IID_PPV_ARGS(&pReflection)));
+    IFT(pLibrary->CreateIncludeHandler(&pIncludeHandler));
+  }
+};
+
+static double MillisecondsSince(BenchClock::time_point start) {
+  return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+static std::string BlobToUtf8(IDxcLibrary *pLibrary, IDxcBlob *pBlob) {
+  if (pBlob == nullptr)
+    return std::string();
+  CComPtr<IDxcBlobEncoding> pUtf8;
+  IFT(pLibrary->GetBlobAsUtf8(pBlob, &pUtf8));
+  return std::string((const char *)pUtf8->GetBufferPointer(),
+                     pUtf8->GetBufferSize());
+}
+
+// Returns the result blob, or throws with the error buffer as the message.
+static void GetResultOrThrow(IDxcLibrary *pLibrary, IDxcOperationResult *pResult,
+                             IDxcBlob **ppBlob) {
+  HRESULT status;
+  IFT(pResult->GetStatus(&status));
+  if (FAILED(status)) {
+    CComPtr<IDxcBlobEncoding> pErrors;
+    IFT(pResult->GetErrorBuffer(&pErrors));
+    throw ::hlsl::Exception(status, BlobToUtf8(pLibrary, pErrors));
+  }
+  if (ppBlob != nullptr)
+    IFT(pResult->GetResult(ppBlob));
+}
+
+// Reads the arguments of the first '// RUN: %dxc' line of the source.
+static void ReadRunLine(BenchShader &shader) {
+  StringRef text((const char *)shader.pSource->GetBufferPointer(),
+                 shader.pSource->GetBufferSize());
+  const StringRef runPrefix = "RUN: %dxc ";
+  size_t pos = text.find(runPrefix);
+  if (pos == StringRef::npos)
+    throw ::hlsl::Exception(E_INVALIDARG, shader.Name + ": no '// RUN: %dxc' line");
+  StringRef line = text.substr(pos + runPrefix.size());
+  line = line.substr(0, line.find_first_of("\r\n"));
+  line = line.substr(0, line.find('|'));
+
+  SmallVector<StringRef, 8> splitArgs;
+  line.split(splitArgs, " ", -1, /*KeepEmpty*/ false);
+  splitArgs.erase(std::remove(splitArgs.begin(), splitArgs.end(), "%s"),
+                  splitArgs.end());
+
+  hlsl::options::MainArgs argStrings(splitArgs);
+  hlsl::options::DxcOpts opts;
+  std::string errorString;
+  raw_string_ostream errorStream(errorString);
+  if (hlsl::options::ReadDxcOpts(hlsl::options::getHlslOptTable(),
+                                 /*flagsToInclude*/ 0, argStrings, opts,
+                                 errorStream) != 0) {
+    throw ::hlsl::Exception(E_INVALIDARG, shader.Name + ": " + errorStream.str());
+  }
+  shader.EntryPoint = Unicode::UTF8ToUTF16StringOrThrow(opts.EntryPoint.str().c_str());
+  shader.TargetProfile = Unicode::UTF8ToUTF16StringOrThrow(opts.TargetProfile.str().c_str());
+  hlsl::options::CopyArgsToWStrings(opts.Args, hlsl::options::CoreOption,
+                                    shader.ArgStrings);
+  for (const std::wstring &a : shader.ArgStrings)
+    shader.Args.push_back(a.c_str());
+}
+
+// Produces the high-level module and the pass list that the optimizer stage
+// runs over it, as a split -fcgl / optimizer compilation would.
+static void PrepareOptimizerInput(BenchContext &ctx, BenchShader &shader) {
+  std::vector<LPCWSTR> args(shader.Args);
+  args.push_back(L"-Odump");
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlob> pPassesBlob;
+  IFT(ctx.pCompiler->Compile(shader.pSource, shader.Path.c_str(),
+                             shader.EntryPoint.c_str(), shader.TargetProfile.c_str(),
+                             args.data(), args.size(), nullptr, 0,
+                             ctx.pIncludeHandler, &pResult));
+  GetResultOrThrow(ctx.pLibrary, pResult, &pPassesBlob);
+
+  shader.PassStrings.push_back(L"-hlsl-hlensure");
+  SmallVector<StringRef, 64> lines;
+  StringRef((const char *)pPassesBlob->GetBufferPointer(),
+            pPassesBlob->GetBufferSize())
+      .split(lines, "\n", -1, /*KeepEmpty*/ false);
+  for (StringRef line : lines) {
+    line = line.trim();
+    if (line.empty() || line[0] == '#')
+      continue;
+    shader.PassStrings.push_back(Unicode::UTF8ToUTF16StringOrThrow(line.str().c_str()));
+  }
+  for (const std::wstring &p : shader.PassStrings)
+    shader.Passes.push_back(p.c_str());
+
+  args.back() = L"-fcgl";
+  pResult.Release();
+  IFT(ctx.pCompiler->Compile(shader.pSource, shader.Path.c_str(),
+                             shader.EntryPoint.c_str(), shader.TargetProfile.c_str(),
+                             args.data(), args.size(), nullptr, 0,
+                             ctx.pIncludeHandler, &pResult));
+  GetResultOrThrow(ctx.pLibrary, pResult, &shader.pHighLevel);
+}
+
+static void CompileShader(BenchContext &ctx, BenchShader &shader,
+                          IDxcBlob **ppContainer) {
+  CComPtr<IDxcOperationResult> pResult;
+  IFT(ctx.pCompiler->Compile(shader.pSource, shader.Path.c_str(),
+                             shader.EntryPoint.c_str(), shader.TargetProfile.c_str(),
+                             shader.Args.data(), shader.Args.size(), nullptr, 0,
+                             ctx.pIncludeHandler, &pResult));
+  GetResultOrThrow(ctx.pLibrary, pResult, ppContainer);
+}
+
+// Runs every stage once for the shader, recording the samples if requested.
+static void RunStages(BenchContext &ctx, BenchShader &shader, bool record) {
+  double elapsed[BenchStage_Count];
+  BenchClock::time_point start;
+
+  CComPtr<IDxcBlob> pContainer;
+  start = BenchClock::now();
+  CompileShader(ctx, shader, &pContainer);
+  elapsed[BenchStage_Compile] = MillisecondsSince(start);
+
+  CComPtr<IDxcBlob> pOptimized;
+  start = BenchClock::now();
+  IFT(ctx.pOptimizer->RunOptimizer(shader.pHighLevel, shader.Passes.data(),
+                                   shader.Passes.size(), &pOptimized, nullptr));
+  elapsed[BenchStage_Optimize] = MillisecondsSince(start);
+
+  CComPtr<IDxcOperationResult> pValidation;
+  start = BenchClock::now();
+  IFT(ctx.pValidator->Validate(pContainer, DxcValidatorFlags_Default, &pValidation));
+  elapsed[BenchStage_Validate] = MillisecondsSince(start);
+  GetResultOrThrow(ctx.pLibrary, pValidation, nullptr);
+
+  CComPtr<ID3D12ShaderReflection> pShaderReflection;
+  D3D12_SHADER_DESC desc;
+  UINT32 partIndex;
+  start = BenchClock::now();
+  IFT(ctx.pReflection->Load(pContainer));
+  IFT(ctx.pReflection->FindFirstPartKind(hlsl::DFCC_DXIL, &partIndex));
+  IFT(ctx.pReflection->GetPartReflection(partIndex, __uuidof(ID3D12ShaderReflection),
+                                         (void **)&pShaderReflection));
+  IFT(pShaderReflection->GetDesc(&desc));
+  elapsed[BenchStage_Reflect] = MillisecondsSince(start);
+
+  if (record) {
+    for (unsigned i = 0; i < BenchStage_Count; ++i)
+      shader.Samples[i].push_back(elapsed[i]);
+  }
+}
+
+// Compiles every shader iterationCount times on threadCount threads and
+// returns the wall time in milliseconds.
+static double RunThroughput(std::vector<BenchShader> &shaders,
+                            unsigned iterationCount, unsigned threadCount) {
+  const unsigned jobCount = shaders.size() * iterationCount;
+  std::atomic<unsigned> nextJob(0);
+  std::atomic<bool> failed(false);
+  std::string failure;
+
+  auto worker = [&]() {
+    try {
+      BenchContext ctx;
+      for (unsigned job = nextJob++; job < jobCount && !failed; job = nextJob++) {
+        CComPtr<IDxcBlob> pContainer;
+        CompileShader(ctx, shaders[job % shaders.size()], &pContainer);
+      }
+    } catch (const ::hlsl::Exception &e) {
+      if (!failed.exchange(true))
+        failure = e.msg.empty() ? "Compilation failed." : e.msg;
+    } catch (...) {
+      if (!failed.exchange(true))
+        failure = "Compilation failed - unknown error.";
+    }
+  };
+
+  BenchClock::time_point start = BenchClock::now();
+  std::vector<std::thread> threads;
+  threads.reserve(threadCount);
+  for (unsigned i = 0; i < threadCount; ++i)
+    threads.emplace_back(worker);
+  for (std::thread &t : threads)
+    t.join();
+  double elapsed = MillisecondsSince(start);
+
+  if (failed)
+    throw ::hlsl::Exception(E_FAIL, failure);
+  return elapsed;
+}
+
+static uint64_t GetPeakWorkingSet() {
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+  return counters.PeakWorkingSetSize;
+}
+
+// Nearest-rank percentile of sorted samples.
+static double Percentile(const std::vector<double> &sorted, unsigned p) {
+  size_t rank = (sorted.size() * p + 99) / 100;
+  return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+static void WriteJSONString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (char C : Str) {
+    switch (C) {
+    case '"':  OS << "\\\""; break;
+    case '\\': OS << "\\\\"; break;
+    default:
+      if ((unsigned char)C < 0x20)
+        OS << format("\\u%04x", (unsigned)C);
+      else
+        OS << C;
+    }
+  }
+  OS << '"';
+}
+
+static void WriteLatency(raw_ostream &OS, std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  double total = 0;
+  for (double s : samples)
+    total += s;
+  OS << "{\"samples\":" << samples.size()
+     << ",\"min\":" << format("%.3f", samples.front())
+     << ",\"p50\":" << format("%.3f", Percentile(samples, 50))
+     << ",\"p90\":" << format("%.3f", Percentile(samples, 90))
+     << ",\"p99\":" << format("%.3f", Percentile(samples, 99))
+     << ",\"max\":" << format("%.3f", samples.back())
+     << ",\"mean\":" << format("%.3f", total / samples.size()) << "}";
+}
+
+static void PrintHelp() {
+  wprintf(L"%s",
+    L"Measures compiler performance over a fixed corpus of shaders.\n\n"
+    L"dxc-bench [-? | [-corpus=FILE] [-root=DIR] [-iterations=N] [-threads=N] [-o=OUT-FILE]]\n\n"
+    L"Arguments:\n"
+    L"  -?             Displays this help message\n"
+    L"  -corpus=FILE   File listing the shaders to compile, one per line\n"
+    L"                 (default: %HLSL_SRC_DIR%\\tools\\clang\\tools\\dxc-bench\\corpus.txt)\n"
+    L"  -root=DIR      Directory the corpus paths are relative to\n"
+    L"                 (default: %HLSL_SRC_DIR%\\tools\\clang\\test\\CodeGenHLSL)\n"
+    L"  -iterations=N  Number of timed runs over the corpus (default: 5)\n"
+    L"  -threads=N     Threads used to measure throughput (default: one per core)\n"
+    L"  -o=OUT-FILE    Output file for results\n"
+    L"\n"
+    L"Each shader is compiled with the arguments on its '// RUN: %dxc' line. The\n"
+    L"corpus is run once untimed before measurements start. Results are written as\n"
+    L"JSON to the standard output unless -o is given; times are in milliseconds.\n"
+  );
+}
+
+int __cdecl wmain(int argc, const wchar_t **argv_) {
+  const char *pStage = "Operation";
+  int retVal = 0;
+  try {
+    // Parse command line options.
+    pStage = "Argument processing";
+
+    std::wstring corpusFileName;
+    std::wstring rootDir;
+    LPCWSTR outFileName = nullptr;
+    unsigned iterationCount = 5;
+    unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    const wchar_t *srcDir = _wgetenv(L"HLSL_SRC_DIR");
+    if (srcDir != nullptr) {
+      corpusFileName = std::wstring(srcDir) + L"\\tools\\clang\\tools\\dxc-bench\\corpus.txt";
+      rootDir = std::wstring(srcDir) + L"\\tools\\clang\\test\\CodeGenHLSL";
+    }
+
+    for (int argIdx = 1; argIdx < argc; ++argIdx) {
+      LPCWSTR arg = argv_[argIdx];
+      if (wcsieq(arg, L"-?") || wcsieq(arg, L"/?")) {
+        PrintHelp();
+        return retVal;
+      }
+      else if (wcsistarts(arg, L"-corpus=")) {
+        corpusFileName = arg + wcslen(L"-corpus=");
+      }
+      else if (wcsistarts(arg, L"-root=")) {
+        rootDir = arg + wcslen(L"-root=");
+      }
+      else if (wcsistarts(arg, L"-iterations=")) {
+        iterationCount = _wtoi(arg + wcslen(L"-iterations="));
+      }
+      else if (wcsistarts(arg, L"-threads=")) {
+        threadCount = _wtoi(arg + wcslen(L"-threads="));
+      }
+      else if (wcsistarts(arg, L"-o=")) {
+        outFileName = arg + wcslen(L"-o=");
+      }
+      else {
+        fwprintf(stderr, L"Unknown argument '%s'.\n", arg);
+        return 1;
+      }
+    }
+
+    if (corpusFileName.empty() || rootDir.empty()) {
+      printf("Either set HLSL_SRC_DIR or pass -corpus= and -root=.\n");
+      return 1;
+    }
+    if (iterationCount == 0 || threadCount == 0) {
+      printf("-iterations and -threads must be positive.\n");
+      return 1;
+    }
+
+    pStage = "Loading corpus";
+    BenchContext ctx;
+    std::vector<BenchShader> shaders;
+    {
+      CComPtr<IDxcBlobEncoding> pCorpus;
+      IFT(ctx.pLibrary->CreateBlobFromFile(corpusFileName.c_str(), nullptr, &pCorpus));
+      std::string corpus = BlobToUtf8(ctx.pLibrary, pCorpus);
+      SmallVector<StringRef, 32> lines;
+      StringRef(corpus).split(lines, "\n", -1, /*KeepEmpty*/ false);
+      std::vector<std::string> names;
+      for (StringRef line : lines) {
+        line = line.trim();
+        if (!line.empty() && line[0] != '#')
+          names.push_back(line.str());
+      }
+      // Sized up front; the argument pointer arrays refer into each entry.
+      shaders.resize(names.size());
+      for (size_t i = 0; i < names.size(); ++i) {
+        BenchShader &shader = shaders[i];
+        shader.Name = names[i];
+        shader.Path = rootDir + L"\\" + Unicode::UTF8ToUTF16StringOrThrow(names[i].c_str());
+        std::replace(shader.Path.begin(), shader.Path.end(), L'/', L'\\');
+        IFT(ctx.pLibrary->CreateBlobFromFile(shader.Path.c_str(), nullptr, &shader.pSource));
+        ReadRunLine(shader);
+        PrepareOptimizerInput(ctx, shader);
+      }
+    }
+    if (shaders.empty()) {
+      printf("The corpus is empty.\n");
+      return 1;
+    }
+
+    pStage = "Warming up";
+    for (BenchShader &shader : shaders)
+      RunStages(ctx, shader, false);
+
+    pStage = "Measuring latency";
+    for (unsigned i = 0; i < iterationCount; ++i) {
+      for (BenchShader &shader : shaders)
+        RunStages(ctx, shader, true);
+    }
+    uint64_t latencyPeak = GetPeakWorkingSet();
+
+    pStage = "Measuring throughput";
+    double throughputMs = RunThroughput(shaders, iterationCount, threadCount);
+    unsigned throughputCompiles = shaders.size() * iterationCount;
+    uint64_t peak = GetPeakWorkingSet();
+
+    pStage = "Writing results";
+    std::string output;
+    {
+      raw_string_ostream OS(output);
+      OS << "{\n\"iterations\":" << iterationCount
+         << ",\n\"stages\":{";
+      for (unsigned s = 0; s < BenchStage_Count; ++s) {
+        std::vector<double> all;
+        for (const BenchShader &shader : shaders)
+          all.insert(all.end(), shader.Samples[s].begin(), shader.Samples[s].end());
+        OS << (s ? ",\n" : "\n") << '"' << BenchStageNames[s] << "\":";
+        WriteLatency(OS, std::move(all));
+      }
+      OS << "\n},\n\"throughput\":{\"threads\":" << threadCount
+         << ",\"compiles\":" << throughputCompiles
+         << ",\"ms\":" << format("%.3f", throughputMs)
+         << ",\"compilesPerSecond\":"
+         << format("%.2f", throughputCompiles * 1000.0 / throughputMs) << "}"
+         << ",\n\"memory\":{\"peakWorkingSetSingleThread\":" << latencyPeak
+         << ",\"peakWorkingSet\":" << peak << "}"
+         << ",\n\"shaders\":[";
+      for (size_t i = 0; i < shaders.size(); ++i) {
+        const BenchShader &shader = shaders[i];
+        OS << (i ? ",\n" : "\n") << "{\"name\":";
+        WriteJSONString(OS, shader.Name);
+        for (unsigned s = 0; s < BenchStage_Count; ++s) {
+          std::vector<double> samples(shader.Samples[s]);
+          std::sort(samples.begin(), samples.end());
+          OS << ",\"" << BenchStageNames[s] << "\":"
+             << format("%.3f", Percentile(samples, 50));
+        }
+        OS << "}";
+      }
+      OS << "\n]\n}\n";
+    }
+
+    if (outFileName != nullptr && *outFileName) {
+      dxc::WriteBinaryFile(outFileName, output.data(), output.size());
+    }
+    else {
+      fwrite(output.data(), 1, output.size(), stdout);
+    }
+  } catch (const ::hlsl::Exception &hlslException) {
+    try {
+      const char *msg = hlslException.what();
+      Unicode::acp_char printBuffer[128]; // printBuffer is safe to treat as
+                                          // UTF-8 because we use ASCII only errors
+      if (msg == nullptr || *msg == '\0') {
+        sprintf_s(printBuffer, _countof(printBuffer),
+                  "Operation failed - error code 0x%08x.\n", hlslException.hr);
+        msg = printBuffer;
+      }
+
+      printf("%s failed.\n", pStage);
+      dxc::WriteUtf8ToConsoleSizeT(msg, strlen(msg));
+      printf("\n");
+    } catch (...) {
+      printf("%s failed - unable to retrieve error message.\n", pStage);
+    }
+
+    return 1;
+  } catch (std::bad_alloc &) {
+    printf("%s failed - out of memory.\n", pStage);
+    return 1;
+  } catch (...) {
+    printf("%s failed - unknown error.\n", pStage);
+    return 1;
+  }
+
+  return retVal;
+}
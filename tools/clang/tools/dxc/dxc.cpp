@@ -60,12 +60,20 @@
 #include "dxc/Support/microcom.h"
 #include "llvm/Option/OptTable.h"
 #include "llvm/Option/ArgList.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include <dia2.h>
 #include <comdef.h>
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <fcntl.h>
+#include <io.h>
 
 inline bool wcseq(LPCWSTR a, LPCWSTR b) {
   return (a == nullptr && b == nullptr) || (a != nullptr && b != nullptr && wcscmp(a, b) == 0);
@@ -81,8 +89,19 @@ class DxcContext {
 private:
   DxcOpts &m_Opts;
   DxcDllSupport &m_dxcSupport;
-
+  // Shared instances and captured console output, used in server mode.
+  CComPtr<IDxcLibrary> m_pLibrary;
+  CComPtr<IDxcCompiler> m_pCompiler;
+  std::string *m_pOutput;
+
+  void CreateLibrary(IDxcLibrary **ppLibrary);
+  void CreateCompiler(IDxcCompiler **ppCompiler);
+  void WriteBlobToOutput(_In_opt_ IDxcBlob *pBlob);
+  void WriteOperationErrorsToOutput(_In_ IDxcOperationResult *pResult);
   void ActOnBlob(IDxcBlob *pBlob);
+  void WriteCostReport(IDxcBlob *pBlob, llvm::StringRef FName);
+  void WriteTrace(IDxcOperationResult *pResult, llvm::StringRef FName);
+  void WriteSplitDebugInfo(IDxcOperationResult *pResult, llvm::StringRef FName);
   void WriteHeader(IDxcBlobEncoding *pDisassembly, IDxcBlob *pCode,
                    llvm::Twine &pVariableName, LPCWSTR pPath);
   // TODO : Refactor two functions below. There are duplicate functions in DxcContext in dxa.cpp
@@ -91,12 +110,17 @@ private:
 
 public:
   DxcContext(DxcOpts &Opts, DxcDllSupport &dxcSupport)
-      : m_Opts(Opts), m_dxcSupport(dxcSupport) {}
+      : m_Opts(Opts), m_dxcSupport(dxcSupport), m_pOutput(nullptr) {}
+  DxcContext(DxcOpts &Opts, DxcDllSupport &dxcSupport, IDxcLibrary *pLibrary,
+             IDxcCompiler *pCompiler, std::string *pOutput)
+      : m_Opts(Opts), m_dxcSupport(dxcSupport), m_pLibrary(pLibrary),
+        m_pCompiler(pCompiler), m_pOutput(pOutput) {}
 
   int  Compile();
   void Recompile(IDxcBlob *pSource, IDxcLibrary *pLibrary, IDxcCompiler *pCompiler, std::vector<LPCWSTR> &args, IDxcOperationResult **pCompileResult);
   void DumpBinary();
   void Preprocess();
+  int  CheckPipelines();
 };
 
 static void WriteBlobToFile(_In_opt_ IDxcBlob *pBlob, llvm::StringRef FName) {
@@ -110,6 +134,18 @@ static void WritePartToFile(IDxcBlob *pBlob, hlsl::DxilFourCC CC,
   if (!pContainer) {
     throw hlsl::Exception(E_FAIL, "Unable to find required part in blob");
   }
+  // Write parts in their original form even when /compress is in effect.
+  CComPtr<hlsl::AbstractMemoryStream> pExpandedStream;
+  if (hlsl::HasCompressedDxilParts(pContainer)) {
+    CComPtr<IMalloc> pMalloc;
+    IFT(CoGetMalloc(1, &pMalloc));
+    IFT(hlsl::CreateMemoryStream(pMalloc, &pExpandedStream));
+    if (!hlsl::DecompressDxilContainer(pContainer, pExpandedStream)) {
+      throw hlsl::Exception(DXC_E_CONTAINER_INVALID);
+    }
+    pContainer = reinterpret_cast<const hlsl::DxilContainerHeader *>(
+        pExpandedStream->GetPtr());
+  }
   hlsl::DxilPartIsType pred(CC);
   hlsl::DxilPartIterator it =
       std::find_if(hlsl::begin(pContainer), hlsl::end(pContainer), pred);
@@ -131,10 +167,53 @@ static void WritePartToFile(IDxcBlob *pBlob, hlsl::DxilFourCC CC,
   }
 }
 
+void DxcContext::CreateLibrary(IDxcLibrary **ppLibrary) {
+  if (m_pLibrary != nullptr) {
+    *ppLibrary = m_pLibrary;
+    (*ppLibrary)->AddRef();
+    return;
+  }
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, ppLibrary));
+}
+
+void DxcContext::CreateCompiler(IDxcCompiler **ppCompiler) {
+  if (m_pCompiler != nullptr) {
+    *ppCompiler = m_pCompiler;
+    (*ppCompiler)->AddRef();
+    return;
+  }
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, ppCompiler));
+}
+
+void DxcContext::WriteBlobToOutput(_In_opt_ IDxcBlob *pBlob) {
+  if (m_pOutput == nullptr) {
+    WriteBlobToConsole(pBlob);
+    return;
+  }
+  if (pBlob != nullptr) {
+    m_pOutput->append((const char *)pBlob->GetBufferPointer(),
+                      pBlob->GetBufferSize());
+  }
+}
+
+void DxcContext::WriteOperationErrorsToOutput(_In_ IDxcOperationResult *pResult) {
+  if (m_pOutput == nullptr) {
+    WriteOperationErrorsToConsole(pResult, m_Opts.OutputWarnings);
+    return;
+  }
+  HRESULT status;
+  IFT(pResult->GetStatus(&status));
+  if (FAILED(status) || m_Opts.OutputWarnings) {
+    CComPtr<IDxcBlobEncoding> pErrors;
+    IFT(pResult->GetErrorBuffer(&pErrors));
+    WriteBlobToOutput(pErrors);
+  }
+}
+
 void DxcContext::ActOnBlob(IDxcBlob *pBlob) {
   // Text output.
   if (m_Opts.AstDump || m_Opts.OptDump) {
-    WriteBlobToConsole(pBlob);
+    WriteBlobToOutput(pBlob);
     return;
   }
 
@@ -143,8 +222,13 @@ void DxcContext::ActOnBlob(IDxcBlob *pBlob) {
     WriteBlobToFile(pBlob, m_Opts.OutputObject);
   }
 
-  // Extract and write the PDB/debug information.
-  if (!m_Opts.DebugFile.empty()) {
+  // A header token cache has no parts or disassembly.
+  if (m_Opts.EmitTokenCache)
+    return;
+
+  // Extract and write the PDB/debug information. Split debug info was
+  // written from the compile result instead.
+  if (!m_Opts.DebugFile.empty() && !m_Opts.SplitDebugInfo) {
     WritePartToFile(pBlob, hlsl::DFCC_ShaderDebugInfoDXIL, m_Opts.DebugFile);
   }
 
@@ -153,6 +237,11 @@ void DxcContext::ActOnBlob(IDxcBlob *pBlob) {
     WritePartToFile(pBlob, hlsl::DFCC_RootSignature, m_Opts.ExtractRootSignatureFile);
   }
 
+  // Estimate the cost of the shader.
+  if (!m_Opts.CostReport.empty()) {
+    WriteCostReport(pBlob, m_Opts.CostReport);
+  }
+
   // OutputObject suppresses console dump.
   bool needDisassembly = !m_Opts.OutputHeader.empty() ||
                          !m_Opts.AssemblyCode.empty() ||
@@ -161,7 +250,7 @@ void DxcContext::ActOnBlob(IDxcBlob *pBlob) {
     return;
 
   CComPtr<IDxcCompiler> pCompiler;
-  IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+  CreateCompiler(&pCompiler);
 
   CComPtr<IDxcBlobEncoding> pDisassembleResult;
   IFT(pCompiler->Disassemble(pBlob, &pDisassembleResult));
@@ -174,8 +263,53 @@ void DxcContext::ActOnBlob(IDxcBlob *pBlob) {
   } else if (!m_Opts.AssemblyCode.empty()) {
     WriteBlobToFile(pDisassembleResult, m_Opts.AssemblyCode);
   } else {
-    WriteBlobToConsole(pDisassembleResult);
+    WriteBlobToOutput(pDisassembleResult);
+  }
+}
+
+// The estimate is produced by the optimizer's cost analysis on the program
+// bitcode.
+void DxcContext::WriteCostReport(IDxcBlob *pBlob, llvm::StringRef FName) {
+  CComPtr<IDxcLibrary> pLibrary;
+  CComPtr<IDxcBlob> pModule;
+  CComPtr<IDxcOptimizer> pOptimizer;
+  CComPtr<IDxcBlobEncoding> pReport;
+  CreateLibrary(&pLibrary);
+  IFT(FindModuleBlob(hlsl::DFCC_DXIL, pBlob, pLibrary, &pModule));
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcOptimizer, &pOptimizer));
+  LPCWSTR options[] = { L"-analyze", L"-hlsl-dxil-cost" };
+  IFT(pOptimizer->RunOptimizer(pModule, options, _countof(options), nullptr,
+                               &pReport));
+  WriteBlobToFile(pReport, FName);
+}
+
+// Results only carry a trace if the compilation got far enough to record one.
+void DxcContext::WriteTrace(IDxcOperationResult *pResult, llvm::StringRef FName) {
+  CComPtr<IDxcOperationResultTrace> pResultTrace;
+  if (FAILED(pResult->QueryInterface(&pResultTrace)))
+    return;
+  CComPtr<IDxcBlobEncoding> pTrace;
+  IFT(pResultTrace->GetTrace(&pTrace));
+  WriteBlobToFile(pTrace, FName);
+}
+
+// Writes the debug container split with /Qsplit_debug. If FName names a
+// directory (ends with a separator), the container's own name is used.
+void DxcContext::WriteSplitDebugInfo(IDxcOperationResult *pResult,
+                                     llvm::StringRef FName) {
+  CComPtr<IDxcOperationResultDebugInfo> pResultDebugInfo;
+  if (FAILED(pResult->QueryInterface(&pResultDebugInfo)))
+    return;
+  CComPtr<IDxcBlob> pDebugInfo;
+  IFT(pResultDebugInfo->GetDebugInfo(&pDebugInfo));
+  std::string path = FName;
+  if (path.back() == '\\' || path.back() == '/') {
+    CComPtr<IDxcBlobEncoding> pName;
+    IFT(pResultDebugInfo->GetDebugName(&pName));
+    path.append((const char *)pName->GetBufferPointer(),
+                pName->GetBufferSize());
   }
+  WriteBlobToFile(pDebugInfo, path);
 }
 
 class DxcIncludeHandlerForInjectedSources : public IDxcIncludeHandler {
@@ -383,8 +517,8 @@ int DxcContext::Compile() {
       args.push_back(L"-ast-dump");
 
     CComPtr<IDxcLibrary> pLibrary;
-    IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, &pLibrary));
-    IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+    CreateLibrary(&pLibrary);
+    CreateCompiler(&pCompiler);
     ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile), &pSource);
     IFTARG(pSource->GetBufferSize() >= 4);
 
@@ -416,7 +550,15 @@ int DxcContext::Compile() {
     WriteBlobToFile(pErrors, m_Opts.OutputWarningsFile);
   }
   else {
-    WriteOperationErrorsToConsole(pCompileResult, m_Opts.OutputWarnings);
+    WriteOperationErrorsToOutput(pCompileResult);
+  }
+
+  if (!m_Opts.TimeTrace.empty()) {
+    WriteTrace(pCompileResult, m_Opts.TimeTrace);
+  }
+
+  if (m_Opts.SplitDebugInfo && !m_Opts.DebugFile.empty()) {
+    WriteSplitDebugInfo(pCompileResult, m_Opts.DebugFile);
   }
 
   HRESULT status;
@@ -448,18 +590,18 @@ void DxcContext::Preprocess() {
 
   CComPtr<IDxcLibrary> pLibrary;
   CComPtr<IDxcIncludeHandler> pIncludeHandler;
-  IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, &pLibrary));
+  CreateLibrary(&pLibrary);
   IFT(pLibrary->CreateIncludeHandler(&pIncludeHandler));
 
   ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile), &pSource);
-  IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+  CreateCompiler(&pCompiler);
   IFT(pCompiler->Compile(pSource, StringRefUtf16(m_Opts.InputFile),
     StringRefUtf16(m_Opts.EntryPoint),
     StringRefUtf16(m_Opts.TargetProfile), args.data(),
     args.size(), m_Opts.Defines.data(),
     m_Opts.Defines.size(), pIncludeHandler, &pCompileResult));
 
-  WriteOperationErrorsToConsole(pCompileResult, m_Opts.OutputWarnings);
+  WriteOperationErrorsToOutput(pCompileResult);
 
   HRESULT status;
   IFT(pCompileResult->GetStatus(&status));
@@ -470,6 +612,97 @@ void DxcContext::Preprocess() {
   }
 }
 
+// Reads the pipelines listed in the input file, one per line as
+//   vs=<file> [hs=<file> ds=<file>] [gs=<file>] [ps=<file>]
+// separated by whitespace, where files are compiled stage containers. Empty
+// lines and lines starting with '#' are skipped. Each container is loaded
+// once however many pipelines use it, and all pipelines are checked in one
+// batch.
+int DxcContext::CheckPipelines() {
+  CComPtr<IDxcBlobEncoding> pList;
+  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile), &pList);
+  llvm::StringRef listText((const char *)pList->GetBufferPointer(),
+                           pList->GetBufferSize());
+
+  std::unordered_map<std::string, CComPtr<IDxcBlob>> containers;
+  std::vector<DxcPipelineStages> pipelines;
+  std::vector<unsigned> pipelineLines;
+  llvm::SmallVector<llvm::StringRef, 64> lines;
+  listText.split(lines, "\n");
+  for (unsigned lineIndex = 0; lineIndex < lines.size(); ++lineIndex) {
+    llvm::StringRef line = lines[lineIndex].trim();
+    if (line.empty() || line.startswith("#"))
+      continue;
+    std::string location = m_Opts.InputFile.str() + "(" +
+                           std::to_string(lineIndex + 1) + "): ";
+    DxcPipelineStages stages = {};
+    llvm::SmallVector<llvm::StringRef, 8> tokens;
+    llvm::SplitString(line, tokens, " \t\v\f\r");
+    for (llvm::StringRef token : tokens) {
+      std::pair<llvm::StringRef, llvm::StringRef> stageAndFile =
+          token.split('=');
+      llvm::StringRef stage = stageAndFile.first;
+      IDxcBlob **ppStage = stage.equals_lower("vs") ? &stages.pVS
+                         : stage.equals_lower("hs") ? &stages.pHS
+                         : stage.equals_lower("ds") ? &stages.pDS
+                         : stage.equals_lower("gs") ? &stages.pGS
+                         : stage.equals_lower("ps") ? &stages.pPS
+                         : nullptr;
+      if (ppStage == nullptr || stageAndFile.second.empty() ||
+          *ppStage != nullptr) {
+        throw hlsl::Exception(E_INVALIDARG,
+                              location + "expected one vs=, hs=, ds=, gs= or "
+                                         "ps= <file> per stage");
+      }
+      CComPtr<IDxcBlob> &pContainer = containers[stageAndFile.second.str()];
+      if (pContainer == nullptr) {
+        CComPtr<IDxcBlobEncoding> pFile;
+        ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(stageAndFile.second),
+                         &pFile);
+        pContainer = pFile;
+      }
+      *ppStage = pContainer;
+    }
+    pipelines.push_back(stages);
+    pipelineLines.push_back(lineIndex + 1);
+  }
+
+  // A list without pipelines has nothing to check and reports success.
+  std::vector<IDxcOperationResult *> results(pipelines.size());
+  if (!pipelines.empty()) {
+    CComPtr<IDxcPipelineChecker> pChecker;
+    IFT(m_dxcSupport.CreateInstance(CLSID_DxcPipelineChecker, &pChecker));
+    IFT(pChecker->CheckPipelines(pipelines.data(), pipelines.size(),
+                                 results.data()));
+  }
+
+  std::string report;
+  unsigned failedCount = 0;
+  for (size_t i = 0; i < results.size(); ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    pResult.Attach(results[i]);
+    HRESULT status;
+    IFT(pResult->GetStatus(&status));
+    if (SUCCEEDED(status))
+      continue;
+    ++failedCount;
+    CComPtr<IDxcBlobEncoding> pErrors;
+    IFT(pResult->GetErrorBuffer(&pErrors));
+    report += m_Opts.InputFile.str() + "(" + std::to_string(pipelineLines[i]) +
+              "): pipeline doesn't link\n";
+    if (pErrors != nullptr)
+      report.append((const char *)pErrors->GetBufferPointer(),
+                    pErrors->GetBufferSize());
+  }
+  report += std::to_string(pipelines.size() - failedCount) + " of " +
+            std::to_string(pipelines.size()) + " pipelines link.\n";
+  if (m_pOutput != nullptr)
+    m_pOutput->append(report);
+  else
+    WriteUtf8ToConsoleSizeT(report.data(), report.size());
+  return failedCount == 0 ? 0 : 1;
+}
+
 static void WriteString(HANDLE hFile, _In_z_ LPCSTR value, LPCWSTR pFileName) {
   DWORD written;
   if (FALSE == WriteFile(hFile, value, strlen(value) * sizeof(value[0]), &written, nullptr))
@@ -587,6 +820,204 @@ HRESULT DxcContext::GetDxcDiaTable(IDxcLibrary *pLibrary, IDxcBlob *pTargetBlob,
   return S_OK;
 }
 
+static int ActOnOpts(DxcContext &context, const DxcOpts &dxcOpts,
+                     const char *&pStage) {
+  // TODO: implement all other actions.
+  if (!dxcOpts.Preprocess.empty()) {
+    pStage = "Preprocessing";
+    context.Preprocess();
+    return 0;
+  }
+  else if (dxcOpts.DumpBin) {
+    pStage = "Dumping existing binary";
+    context.DumpBinary();
+    return 0;
+  }
+  else if (dxcOpts.CheckPipelines) {
+    pStage = "Checking pipelines";
+    return context.CheckPipelines();
+  }
+  pStage = "Compilation";
+  return context.Compile();
+}
+
+// Server mode.
+//
+// With -server, each line read from standard input is a request: an
+// identifier followed by the arguments of a regular dxc.exe invocation, as in
+//   7 -T ps_6_0 -E main -Fo shader.cso shader.hlsl
+// Arguments are separated by spaces or tabs; double quotes group an argument
+// that contains spaces. Relative paths resolve against the server's current
+// directory. An empty line or the end of input stops the server once every
+// pending request has completed.
+//
+// Each response is a header line with the request identifier, the exit code
+// the invocation would have produced and the size in bytes of the text that
+// follows, then that text (whatever would have been written to the console):
+//   7 0 0
+// Requests run concurrently on a single compiler instance, so responses may
+// be written in a different order than requests were read.
+
+static bool SplitServerRequest(llvm::StringRef line, std::string &id,
+                               std::vector<std::string> &args) {
+  std::vector<std::string> tokens;
+  std::string current;
+  bool inToken = false, inQuotes = false;
+  for (char c : line) {
+    if (c == '"') {
+      inQuotes = !inQuotes;
+      inToken = true;
+    }
+    else if ((c == ' ' || c == '\t') && !inQuotes) {
+      if (inToken)
+        tokens.push_back(std::move(current));
+      current.clear();
+      inToken = false;
+    }
+    else {
+      current += c;
+      inToken = true;
+    }
+  }
+  if (inToken)
+    tokens.push_back(std::move(current));
+  if (inQuotes || tokens.empty())
+    return false;
+  id = std::move(tokens.front());
+  args.assign(std::make_move_iterator(tokens.begin() + 1),
+              std::make_move_iterator(tokens.end()));
+  return true;
+}
+
+static int RunServerRequest(DxcDllSupport &dxcSupport, IDxcLibrary *pLibrary,
+                            IDxcCompiler *pCompiler,
+                            const std::vector<std::string> &args,
+                            std::string &output) {
+  const char *pStage = "Argument processing";
+  try {
+    std::vector<llvm::StringRef> argRefs(args.begin(), args.end());
+    MainArgs argStrings(argRefs);
+    DxcOpts dxcOpts;
+    {
+      llvm::raw_string_ostream errorStream(output);
+      int optResult = ReadDxcOpts(getHlslOptTable(), DxcFlags, argStrings,
+                                  dxcOpts, errorStream);
+      errorStream.flush();
+      if (optResult != 0)
+        return optResult;
+    }
+    // Options that affect the whole process can only be given to the server.
+    if (dxcOpts.ShowHelp || dxcOpts.ServerMode || !dxcOpts.ExternalLib.empty()) {
+      output += "Option cannot be used in a server request.";
+      return 1;
+    }
+    if (dxcOpts.EntryPoint.empty() && !dxcOpts.RecompileFromBinary) {
+      dxcOpts.EntryPoint = "main";
+    }
+
+    DxcContext context(dxcOpts, dxcSupport, pLibrary, pCompiler, &output);
+    return ActOnOpts(context, dxcOpts, pStage);
+  } catch (const ::hlsl::Exception &hlslException) {
+    const char *msg = hlslException.what();
+    if (msg == nullptr || *msg == '\0') {
+      char printBuffer[128];
+      sprintf_s(printBuffer, _countof(printBuffer),
+                "%s failed - error code 0x%08x.", pStage, hlslException.hr);
+      output += printBuffer;
+    }
+    else {
+      output += msg;
+    }
+  } catch (std::bad_alloc &) {
+    output += pStage;
+    output += " failed - out of memory.";
+  } catch (...) {
+    output += pStage;
+    output += " failed - unknown error.";
+  }
+  return 1;
+}
+
+static int RunServer(DxcDllSupport &dxcSupport) {
+  struct Request {
+    std::string Id;
+    std::vector<std::string> Args;
+  };
+
+  CComPtr<IDxcLibrary> pLibrary;
+  CComPtr<IDxcCompiler> pCompiler;
+  IFT(dxcSupport.CreateInstance(CLSID_DxcLibrary, &pLibrary));
+  IFT(dxcSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+
+  // Response sizes are in bytes, so keep the runtime from translating them.
+  fflush(stdout);
+  _setmode(_fileno(stdout), _O_BINARY);
+
+  std::mutex queueLock, outputLock;
+  std::condition_variable queueChanged;
+  std::deque<Request> queue;
+  bool inputDone = false;
+
+  auto writeResponse = [&](const std::string &id, int exitCode,
+                           const std::string &text) {
+    std::lock_guard<std::mutex> lock(outputLock);
+    fprintf(stdout, "%s %d %u\n", id.c_str(), exitCode, (unsigned)text.size());
+    fwrite(text.data(), 1, text.size(), stdout);
+    fflush(stdout);
+  };
+
+  auto worker = [&]() {
+    for (;;) {
+      Request request;
+      {
+        std::unique_lock<std::mutex> lock(queueLock);
+        queueChanged.wait(lock, [&] { return inputDone || !queue.empty(); });
+        if (queue.empty())
+          return;
+        request = std::move(queue.front());
+        queue.pop_front();
+      }
+      std::string output;
+      int exitCode = RunServerRequest(dxcSupport, pLibrary, pCompiler,
+                                      request.Args, output);
+      writeResponse(request.Id, exitCode, output);
+    }
+  };
+
+  unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::thread> threads;
+  threads.reserve(threadCount);
+  for (unsigned i = 0; i < threadCount; ++i)
+    threads.emplace_back(worker);
+
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (line.empty())
+      break;
+    Request request;
+    if (!SplitServerRequest(line, request.Id, request.Args)) {
+      writeResponse("?", 1, "Unable to parse request.");
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(queueLock);
+      queue.emplace_back(std::move(request));
+    }
+    queueChanged.notify_one();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(queueLock);
+    inputDone = true;
+  }
+  queueChanged.notify_all();
+  for (std::thread &t : threads)
+    t.join();
+  return 0;
+}
+
 int __cdecl wmain(int argc, const wchar_t **argv_) {
   const char *pStage = "Operation";
   int retVal = 0;
@@ -643,19 +1074,13 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
     }
 
     EnsureEnabled(dxcSupport);
-    DxcContext context(dxcOpts, dxcSupport);
-    // TODO: implement all other actions.
-    if (!dxcOpts.Preprocess.empty()) {
-      pStage = "Preprocessing";
-      context.Preprocess();
-    }
-    else if (dxcOpts.DumpBin) {
-      pStage = "Dumping existing binary";
-      context.DumpBinary();
+    if (dxcOpts.ServerMode) {
+      pStage = "Serving requests";
+      retVal = RunServer(dxcSupport);
     }
     else {
-      pStage = "Compilation";
-      retVal = context.Compile();
+      DxcContext context(dxcOpts, dxcSupport);
+      retVal = ActOnOpts(context, dxcOpts, pStage);
     }
   } catch (const ::hlsl::Exception &hlslException) {
     try {
@@ -26,6 +26,10 @@ HRESULT CreateDxcRewriter(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcValidator(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcAssembler(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcOptimizer(_In_ REFIID riid, _Out_ LPVOID *ppv);
+HRESULT CreateDxcIncludeCache(_In_ REFIID riid, _Out_ LPVOID *ppv);
+HRESULT CreateDxcModuleSession(_In_ REFIID riid, _Out_ LPVOID *ppv);
+HRESULT CreateDxcLinker(_In_ REFIID riid, _Out_ LPVOID *ppv);
+HRESULT CreateDxcPipelineChecker(_In_ REFIID riid, _Out_ LPVOID *ppv);
 
 namespace hlsl {
 void CreateDxcContainerReflection(IDxcContainerReflection **ppResult);
@@ -83,6 +87,18 @@ DxcCreateInstance(_In_ REFCLSID   rclsid,
   else if (IsEqualCLSID(rclsid, CLSID_DxcOptimizer)) {
     hr = CreateDxcOptimizer(riid, ppv);
   }
+  else if (IsEqualCLSID(rclsid, CLSID_DxcIncludeCache)) {
+    hr = CreateDxcIncludeCache(riid, ppv);
+  }
+  else if (IsEqualCLSID(rclsid, CLSID_DxcModuleSession)) {
+    hr = CreateDxcModuleSession(riid, ppv);
+  }
+  else if (IsEqualCLSID(rclsid, CLSID_DxcLinker)) {
+    hr = CreateDxcLinker(riid, ppv);
+  }
+  else if (IsEqualCLSID(rclsid, CLSID_DxcPipelineChecker)) {
+    hr = CreateDxcPipelineChecker(riid, ppv);
+  }
   else if (IsEqualCLSID(rclsid, CLSID_DxcDiaDataSource)) {
     hr = CreateDxcDiaDataSource(riid, ppv);
   }
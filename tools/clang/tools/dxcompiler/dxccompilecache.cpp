@@ -0,0 +1,343 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccompilecache.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements a content-addressed cache for IDxcCompiler::Compile results.   //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/microcom.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "clang/Basic/Version.h"
+#include "dxccompilecache.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+// Bump whenever anything that affects code generation changes in a way that
+// is not otherwise captured by the key, or when the file layout changes.
+static const uint32_t CacheFormatVersion = 2;
+static const uint32_t CacheFileMagic = 0x43435844; // 'DXCC'
+
+///////////////////////////////////////////////////////////////////////////////
+// Key computation.
+
+DxcCompileCacheKeyBuilder::DxcCompileCacheKeyBuilder() {
+  AddUInt32(CacheFormatVersion);
+  // Entries persisted to a directory must not be picked up by a different
+  // version of the compiler; the version includes the source revision when
+  // the build records it.
+  static const std::string CompilerVersion = clang::getClangFullVersion();
+  AddString(CompilerVersion);
+}
+
+void DxcCompileCacheKeyBuilder::AddBytes(const void *pData, size_t size) {
+  AddUInt32((uint32_t)size);
+  m_hash.update(ArrayRef<uint8_t>((const uint8_t *)pData, size));
+}
+
+void DxcCompileCacheKeyBuilder::AddString(StringRef value) {
+  AddBytes(value.data(), value.size());
+}
+
+void DxcCompileCacheKeyBuilder::AddWideString(LPCWSTR value) {
+  if (value == nullptr) {
+    AddUInt32(0xFFFFFFFF);
+    return;
+  }
+  AddBytes(value, wcslen(value) * sizeof(wchar_t));
+}
+
+void DxcCompileCacheKeyBuilder::AddUInt32(uint32_t value) {
+  m_hash.update(ArrayRef<uint8_t>((const uint8_t *)&value, sizeof(value)));
+}
+
+std::string DxcCompileCacheKeyBuilder::Finish() {
+  MD5::MD5Result result;
+  m_hash.final(result);
+  SmallString<32> hex;
+  MD5::stringifyResult(result, hex);
+  return hex.str().str();
+}
+
+// A null terminator isn't part of the contents; the compiler may have added
+// one to a blob that didn't have it.
+static uint32_t GetContentsSize(IDxcBlob *pUtf8Blob) {
+  const uint8_t *pData = (const uint8_t *)pUtf8Blob->GetBufferPointer();
+  size_t size = pUtf8Blob->GetBufferSize();
+  if (size > 0 && pData[size - 1] == '\0')
+    --size;
+  return (uint32_t)size;
+}
+
+void hlsl::DxcComputeDependencyDigest(IDxcBlob *pUtf8Blob, uint32_t &size,
+                                      MD5::MD5Result &digest) {
+  const uint8_t *pData = (const uint8_t *)pUtf8Blob->GetBufferPointer();
+  size = GetContentsSize(pUtf8Blob);
+  MD5 hash;
+  hash.update(ArrayRef<uint8_t>(pData, size));
+  hash.final(digest);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// On-disk representation.
+//
+// The layout is: magic, version, dependency count, then for each dependency
+// a present flag, a name length in characters, the UTF-16 name, the size
+// and the digest; then the diagnostics and the program, each length-prefixed.
+
+namespace {
+class CacheFileWriter {
+public:
+  std::vector<char> Data;
+  void WriteBytes(const void *pData, size_t size) {
+    const char *pBytes = (const char *)pData;
+    Data.insert(Data.end(), pBytes, pBytes + size);
+  }
+  void WriteUInt32(uint32_t value) { WriteBytes(&value, sizeof(value)); }
+  void WriteString(StringRef value) {
+    WriteUInt32((uint32_t)value.size());
+    WriteBytes(value.data(), value.size());
+  }
+};
+
+class CacheFileReader {
+private:
+  const char *m_pCur;
+  const char *m_pEnd;
+public:
+  CacheFileReader(const char *pData, size_t size)
+      : m_pCur(pData), m_pEnd(pData + size) {}
+  bool ReadBytes(void *pData, size_t size) {
+    if ((size_t)(m_pEnd - m_pCur) < size) return false;
+    memcpy(pData, m_pCur, size);
+    m_pCur += size;
+    return true;
+  }
+  bool ReadUInt32(uint32_t &value) { return ReadBytes(&value, sizeof(value)); }
+  bool ReadString(std::string &value) {
+    uint32_t size;
+    if (!ReadUInt32(size) || (size_t)(m_pEnd - m_pCur) < size) return false;
+    value.assign(m_pCur, size);
+    m_pCur += size;
+    return true;
+  }
+  bool AtEnd() const { return m_pCur == m_pEnd; }
+};
+}
+
+static std::wstring GetCacheFilePath(StringRef cacheDir, const std::string &key) {
+  std::wstring result = Unicode::UTF8ToUTF16StringOrThrow(cacheDir.str().c_str());
+  if (!result.empty() && result.back() != L'\\' && result.back() != L'/')
+    result += L'\\';
+  result += Unicode::UTF8ToUTF16StringOrThrow(key.c_str());
+  result += L".dxcc";
+  return result;
+}
+
+static bool ReadCacheFile(StringRef cacheDir, const std::string &key,
+                          DxcCompileCache::Entry &entry) {
+  try {
+    std::wstring path = GetCacheFilePath(cacheDir, key);
+    if (GetFileAttributesW(path.c_str()) == INVALID_FILE_ATTRIBUTES)
+      return false;
+    CComHeapPtr<char> pData;
+    DWORD dataSize;
+    ReadBinaryFile(path.c_str(), (void **)&pData, &dataSize);
+
+    CacheFileReader reader(pData.m_pData, dataSize);
+    uint32_t magic, version, depCount;
+    if (!reader.ReadUInt32(magic) || magic != CacheFileMagic ||
+        !reader.ReadUInt32(version) || version != CacheFormatVersion ||
+        !reader.ReadUInt32(depCount))
+      return false;
+    for (uint32_t i = 0; i < depCount; ++i) {
+      DxcCompileCacheDependency dep;
+      uint32_t present, nameLen;
+      if (!reader.ReadUInt32(present) || !reader.ReadUInt32(nameLen) ||
+          nameLen > MAX_PATH * 4)
+        return false;
+      dep.Present = present != 0;
+      dep.Name.resize(nameLen);
+      if (!reader.ReadBytes(&dep.Name[0], nameLen * sizeof(wchar_t)) ||
+          !reader.ReadUInt32(dep.Size) ||
+          !reader.ReadBytes(dep.Digest, sizeof(dep.Digest)))
+        return false;
+      entry.Dependencies.emplace_back(std::move(dep));
+    }
+    return reader.ReadString(entry.Diagnostics) &&
+           reader.ReadString(entry.Program) && reader.AtEnd();
+  }
+  catch (...) {
+    return false;
+  }
+}
+
+static void WriteCacheFile(StringRef cacheDir, const std::string &key,
+                           const DxcCompileCache::Entry &entry) {
+  try {
+    CacheFileWriter writer;
+    writer.WriteUInt32(CacheFileMagic);
+    writer.WriteUInt32(CacheFormatVersion);
+    writer.WriteUInt32((uint32_t)entry.Dependencies.size());
+    for (const DxcCompileCacheDependency &dep : entry.Dependencies) {
+      writer.WriteUInt32(dep.Present ? 1 : 0);
+      writer.WriteUInt32((uint32_t)dep.Name.size());
+      writer.WriteBytes(dep.Name.data(), dep.Name.size() * sizeof(wchar_t));
+      writer.WriteUInt32(dep.Size);
+      writer.WriteBytes(dep.Digest, sizeof(dep.Digest));
+    }
+    writer.WriteString(entry.Diagnostics);
+    writer.WriteString(entry.Program);
+
+    // Write to a private name first so concurrent readers never observe a
+    // partially written entry.
+    std::wstring path = GetCacheFilePath(cacheDir, key);
+    std::wstring tempPath = path;
+    tempPath += L".";
+    tempPath += std::to_wstring(GetCurrentProcessId());
+    tempPath += L".";
+    tempPath += std::to_wstring(GetCurrentThreadId());
+    WriteBinaryFile(tempPath.c_str(), writer.Data.data(),
+                    (DWORD)writer.Data.size());
+    if (!MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+      DeleteFileW(tempPath.c_str());
+  }
+  catch (...) {
+    // The cache directory is an optimization only.
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DxcCompileCache.
+
+static ManagedStatic<DxcCompileCache> g_CompileCache;
+
+DxcCompileCache &DxcCompileCache::Get() {
+  return *g_CompileCache;
+}
+
+DxcCompileCache::EntryPtr DxcCompileCache::FindInMemory(const std::string &key) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  auto it = m_entries.find(key);
+  return it == m_entries.end() ? EntryPtr() : it->second;
+}
+
+void DxcCompileCache::AddInMemory(const std::string &key, EntryPtr entry) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  auto inserted = m_entries.insert(std::make_pair(key, entry));
+  if (!inserted.second) {
+    inserted.first->second = entry;
+    return;
+  }
+  m_insertionOrder.push_back(key);
+  while (m_insertionOrder.size() > MaxEntries) {
+    m_entries.erase(m_insertionOrder.front());
+    m_insertionOrder.pop_front();
+  }
+}
+
+static bool DependenciesMatch(const DxcCompileCache::Entry &entry,
+                              IDxcIncludeHandler *pIncludeHandler,
+                              DxcCompileCacheSources &sources) {
+  for (const DxcCompileCacheDependency &dep : entry.Dependencies) {
+    if (pIncludeHandler == nullptr)
+      return false;
+    auto found = sources.find(dep.Name);
+    if (found == sources.end()) {
+      CComPtr<IDxcBlob> pLoaded;
+      if (FAILED(pIncludeHandler->LoadSource(dep.Name.c_str(), &pLoaded)))
+        pLoaded.Release();
+      found = sources.emplace(dep.Name, pLoaded).first;
+    }
+    IDxcBlob *pBlob = found->second;
+    if ((pBlob != nullptr) != dep.Present)
+      return false;
+    if (pBlob == nullptr)
+      continue;
+    CComPtr<IDxcBlobEncoding> pUtf8;
+    if (FAILED(DxcGetBlobAsUtf8(pBlob, &pUtf8)))
+      return false;
+    // Most edits change the size; only digest contents that could match.
+    if (GetContentsSize(pUtf8) != dep.Size)
+      return false;
+    uint32_t size;
+    MD5::MD5Result digest;
+    DxcComputeDependencyDigest(pUtf8, size, digest);
+    if (0 != memcmp(digest, dep.Digest, sizeof(digest)))
+      return false;
+  }
+  return true;
+}
+
+_Use_decl_annotations_
+bool DxcCompileCache::Lookup(const std::string &key, StringRef cacheDir,
+                             IDxcIncludeHandler *pIncludeHandler,
+                             DxcCompileCacheSources &sources,
+                             IDxcBlob **ppProgram, std::string &diagnostics) {
+  *ppProgram = nullptr;
+  EntryPtr entry = FindInMemory(key);
+  if (entry == nullptr && !cacheDir.empty()) {
+    std::shared_ptr<Entry> diskEntry = std::make_shared<Entry>();
+    if (ReadCacheFile(cacheDir, key, *diskEntry)) {
+      entry = diskEntry;
+      AddInMemory(key, entry);
+    }
+  }
+  if (entry == nullptr || !DependenciesMatch(*entry, pIncludeHandler, sources))
+    return false;
+
+  // Hand out a private copy; callers may edit the result in place (for
+  // example, when signing it through a validator).
+  CComPtr<IDxcBlob> pProgram;
+  if (FAILED(DxcCreateBlobOnHeapCopy(entry->Program.data(),
+                                     (UINT32)entry->Program.size(), &pProgram)))
+    return false;
+  diagnostics = entry->Diagnostics;
+  *ppProgram = pProgram.Detach();
+  return true;
+}
+
+_Use_decl_annotations_
+void DxcCompileCache::Store(const std::string &key, StringRef cacheDir,
+                            IDxcBlob *pProgram, StringRef diagnostics,
+                            std::vector<DxcCompileCacheDependency> &&dependencies) {
+  std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+  entry->Dependencies = std::move(dependencies);
+  entry->Program.assign((const char *)pProgram->GetBufferPointer(),
+                        pProgram->GetBufferSize());
+  entry->Diagnostics = diagnostics.str();
+  if (!cacheDir.empty())
+    WriteCacheFile(cacheDir, key, *entry);
+  AddInMemory(key, entry);
+}
+
+bool DxcCompileCache::BeginCompile(const std::string &key) {
+  std::unique_lock<std::mutex> lock(m_lock);
+  if (m_compiling.insert(key).second)
+    return true;
+  m_compileDone.wait(lock, [&] { return m_compiling.count(key) == 0; });
+  return false;
+}
+
+void DxcCompileCache::EndCompile(const std::string &key) {
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_compiling.erase(key);
+  }
+  m_compileDone.notify_all();
+}
+
+void DxcCompileCache::Clear() {
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_entries.clear();
+  m_insertionOrder.clear();
+}
@@ -0,0 +1,161 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccompilecache.h                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a content-addressed cache for IDxcCompiler::Compile results.     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/dxcapi.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MD5.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace hlsl {
+
+/// A file the include handler was asked for during a cached compilation,
+/// along with what it returned.
+struct DxcCompileCacheDependency {
+  std::wstring Name;
+  bool Present;                 // false if the handler had no such file
+  uint32_t Size;                // size of the UTF-8 contents if present
+  llvm::MD5::MD5Result Digest;  // digest of the UTF-8 contents if present
+};
+
+/// The include handler's answers read while checking cached entries, by
+/// name; a null blob means the handler had no such file. A compilation that
+/// follows a miss takes these rather than asking the handler again.
+typedef std::unordered_map<std::wstring, CComPtr<IDxcBlob>>
+    DxcCompileCacheSources;
+
+/// Accumulates the inputs that determine the output of a compilation into
+/// a key. Every value is length-prefixed so adjacent values can't alias.
+class DxcCompileCacheKeyBuilder {
+private:
+  llvm::MD5 m_hash;
+public:
+  DxcCompileCacheKeyBuilder();
+  void AddBytes(const void *pData, size_t size);
+  void AddString(llvm::StringRef value);
+  void AddWideString(LPCWSTR value);
+  void AddUInt32(uint32_t value);
+  /// Returns the key as a hex string, suitable as a file name.
+  std::string Finish();
+};
+
+/// Computes the size and digest recorded for an included file.
+void DxcComputeDependencyDigest(_In_ IDxcBlob *pUtf8Blob, uint32_t &size,
+                                llvm::MD5::MD5Result &digest);
+
+/// A process-wide cache of compilation results, keyed by the digest of the
+/// source and options, or of the preprocessed tokens and options. Entries
+/// keyed on the source also record the include handler responses they
+/// depended on, and are only reused when the handler still returns the same
+/// contents for each of them. When a directory is given, entries are
+/// additionally persisted there so they survive across processes.
+///
+/// Caching is best-effort: failures to read or write the directory result in
+/// a cache miss rather than an error.
+class DxcCompileCache {
+public:
+  struct Entry {
+    std::vector<DxcCompileCacheDependency> Dependencies;
+    std::string Program;
+    std::string Diagnostics;
+  };
+
+  /// Identifies the validator a result was produced with. Path is the
+  /// dxil.dll the validator was loaded from, and is empty for the built-in
+  /// one; the version is zero if the validator doesn't report one.
+  struct ValidatorInfo {
+    bool Internal = false;
+    uint32_t MajorVer = 0;
+    uint32_t MinorVer = 0;
+    std::wstring Path;
+  };
+
+  static DxcCompileCache &Get();
+
+  /// Looks up a compilation result; returns true on a hit. The include
+  /// handler is asked once for each recorded dependency that isn't already
+  /// in sources, and its answers are added there; a dependency's size is
+  /// compared before its contents are digested.
+  bool Lookup(const std::string &key, llvm::StringRef cacheDir,
+              _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+              DxcCompileCacheSources &sources,
+              _Outptr_ IDxcBlob **ppProgram, std::string &diagnostics);
+
+  /// Records a successful compilation result.
+  void Store(const std::string &key, llvm::StringRef cacheDir,
+             _In_ IDxcBlob *pProgram, llvm::StringRef diagnostics,
+             std::vector<DxcCompileCacheDependency> &&dependencies);
+
+  /// Claims the compilation of key for the caller, so that concurrent
+  /// compilations with the same key wait for its result rather than repeat
+  /// the work. Returns false, once the current holder has finished, if the
+  /// key was already claimed; the caller should then look it up again.
+  bool BeginCompile(const std::string &key);
+
+  /// Releases a key claimed with BeginCompile, whether or not a result was
+  /// stored for it.
+  void EndCompile(const std::string &key);
+
+  /// Drops all in-memory entries.
+  void Clear();
+
+private:
+  typedef std::shared_ptr<const Entry> EntryPtr;
+  // Bounds the number of in-memory entries; the oldest are dropped first.
+  static const size_t MaxEntries = 512;
+
+  std::mutex m_lock;
+  std::unordered_map<std::string, EntryPtr> m_entries;
+  std::deque<std::string> m_insertionOrder;
+  std::unordered_set<std::string> m_compiling;
+  std::condition_variable m_compileDone;
+
+  EntryPtr FindInMemory(const std::string &key);
+  void AddInMemory(const std::string &key, EntryPtr entry);
+};
+
+/// Holds a key claimed with DxcCompileCache::BeginCompile, and releases it
+/// on destruction so that waiters aren't left blocked if compilation fails.
+class DxcCompileCacheClaim {
+private:
+  std::string m_key;
+  bool m_claimed = false;
+public:
+  DxcCompileCacheClaim() {}
+  DxcCompileCacheClaim(const DxcCompileCacheClaim &) = delete;
+  DxcCompileCacheClaim &operator=(const DxcCompileCacheClaim &) = delete;
+  ~DxcCompileCacheClaim() { End(); }
+  /// Returns true if the key is now held; see DxcCompileCache::BeginCompile.
+  /// Any key held before is released first.
+  bool Begin(const std::string &key) {
+    End();
+    m_claimed = DxcCompileCache::Get().BeginCompile(key);
+    if (m_claimed)
+      m_key = key;
+    return m_claimed;
+  }
+  void End() {
+    if (m_claimed)
+      DxcCompileCache::Get().EndCompile(m_key);
+    m_claimed = false;
+  }
+};
+
+} // namespace hlsl
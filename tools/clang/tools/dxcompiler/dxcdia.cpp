@@ -16,6 +16,8 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/DebugInfo.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Path.h"
 
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/HLSL/DxilContainer.h"
@@ -85,6 +87,9 @@ static const DWORD HlslCompilandEnvEntryId = 6;
 static const DWORD HlslCompilandEnvDefinesId = 7;
 static const DWORD HlslCompilandEnvArgumentsId = 8;
 
+// Source file id for lines whose scope names no known file.
+static const DWORD NoSourceFileId = (DWORD)-1;
+
 ///////////////////////////////////////////////////////////////////////////////
 // Memory helpers.
 static
@@ -132,6 +137,22 @@ static HRESULT StringRefToBSTR(llvm::StringRef value, BSTR *pRetVal) {
 
 static HRESULT CreateDxcDiaEnumTables(DxcDiaSession *, IDiaEnumTables **);
 static HRESULT CreateDxcDiaTable(DxcDiaSession *, DiaTableKind kind, IDiaTable **ppTable);
+static HRESULT CreateDxcDiaEnumLineNumbers(DxcDiaSession *,
+                                           std::vector<DWORD> &&lines,
+                                           IDiaEnumLineNumbers **ppResult);
+static HRESULT CreateDxcDiaEnumSourceFiles(DxcDiaSession *,
+                                           std::vector<DWORD> &&files,
+                                           IDiaEnumSourceFiles **ppResult);
+static HRESULT CreateDxcDiaSourceFile(DxcDiaSession *, DWORD fileId,
+                                      IDiaSourceFile **ppResult);
+static HRESULT CreateDxcDiaSymbolById(DxcDiaSession *, DWORD symIndexId,
+                                      IDiaSymbol **ppSymbol);
+
+// Returns the name of the file a debug location scope belongs to.
+static StringRef GetScopeFileName(const MDNode *pScope) {
+  const DIScope *pDIScope = dyn_cast_or_null<DIScope>(pScope);
+  return pDIScope ? pDIScope->getFilename() : StringRef();
+}
 
 class DxcDiaSession : public IDiaSession {
 private:
@@ -146,13 +167,82 @@ private:
   llvm::NamedMDNode *m_arguments;
   std::vector<const Instruction *> m_instructions;
   std::vector<const Instruction *> m_instructionLines; // Instructions with line info.
+  // Each line covers its instruction and any following instructions without
+  // line info in the same function: [m_lineRVAs[i], +m_lineLengths[i]). The
+  // ranges are sorted and disjoint, so address lookups are binary searches.
+  std::vector<DWORD> m_lineRVAs;
+  std::vector<DWORD> m_lineLengths;
+  // Source file indexes, built on first use by BuildLineIndex.
+  bool m_lineIndexBuilt;
+  llvm::StringMap<DWORD> m_fileIdsByName;
+  std::vector<DWORD> m_lineFileIds;                 // Per line; NoSourceFileId if unknown.
+  std::vector<std::vector<DWORD>> m_fileLines;      // Per file, lines in RVA order.
+  std::vector<std::vector<DWORD>> m_fileLinesByNum; // Per file, lines by line/column.
+
+  void BuildLineIndex() {
+    if (m_lineIndexBuilt)
+      return;
+    unsigned fileCount =
+        (Contents() == nullptr) ? 0 : Contents()->getNumOperands();
+    for (unsigned i = 0; i < fileCount; ++i) {
+      StringRef fn =
+          dyn_cast<MDString>(Contents()->getOperand(i)->getOperand(0))
+              ->getString();
+      m_fileIdsByName.insert(std::make_pair(fn, (DWORD)i)); // First one wins.
+    }
+
+    m_fileLines.resize(fileCount);
+    m_lineFileIds.reserve(m_instructionLines.size());
+    for (DWORD i = 0; i < m_instructionLines.size(); ++i) {
+      StringRef fn =
+          GetScopeFileName(m_instructionLines[i]->getDebugLoc().getScope());
+      auto it = m_fileIdsByName.find(fn);
+      DWORD fileId = (it == m_fileIdsByName.end()) ? NoSourceFileId : it->second;
+      m_lineFileIds.push_back(fileId);
+      if (fileId != NoSourceFileId)
+        m_fileLines[fileId].push_back(i);
+    }
+
+    m_fileLinesByNum = m_fileLines;
+    for (std::vector<DWORD> &lines : m_fileLinesByNum) {
+      std::stable_sort(lines.begin(), lines.end(), [this](DWORD a, DWORD b) {
+        const DebugLoc &A = m_instructionLines[a]->getDebugLoc();
+        const DebugLoc &B = m_instructionLines[b]->getDebugLoc();
+        return std::make_pair(A.getLine(), A.getCol()) <
+               std::make_pair(B.getLine(), B.getCol());
+      });
+    }
+    m_lineIndexBuilt = true;
+  }
+
+  HRESULT GetSourceFileId(IDiaSourceFile *pFile, DWORD *pFileId) {
+    if (pFile == nullptr)
+      return E_INVALIDARG;
+    IFR(pFile->get_uniqueId(pFileId));
+    BuildLineIndex();
+    return (*pFileId < m_fileLines.size()) ? S_OK : E_INVALIDARG;
+  }
+
+  // Only the single compiland symbol (or none, meaning any) is accepted as a
+  // scope for the line queries.
+  static bool IsCompilandScope(IDiaSymbol *pCompiland) {
+    DWORD id;
+    return pCompiland == nullptr ||
+           (SUCCEEDED(pCompiland->get_symIndexId(&id)) && id == HlslCompilandId);
+  }
+
+  static bool IsCompilandSymTag(enum SymTagEnum symtag) {
+    return symtag == SymTagNull || symtag == SymTagCompiland;
+  }
+
 public:
   DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
 
   DxcDiaSession(std::shared_ptr<llvm::LLVMContext> context,
                 std::shared_ptr<llvm::Module> module,
                 std::shared_ptr<llvm::DebugInfoFinder> finder)
-      : m_module(module), m_context(context), m_finder(finder), m_dwRef(0), m_dxilModule(module.get()) {
+      : m_module(module), m_context(context), m_finder(finder), m_dwRef(0),
+        m_dxilModule(module.get()), m_lineIndexBuilt(false) {
     // Extract HLSL metadata.
     m_dxilModule.LoadDxilMetadata();
 
@@ -164,6 +254,7 @@ public:
     // Build up a linear list of instructions. The index will be used as the
     // RVA. Debug instructions are ommitted from this enumeration.
     for (const Function &fn : m_module->functions()) {
+      bool fnHasLine = false;
       for (const BasicBlock &bb : fn.getBasicBlockList()) {
         for (const Instruction &i : bb.getInstList()) {
           if (i.getOpcode() == Instruction::Call) {
@@ -173,9 +264,16 @@ public:
             }
           }
 
+          DWORD rva = m_instructions.size();
           m_instructions.push_back(&i);
           if (i.getDebugLoc()) {
             m_instructionLines.push_back(&i);
+            m_lineRVAs.push_back(rva);
+            m_lineLengths.push_back(1);
+            fnHasLine = true;
+          }
+          else if (fnHasLine) {
+            ++m_lineLengths.back();
           }
         }
       }
@@ -190,23 +288,39 @@ public:
   llvm::DebugInfoFinder &InfoRef() { return *m_finder.get(); }
   std::vector<const Instruction *> &InstructionsRef() { return m_instructions; }
   std::vector<const Instruction *> &InstructionLinesRef() { return m_instructionLines; }
+  DWORD LineRVA(DWORD lineIndex) { return m_lineRVAs[lineIndex]; }
+  DWORD LineLength(DWORD lineIndex) { return m_lineLengths[lineIndex]; }
+  DWORD LineFileId(DWORD lineIndex) {
+    BuildLineIndex();
+    return m_lineFileIds[lineIndex];
+  }
 
   HRESULT getSourceFileIdByName(StringRef fileName, DWORD *pRetVal) {
-    if (Contents() != nullptr) {
-      for (unsigned i = 0; i < Contents()->getNumOperands(); ++i) {
-        StringRef fn =
-            dyn_cast<MDString>(Contents()->getOperand(i)->getOperand(0))
-                ->getString();
-        if (fn.equals(fileName)) {
-          *pRetVal = i;
-          return S_OK;
-        }
-      }
+    BuildLineIndex();
+    auto it = m_fileIdsByName.find(fileName);
+    if (it != m_fileIdsByName.end()) {
+      *pRetVal = it->second;
+      return S_OK;
     }
     *pRetVal = 0;
     return S_FALSE;
   }
 
+  // Returns the lines whose instruction ranges overlap [rva, rva + length).
+  std::vector<DWORD> FindLinesInRange(DWORD rva, DWORD length) {
+    std::vector<DWORD> result;
+    uint64_t end = (uint64_t)rva + std::max(length, (DWORD)1);
+    auto it = std::upper_bound(m_lineRVAs.begin(), m_lineRVAs.end(), rva);
+    if (it != m_lineRVAs.begin()) {
+      DWORD prev = (DWORD)(it - m_lineRVAs.begin()) - 1;
+      if ((uint64_t)m_lineRVAs[prev] + m_lineLengths[prev] > rva)
+        result.push_back(prev);
+    }
+    for (; it != m_lineRVAs.end() && *it < end; ++it)
+      result.push_back((DWORD)(it - m_lineRVAs.begin()));
+    return result;
+  }
+
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
     return DoBasicQueryInterface<IDiaSession>(this, iid, ppvObject);
   }
@@ -270,21 +384,46 @@ public:
     /* [in] */ DWORD rva,
     /* [out] */ IDiaEnumSymbols **ppResult) { return E_NOTIMPL; }
 
+  // Instructions are not placed in sections; addresses are taken as section
+  // zero with the RVA as offset, and the load address is always zero.
   __override STDMETHODIMP findSymbolByAddr(
     /* [in] */ DWORD isect,
     /* [in] */ DWORD offset,
   /* [in] */ enum SymTagEnum symtag,
-    /* [out] */ IDiaSymbol **ppSymbol) { return E_NOTIMPL; }
+    /* [out] */ IDiaSymbol **ppSymbol) {
+    if (ppSymbol == nullptr)
+      return E_INVALIDARG;
+    *ppSymbol = nullptr;
+    if (isect != 0)
+      return S_FALSE;
+    return findSymbolByRVA(offset, symtag, ppSymbol);
+  }
 
   __override STDMETHODIMP findSymbolByRVA(
     /* [in] */ DWORD rva,
   /* [in] */ enum SymTagEnum symtag,
-    /* [out] */ IDiaSymbol **ppSymbol) { return E_NOTIMPL; }
+    /* [out] */ IDiaSymbol **ppSymbol) {
+    if (ppSymbol == nullptr)
+      return E_INVALIDARG;
+    *ppSymbol = nullptr;
+    // HLSL functions are inlined, so the compiland is the only symbol that
+    // covers an address.
+    if (rva >= m_instructions.size() || !IsCompilandSymTag(symtag))
+      return S_FALSE;
+    return CreateDxcDiaSymbolById(this, HlslCompilandId, ppSymbol);
+  }
 
   __override STDMETHODIMP findSymbolByVA(
     /* [in] */ ULONGLONG va,
   /* [in] */ enum SymTagEnum symtag,
-    /* [out] */ IDiaSymbol **ppSymbol) { return E_NOTIMPL; }
+    /* [out] */ IDiaSymbol **ppSymbol) {
+    if (ppSymbol == nullptr)
+      return E_INVALIDARG;
+    *ppSymbol = nullptr;
+    if (va > MAXDWORD)
+      return S_FALSE;
+    return findSymbolByRVA((DWORD)va, symtag, ppSymbol);
+  }
 
   __override STDMETHODIMP findSymbolByToken(
     /* [in] */ ULONG token,
@@ -297,57 +436,196 @@ public:
 
   __override STDMETHODIMP symbolById(
     /* [in] */ DWORD id,
-    /* [out] */ IDiaSymbol **ppSymbol) { return E_NOTIMPL; }
+    /* [out] */ IDiaSymbol **ppSymbol) {
+    if (ppSymbol == nullptr)
+      return E_INVALIDARG;
+    *ppSymbol = nullptr;
+    return CreateDxcDiaSymbolById(this, id, ppSymbol);
+  }
 
   __override STDMETHODIMP findSymbolByRVAEx(
     /* [in] */ DWORD rva,
   /* [in] */ enum SymTagEnum symtag,
     /* [out] */ IDiaSymbol **ppSymbol,
-    /* [out] */ long *displacement) { return E_NOTIMPL; }
+    /* [out] */ long *displacement) {
+    HRESULT hr = findSymbolByRVA(rva, symtag, ppSymbol);
+    if (displacement != nullptr)
+      *displacement = (hr == S_OK) ? (long)rva : 0; // The compiland starts at 0.
+    return hr;
+  }
 
   __override STDMETHODIMP findSymbolByVAEx(
     /* [in] */ ULONGLONG va,
   /* [in] */ enum SymTagEnum symtag,
     /* [out] */ IDiaSymbol **ppSymbol,
-    /* [out] */ long *displacement) { return E_NOTIMPL; }
+    /* [out] */ long *displacement) {
+    HRESULT hr = findSymbolByVA(va, symtag, ppSymbol);
+    if (displacement != nullptr)
+      *displacement = (hr == S_OK) ? (long)va : 0;
+    return hr;
+  }
 
   __override STDMETHODIMP findFile(
     /* [in] */ IDiaSymbol *pCompiland,
     /* [in] */ LPCOLESTR name,
     /* [in] */ DWORD compareFlags,
-    /* [out] */ IDiaEnumSourceFiles **ppResult) { return E_NOTIMPL; }
+    /* [out] */ IDiaEnumSourceFiles **ppResult) {
+    if (ppResult == nullptr)
+      return E_INVALIDARG;
+    *ppResult = nullptr;
+    try {
+      BuildLineIndex();
+      std::vector<DWORD> files;
+      if (IsCompilandScope(pCompiland)) {
+        std::string name8 = name ? Unicode::UTF16ToUTF8StringOrThrow(name) : "";
+        bool exactMatch = (compareFlags & (nsfCaseInsensitive | nsfFNameExt |
+                                           nsfRegularExpression)) == 0;
+        if (name == nullptr) {
+          for (DWORD i = 0; i < m_fileLines.size(); ++i)
+            files.push_back(i);
+        }
+        else if (exactMatch) {
+          auto it = m_fileIdsByName.find(name8);
+          if (it != m_fileIdsByName.end())
+            files.push_back(it->second);
+        }
+        else {
+          for (DWORD i = 0; i < m_fileLines.size(); ++i) {
+            StringRef fn =
+                dyn_cast<MDString>(Contents()->getOperand(i)->getOperand(0))
+                    ->getString();
+            if (compareFlags & nsfFNameExt)
+              fn = llvm::sys::path::filename(fn);
+            bool match;
+            if (compareFlags & nsfRegularExpression)
+              match = Unicode::IsStarMatchUTF8(name8.data(), name8.size(),
+                                               fn.data(), fn.size());
+            else if (compareFlags & nsfCaseInsensitive)
+              match = fn.equals_lower(name8);
+            else
+              match = fn.equals(name8);
+            if (match)
+              files.push_back(i);
+          }
+        }
+      }
+      return CreateDxcDiaEnumSourceFiles(this, std::move(files), ppResult);
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
 
   __override STDMETHODIMP findFileById(
     /* [in] */ DWORD uniqueId,
-    /* [out] */ IDiaSourceFile **ppResult) { return E_NOTIMPL; }
+    /* [out] */ IDiaSourceFile **ppResult) {
+    if (ppResult == nullptr)
+      return E_INVALIDARG;
+    *ppResult = nullptr;
+    BuildLineIndex();
+    if (uniqueId >= m_fileLines.size())
+      return S_FALSE;
+    return CreateDxcDiaSourceFile(this, uniqueId, ppResult);
+  }
 
   __override STDMETHODIMP findLines(
     /* [in] */ IDiaSymbol *compiland,
     /* [in] */ IDiaSourceFile *file,
-    /* [out] */ IDiaEnumLineNumbers **ppResult) { return E_NOTIMPL; }
+    /* [out] */ IDiaEnumLineNumbers **ppResult) {
+    if (ppResult == nullptr)
+      return E_INVALIDARG;
+    *ppResult = nullptr;
+    try {
+      DWORD fileId;
+      IFR(GetSourceFileId(file, &fileId));
+      std::vector<DWORD> lines;
+      if (IsCompilandScope(compiland))
+        lines = m_fileLines[fileId];
+      return CreateDxcDiaEnumLineNumbers(this, std::move(lines), ppResult);
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
 
   __override STDMETHODIMP findLinesByAddr(
     /* [in] */ DWORD seg,
     /* [in] */ DWORD offset,
     /* [in] */ DWORD length,
-    /* [out] */ IDiaEnumLineNumbers **ppResult) { return E_NOTIMPL; }
+    /* [out] */ IDiaEnumLineNumbers **ppResult) {
+    if (ppResult == nullptr)
+      return E_INVALIDARG;
+    *ppResult = nullptr;
+    if (seg != 0)
+      return CreateDxcDiaEnumLineNumbers(this, std::vector<DWORD>(), ppResult);
+    return findLinesByRVA(offset, length, ppResult);
+  }
 
   __override STDMETHODIMP findLinesByRVA(
     /* [in] */ DWORD rva,
     /* [in] */ DWORD length,
-    /* [out] */ IDiaEnumLineNumbers **ppResult) { return E_NOTIMPL; }
+    /* [out] */ IDiaEnumLineNumbers **ppResult) {
+    if (ppResult == nullptr)
+      return E_INVALIDARG;
+    *ppResult = nullptr;
+    try {
+      return CreateDxcDiaEnumLineNumbers(this, FindLinesInRange(rva, length),
+                                         ppResult);
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
 
   __override STDMETHODIMP findLinesByVA(
     /* [in] */ ULONGLONG va,
     /* [in] */ DWORD length,
-    /* [out] */ IDiaEnumLineNumbers **ppResult) { return E_NOTIMPL; }
+    /* [out] */ IDiaEnumLineNumbers **ppResult) {
+    if (ppResult == nullptr)
+      return E_INVALIDARG;
+    *ppResult = nullptr;
+    if (va > MAXDWORD)
+      return CreateDxcDiaEnumLineNumbers(this, std::vector<DWORD>(), ppResult);
+    return findLinesByRVA((DWORD)va, length, ppResult);
+  }
 
+  // Returns the lines at linenum, or at the next line with code if linenum
+  // has none. A nonzero column narrows the result when it matches.
   __override STDMETHODIMP findLinesByLinenum(
     /* [in] */ IDiaSymbol *compiland,
     /* [in] */ IDiaSourceFile *file,
     /* [in] */ DWORD linenum,
     /* [in] */ DWORD column,
-    /* [out] */ IDiaEnumLineNumbers **ppResult) { return E_NOTIMPL; }
+    /* [out] */ IDiaEnumLineNumbers **ppResult) {
+    if (ppResult == nullptr)
+      return E_INVALIDARG;
+    *ppResult = nullptr;
+    try {
+      DWORD fileId;
+      IFR(GetSourceFileId(file, &fileId));
+      std::vector<DWORD> lines;
+      if (IsCompilandScope(compiland)) {
+        const std::vector<DWORD> &byNum = m_fileLinesByNum[fileId];
+        auto lineOf = [this](DWORD index) {
+          return (DWORD)m_instructionLines[index]->getDebugLoc().getLine();
+        };
+        auto first = std::lower_bound(
+            byNum.begin(), byNum.end(), linenum,
+            [&](DWORD index, DWORD value) { return lineOf(index) < value; });
+        if (first != byNum.end()) {
+          DWORD found = lineOf(*first);
+          auto last = first;
+          while (last != byNum.end() && lineOf(*last) == found)
+            ++last;
+          if (column != 0) {
+            for (auto it = first; it != last; ++it) {
+              if (m_instructionLines[*it]->getDebugLoc().getCol() == column)
+                lines.push_back(*it);
+            }
+          }
+          if (lines.empty())
+            lines.assign(first, last);
+          std::sort(lines.begin(), lines.end()); // Report in RVA order.
+        }
+      }
+      return CreateDxcDiaEnumLineNumbers(this, std::move(lines), ppResult);
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
 
   __override STDMETHODIMP findInjectedSource(
     /* [in] */ LPCOLESTR srcFile,
@@ -678,8 +956,8 @@ public:
     /* [in] */ DWORD index,
     /* [retval][out] */ TItem **ppItem) {
     if (index >= m_count)
-      return GetItem(index, ppItem);
-    return E_INVALIDARG;
+      return E_INVALIDARG;
+    return GetItem(index, ppItem);
   }
 
   virtual HRESULT GetItem(DWORD index, TItem **ppItem) {
@@ -1589,6 +1867,20 @@ public:
   }
 };
 
+static HRESULT CreateDxcDiaSymbolById(DxcDiaSession *pSession, DWORD symIndexId,
+                                      IDiaSymbol **ppSymbol) {
+  *ppSymbol = nullptr;
+  CComPtr<DxcDiaTableSymbols> pTable =
+      new (std::nothrow)DxcDiaTableSymbols(pSession);
+  if (pTable == nullptr)
+    return E_OUTOFMEMORY;
+  LONG count;
+  IFR(pTable->get_Count(&count));
+  if (symIndexId == 0 || symIndexId > (DWORD)count)
+    return S_FALSE;
+  return pTable->GetItem(symIndexId - 1, ppSymbol);
+}
+
 class DxcDiaSourceFile : public IDiaSourceFile {
   DXC_MICROCOM_REF_FIELD(m_dwRef)
   CComPtr<DxcDiaSession> m_pSession;
@@ -1654,6 +1946,40 @@ public:
   }
 };
 
+// Enumerates a subset of the source files, as returned by findFile.
+class DxcDiaEnumSourceFiles : public DxcDiaTableBase<IDiaEnumSourceFiles, IDiaSourceFile> {
+  std::vector<DWORD> m_files;
+public:
+  DxcDiaEnumSourceFiles(DxcDiaSession *pSession, std::vector<DWORD> &&files)
+      : DxcDiaTableBase(pSession, DiaTableKind::SourceFiles),
+        m_files(std::move(files)) {
+    m_count = m_files.size();
+  }
+
+  __override HRESULT GetItem(DWORD index, IDiaSourceFile **ppItem) {
+    return CreateDxcDiaSourceFile(m_pSession, m_files[index], ppItem);
+  }
+};
+
+static HRESULT CreateDxcDiaSourceFile(DxcDiaSession *pSession, DWORD fileId,
+                                      IDiaSourceFile **ppResult) {
+  *ppResult = new (std::nothrow)DxcDiaSourceFile(pSession, fileId);
+  if (*ppResult == nullptr)
+    return E_OUTOFMEMORY;
+  (*ppResult)->AddRef();
+  return S_OK;
+}
+
+static HRESULT CreateDxcDiaEnumSourceFiles(DxcDiaSession *pSession,
+                                           std::vector<DWORD> &&files,
+                                           IDiaEnumSourceFiles **ppResult) {
+  *ppResult = new (std::nothrow)DxcDiaEnumSourceFiles(pSession, std::move(files));
+  if (*ppResult == nullptr)
+    return E_OUTOFMEMORY;
+  (*ppResult)->AddRef();
+  return S_OK;
+}
+
 class DxcDiaLineNumber : public IDiaLineNumber {
   DXC_MICROCOM_REF_FIELD(m_dwRef)
   CComPtr<DxcDiaSession> m_pSession;
@@ -1672,10 +1998,19 @@ public:
   }
 
   __override STDMETHODIMP get_compiland(
-    /* [retval][out] */ IDiaSymbol **pRetVal) { return E_NOTIMPL; }
+    /* [retval][out] */ IDiaSymbol **pRetVal) {
+    return CreateDxcDiaSymbolById(m_pSession, HlslCompilandId, pRetVal);
+  }
 
   __override STDMETHODIMP get_sourceFile(
-    /* [retval][out] */ IDiaSourceFile **pRetVal) { return E_NOTIMPL; }
+    /* [retval][out] */ IDiaSourceFile **pRetVal) {
+    DWORD fileId = m_pSession->LineFileId(m_index);
+    if (fileId == NoSourceFileId) {
+      *pRetVal = nullptr;
+      return S_FALSE;
+    }
+    return CreateDxcDiaSourceFile(m_pSession, fileId, pRetVal);
+  }
 
   __override STDMETHODIMP get_lineNumber(
     /* [retval][out] */ DWORD *pRetVal) {
@@ -1701,37 +2036,46 @@ public:
     return S_OK;
   }
 
+  // Addresses are in section zero, where the offset is the RVA.
   __override STDMETHODIMP get_addressSection(
-    /* [retval][out] */ DWORD *pRetVal) { return E_NOTIMPL; }
+    /* [retval][out] */ DWORD *pRetVal) {
+    *pRetVal = 0;
+    return S_OK;
+  }
 
   __override STDMETHODIMP get_addressOffset(
-    /* [retval][out] */ DWORD *pRetVal) { return E_NOTIMPL; }
+    /* [retval][out] */ DWORD *pRetVal) {
+    *pRetVal = m_pSession->LineRVA(m_index);
+    return S_OK;
+  }
 
   __override STDMETHODIMP get_relativeVirtualAddress(
     /* [retval][out] */ DWORD *pRetVal) { 
-    *pRetVal = m_index;
+    *pRetVal = m_pSession->LineRVA(m_index);
     return S_OK;
   }
 
   __override STDMETHODIMP get_virtualAddress(
-    /* [retval][out] */ ULONGLONG *pRetVal) { return E_NOTIMPL; }
+    /* [retval][out] */ ULONGLONG *pRetVal) {
+    *pRetVal = m_pSession->LineRVA(m_index);
+    return S_OK;
+  }
 
   __override STDMETHODIMP get_length(
-    /* [retval][out] */ DWORD *pRetVal) { return E_NOTIMPL; }
+    /* [retval][out] */ DWORD *pRetVal) {
+    *pRetVal = m_pSession->LineLength(m_index);
+    return S_OK;
+  }
 
   __override STDMETHODIMP get_sourceFileId(
     /* [retval][out] */ DWORD *pRetVal) {
-    MDNode *pScope = DL().getScope();
-    DILexicalBlock *pBlock = dyn_cast_or_null<DILexicalBlock>(pScope);
-    if (pBlock != nullptr) {
-      return m_pSession->getSourceFileIdByName(pBlock->getFile()->getFilename(), pRetVal);
-    }
-    DISubprogram *pSubProgram= dyn_cast_or_null<DISubprogram>(pScope);
-    if (pSubProgram != nullptr) {
-      return m_pSession->getSourceFileIdByName(pSubProgram->getFile()->getFilename(), pRetVal);
+    DWORD fileId = m_pSession->LineFileId(m_index);
+    if (fileId == NoSourceFileId) {
+      *pRetVal = 0;
+      return S_FALSE;
     }
-    *pRetVal = 0;
-    return S_FALSE;
+    *pRetVal = fileId;
+    return S_OK;
   }
 
   __override STDMETHODIMP get_statement(
@@ -1762,6 +2106,36 @@ public:
   }
 };
 
+// Enumerates a subset of the line numbers, as returned by the findLines*
+// queries.
+class DxcDiaEnumLineNumbers : public DxcDiaTableBase<IDiaEnumLineNumbers, IDiaLineNumber> {
+  std::vector<DWORD> m_lines;
+public:
+  DxcDiaEnumLineNumbers(DxcDiaSession *pSession, std::vector<DWORD> &&lines)
+      : DxcDiaTableBase(pSession, DiaTableKind::LineNumbers),
+        m_lines(std::move(lines)) {
+    m_count = m_lines.size();
+  }
+
+  __override HRESULT GetItem(DWORD index, IDiaLineNumber **ppItem) {
+    *ppItem = new (std::nothrow)DxcDiaLineNumber(m_pSession, m_lines[index]);
+    if (*ppItem == nullptr)
+      return E_OUTOFMEMORY;
+    (*ppItem)->AddRef();
+    return S_OK;
+  }
+};
+
+static HRESULT CreateDxcDiaEnumLineNumbers(DxcDiaSession *pSession,
+                                           std::vector<DWORD> &&lines,
+                                           IDiaEnumLineNumbers **ppResult) {
+  *ppResult = new (std::nothrow)DxcDiaEnumLineNumbers(pSession, std::move(lines));
+  if (*ppResult == nullptr)
+    return E_OUTOFMEMORY;
+  (*ppResult)->AddRef();
+  return S_OK;
+}
+
 class DxcDiaTableSections : public DxcDiaTableBase<IDiaEnumSectionContribs, IDiaSectionContrib> {
 public:
   DxcDiaTableSections(DxcDiaSession *pSession) : DxcDiaTableBase(pSession, DiaTableKind::Sections) { }
@@ -1945,32 +2319,132 @@ public:
     return E_NOTIMPL;
   }
 
+  // The executable is a shader container split with /Qsplit_debug; its debug
+  // container is looked up by the name recorded in it, in each directory of
+  // the semicolon-separated search path and then next to the shader. The
+  // callback is not used.
   __override HRESULT STDMETHODCALLTYPE loadDataForExe(
     _In_ LPCOLESTR executable,
     _In_ LPCOLESTR searchPath,
     _In_ IUnknown *pCallback) {
-    return E_NOTIMPL;
+    if (executable == nullptr)
+      return E_INVALIDARG;
+    if (m_module.get() != nullptr) {
+      return E_FAIL;
+    }
+    try {
+      CComPtr<IDxcBlobEncoding> pShader;
+      IFR(DxcCreateBlobFromFile(executable, nullptr, &pShader));
+      const DxilContainerHeader *pContainer = IsDxilContainerLike(
+          pShader->GetBufferPointer(), pShader->GetBufferSize());
+      if (!pContainer ||
+          !IsValidDxilContainer(pContainer, pShader->GetBufferSize()))
+        return DXC_E_CONTAINER_INVALID;
+      const char *pName = GetDxilShaderDebugName(pContainer);
+      if (pName == nullptr)
+        return E_PDB_NOT_FOUND;
+      // The name is read from the file, so only accept a plain file name that
+      // cannot reach outside the directories searched.
+      if (pName[0] == '\0' || strpbrk(pName, "\\/:") != nullptr ||
+          strstr(pName, "..") != nullptr)
+        return DXC_E_CONTAINER_INVALID;
+      std::wstring name = Unicode::UTF8ToUTF16StringOrThrow(pName);
+
+      std::vector<std::wstring> dirs;
+      if (searchPath != nullptr) {
+        std::wstring paths(searchPath);
+        size_t start = 0;
+        while (start <= paths.size()) {
+          size_t end = paths.find(L';', start);
+          if (end == std::wstring::npos)
+            end = paths.size();
+          if (end > start)
+            dirs.push_back(paths.substr(start, end - start));
+          start = end + 1;
+        }
+      }
+      std::wstring exeDir(executable);
+      size_t slash = exeDir.find_last_of(L"\\/");
+      dirs.push_back(slash == std::wstring::npos ? L"." : exeDir.substr(0, slash));
+
+      for (const std::wstring &dir : dirs) {
+        std::wstring path = dir;
+        if (path.back() != L'\\' && path.back() != L'/')
+          path += L'\\';
+        path += name;
+        if (GetFileAttributesW(path.c_str()) == INVALID_FILE_ATTRIBUTES)
+          continue;
+        CComPtr<IDxcBlobEncoding> pDebugInfo;
+        if (FAILED(DxcCreateBlobFromFile(path.c_str(), nullptr, &pDebugInfo)))
+          continue;
+        // Skip stale files that no longer match the shader.
+        const DxilContainerHeader *pDebugContainer = IsDxilContainerLike(
+            pDebugInfo->GetBufferPointer(), pDebugInfo->GetBufferSize());
+        if (!pDebugContainer ||
+            !IsValidDxilContainer(pDebugContainer,
+                                  pDebugInfo->GetBufferSize()))
+          continue;
+        const char *pDebugName = GetDxilShaderDebugName(pDebugContainer);
+        if (pDebugName == nullptr || strcmp(pDebugName, pName) != 0)
+          continue;
+        std::unique_ptr<MemoryBuffer> pBuffer =
+            getMemBufferFromBlob(pDebugInfo, "data");
+        return loadDataFromBuffer(*pBuffer);
+      }
+    }
+    CATCH_CPP_RETURN_HRESULT();
+    return E_PDB_NOT_FOUND;
   }
 
+  // Accepts bitcode, or a container with a debug part, such as a shader
+  // compiled with /Zi or the debug container split with /Qsplit_debug.
   __override STDMETHODIMP loadDataFromIStream(_In_ IStream *pIStream) {
     if (m_module.get() != nullptr) {
       return E_FAIL;
     }
-    m_context.reset();
-    m_finder.reset();
     try {
-      m_context = std::make_shared<LLVMContext>();
       std::unique_ptr<MemoryBuffer> pBuffer =
           getMemBufferFromStream(pIStream, "data");
-      ErrorOr<std::unique_ptr<llvm::Module>> module =
-          parseBitcodeFile(pBuffer->getMemBufferRef(), *m_context.get());
-      if (!module)
-        return E_FAIL;
-      m_finder = std::make_shared<DebugInfoFinder>();
-      m_finder->processModule(*module.get().get());
-      m_module.reset(module.get().release());
+      return loadDataFromBuffer(*pBuffer);
     }
     CATCH_CPP_RETURN_HRESULT();
+  }
+
+  HRESULT loadDataFromBuffer(const MemoryBuffer &buffer) {
+    m_context.reset();
+    m_finder.reset();
+    StringRef bitcode = buffer.getBuffer();
+    CComPtr<AbstractMemoryStream> pExpandedStream;
+    if (const DxilContainerHeader *pContainer =
+            IsDxilContainerLike(bitcode.data(), bitcode.size())) {
+      if (!IsValidDxilContainer(pContainer, bitcode.size()))
+        return DXC_E_CONTAINER_INVALID;
+      if (HasCompressedDxilParts(pContainer)) {
+        CComPtr<IMalloc> pMalloc;
+        IFR(CoGetMalloc(1, &pMalloc));
+        IFR(CreateMemoryStream(pMalloc, &pExpandedStream));
+        if (!DecompressDxilContainer(pContainer, pExpandedStream))
+          return DXC_E_CONTAINER_INVALID;
+        pContainer = reinterpret_cast<const DxilContainerHeader *>(
+            pExpandedStream->GetPtr());
+      }
+      const DxilProgramHeader *pProgramHeader =
+          GetDxilProgramHeader(pContainer, DFCC_ShaderDebugInfoDXIL);
+      if (pProgramHeader == nullptr)
+        return E_FAIL;
+      const char *pBitcode;
+      uint32_t bitcodeSize;
+      GetDxilProgramBitcode(pProgramHeader, &pBitcode, &bitcodeSize);
+      bitcode = StringRef(pBitcode, bitcodeSize);
+    }
+    m_context = std::make_shared<LLVMContext>();
+    ErrorOr<std::unique_ptr<llvm::Module>> module =
+        parseBitcodeFile(MemoryBufferRef(bitcode, "data"), *m_context.get());
+    if (!module)
+      return E_FAIL;
+    m_finder = std::make_shared<DebugInfoFinder>();
+    m_finder->processModule(*module.get().get());
+    m_module.reset(module.get().release());
     return S_OK;
   }
 
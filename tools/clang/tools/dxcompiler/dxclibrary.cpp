@@ -19,6 +19,9 @@
 
 #include "dxc/dxcapi.internal.h"
 #include "dxc/dxctools.h"
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
 using namespace llvm;
 using namespace hlsl;
@@ -48,6 +51,82 @@ public:
   }
 };
 
+class DxcIncludeCache : public IDxcIncludeHandler, public IDxcIncludeCache {
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  struct LoadResult {
+    HRESULT hr;
+    CComPtr<IDxcBlobEncoding> Blob; // UTF-8 contents, null if not found.
+  };
+  // Held while calling the inner handler, which needn't be thread-safe.
+  std::mutex m_lock;
+  CComPtr<IDxcIncludeHandler> m_pInner;
+  std::unordered_map<std::wstring, LoadResult> m_results;
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
+    return DoBasicQueryInterface2<IDxcIncludeHandler, IDxcIncludeCache>(this, iid, ppvObject);
+  }
+
+  DxcIncludeCache() : m_dwRef(0) { }
+
+  __override HRESULT STDMETHODCALLTYPE SetIncludeHandler(
+    _In_ IDxcIncludeHandler *pHandler) {
+    if (pHandler == nullptr)
+      return E_INVALIDARG;
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_pInner = pHandler;
+    return S_OK;
+  }
+
+  __override HRESULT STDMETHODCALLTYPE Clear() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_results.clear();
+    return S_OK;
+  }
+
+  __override HRESULT STDMETHODCALLTYPE LoadSource(
+    _In_ LPCWSTR pFilename,                                   // Candidate filename.
+    _COM_Outptr_result_maybenull_ IDxcBlob **ppIncludeSource  // Resultant source object for included file, nullptr if not found.
+    ) {
+    *ppIncludeSource = nullptr;
+    try {
+      std::lock_guard<std::mutex> lock(m_lock);
+      auto it = m_results.find(pFilename);
+      if (it == m_results.end()) {
+        if (m_pInner == nullptr)
+          return E_FAIL;
+        LoadResult result;
+        CComPtr<IDxcBlob> pBlob;
+        result.hr = m_pInner->LoadSource(pFilename, &pBlob);
+        if (SUCCEEDED(result.hr) && pBlob != nullptr) {
+          // Converting once here lets every compilation use the contents in
+          // place.
+          result.hr = DxcGetBlobAsUtf8NullTerm(pBlob, &result.Blob);
+        }
+        it = m_results.insert(std::make_pair(std::wstring(pFilename), result)).first;
+      }
+      if (SUCCEEDED(it->second.hr) && it->second.Blob != nullptr) {
+        *ppIncludeSource = it->second.Blob;
+        (*ppIncludeSource)->AddRef();
+      }
+      return it->second.hr;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+};
+
+HRESULT CreateDxcIncludeCache(_In_ REFIID riid, _Out_ LPVOID* ppv) {
+  CComPtr<DxcIncludeCache> result = new (std::nothrow) DxcIncludeCache();
+  if (result == nullptr) {
+    *ppv = nullptr;
+    return E_OUTOFMEMORY;
+  }
+
+  return result.p->QueryInterface(riid, ppv);
+}
+
 class DxcLibrary : public IDxcLibrary {
 private:
   DXC_MICROCOM_REF_FIELD(m_dwRef)
@@ -0,0 +1,790 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxclinker.cpp                                                             //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the linker for libraries compiled with /library.               //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/LangOptions.h"
+#include "clang/Basic/TargetOptions.h"
+#include "clang/CodeGen/BackendUtil.h"
+#include "clang/Frontend/CodeGenOptions.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/HLSL/DxilContainer.h"
+#include "dxc/HLSL/DxilMetadataHelper.h"
+#include "dxc/HLSL/DxilShaderModel.h"
+#include "dxc/HLSL/HLModule.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/Unicode.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "dxc/Support/microcom.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/dxcapi.impl.h"
+#include "dxc/Support/HLSLOptions.h"
+#include "dxc/Support/dxcapi.use.h"
+#include "dxc/dxcapi.h"
+
+#include <map>
+#include <set>
+
+using namespace llvm;
+using namespace hlsl;
+
+void CreateValidatorForCompile(dxc::DxcDllSupport &validatorDll,
+                               raw_ostream &w,
+                               CComPtr<IDxcValidator> &pValidator,
+                               bool &internalValidator);
+HRESULT RunInternalValidator(_In_ IDxcValidator *pValidator,
+                             _In_ llvm::Module *pModule,
+                             _In_ llvm::Module *pDebugModule,
+                             _In_opt_ IDxcBlob *pShader, UINT32 Flags,
+                             _COM_Outptr_ IDxcOperationResult **ppResult);
+void SetupCodeGenOptsForOptimization(const hlsl::options::DxcOpts &opts,
+                                     clang::CodeGenOptions &codeGenOpts);
+
+// Parses the high-level module stored in a library container. Returns false
+// with a message in errors if the blob isn't a library.
+static bool LoadLibraryModule(IDxcBlob *pLib, LLVMContext &Ctx,
+                              std::unique_ptr<Module> &pModule,
+                              raw_ostream &errors) {
+  const char *pIL = (const char *)pLib->GetBufferPointer();
+  uint32_t pILLength = pLib->GetBufferSize();
+  const DxilContainerHeader *pContainer = IsDxilContainerLike(pIL, pILLength);
+  if (!pContainer || !IsValidDxilContainer(pContainer, pILLength)) {
+    errors << "not a valid container";
+    return false;
+  }
+  CComPtr<AbstractMemoryStream> pExpandedStream;
+  if (HasCompressedDxilParts(pContainer)) {
+    CComPtr<IMalloc> pMalloc;
+    IFT(CoGetMalloc(1, &pMalloc));
+    IFT(CreateMemoryStream(pMalloc, &pExpandedStream));
+    if (!DecompressDxilContainer(pContainer, pExpandedStream)) {
+      errors << "not a valid container";
+      return false;
+    }
+    pContainer =
+        reinterpret_cast<const DxilContainerHeader *>(pExpandedStream->GetPtr());
+  }
+  DxilPartIterator it = std::find_if(begin(pContainer), end(pContainer),
+                                     DxilPartIsType(DFCC_ShaderLibrary));
+  if (it == end(pContainer)) {
+    errors << "not compiled with /library";
+    return false;
+  }
+  const DxilProgramHeader *pProgramHeader =
+      reinterpret_cast<const DxilProgramHeader *>(GetDxilPartData(*it));
+  if (!IsValidDxilProgramHeader(pProgramHeader, (*it)->PartSize)) {
+    errors << "not a valid container";
+    return false;
+  }
+  GetDxilProgramBitcode(pProgramHeader, &pIL, &pILLength);
+
+  // Parsing materializes the whole module, so the bitcode can be read in
+  // place even though the expanded container goes away.
+  std::unique_ptr<MemoryBuffer> pBitcodeBuf(
+      MemoryBuffer::getMemBuffer(StringRef(pIL, pILLength), "", false));
+  ErrorOr<std::unique_ptr<Module>> pLoaded =
+      parseBitcodeFile(pBitcodeBuf->getMemBufferRef(), Ctx);
+  if (std::error_code ec = pLoaded.getError()) {
+    errors << ec.message();
+    return false;
+  }
+  pModule = std::move(pLoaded.get());
+  return true;
+}
+
+// Calls the static initializers of every library from the entry point, as
+// codegen does for a shader compiled from a single source.
+static void CallGlobalConstructors(Module &M, Function *pEntryFunc) {
+  GlobalVariable *GV = M.getGlobalVariable("llvm.global_ctors");
+  if (!GV)
+    return;
+  if (ConstantArray *CA = dyn_cast<ConstantArray>(GV->getInitializer())) {
+    IRBuilder<> Builder(pEntryFunc->getEntryBlock().getFirstInsertionPt());
+    for (User::op_iterator i = CA->op_begin(), e = CA->op_end(); i != e; ++i) {
+      if (isa<ConstantAggregateZero>(*i))
+        continue;
+      ConstantStruct *CS = cast<ConstantStruct>(*i);
+      if (Function *Ctor = dyn_cast<Function>(CS->getOperand(1)))
+        Builder.CreateCall(Ctor);
+    }
+  }
+  GV->eraseFromParent();
+}
+
+// Removes the type system helper variables that only anchor the metadata
+// loaded into the HLModule, as they are not emitted for a single source.
+static void RemoveTypeSystemHelperVariables(Module &M) {
+  if (GlobalVariable *pUsed = M.getGlobalVariable("llvm.used"))
+    pUsed->eraseFromParent();
+  const StringRef prefix = DxilMDHelper::kDxilTypeSystemHelperVariablePrefix;
+  for (auto it = M.global_begin(), e = M.global_end(); it != e;) {
+    GlobalVariable *GV = it++;
+    if (GV->getName().startswith(prefix) && GV->use_empty())
+      GV->eraseFromParent();
+  }
+}
+
+// Keeps the entry point and its patch constant function, and drops the
+// library functions that it doesn't call.
+static void InternalizeLinkedFunctions(HLModule &HM) {
+  Function *pEntryFunc = HM.GetEntryFunction();
+  Function *pPatchConstantFunc = nullptr;
+  if (HM.GetShaderModel()->IsHS() && HM.HasHLFunctionProps(pEntryFunc))
+    pPatchConstantFunc = HM.GetHLFunctionProps(pEntryFunc)
+                             .ShaderProps.HS.patchConstantFunc;
+
+  Module &M = *HM.GetModule();
+  for (Function &F : M.functions()) {
+    if (&F == pEntryFunc || &F == pPatchConstantFunc || F.isDeclaration())
+      F.setLinkage(GlobalValue::LinkageTypes::ExternalLinkage);
+    else
+      F.setLinkage(GlobalValue::LinkageTypes::InternalLinkage);
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto it = M.begin(), e = M.end(); it != e;) {
+      Function *F = it++;
+      if (F->hasLocalLinkage() && F->user_empty()) {
+        HM.RemoveFunction(F);
+        F->eraseFromParent();
+        changed = true;
+      }
+    }
+  }
+}
+
+// Compares function definitions from different libraries. Libraries are
+// loaded into one context, so a struct type that several of them declare is
+// named apart in each, and types are compared by structure instead. Debug
+// information is ignored; static functions that the definitions call are
+// compared in turn, and other globals by name.
+class FunctionBodyMatcher {
+private:
+  std::set<std::pair<const Function *, const Function *>> m_matching;
+  std::set<std::pair<Type *, Type *>> m_typesMatching;
+
+  bool TypesMatch(Type *A, Type *B) {
+    if (A == B)
+      return true;
+    if (A->getTypeID() != B->getTypeID() ||
+        A->getNumContainedTypes() != B->getNumContainedTypes())
+      return false;
+    // Structs may refer to themselves through pointers; assume a pair being
+    // compared matches until shown otherwise.
+    auto inserted = m_typesMatching.insert(std::make_pair(A, B));
+    if (!inserted.second)
+      return true;
+    if (!ContainedTypesMatch(A, B)) {
+      m_typesMatching.erase(inserted.first);
+      return false;
+    }
+    return true;
+  }
+
+  bool ContainedTypesMatch(Type *A, Type *B) {
+    switch (A->getTypeID()) {
+    case Type::StructTyID: {
+      StructType *SA = cast<StructType>(A), *SB = cast<StructType>(B);
+      if (SA->isOpaque() || SB->isOpaque() || SA->isPacked() != SB->isPacked())
+        return false;
+      break;
+    }
+    case Type::PointerTyID:
+      if (A->getPointerAddressSpace() != B->getPointerAddressSpace())
+        return false;
+      break;
+    case Type::ArrayTyID:
+      if (A->getArrayNumElements() != B->getArrayNumElements())
+        return false;
+      break;
+    case Type::VectorTyID:
+      if (A->getVectorNumElements() != B->getVectorNumElements())
+        return false;
+      break;
+    case Type::FunctionTyID:
+      if (cast<FunctionType>(A)->isVarArg() !=
+          cast<FunctionType>(B)->isVarArg())
+        return false;
+      break;
+    default:
+      // Other types are unique in a context.
+      return false;
+    }
+    for (unsigned i = 0; i < A->getNumContainedTypes(); ++i) {
+      if (!TypesMatch(A->getContainedType(i), B->getContainedType(i)))
+        return false;
+    }
+    return true;
+  }
+
+  bool ConstantsMatch(const Constant *A, const Constant *B) {
+    if (A == B)
+      return true;
+    if (A->getValueID() != B->getValueID() ||
+        !TypesMatch(A->getType(), B->getType()))
+      return false;
+    if (const GlobalValue *GA = dyn_cast<GlobalValue>(A)) {
+      const GlobalValue *GB = cast<GlobalValue>(B);
+      if (GA->getName() != GB->getName())
+        return false;
+      const Function *FA = dyn_cast<Function>(GA);
+      const Function *FB = dyn_cast<Function>(GB);
+      if (FA && FA->hasLocalLinkage() && FB->hasLocalLinkage())
+        return FunctionsMatch(*FA, *FB);
+      return true;
+    }
+    // Constants without operands are unique for their type and value.
+    if (A->getNumOperands() == 0)
+      return isa<ConstantAggregateZero>(A) || isa<UndefValue>(A) ||
+             isa<ConstantPointerNull>(A);
+    if (A->getNumOperands() != B->getNumOperands() ||
+        A->getRawSubclassOptionalData() != B->getRawSubclassOptionalData())
+      return false;
+    if (const ConstantExpr *CA = dyn_cast<ConstantExpr>(A)) {
+      const ConstantExpr *CB = cast<ConstantExpr>(B);
+      if (CA->getOpcode() != CB->getOpcode() ||
+          (CA->isCompare() && CA->getPredicate() != CB->getPredicate()) ||
+          (CA->hasIndices() && CA->getIndices() != CB->getIndices()))
+        return false;
+    }
+    for (unsigned i = 0; i < A->getNumOperands(); ++i) {
+      if (!ConstantsMatch(cast<Constant>(A->getOperand(i)),
+                          cast<Constant>(B->getOperand(i))))
+        return false;
+    }
+    return true;
+  }
+
+  static bool IsDebugInfo(const Instruction &I) {
+    return isa<DbgInfoIntrinsic>(I);
+  }
+
+  // Compares what an instruction does, other than its operands.
+  bool OperationsMatch(const Instruction &A, const Instruction &B) {
+    if (A.getOpcode() != B.getOpcode() ||
+        A.getNumOperands() != B.getNumOperands() ||
+        A.getRawSubclassOptionalData() != B.getRawSubclassOptionalData() ||
+        !TypesMatch(A.getType(), B.getType()))
+      return false;
+    for (unsigned i = 0; i < A.getNumOperands(); ++i) {
+      if (!TypesMatch(A.getOperand(i)->getType(), B.getOperand(i)->getType()))
+        return false;
+    }
+    if (const LoadInst *LA = dyn_cast<LoadInst>(&A)) {
+      const LoadInst *LB = cast<LoadInst>(&B);
+      return LA->isVolatile() == LB->isVolatile() &&
+             LA->getAlignment() == LB->getAlignment() &&
+             LA->getOrdering() == LB->getOrdering() &&
+             LA->getSynchScope() == LB->getSynchScope();
+    }
+    if (const StoreInst *SA = dyn_cast<StoreInst>(&A)) {
+      const StoreInst *SB = cast<StoreInst>(&B);
+      return SA->isVolatile() == SB->isVolatile() &&
+             SA->getAlignment() == SB->getAlignment() &&
+             SA->getOrdering() == SB->getOrdering() &&
+             SA->getSynchScope() == SB->getSynchScope();
+    }
+    if (const AllocaInst *AA = dyn_cast<AllocaInst>(&A))
+      return AA->getAlignment() == cast<AllocaInst>(&B)->getAlignment();
+    if (const CmpInst *CA = dyn_cast<CmpInst>(&A))
+      return CA->getPredicate() == cast<CmpInst>(&B)->getPredicate();
+    if (const CallInst *CA = dyn_cast<CallInst>(&A)) {
+      const CallInst *CB = cast<CallInst>(&B);
+      return CA->getCallingConv() == CB->getCallingConv() &&
+             CA->getAttributes() == CB->getAttributes() &&
+             CA->isTailCall() == CB->isTailCall();
+    }
+    if (const GetElementPtrInst *GA = dyn_cast<GetElementPtrInst>(&A))
+      return TypesMatch(GA->getSourceElementType(),
+                        cast<GetElementPtrInst>(&B)->getSourceElementType());
+    if (const ExtractValueInst *EA = dyn_cast<ExtractValueInst>(&A))
+      return EA->getIndices() == cast<ExtractValueInst>(&B)->getIndices();
+    if (const InsertValueInst *IA = dyn_cast<InsertValueInst>(&A))
+      return IA->getIndices() == cast<InsertValueInst>(&B)->getIndices();
+    if (isa<BinaryOperator>(A) || isa<CastInst>(A) || isa<SelectInst>(A) ||
+        isa<PHINode>(A) || isa<TerminatorInst>(A) ||
+        isa<ExtractElementInst>(A) || isa<InsertElementInst>(A) ||
+        isa<ShuffleVectorInst>(A))
+      return true;
+    // The remaining instructions don't involve struct types.
+    return A.isSameOperationAs(&B);
+  }
+
+public:
+  bool FunctionsMatch(const Function &A, const Function &B) {
+    if (A.isDeclaration() || B.isDeclaration())
+      return A.isDeclaration() == B.isDeclaration();
+    // Static functions may call each other; as with types, a pair being
+    // compared is assumed to match.
+    auto inserted = m_matching.insert(std::make_pair(&A, &B));
+    if (!inserted.second)
+      return true;
+    if (!BodiesMatch(A, B)) {
+      m_matching.erase(inserted.first);
+      return false;
+    }
+    return true;
+  }
+
+private:
+  bool BodiesMatch(const Function &A, const Function &B) {
+    if (!TypesMatch(A.getFunctionType(), B.getFunctionType()) ||
+        A.getAttributes() != B.getAttributes() ||
+        A.getCallingConv() != B.getCallingConv() ||
+        A.size() != B.size())
+      return false;
+
+    // Pair up the blocks and instructions first; operands may refer ahead.
+    std::map<const Value *, const Value *> pairs;
+    std::vector<std::pair<const Instruction *, const Instruction *>> insts;
+    for (auto BA = A.begin(), BB = B.begin(); BA != A.end(); ++BA, ++BB) {
+      pairs[&*BA] = &*BB;
+      auto IA = BA->begin(), IB = BB->begin();
+      for (;;) {
+        while (IA != BA->end() && IsDebugInfo(*IA))
+          ++IA;
+        while (IB != BB->end() && IsDebugInfo(*IB))
+          ++IB;
+        if (IA == BA->end() || IB == BB->end()) {
+          if (IA != BA->end() || IB != BB->end())
+            return false;
+          break;
+        }
+        pairs[&*IA] = &*IB;
+        insts.emplace_back(&*IA, &*IB);
+        ++IA;
+        ++IB;
+      }
+    }
+
+    for (auto &&inst : insts) {
+      const Instruction &IA = *inst.first, &IB = *inst.second;
+      if (!OperationsMatch(IA, IB))
+        return false;
+      for (unsigned i = 0; i < IA.getNumOperands(); ++i) {
+        const Value *VA = IA.getOperand(i), *VB = IB.getOperand(i);
+        if (isa<Instruction>(VA) || isa<BasicBlock>(VA)) {
+          auto found = pairs.find(VA);
+          if (found == pairs.end() || found->second != VB)
+            return false;
+        }
+        else if (const Argument *AA = dyn_cast<Argument>(VA)) {
+          const Argument *AB = dyn_cast<Argument>(VB);
+          if (!AB || AA->getArgNo() != AB->getArgNo())
+            return false;
+        }
+        else if (const Constant *CA = dyn_cast<Constant>(VA)) {
+          const Constant *CB = dyn_cast<Constant>(VB);
+          if (!CB || !ConstantsMatch(CA, CB))
+            return false;
+        }
+        else if (isa<MetadataAsValue>(VA)) {
+          if (!isa<MetadataAsValue>(VB))
+            return false;
+        }
+        else if (VA != VB) {
+          return false;
+        }
+      }
+      if (const PHINode *PA = dyn_cast<PHINode>(&IA)) {
+        const PHINode *PB = cast<PHINode>(&IB);
+        for (unsigned i = 0; i < PA->getNumIncomingValues(); ++i) {
+          auto found = pairs.find(PA->getIncomingBlock(i));
+          if (found == pairs.end() || found->second != PB->getIncomingBlock(i))
+            return false;
+        }
+      }
+    }
+    return true;
+  }
+};
+
+// Helper functions that are not static are linkonce_odr in a library, so
+// the linker keeps one of the definitions that several libraries have for
+// the same name. That is only right if they are the same function, as when
+// they come from a shared header. Returns false with a message in errors if
+// pLib defines one differently from pLinked.
+static bool CheckSharedFunctions(Module &Linked, Module &Lib,
+                                 const std::map<std::string, std::string>
+                                     &definedBy,
+                                 StringRef libName, raw_ostream &errors) {
+  FunctionBodyMatcher matcher;
+  for (Function &F : Lib) {
+    if (F.isDeclaration() || !F.hasLinkOnceODRLinkage())
+      continue;
+    Function *pExisting = Linked.getFunction(F.getName());
+    if (pExisting == nullptr || pExisting->isDeclaration())
+      continue;
+    if (!matcher.FunctionsMatch(*pExisting, F)) {
+      errors << "function " << F.getName() << " is defined differently by "
+             << "libraries " << definedBy.at(F.getName().str()) << " and "
+             << libName << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+class DxcLinker : public IDxcLinker {
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  std::map<std::wstring, CComPtr<IDxcBlob>> m_libraries;
+
+  // Links the named libraries into a single high-level module whose entry
+  // point is pEntryName, or returns nullptr with a message in errors.
+  std::unique_ptr<Module> LinkLibraries(LLVMContext &Ctx,
+                                        const std::string &entryName,
+                                        const ShaderModel *pSM,
+                                        const LPCWSTR *pLibNames,
+                                        UINT32 libCount, raw_ostream &errors);
+
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  DxcLinker() : m_dwRef(0) {}
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
+    return DoBasicQueryInterface<IDxcLinker>(this, iid, ppvObject);
+  }
+
+  // Registering a library under a name already in use replaces it.
+  __override HRESULT STDMETHODCALLTYPE RegisterLibrary(
+    _In_ LPCWSTR pLibName, _In_ IDxcBlob *pLib);
+  __override HRESULT STDMETHODCALLTYPE Link(
+    _In_ LPCWSTR pEntryName, _In_ LPCWSTR pTargetProfile,
+    _In_count_(libCount) const LPCWSTR *pLibNames, _In_ UINT32 libCount,
+    _In_count_(argCount) const LPCWSTR *pArguments, _In_ UINT32 argCount,
+    _COM_Outptr_ IDxcOperationResult **ppResult);
+};
+
+HRESULT STDMETHODCALLTYPE DxcLinker::RegisterLibrary(_In_ LPCWSTR pLibName,
+                                                     _In_ IDxcBlob *pLib) {
+  if (pLibName == nullptr || pLib == nullptr)
+    return E_INVALIDARG;
+  try {
+    m_libraries[pLibName] = pLib;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+  return S_OK;
+}
+
+std::unique_ptr<Module>
+DxcLinker::LinkLibraries(LLVMContext &Ctx, const std::string &entryName,
+                         const ShaderModel *pSM, const LPCWSTR *pLibNames,
+                         UINT32 libCount, raw_ostream &errors) {
+  std::vector<std::unique_ptr<Module>> libs;
+  size_t entryLib = libCount;
+  for (UINT32 i = 0; i < libCount; ++i) {
+    std::string libName = Unicode::UTF16ToUTF8StringOrThrow(pLibNames[i]);
+    auto found = m_libraries.find(pLibNames[i]);
+    if (found == m_libraries.end()) {
+      errors << "library " << libName << " is not registered\n";
+      return nullptr;
+    }
+    std::unique_ptr<Module> pLib;
+    std::string loadErrors;
+    raw_string_ostream loadErrorStream(loadErrors);
+    if (!LoadLibraryModule(found->second, Ctx, pLib, loadErrorStream)) {
+      errors << "library " << libName << " is " << loadErrorStream.str()
+             << "\n";
+      return nullptr;
+    }
+
+    HLModule &HM = pLib->GetOrCreateHLModule();
+    if (HM.GetShaderModel() != pSM) {
+      errors << "library " << libName << " was compiled for "
+             << HM.GetShaderModel()->GetName() << ", not " << pSM->GetName()
+             << "\n";
+      return nullptr;
+    }
+    if (HM.GetEntryFunction() != nullptr &&
+        HM.GetEntryFunctionName() == entryName) {
+      if (entryLib != libCount) {
+        errors << "entry point " << entryName
+               << " is defined by more than one library\n";
+        return nullptr;
+      }
+      entryLib = i;
+    }
+    libs.emplace_back(std::move(pLib));
+  }
+  if (entryLib == libCount) {
+    errors << "cannot find entry function " << entryName
+           << "; compile its library with /E " << entryName << "\n";
+    return nullptr;
+  }
+
+  // Resource bindings and constant buffer layouts are decided for a single
+  // source, so only the entry library may declare them.
+  for (UINT32 i = 0; i < libCount; ++i) {
+    HLModule &HM = libs[i]->GetHLModule();
+    if (i != entryLib) {
+      bool hasResources = !HM.GetSRVs().empty() || !HM.GetUAVs().empty() ||
+                          !HM.GetSamplers().empty();
+      for (auto &&CB : HM.GetCBuffers())
+        hasResources |= CB->GetSize() != 0;
+      if (hasResources) {
+        errors << "library "
+               << Unicode::UTF16ToUTF8StringOrThrow(pLibNames[i])
+               << " declares resources or constants; only the library with "
+                  "the entry point may\n";
+        return nullptr;
+      }
+    }
+    libs[i]->ResetHLModule();
+    HLModule::PrepareLibraryForLink(*libs[i], i == entryLib, i);
+  }
+
+  std::unique_ptr<Module> pLinked = std::move(libs[entryLib]);
+  raw_ostream *pErrors = &errors;
+  Linker linker(pLinked.get(), [pErrors](const DiagnosticInfo &DI) {
+    DiagnosticPrinterRawOStream DP(*pErrors);
+    DI.print(DP);
+    *pErrors << "\n";
+  });
+  // Names the library each function that is not static was first defined
+  // by, for reporting conflicting definitions.
+  std::map<std::string, std::string> definedBy;
+  auto recordDefinitions = [&](Module &Lib, UINT32 i) {
+    std::string libName = Unicode::UTF16ToUTF8StringOrThrow(pLibNames[i]);
+    for (Function &F : Lib) {
+      if (!F.isDeclaration() && !F.hasLocalLinkage())
+        definedBy.emplace(F.getName().str(), libName);
+    }
+  };
+  recordDefinitions(*pLinked, entryLib);
+  for (UINT32 i = 0; i < libCount; ++i) {
+    if (i == entryLib)
+      continue;
+    recordDefinitions(*libs[i], i);
+    if (!CheckSharedFunctions(
+            *pLinked, *libs[i], definedBy,
+            Unicode::UTF16ToUTF8StringOrThrow(pLibNames[i]), errors))
+      return nullptr;
+    if (linker.linkInModule(libs[i].get()))
+      return nullptr;
+    libs[i].reset();
+  }
+
+  HLModule::MergeLinkedHLMetadata(*pLinked);
+  HLModule &HM = pLinked->GetOrCreateHLModule();
+  HLModule::ClearHLMetadata(*pLinked);
+  RemoveTypeSystemHelperVariables(*pLinked);
+  CallGlobalConstructors(*pLinked, HM.GetEntryFunction());
+  InternalizeLinkedFunctions(HM);
+  return pLinked;
+}
+
+// Linking runs the optimization pipeline and validates the result; options
+// for anything else would only apply when compiling the libraries, so they
+// are rejected rather than silently ignored.
+static bool CheckLinkArguments(const hlsl::options::DxcOpts &opts,
+                               raw_ostream &errors) {
+  for (const llvm::opt::Arg *A : opts.Args) {
+    const llvm::opt::Option &O = A->getOption();
+    if (O.matches(hlsl::options::OPT_O0) || O.matches(hlsl::options::OPT_O1) ||
+        O.matches(hlsl::options::OPT_O2) || O.matches(hlsl::options::OPT_O3) ||
+        O.matches(hlsl::options::OPT_Od) || O.matches(hlsl::options::OPT_Gfa) ||
+        O.matches(hlsl::options::OPT_Gfp) || O.matches(hlsl::options::OPT_VD) ||
+        O.matches(hlsl::options::OPT_compress))
+      continue;
+    errors << "option " << A->getSpelling()
+           << " is not supported when linking; use it to compile the "
+              "libraries\n";
+    return false;
+  }
+  return true;
+}
+
+HRESULT STDMETHODCALLTYPE DxcLinker::Link(
+    _In_ LPCWSTR pEntryName, _In_ LPCWSTR pTargetProfile,
+    _In_count_(libCount) const LPCWSTR *pLibNames, _In_ UINT32 libCount,
+    _In_count_(argCount) const LPCWSTR *pArguments, _In_ UINT32 argCount,
+    _COM_Outptr_ IDxcOperationResult **ppResult) {
+  if (ppResult == nullptr)
+    return E_INVALIDARG;
+  *ppResult = nullptr;
+  if (pEntryName == nullptr || pTargetProfile == nullptr ||
+      (libCount > 0 && pLibNames == nullptr) ||
+      (argCount > 0 && pArguments == nullptr))
+    return E_INVALIDARG;
+
+  try {
+    ::llvm::sys::fs::MSFileSystem *msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+
+    CComPtr<IMalloc> pMalloc;
+    IFT(CoGetMalloc(1, &pMalloc));
+
+    std::string errors;
+    raw_string_ostream errorStream(errors);
+    CComPtr<IDxcBlob> pOutputBlob;
+    HRESULT status = E_FAIL;
+
+    int argCountInt;
+    IFT(UIntToInt(argCount, &argCountInt));
+    hlsl::options::MainArgs mainArgs(argCountInt,
+                                     const_cast<LPCWSTR *>(pArguments), 0);
+    hlsl::options::DxcOpts opts;
+    std::string entryName = Unicode::UTF16ToUTF8StringOrThrow(pEntryName);
+    std::string profile = Unicode::UTF16ToUTF8StringOrThrow(pTargetProfile);
+    const ShaderModel *pSM = ShaderModel::GetByName(profile.c_str());
+    LLVMContext Ctx;
+    std::unique_ptr<Module> pLinked;
+    if (0 != hlsl::options::ReadDxcOpts(hlsl::options::getHlslOptTable(),
+                                        hlsl::options::CompilerFlags,
+                                        mainArgs, opts, errorStream)) {
+      status = E_INVALIDARG;
+    }
+    else if (!CheckLinkArguments(opts, errorStream)) {
+      status = E_INVALIDARG;
+    }
+    else if (!pSM->IsValid()) {
+      errorStream << "invalid profile " << profile << "\n";
+      status = E_INVALIDARG;
+    }
+    else {
+      pLinked = LinkLibraries(Ctx, entryName, pSM, pLibNames, libCount,
+                              errorStream);
+    }
+
+    if (pLinked) {
+      // Run the pipeline codegen runs after emitting a single source, set up
+      // from the options the same way.
+      clang::CodeGenOptions codeGenOpts;
+      SetupCodeGenOptsForOptimization(opts, codeGenOpts);
+      clang::LangOptions langOpts;
+      langOpts.HLSL = true;
+      IntrusiveRefCntPtr<clang::DiagnosticIDs> diagIDs(
+          new clang::DiagnosticIDs());
+      IntrusiveRefCntPtr<clang::DiagnosticOptions> diagOpts(
+          new clang::DiagnosticOptions());
+      clang::TextDiagnosticPrinter diagPrinter(errorStream, diagOpts.get());
+      clang::DiagnosticsEngine diags(diagIDs, diagOpts.get(), &diagPrinter,
+                                     /*ShouldOwnClient*/ false);
+      clang::EmitBackendOutput(diags, codeGenOpts, clang::TargetOptions(),
+                               langOpts, "", pLinked.get(),
+                               clang::Backend_EmitNothing, nullptr);
+      if (diags.hasErrorOccurred())
+        pLinked.reset();
+    }
+
+    if (pLinked) {
+      CComPtr<AbstractMemoryStream> pModuleBitcode;
+      CComPtr<AbstractMemoryStream> pContainerStream;
+      IFT(CreateMemoryStream(pMalloc, &pModuleBitcode));
+      IFT(CreateMemoryStream(pMalloc, &pContainerStream));
+      {
+        raw_stream_ostream outStream(pModuleBitcode.p);
+        WriteBitcodeToFile(pLinked.get(), outStream, true);
+      }
+
+      // Validate with the same validator the compiler would pick. The
+      // validator is released before the DLL so that it can be unloaded.
+      dxc::DxcDllSupport validatorDll;
+      CComPtr<IDxcValidator> pValidator;
+      bool internalValidator = false;
+      if (!opts.DisableValidation) {
+        validatorDll.InitializeForDll(L"dxil.dll", "DxcCreateInstance");
+        CreateValidatorForCompile(validatorDll, errorStream, pValidator,
+                                  internalValidator);
+      }
+
+      // Serializing strips debug info from the module; the built-in
+      // validator checks the instructions against a copy that keeps it.
+      std::unique_ptr<Module> pDebugModule;
+      if (internalValidator && getDebugMetadataVersionFromModule(*pLinked) != 0)
+        pDebugModule.reset(CloneModule(pLinked.get()));
+      SerializeDxilContainerForModule(pLinked.get(), pModuleBitcode,
+                                      pContainerStream);
+      IFT(pContainerStream.QueryInterface(&pOutputBlob));
+
+      status = S_OK;
+      if (pValidator != nullptr) {
+        CComPtr<IDxcOperationResult> pValResult;
+        if (internalValidator) {
+          IFT(RunInternalValidator(pValidator, pLinked.get(),
+                                   pDebugModule.get(), pOutputBlob,
+                                   DxcValidatorFlags_InPlaceEdit, &pValResult));
+        }
+        else {
+          IFT(pValidator->Validate(pOutputBlob, DxcValidatorFlags_InPlaceEdit,
+                                   &pValResult));
+        }
+        IFT(pValResult->GetStatus(&status));
+        CComPtr<IDxcBlob> pValidatedBlob;
+        IFT(pValResult->GetResult(&pValidatedBlob));
+        if (pValidatedBlob != nullptr)
+          std::swap(pOutputBlob, pValidatedBlob);
+        if (FAILED(status)) {
+          CComPtr<IDxcBlobEncoding> pValErrors;
+          CComPtr<IDxcBlobEncoding> pValErrorsUtf8;
+          IFT(pValResult->GetErrorBuffer(&pValErrors));
+          IFT(hlsl::DxcGetBlobAsUtf8(pValErrors, &pValErrorsUtf8));
+          errorStream << "validation errors\r\n"
+                      << StringRef((const char *)pValErrorsUtf8->GetBufferPointer(),
+                                   pValErrorsUtf8->GetBufferSize());
+        }
+      }
+      if (SUCCEEDED(status) && opts.CompressParts) {
+        CComPtr<AbstractMemoryStream> pCompressedStream;
+        IFT(CreateMemoryStream(pMalloc, &pCompressedStream));
+        CompressDxilContainer(
+            reinterpret_cast<const DxilContainerHeader *>(
+                pOutputBlob->GetBufferPointer()),
+            pCompressedStream);
+        pOutputBlob.Release();
+        IFT(pCompressedStream.QueryInterface(&pOutputBlob));
+      }
+    }
+
+    errorStream.flush();
+    CComPtr<IDxcBlobEncoding> pErrorBlob;
+    IFT(DxcCreateBlobWithEncodingOnHeapCopy(errors.c_str(), errors.size(),
+                                            CP_UTF8, &pErrorBlob));
+    if (FAILED(status))
+      pOutputBlob.Release();
+    IFT(DxcOperationResult::CreateFromResultErrorStatus(pOutputBlob, pErrorBlob,
+                                                        status, ppResult));
+  }
+  CATCH_CPP_RETURN_HRESULT();
+  return S_OK;
+}
+
+HRESULT CreateDxcLinker(_In_ REFIID riid, _Out_ LPVOID *ppv) {
+  CComPtr<DxcLinker> result = new (std::nothrow) DxcLinker();
+  if (result == nullptr) {
+    *ppv = nullptr;
+    return E_OUTOFMEMORY;
+  }
+
+  return result.p->QueryInterface(riid, ppv);
+}
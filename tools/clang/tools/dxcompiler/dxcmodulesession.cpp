@@ -0,0 +1,230 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcmodulesession.cpp                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements a session that keeps a parsed module across tool calls.        //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/HLSL/DxilContainer.h"
+#include "dxc/Support/Global.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "dxc/Support/microcom.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/dxcapi.impl.h"
+#include "dxc/dxcapi.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+HRESULT CreateDxcOptimizer(_In_ REFIID riid, _Out_ LPVOID *ppv);
+HRESULT CreateDxcValidator(_In_ REFIID riid, _Out_ LPVOID *ppv);
+HRESULT RunInternalOptimizer(_In_ IDxcOptimizer *pOptimizer,
+                             _In_ llvm::Module *pModule,
+                             _In_count_(optionCount) LPCWSTR *ppOptions,
+                             UINT32 optionCount,
+                             _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText);
+HRESULT RunInternalValidator(_In_ IDxcValidator *pValidator,
+                             _In_ llvm::Module *pModule,
+                             _In_ llvm::Module *pDebugModule,
+                             _In_opt_ IDxcBlob *pShader, UINT32 Flags,
+                             _COM_Outptr_ IDxcOperationResult **ppResult);
+void PrintDxilModule(llvm::Module *pModule, raw_string_ostream &Stream);
+
+class DxcModuleSession : public IDxcModuleSession {
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  // The module is destroyed before the context that owns its types.
+  std::unique_ptr<LLVMContext> m_pContext;
+  std::unique_ptr<Module> m_pModule;
+  CComPtr<IDxcOptimizer> m_pOptimizer;
+  CComPtr<IDxcValidator> m_pValidator;
+
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  DxcModuleSession() : m_dwRef(0) {}
+  ~DxcModuleSession() {
+    m_pModule.reset();
+  }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
+    return DoBasicQueryInterface<IDxcModuleSession>(this, iid, ppvObject);
+  }
+
+  __override HRESULT STDMETHODCALLTYPE Load(_In_ IDxcBlob *pModule);
+  __override HRESULT STDMETHODCALLTYPE RunOptimizer(
+    _In_count_(optionCount) LPCWSTR *ppOptions, UINT32 optionCount,
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText);
+  __override HRESULT STDMETHODCALLTYPE Validate(
+    _COM_Outptr_ IDxcOperationResult **ppResult);
+  __override HRESULT STDMETHODCALLTYPE Disassemble(
+    _COM_Outptr_ IDxcBlobEncoding **ppDisassembly);
+  __override HRESULT STDMETHODCALLTYPE GetModule(
+    _COM_Outptr_ IDxcBlob **ppModule);
+};
+
+HRESULT STDMETHODCALLTYPE DxcModuleSession::Load(_In_ IDxcBlob *pModule) {
+  if (pModule == nullptr)
+    return E_INVALIDARG;
+
+  try {
+    // Accept a DXIL container, a DXIL program part, bitcode or assembly.
+    const char *pIL = (const char *)pModule->GetBufferPointer();
+    uint32_t pILLength = pModule->GetBufferSize();
+    CComPtr<AbstractMemoryStream> pExpandedStream;
+    if (const DxilContainerHeader *pContainer =
+            IsDxilContainerLike(pIL, pILLength)) {
+      if (!IsValidDxilContainer(pContainer, pILLength))
+        return DXC_E_CONTAINER_INVALID;
+      if (HasCompressedDxilParts(pContainer)) {
+        CComPtr<IMalloc> pMalloc;
+        IFT(CoGetMalloc(1, &pMalloc));
+        IFT(CreateMemoryStream(pMalloc, &pExpandedStream));
+        if (!DecompressDxilContainer(pContainer, pExpandedStream))
+          return DXC_E_CONTAINER_INVALID;
+        pContainer = reinterpret_cast<const DxilContainerHeader *>(
+            pExpandedStream->GetPtr());
+      }
+      DxilPartIterator it = std::find_if(begin(pContainer), end(pContainer),
+                                         DxilPartIsType(DFCC_DXIL));
+      if (it == end(pContainer))
+        return DXC_E_CONTAINER_MISSING_DXIL;
+      const DxilProgramHeader *pProgramHeader =
+          reinterpret_cast<const DxilProgramHeader *>(GetDxilPartData(*it));
+      if (!IsValidDxilProgramHeader(pProgramHeader, (*it)->PartSize))
+        return DXC_E_CONTAINER_INVALID;
+      GetDxilProgramBitcode(pProgramHeader, &pIL, &pILLength);
+    }
+    else {
+      const DxilProgramHeader *pProgramHeader =
+          reinterpret_cast<const DxilProgramHeader *>(pIL);
+      if (IsValidDxilProgramHeader(pProgramHeader, pILLength))
+        GetDxilProgramBitcode(pProgramHeader, &pIL, &pILLength);
+    }
+
+    // Bitcode is fully materialized while parsing, so it can be read in
+    // place; the assembly parser needs a null-terminated copy.
+    StringRef bufStrRef(pIL, pILLength);
+    std::unique_ptr<MemoryBuffer> memBuf;
+    if (isBitcode(bufStrRef.bytes_begin(), bufStrRef.bytes_end()))
+      memBuf = MemoryBuffer::getMemBuffer(bufStrRef, "", false);
+    else
+      memBuf = MemoryBuffer::getMemBufferCopy(bufStrRef);
+
+    std::unique_ptr<LLVMContext> pContext(new LLVMContext());
+    SMDiagnostic Err;
+    std::unique_ptr<Module> pLoaded =
+        parseIR(memBuf->getMemBufferRef(), Err, *pContext);
+    if (!pLoaded)
+      return DXC_E_IR_VERIFICATION_FAILED;
+
+    m_pModule.reset();
+    m_pContext = std::move(pContext);
+    m_pModule = std::move(pLoaded);
+  }
+  CATCH_CPP_RETURN_HRESULT();
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DxcModuleSession::RunOptimizer(
+    _In_count_(optionCount) LPCWSTR *ppOptions, UINT32 optionCount,
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText) {
+  AssignToOutOpt(nullptr, ppOutputText);
+  if (m_pModule == nullptr)
+    return E_FAIL;
+  if (m_pOptimizer == nullptr)
+    IFR(CreateDxcOptimizer(IID_PPV_ARGS(&m_pOptimizer)));
+  return RunInternalOptimizer(m_pOptimizer, m_pModule.get(), ppOptions,
+                              optionCount, ppOutputText);
+}
+
+HRESULT STDMETHODCALLTYPE DxcModuleSession::Validate(
+    _COM_Outptr_ IDxcOperationResult **ppResult) {
+  if (ppResult == nullptr)
+    return E_INVALIDARG;
+  *ppResult = nullptr;
+  if (m_pModule == nullptr)
+    return E_FAIL;
+  if (m_pValidator == nullptr)
+    IFR(CreateDxcValidator(IID_PPV_ARGS(&m_pValidator)));
+  HRESULT hr = RunInternalValidator(m_pValidator, m_pModule.get(), nullptr,
+                                    nullptr, DxcValidatorFlags_Default,
+                                    ppResult);
+  // The validator installs a diagnostic handler that only lives for the
+  // duration of the call.
+  m_pContext->setDiagnosticHandler(nullptr, nullptr);
+  return hr;
+}
+
+HRESULT STDMETHODCALLTYPE DxcModuleSession::Disassemble(
+    _COM_Outptr_ IDxcBlobEncoding **ppDisassembly) {
+  if (ppDisassembly == nullptr)
+    return E_INVALIDARG;
+  *ppDisassembly = nullptr;
+  if (m_pModule == nullptr)
+    return E_FAIL;
+
+  try {
+    ::llvm::sys::fs::MSFileSystem *msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+
+    std::string StreamStr;
+    raw_string_ostream Stream(StreamStr);
+    PrintDxilModule(m_pModule.get(), Stream);
+    Stream.flush();
+
+    IFT(DxcCreateBlobWithEncodingOnHeapCopy(
+        StreamStr.c_str(), StreamStr.size(), CP_UTF8, ppDisassembly));
+  }
+  CATCH_CPP_RETURN_HRESULT();
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DxcModuleSession::GetModule(
+    _COM_Outptr_ IDxcBlob **ppModule) {
+  if (ppModule == nullptr)
+    return E_INVALIDARG;
+  *ppModule = nullptr;
+  if (m_pModule == nullptr)
+    return E_FAIL;
+
+  try {
+    CComPtr<IMalloc> pMalloc;
+    CComPtr<AbstractMemoryStream> pProgramStream;
+    IFT(CoGetMalloc(1, &pMalloc));
+    IFT(CreateMemoryStream(pMalloc, &pProgramStream));
+    {
+      raw_stream_ostream outStream(pProgramStream.p);
+      WriteBitcodeToFile(m_pModule.get(), outStream, true);
+    }
+    IFT(pProgramStream.QueryInterface(ppModule));
+  }
+  CATCH_CPP_RETURN_HRESULT();
+  return S_OK;
+}
+
+HRESULT CreateDxcModuleSession(_In_ REFIID riid, _Out_ LPVOID *ppv) {
+  CComPtr<DxcModuleSession> result = new (std::nothrow) DxcModuleSession();
+  if (result == nullptr) {
+    *ppv = nullptr;
+    return E_OUTOFMEMORY;
+  }
+
+  return result.p->QueryInterface(riid, ppv);
+}
@@ -28,6 +28,7 @@
 #include "clang/Sema/SemaHLSL.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "clang/Frontend/FrontendActions.h"
+#include "clang/Frontend/Utils.h"
 #include "clang/CodeGen/CodeGenAction.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/DiagnosticPrinter.h"
@@ -35,6 +36,7 @@
 #include "llvm/IR/AssemblyAnnotationWriter.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "dxc/Support/WinIncludes.h"  // For DxilPipelineStateValidation.h
 #include "dxc/HLSL/DxilPipelineStateValidation.h"
 #include "dxc/HLSL/HLSLExtensionsCodegenHelper.h"
@@ -73,7 +75,13 @@
 #include "dxc/Support/DxcLangExtensionsHelper.h"
 #include "dxc/Support/HLSLOptions.h"
 #include "dxcetw.h"
+#include "dxccompilecache.h"
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 #define CP_UTF16 1200
 
@@ -83,6 +91,7 @@ using namespace hlsl;
 
 // This declaration is used for the locally-linked validator.
 HRESULT CreateDxcValidator(_In_ REFIID riid, _Out_ LPVOID *ppv);
+HRESULT CreateDxcIncludeCache(_In_ REFIID riid, _Out_ LPVOID *ppv);
 
 // This internal call allows the validator to avoid having to re-deserialize
 // the module. It trusts that the caller didn't make any changes and is
@@ -94,6 +103,46 @@ HRESULT RunInternalValidator(_In_ IDxcValidator *pValidator,
                              _In_ IDxcBlob *pShader, UINT32 Flags,
                              _In_ IDxcOperationResult **ppResult);
 
+// Creates the validator, preferring the one in dxil.dll and falling back to
+// the built-in one. The linker validates its output the same way.
+void CreateValidatorForCompile(dxc::DxcDllSupport &validatorDll,
+                               raw_ostream &w,
+                               CComPtr<IDxcValidator> &pValidator,
+                               bool &internalValidator) {
+  internalValidator = false;
+  if (validatorDll.IsEnabled()) {
+    // If the DLL is found but doesn't work, warn.
+    if (FAILED(validatorDll.CreateInstance(CLSID_DxcValidator, &pValidator))) {
+      w << "Unable to create validator from dxil.dll, fallback to built-in.";
+    }
+  }
+  if (pValidator == nullptr) {
+    IFT(CreateDxcValidator(IID_PPV_ARGS(&pValidator)));
+    internalValidator = true;
+  }
+}
+
+// Sets the code generation options that select the optimization pipeline
+// run after emitting a module. The linker runs the same pipeline.
+void SetupCodeGenOptsForOptimization(const hlsl::options::DxcOpts &opts,
+                                     CodeGenOptions &codeGenOpts) {
+  if (opts.DisableOptimizations)
+    codeGenOpts.DisableLLVMOpts = true;
+
+  codeGenOpts.OptimizationLevel = opts.OptLevel;
+  if (opts.OptLevel >= 3)
+    codeGenOpts.UnrollLoops = true;
+
+  // Overrding default set of loop unroll.
+  if (opts.PreferFlowControl)
+    codeGenOpts.UnrollLoops = false;
+  if (opts.AvoidFlowControl)
+    codeGenOpts.UnrollLoops = true;
+
+  // always inline for hlsl
+  codeGenOpts.setInlining(clang::CodeGenOptions::OnlyAlwaysInlining);
+}
+
 static const HANDLE StdOutHandle = (HANDLE)0x1;
 static const HANDLE StdErrHandle = (HANDLE)0x2;
 static const HANDLE SourceParentDirHandle = (HANDLE)0x11;
@@ -101,10 +150,10 @@ static const HANDLE SourceHandle = (HANDLE)0x12;
 static const HANDLE OutputHandle = (HANDLE)0x13;
 static const size_t IncludedHandleOffset = 0x100;
 
-/// Max number of included files (1:1 to their directories) or search directories.
-/// If programs include more than a handful, DxcArgsFileSystem will need to do better than linear scans.
+/// Max number of included files (1:1 to their directories) or search directories,
+/// bounded by the handle ranges below.
 /// If this is fired, ERROR_OUT_OF_STRUCTURES will be returned by an attempt to open a file.
-static const size_t MaxIncludedFiles = 200;
+static const size_t MaxIncludedFiles = 0xE00;
 static const size_t IncludedDirHandleOffset = 0x1000;
 static const size_t SearchDirHandleOffset = 0x2000;
 
@@ -169,6 +218,37 @@ private:
       : Name(name), Blob(pBlob), BlobStream(pStream) { }
   };
   llvm::SmallVector<IncludedFile, 4> m_includedFiles;
+  // Index of m_includedFiles by name.
+  std::unordered_map<std::wstring, size_t> m_includedFileIndex;
+  // Directories of the included files and search entries, mapped to the
+  // first file or entry in them; see AddDirsOf.
+  std::unordered_map<std::wstring, size_t> m_includedDirIndex;
+  std::unordered_map<std::wstring, size_t> m_searchDirIndex;
+  // Names the include handler had no file for; kept to validate cached results.
+  std::vector<std::wstring> m_missingFiles;
+  std::unordered_set<std::wstring> m_missingFileSet;
+  // Handler answers read before the compilation; see SetPreloadedSources.
+  DxcCompileCacheSources m_preloadedSources;
+
+  void AddMissingFile(LPCWSTR lpFileName) {
+    if (m_missingFileSet.insert(lpFileName).second)
+      m_missingFiles.emplace_back(lpFileName);
+  }
+
+  // Records every directory that path is in, both with and without a
+  // trailing separator, so that lookups match what IsDirOf would accept.
+  // Earlier entries take precedence.
+  static void AddDirsOf(const std::wstring &path, size_t index,
+                        std::unordered_map<std::wstring, size_t> &dirs) {
+    for (size_t i = 0; i < path.size(); ++i) {
+      if (path[i] != L'\\' && path[i] != L'/')
+        continue;
+      if (i > 0)
+        dirs.emplace(path.substr(0, i), index);
+      if (i + 1 < path.size())
+        dirs.emplace(path.substr(0, i + 1), index);
+    }
+  }
 
   static bool IsDirOf(LPCWSTR lpDir, size_t dirLen, const std::wstring &fileName) {
     if (fileName.size() <= dirLen) return false;
@@ -190,27 +270,25 @@ private:
   }
 
   HANDLE TryFindDirHandle(LPCWSTR lpDir) const {
-    size_t dirLen = wcslen(lpDir);
-    for (size_t i = 0; i < m_includedFiles.size(); ++i) {
-      const std::wstring &fileName = m_includedFiles[i].Name;
-      if (IsDirOf(lpDir, dirLen, fileName)) {
-        return IncludedDirIndexToHandle(i);
-      }
+    std::wstring dir(lpDir);
+    auto included = m_includedDirIndex.find(dir);
+    if (included != m_includedDirIndex.end()) {
+      DXASSERT_NOMSG(IsDirOf(lpDir, dir.size(), m_includedFiles[included->second].Name));
+      return IncludedDirIndexToHandle(included->second);
     }
-    for (size_t i = 0; i < m_searchEntries.size(); ++i) {
-      if (IsDirPrefixOrSame(lpDir, dirLen, m_searchEntries[i])) {
-        return SearchDirIndexToHandle(i);
-      }
+    auto search = m_searchDirIndex.find(dir);
+    if (search != m_searchDirIndex.end()) {
+      DXASSERT_NOMSG(IsDirPrefixOrSame(lpDir, dir.size(), m_searchEntries[search->second]));
+      return SearchDirIndexToHandle(search->second);
     }
     return INVALID_HANDLE_VALUE;
   }
   DWORD TryFindOrOpen(LPCWSTR lpFileName, size_t &index) {
     if (m_includeLoader.p != nullptr) {
-      for (size_t i = 0; i < m_includedFiles.size(); ++i) {
-        if (0 == wcscmp(lpFileName, m_includedFiles[i].Name.data())) {
-          index = i;
-          return ERROR_SUCCESS;
-        }
+      auto found = m_includedFileIndex.find(lpFileName);
+      if (found != m_includedFileIndex.end()) {
+        index = found->second;
+        return ERROR_SUCCESS;
       }
 
       if (m_includedFiles.size() == MaxIncludedFiles) {
@@ -218,13 +296,24 @@ private:
       }
 
       CComPtr<IDxcBlob> fileBlob;
-      HRESULT hr = m_includeLoader->LoadSource(lpFileName, &fileBlob);
+      HRESULT hr;
+      auto preloaded = m_preloadedSources.find(lpFileName);
+      if (preloaded != m_preloadedSources.end()) {
+        fileBlob = preloaded->second;
+        hr = fileBlob != nullptr ? S_OK : E_FAIL;
+        m_preloadedSources.erase(preloaded);
+      }
+      else {
+        hr = m_includeLoader->LoadSource(lpFileName, &fileBlob);
+      }
       if (FAILED(hr)) {
+        AddMissingFile(lpFileName);
         return ERROR_UNHANDLED_EXCEPTION;
       }
       if (fileBlob.p != nullptr) {
         CComPtr<IDxcBlobEncoding> fileBlobEncoded;
-        if (FAILED(hlsl::DxcGetBlobAsUtf8(fileBlob, &fileBlobEncoded))) {
+        // Null-terminated contents are read by clang in place.
+        if (FAILED(hlsl::DxcGetBlobAsUtf8NullTerm(fileBlob, &fileBlobEncoded))) {
           return ERROR_UNHANDLED_EXCEPTION;
         }
         CComPtr<IStream> fileStream;
@@ -233,6 +322,8 @@ private:
         }
         m_includedFiles.emplace_back(std::wstring(lpFileName), fileBlobEncoded, fileStream);
         index = m_includedFiles.size() - 1;
+        m_includedFileIndex.emplace(m_includedFiles[index].Name, index);
+        AddDirsOf(m_includedFiles[index].Name, index, m_includedDirIndex);
 
         if (m_bDisplayIncludeProcess) {
           std::string openFileStr;
@@ -247,6 +338,7 @@ private:
         }
         return ERROR_SUCCESS;
       }
+      AddMissingFile(lpFileName);
     }
     return ERROR_NOT_FOUND;
   }
@@ -291,6 +383,15 @@ private:
       h == SourceHandle || h == SourceParentDirHandle || h == OutputHandle ||
       IsDirHandle(h) || IsHandleIncludedFile(h);
   }
+  // Blobs that end in a null terminator are presented without it, so their
+  // contents can be handed out in place as a null-terminated buffer.
+  static bool IsNullTerminated(IDxcBlob *pBlob) {
+    size_t size = pBlob->GetBufferSize();
+    return size > 0 && ((const char *)pBlob->GetBufferPointer())[size - 1] == '\0';
+  }
+  static DWORD GetContentsSize(IDxcBlob *pBlob) {
+    return pBlob->GetBufferSize() - (IsNullTerminated(pBlob) ? 1 : 0);
+  }
   IncludedFile &HandleToIncludedFile(HANDLE handle) {
     DXASSERT_NOMSG((size_t)handle >= IncludedHandleOffset);
     size_t index = (size_t)handle - IncludedHandleOffset;
@@ -306,6 +407,31 @@ public:
   void EnableDisplayIncludeProcess() {
     m_bDisplayIncludeProcess = true;
   }
+  /// Provides the include handler's answers for files it was already asked
+  /// for, such as while checking a cached result; the handler is only asked
+  /// about other files.
+  void SetPreloadedSources(DxcCompileCacheSources &&sources) {
+    m_preloadedSources = std::move(sources);
+  }
+  /// Describes every answer the include handler gave, so that a cached
+  /// result can later be checked against the handler's current answers.
+  void GetIncludeDependencies(std::vector<DxcCompileCacheDependency> &deps) {
+    for (const IncludedFile &file : m_includedFiles) {
+      DxcCompileCacheDependency dep;
+      dep.Name = file.Name;
+      dep.Present = true;
+      DxcComputeDependencyDigest(file.Blob, dep.Size, dep.Digest);
+      deps.emplace_back(std::move(dep));
+    }
+    for (const std::wstring &name : m_missingFiles) {
+      DxcCompileCacheDependency dep;
+      dep.Name = name;
+      dep.Present = false;
+      dep.Size = 0;
+      memset(dep.Digest, 0, sizeof(dep.Digest));
+      deps.emplace_back(std::move(dep));
+    }
+  }
   void WriteStdErrToStream(raw_string_ostream &s) {
     s.write((char*)m_pStdErrStream->GetPtr(), m_pStdErrStream->GetPtrSize());
     s.flush();
@@ -362,6 +488,8 @@ public:
         ws += Unicode::UTF8ToUTF16StringOrThrow(E.Path.c_str());
         m_searchEntries.emplace_back(std::move(ws));
       }
+      m_searchDirIndex.emplace(m_searchEntries.back(), i);
+      AddDirsOf(m_searchEntries.back(), i, m_searchDirIndex);
     }
   }
 
@@ -450,7 +578,7 @@ public:
     lpFileInformation->nFileIndexLow = (DWORD)(uintptr_t)hFile;
     if (hFile == SourceHandle) {
       lpFileInformation->dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
-      lpFileInformation->nFileSizeLow = m_pSource->GetBufferSize();
+      lpFileInformation->nFileSizeLow = GetContentsSize(m_pSource);
       return TRUE;
     }
     else if (hFile == OutputHandle) {
@@ -473,7 +601,7 @@ public:
     if (IsHandleIncludedFile(hFile)) {
       IncludedFile &file = HandleToIncludedFile(hFile);
       lpFileInformation->dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
-      lpFileInformation->nFileSizeLow = file.Blob->GetBufferSize();
+      lpFileInformation->nFileSizeLow = GetContentsSize(file.Blob);
       return TRUE;
     }
 
@@ -610,6 +738,19 @@ public:
     SetLastError(ERROR_NOT_CAPABLE);
     return FALSE;
   }
+  __override bool GetPinnedBuffer(int fd, _Outptr_ const char **ppData, _Out_ size_t *pSize) throw() {
+    HANDLE handle = (HANDLE)(uintptr_t)fd;
+    IDxcBlob *pBlob = nullptr;
+    if (handle == SourceHandle)
+      pBlob = m_pSource;
+    else if (IsHandleIncludedFile(handle))
+      pBlob = HandleToIncludedFile(handle).Blob;
+    if (pBlob == nullptr || !IsNullTerminated(pBlob))
+      return false;
+    *ppData = (const char *)pBlob->GetBufferPointer();
+    *pSize = GetContentsSize(pBlob);
+    return true;
+  }
 
   // Console APIs.
   __override bool FileDescriptorIsDisplayed(int fd) throw() {
@@ -723,7 +864,7 @@ CreateDxcArgsFileSystem(_In_ IDxcBlob *pSource, _In_ LPCWSTR pSourceName,
 
 static void CreateOperationResultFromOutputs(
     IDxcBlob *pResultBlob, DxcArgsFileSystem *msfPtr,
-    const std::string &warnings, clang::DiagnosticsEngine &diags,
+    const std::string &warnings, HRESULT status,
     _COM_Outptr_ IDxcOperationResult **ppResult) {
   CComPtr<IStream> pErrorStream;
   CComPtr<IDxcBlobEncoding> pErrorBlob;
@@ -739,10 +880,17 @@ static void CreateOperationResultFromOutputs(
                                             CP_UTF8, &pErrorBlob));
   }
 
-  HRESULT status = diags.hasErrorOccurred() ? E_FAIL : S_OK;
   IFT(DxcOperationResult::CreateFromResultErrorStatus(pResultBlob, pErrorBlob, status, ppResult));
 }
 
+static void CreateOperationResultFromOutputs(
+    IDxcBlob *pResultBlob, DxcArgsFileSystem *msfPtr,
+    const std::string &warnings, clang::DiagnosticsEngine &diags,
+    _COM_Outptr_ IDxcOperationResult **ppResult) {
+  HRESULT status = diags.hasErrorOccurred() ? E_FAIL : S_OK;
+  CreateOperationResultFromOutputs(pResultBlob, msfPtr, warnings, status, ppResult);
+}
+
 static void CreateOperationResultFromOutputs(
     AbstractMemoryStream *pOutputStream, DxcArgsFileSystem *msfPtr,
     const std::string &warnings, clang::DiagnosticsEngine &diags,
@@ -752,6 +900,56 @@ static void CreateOperationResultFromOutputs(
   CreateOperationResultFromOutputs(pResultBlob, msfPtr, warnings, diags, ppResult);
 }
 
+static void CreateTraceBlob(const llvm::TimeTraceProfiler &profiler,
+                            CComPtr<IDxcBlobEncoding> &pTrace) {
+  std::string trace;
+  raw_string_ostream traceStream(trace);
+  profiler.write(traceStream);
+  traceStream.flush();
+  IFT(DxcCreateBlobWithEncodingOnHeapCopy(trace.c_str(), trace.size(),
+                                          CP_UTF8, &pTrace));
+}
+
+// Replaces *ppResult with a result that also exposes the given trace through
+// IDxcOperationResultTrace.
+static void AttachTraceToResult(IDxcBlobEncoding *pTrace,
+                                _Inout_ IDxcOperationResult **ppResult) {
+  CComPtr<IDxcOperationResult> pUntraced;
+  pUntraced.Attach(*ppResult);
+  *ppResult = nullptr;
+  IFT(DxcOperationResult::CreateWithTrace(pUntraced, pTrace, ppResult));
+}
+
+// Replaces *ppResult with a result that also exposes the debug container
+// split from its output through IDxcOperationResultDebugInfo.
+static void AttachDebugInfoToResult(_In_opt_ IDxcBlob *pDebugBlob,
+                                    _Inout_ IDxcOperationResult **ppResult) {
+  if (pDebugBlob == nullptr)
+    return;
+  const char *pName = GetDxilShaderDebugName(
+      reinterpret_cast<const DxilContainerHeader *>(
+          pDebugBlob->GetBufferPointer()));
+  DXASSERT(pName != nullptr, "else debug container was written without a name");
+  CComPtr<IDxcBlobEncoding> pDebugName;
+  IFT(DxcCreateBlobWithEncodingOnHeapCopy(pName, strlen(pName), CP_UTF8,
+                                          &pDebugName));
+  CComPtr<IDxcOperationResult> pResult;
+  pResult.Attach(*ppResult);
+  *ppResult = nullptr;
+  IFT(DxcOperationResult::CreateWithDebugInfo(pResult, pDebugBlob, pDebugName,
+                                              ppResult));
+}
+
+static void FinishTrace(llvm::TimeTraceProfiler *pProfiler,
+                        _Inout_ IDxcOperationResult **ppResult) {
+  if (pProfiler == nullptr)
+    return;
+  pProfiler->end();
+  CComPtr<IDxcBlobEncoding> pTrace;
+  CreateTraceBlob(*pProfiler, pTrace);
+  AttachTraceToResult(pTrace, ppResult);
+}
+
 static void PrintDiagnosticHandler(const DiagnosticInfo &DI, void *Context) {
   DiagnosticPrinter *printer = reinterpret_cast<DiagnosticPrinter *>(Context);
   DI.print(*printer);
@@ -1578,6 +1776,29 @@ public:
   }
 };
 
+// Prints the DXIL summaries and annotated IR of a loaded module. This is
+// also used by IDxcModuleSession.
+void PrintDxilModule(llvm::Module *pModule, raw_string_ostream &Stream) {
+  if (pModule->getNamedMetadata("dx.version")) {
+    DxilModule &dxilModule = pModule->GetOrCreateDxilModule();
+    PrintDxilSignature("Input",
+                             dxilModule.GetInputSignature(), Stream,
+                             /*comment*/ ";");
+    PrintDxilSignature("Output",
+                             dxilModule.GetOutputSignature(), Stream,
+                             /*comment*/ ";");
+    PrintDxilSignature("Patch Constant signature",
+                             dxilModule.GetPatchConstantSignature(), Stream,
+                             /*comment*/ ";");
+    PrintBufferDefinitions(dxilModule, Stream, /*comment*/ ";");
+    PrintResourceBindings(dxilModule, Stream, /*comment*/ ";");
+  }
+  DxcAssemblyAnnotationWriter w;
+  // A lazily loaded module is printed one function body at a time.
+  if (pModule->printMaterializingFunctions(Stream, &w))
+    throw hlsl::Exception(DXC_E_IR_VERIFICATION_FAILED);
+}
+
 static void PrintPipelineStateValidationRuntimeInfo(const char *pBuffer, DXIL::ShaderKind shaderKind, raw_string_ostream &OS, StringRef comment) {
   OS << comment << "\n"
      << comment << " Pipeline Runtime Information: \n"
@@ -1866,13 +2087,30 @@ public:
       m_llvmModuleWithDebugInfo.reset(llvm::CloneModule(m_llvmModule.get()));
   }
 
- void WrapModuleInDxilContainer(IMalloc *pMalloc,  AbstractMemoryStream *pModuleBitcode, CComPtr<IDxcBlob> &pDxilContainerBlob) {
+ void WrapModuleInDxilContainer(IMalloc *pMalloc,  AbstractMemoryStream *pModuleBitcode, CComPtr<IDxcBlob> &pDxilContainerBlob,
+                                bool splitDebugInfo, CComPtr<IDxcBlob> &pDebugContainerBlob) {
     CComPtr<AbstractMemoryStream> pContainerStream;
+    CComPtr<AbstractMemoryStream> pDebugStream;
     IFT(CreateMemoryStream(pMalloc, &pContainerStream));
-    SerializeDxilContainerForModule(m_llvmModule.get(), pModuleBitcode, pContainerStream);
+    if (splitDebugInfo)
+      IFT(CreateMemoryStream(pMalloc, &pDebugStream));
+    SerializeDxilContainerForModule(m_llvmModule.get(), pModuleBitcode, pContainerStream, pDebugStream);
 
     pDxilContainerBlob.Release();
     IFT(pContainerStream.QueryInterface(&pDxilContainerBlob));
+    pDebugContainerBlob.Release();
+    if (pDebugStream != nullptr && pDebugStream->GetPtrSize() != 0)
+      IFT(pDebugStream.QueryInterface(&pDebugContainerBlob));
+  }
+
+  void WrapModuleInLibraryContainer(IMalloc *pMalloc, AbstractMemoryStream *pModuleBitcode,
+                                    CComPtr<IDxcBlob> &pLibraryBlob) {
+    CComPtr<AbstractMemoryStream> pContainerStream;
+    IFT(CreateMemoryStream(pMalloc, &pContainerStream));
+    SerializeDxilContainerForLibrary(m_llvmModule.get(), pModuleBitcode, pContainerStream);
+
+    pLibraryBlob.Release();
+    IFT(pContainerStream.QueryInterface(&pLibraryBlob));
   }
 
   llvm::Module *get() { return m_llvmModule.get(); }
@@ -1883,7 +2121,108 @@ private:
   std::unique_ptr<llvm::Module> m_llvmModuleWithDebugInfo;
 };
 
-class DxcCompiler : public IDxcCompiler, public IDxcLangExtensions, public IDxcContainerEvent {
+// Writes the tokens of the main file and of every file it includes to a
+// header token cache, which later compilations read with /token-cache.
+class EmitTokenCacheAction : public PreprocessorFrontendAction {
+public:
+  SmallVector<char, 0> TokenCache;
+
+protected:
+  void ExecuteAction() override {
+    raw_svector_ostream OS(TokenCache);
+    CacheTokens(getCompilerInstance().getPreprocessor(), &OS);
+    OS.flush();
+  }
+};
+
+// Adds the text of each pragma to a key as the preprocessor consumes it.
+// Pragmas don't reach the parser as tokens. HLSL only handles #pragma once,
+// mark and message, whose effects show up in the tokens or as diagnostics,
+// and ignores the rest; hashing them anyway keeps the key correct should a
+// pragma that changes code generation be handled later. The preprocessor
+// owns the callbacks, so they are detached once the key is finished.
+class HashPragmasCallbacks : public PPCallbacks {
+public:
+  HashPragmasCallbacks(SourceManager &SM, DxcCompileCacheKeyBuilder &key)
+      : m_SM(SM), m_pKey(&key) {}
+
+  void Detach() { m_pKey = nullptr; }
+
+  void PragmaDirective(SourceLocation Loc,
+                       PragmaIntroducerKind Introducer) override {
+    if (m_pKey == nullptr)
+      return;
+    SourceLocation ExpansionLoc = m_SM.getExpansionLoc(Loc);
+    bool Invalid = false;
+    StringRef Buffer =
+        m_SM.getBufferData(m_SM.getFileID(ExpansionLoc), &Invalid);
+    if (Invalid)
+      return;
+    const char *Begin = m_SM.getCharacterData(ExpansionLoc);
+    const char *End = Begin;
+    for (; End != Buffer.end(); ++End) {
+      if (*End != '\n')
+        continue;
+      // Stop at the first newline that isn't escaped.
+      const char *Last = End;
+      if (Last != Begin && Last[-1] == '\r')
+        --Last;
+      if (Last == Begin || Last[-1] != '\\')
+        break;
+    }
+    // Token kinds are small, so this can't be mistaken for a token.
+    const uint32_t PragmaMarker = 0xFFFFFFFF;
+    m_pKey->AddUInt32(PragmaMarker);
+    m_pKey->AddString(StringRef(Begin, End - Begin));
+  }
+
+private:
+  SourceManager &m_SM;
+  DxcCompileCacheKeyBuilder *m_pKey;
+};
+
+// Lexes the main file and adds what the parser will see of it to a key: the
+// kind, spelling and position of every token left after preprocessing, along
+// with the pragmas consumed on the way. Sources that only differ in macros
+// they don't use, or in how they spell the same expansion, add the same
+// values. The tokens, up to and including eof, are kept so that the parser
+// can take them without preprocessing the file again.
+static void LexAndHashPreprocessedTokens(Preprocessor &PP,
+                                         DxcCompileCacheKeyBuilder &key,
+                                         std::vector<Token> &tokens) {
+  SourceManager &SM = PP.getSourceManager();
+  std::unique_ptr<HashPragmasCallbacks> pCallbacks =
+      std::make_unique<HashPragmasCallbacks>(SM, key);
+  HashPragmasCallbacks *pPragmas = pCallbacks.get();
+  PP.addPPCallbacks(std::move(pCallbacks));
+
+  SmallString<64> SpellingBuffer;
+  const char *LastFilename = nullptr;
+  Token Tok;
+  PP.EnterMainSourceFile();
+  for (;;) {
+    PP.Lex(Tok);
+    tokens.push_back(Tok);
+    if (Tok.is(tok::eof))
+      break;
+    key.AddUInt32(Tok.getKind());
+    key.AddString(PP.getSpelling(Tok, SpellingBuffer));
+    // Positions end up in diagnostics, so they are part of the result.
+    PresumedLoc PLoc = SM.getPresumedLoc(SM.getExpansionLoc(Tok.getLocation()));
+    if (PLoc.isInvalid())
+      continue;
+    if (LastFilename == nullptr ||
+        strcmp(LastFilename, PLoc.getFilename()) != 0) {
+      LastFilename = PLoc.getFilename();
+      key.AddString(LastFilename);
+    }
+    key.AddUInt32(PLoc.getLine());
+    key.AddUInt32(PLoc.getColumn());
+  }
+  pPragmas->Detach();
+}
+
+class DxcCompiler : public IDxcCompiler, public IDxcCompilerBatch, public IDxcLangExtensions, public IDxcContainerEvent {
 private:
   DXC_MICROCOM_REF_FIELD(m_dwRef)
   DxcLangExtensionsHelper m_langExtensionsHelper;
@@ -1919,48 +2258,318 @@ private:
                                        &pErrorBlobWithEncoding));
       IFT(DxcOperationResult::CreateFromResultErrorStatus(nullptr, pErrorBlobWithEncoding.p, E_INVALIDARG, ppResult));
       finished = true;
+      return;
     }
     DXASSERT(!opts.HLSL2015, "else ReadDxcOpts didn't fail for non-isense");
     finished = false;
   }
-public:
-  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
-  DXC_LANGEXTENSIONS_HELPER_IMPL(m_langExtensionsHelper)
 
-  __override HRESULT STDMETHODCALLTYPE RegisterDxilContainerEventHandler(IDxcContainerEventsHandler *pHandler, UINT64 *pCookie) {
-    DXASSERT(m_pDxcContainerEventsHandler == nullptr, "else events handler is already registered");
-    *pCookie = 1; // Only one EventsHandler supported 
-    m_pDxcContainerEventsHandler = pHandler;
-    return S_OK;
-  };
-  __override HRESULT STDMETHODCALLTYPE UnRegisterDxilContainerEventHandler(UINT64 cookie) {
-    DXASSERT(m_pDxcContainerEventsHandler != nullptr, "else unregister should not have been called");
-    m_pDxcContainerEventsHandler.Release();
-    return S_OK;
+  // Results can only be reused if everything that affects them can be
+  // captured in the cache key; language extensions and container event
+  // handlers run arbitrary code, so they opt out of caching.
+  bool CanUseCompileCache(const hlsl::options::DxcOpts &opts) {
+    return opts.CompileCache && !opts.AstDump && !opts.OptDump &&
+           !opts.EmitTokenCache && !opts.SplitDebugInfo &&
+           m_pDxcContainerEventsHandler == nullptr &&
+           m_langExtensionsHelper.GetIntrinsicTables().empty() &&
+           m_langExtensionsHelper.GetSemanticDefines().empty() &&
+           m_langExtensionsHelper.GetDefines().empty();
+  }
+
+  // Digests the options that affect a compilation's result, for its cache
+  // keys. The cache options themselves don't, and defines are added to each
+  // key in its own way. This only reads opts, so jobs of a batch can share
+  // the result; Arg::getAsString would add to the shared argument list.
+  static std::string
+  ComputeCacheOptionsKey(const hlsl::options::DxcOpts &opts) {
+    DxcCompileCacheKeyBuilder key;
+    for (const llvm::opt::Arg *A : opts.Args) {
+      if (A->getOption().matches(hlsl::options::OPT_cache) ||
+          A->getOption().matches(hlsl::options::OPT_cache_dir) ||
+          A->getOption().matches(hlsl::options::OPT_cache_preprocessed) ||
+          A->getOption().matches(hlsl::options::OPT_D))
+        continue;
+      key.AddString(A->getSpelling());
+      key.AddUInt32(A->getNumValues());
+      for (const char *value : A->getValues())
+        key.AddString(value);
+    }
+    return key.Finish();
+  }
+
+  std::string ComputeCompileCacheKey(IDxcBlob *pUtf8Source,
+                                     const char *pUtf8SourceName,
+                                     LPCWSTR pEntryPoint,
+                                     LPCWSTR pTargetProfile,
+                                     const std::vector<std::string> &defines,
+                                     StringRef optionsKey,
+                                     const DxcCompileCache::ValidatorInfo &validator,
+                                     _In_opt_ IDxcBlob *pTokenCache) {
+    DxcCompileCacheKeyBuilder key;
+    key.AddString(StringRef((const char *)pUtf8Source->GetBufferPointer(),
+                            pUtf8Source->GetBufferSize()));
+    key.AddString(pUtf8SourceName);
+    key.AddWideString(pEntryPoint);
+    key.AddWideString(pTargetProfile);
+    key.AddUInt32((uint32_t)defines.size());
+    for (const std::string &define : defines)
+      key.AddString(define);
+    key.AddString(optionsKey);
+    key.AddUInt32(validator.MajorVer);
+    key.AddUInt32(validator.MinorVer);
+    key.AddUInt32(validator.Internal ? 1 : 0);
+    key.AddWideString(validator.Path.c_str());
+    // The token cache is loaded outside the file system, so it isn't among
+    // the recorded dependencies.
+    if (pTokenCache != nullptr)
+      key.AddBytes(pTokenCache->GetBufferPointer(),
+                   pTokenCache->GetBufferSize());
+    return key.Finish();
+  }
+
+  // Computes a key from the preprocessed tokens of the source for
+  // /cache-preprocessed, so that permutations which preprocess identically
+  // share a result. The source text, defines and include contents are all
+  // reflected in the tokens, so only the remaining options are added.
+  // compiler must have begun the source file; its tokens are left in tokens
+  // for the compilation to parse.
+  //
+  // Returns false if preprocessing reports any diagnostic, as a shared result
+  // would lose it; the caller falls back to keying on the source.
+  static bool ComputePreprocessedCacheKey(CompilerInstance &compiler,
+                                          LPCSTR pUtf8SourceName,
+                                          LPCWSTR pEntryPoint,
+                                          LPCWSTR pTargetProfile,
+                                          StringRef optionsKey,
+                                          const DxcCompileCache::ValidatorInfo &validator,
+                                          std::vector<Token> &tokens,
+                                          std::string &cacheKey) {
+    llvm::TimeTraceScope traceScope("Cache Key");
+    DxcCompileCacheKeyBuilder key;
+    // Keep these keys apart from source-keyed ones.
+    key.AddString("preprocessed");
+    key.AddString(pUtf8SourceName);
+    key.AddWideString(pEntryPoint);
+    key.AddWideString(pTargetProfile);
+    key.AddString(optionsKey);
+    key.AddUInt32(validator.MajorVer);
+    key.AddUInt32(validator.MinorVer);
+    key.AddUInt32(validator.Internal ? 1 : 0);
+    key.AddWideString(validator.Path.c_str());
+
+    const DiagnosticsEngine &diags = compiler.getDiagnostics();
+    unsigned warningsBefore = diags.getNumWarnings();
+    LexAndHashPreprocessedTokens(compiler.getPreprocessor(), key, tokens);
+    if (diags.hasErrorOccurred() || diags.getNumWarnings() != warningsBefore)
+      return false;
+    cacheKey = key.Finish();
+    return true;
   }
 
-  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
-    return DoBasicQueryInterface3<IDxcCompiler, IDxcLangExtensions, IDxcContainerEvent>(this, iid, ppvObject);
+  // Looks key up in the compile cache and, on a hit, creates the result from
+  // the cached entry. On a miss the key is claimed, so that compilations with
+  // the same key wait for this one rather than repeat its work, and the
+  // include handler answers read to check the entry are left in sources.
+  static bool TryGetCachedResult(const std::string &key,
+                                 const hlsl::options::DxcOpts &opts,
+                                 _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+                                 DxcCompileCacheSources &sources,
+                                 DxcCompileCacheClaim &claim,
+                                 _COM_Outptr_ IDxcOperationResult **ppResult) {
+    for (;;) {
+      CComPtr<IDxcBlob> pCachedBlob;
+      std::string cachedDiagnostics;
+      if (DxcCompileCache::Get().Lookup(key, opts.CacheDir, pIncludeHandler,
+                                        sources, &pCachedBlob,
+                                        cachedDiagnostics)) {
+        CComPtr<IDxcBlobEncoding> pCachedErrors;
+        IFT(DxcCreateBlobWithEncodingOnHeapCopy(cachedDiagnostics.c_str(),
+                                                cachedDiagnostics.size(),
+                                                CP_UTF8, &pCachedErrors));
+        IFT(DxcOperationResult::CreateFromResultErrorStatus(
+            pCachedBlob, pCachedErrors, S_OK, ppResult));
+        return true;
+      }
+      if (claim.Begin(key))
+        return false;
+    }
   }
 
-  // Compile a single entry point to the target shader model
-  __override HRESULT STDMETHODCALLTYPE Compile(
-    _In_ IDxcBlob *pSource,                       // Source text to compile
-    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
-    _In_ LPCWSTR pEntryPoint,                     // entry point name
-    _In_ LPCWSTR pTargetProfile,                  // shader profile to compile
-    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
-    _In_ UINT32 argCount,                         // Number of arguments
-    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
-    _In_ UINT32 defineCount,                      // Number of defines
-    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
-    _COM_Outptr_ IDxcOperationResult **ppResult   // Compiler output status, buffer, and errors
-    ) {
-    if (pSource == nullptr || ppResult == nullptr ||
-        (defineCount > 0 && pDefines == nullptr) ||
-        (argCount > 0 && pArguments == nullptr) || pEntryPoint == nullptr ||
-        pTargetProfile == nullptr)
-      return E_INVALIDARG;
+  // Loads the header token cache named by /token-cache through the include
+  // handler. Its contents are binary, so they are handed to the preprocessor
+  // directly rather than through the file system, which converts includes to
+  // UTF-8. If the handler has no such file, the preprocessor looks for it on
+  // the file system and reports the failure.
+  static void LoadTokenCache(const hlsl::options::DxcOpts &opts,
+                             _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+                             CComPtr<IDxcBlob> &pTokenCache) {
+    if (opts.TokenCache.empty() || pIncludeHandler == nullptr)
+      return;
+    std::wstring name =
+        Unicode::UTF8ToUTF16StringOrThrow(opts.TokenCache.str().c_str());
+    if (FAILED(pIncludeHandler->LoadSource(name.c_str(), &pTokenCache)))
+      pTokenCache.Release();
+  }
+
+  // Creates the validator, preferring the one in dxil.dll and falling back to
+  // the built-in one, and describes it: which one it is, the file it was
+  // loaded from and its version. This needs no compiler instance, so it can
+  // come before a compile cache lookup.
+  static void CreateValidator(dxc::DxcDllSupport &validatorDll, raw_ostream &w,
+                              CComPtr<IDxcValidator> &pValidator,
+                              DxcCompileCache::ValidatorInfo &info) {
+    info = DxcCompileCache::ValidatorInfo();
+    CreateValidatorForCompile(validatorDll, w, pValidator, info.Internal);
+    CComPtr<IDxcVersionInfo> pVersionInfo;
+    if (SUCCEEDED(pValidator.QueryInterface(&pVersionInfo)))
+      IFT(pVersionInfo->GetVersion(&info.MajorVer, &info.MinorVer));
+    if (!info.Internal) {
+      std::vector<wchar_t> path(MAX_PATH);
+      for (;;) {
+        DWORD len = GetModuleFileNameW(validatorDll.GetModule(), path.data(),
+                                       (DWORD)path.size());
+        if (len == 0)
+          IFT(HRESULT_FROM_WIN32(GetLastError()));
+        if (len < path.size()) {
+          info.Path.assign(path.data(), len);
+          break;
+        }
+        path.resize(path.size() * 2);
+      }
+    }
+  }
+
+  // Creates the validator as CreateValidator does, and records its version
+  // in the code generation options.
+  void SetupValidator(dxc::DxcDllSupport &validatorDll,
+                      CodeGenOptions &codeGenOpts, raw_ostream &w,
+                      CComPtr<IDxcValidator> &pValidator,
+                      bool &internalValidator) {
+    DxcCompileCache::ValidatorInfo info;
+    CreateValidator(validatorDll, w, pValidator, info);
+    internalValidator = info.Internal;
+    codeGenOpts.HLSLValidatorMajorVer = info.MajorVer;
+    codeGenOpts.HLSLValidatorMinorVer = info.MinorVer;
+  }
+
+  // Packages the module generated for an entry point into a container,
+  // validates it if pValidator is set and notifies the container events
+  // handler. Validation errors are reported through diags; the validation
+  // status is returned. With /Qsplit_debug, pDebugBlob receives the debug
+  // container split from the output.
+  HRESULT ProduceDxilContainer(DxilCompilerLLVMModuleOutput &llvmModule,
+                               const hlsl::options::DxcOpts &opts,
+                               _In_ IMalloc *pMalloc,
+                               _In_ AbstractMemoryStream *pModuleBitcode,
+                               _In_opt_ IDxcValidator *pValidator,
+                               bool internalValidator,
+                               DiagnosticsEngine &diags,
+                               CComPtr<IDxcBlob> &pOutputBlob,
+                               CComPtr<IDxcBlob> &pDebugBlob) {
+    HRESULT valHR = S_OK;
+
+    // If using the internal validator, we'll use the modules directly.
+    // In this case, we'll want to make a clone to avoid SerializeDxilContainerForModule
+    // stripping all the debug info. The debug info will be stripped from the orginal
+    // module, but preserved in the cloned module.
+    if (internalValidator && opts.DebugInfo)
+      llvmModule.CloneForDebugInfo();
+
+    // Do not create a container when there is only a a high-level representation in the module.
+    // Libraries are the exception: their high-level module is packaged for the linker.
+    if (opts.CompileLibrary) {
+      llvm::TimeTraceScope traceScope("Container");
+      llvmModule.WrapModuleInLibraryContainer(pMalloc, pModuleBitcode,
+                                              pOutputBlob);
+    }
+    else if (!opts.CodeGenHighLevel) {
+      llvm::TimeTraceScope traceScope("Container");
+      llvmModule.WrapModuleInDxilContainer(
+          pMalloc, pModuleBitcode, pOutputBlob,
+          opts.DebugInfo && opts.SplitDebugInfo, pDebugBlob);
+    }
+
+    if (pValidator != nullptr) {
+      llvm::TimeTraceScope traceScope("Validation");
+      // Important: in-place edit is required so the blob is reused and thus
+      // dxil.dll can be released.
+      CComPtr<IDxcOperationResult> pValResult;
+      if (internalValidator) {
+        IFT(RunInternalValidator(
+          pValidator, llvmModule.get(), llvmModule.getWithDebugInfo(), pOutputBlob,
+          DxcValidatorFlags_InPlaceEdit, &pValResult));
+      }
+      else {
+        IFT(pValidator->Validate(
+          pOutputBlob, DxcValidatorFlags_InPlaceEdit, &pValResult));
+      }
+      IFT(pValResult->GetStatus(&valHR));
+      if (FAILED(valHR)) {
+        CComPtr<IDxcBlobEncoding> pErrors;
+        CComPtr<IDxcBlobEncoding> pErrorsUtf8;
+        IFT(pValResult->GetErrorBuffer(&pErrors));
+        IFT(hlsl::DxcGetBlobAsUtf8(pErrors, &pErrorsUtf8));
+        StringRef errRef((const char *)pErrorsUtf8->GetBufferPointer(),
+          pErrorsUtf8->GetBufferSize());
+        unsigned DiagID = diags.getCustomDiagID(DiagnosticsEngine::Error,
+          "validation errors\r\n%0");
+        diags.Report(DiagID) << errRef;
+      }
+      CComPtr<IDxcBlob> pValidatedBlob;
+      IFT(pValResult->GetResult(&pValidatedBlob));
+      if (pValidatedBlob != nullptr) {
+        std::swap(pOutputBlob, pValidatedBlob);
+      }
+    }
+    // Callback after valid DXIL is produced
+    if (SUCCEEDED(valHR)) {
+      CComPtr<IDxcBlob> pTargetBlob;
+      if (m_pDxcContainerEventsHandler != nullptr) {
+        HRESULT hr = m_pDxcContainerEventsHandler->OnDxilContainerBuilt(pOutputBlob, &pTargetBlob);
+        if (SUCCEEDED(hr) && pTargetBlob != nullptr) {
+          std::swap(pOutputBlob, pTargetBlob);
+        }
+      }
+    }
+    // Compress last: the external validator and the events handler expect
+    // raw parts, and the hash they produced is carried over unchanged.
+    if (SUCCEEDED(valHR) && opts.CompressParts) {
+      llvm::TimeTraceScope traceScope("Compression");
+      CompressContainerBlob(pMalloc, pOutputBlob);
+      CompressContainerBlob(pMalloc, pDebugBlob);
+    }
+    return valHR;
+  }
+
+  static void CompressContainerBlob(_In_ IMalloc *pMalloc,
+                                    CComPtr<IDxcBlob> &pBlob) {
+    if (pBlob == nullptr)
+      return;
+    const DxilContainerHeader *pHeader =
+        IsDxilContainerLike(pBlob->GetBufferPointer(), pBlob->GetBufferSize());
+    if (!pHeader || !IsValidDxilContainer(pHeader, pBlob->GetBufferSize()))
+      return;
+    CComPtr<AbstractMemoryStream> pCompressedStream;
+    IFT(CreateMemoryStream(pMalloc, &pCompressedStream));
+    CompressDxilContainer(pHeader, pCompressedStream);
+    pBlob.Release();
+    IFT(pCompressedStream.QueryInterface(&pBlob));
+  }
+
+  // Compiles a single entry point. pSharedOpts, pSharedCacheOptionsKey and
+  // pSharedValidatorDll are provided when the options have already been
+  // parsed and dxil.dll already loaded on behalf of several compilations;
+  // otherwise they are set up here.
+  HRESULT CompileWithOpts(
+    _In_ IDxcBlob *pSource, _In_opt_ LPCWSTR pSourceName,
+    _In_ LPCWSTR pEntryPoint, _In_ LPCWSTR pTargetProfile,
+    _In_count_(argCount) LPCWSTR *pArguments, _In_ UINT32 argCount,
+    _In_count_(defineCount) const DxcDefine *pDefines, _In_ UINT32 defineCount,
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+    _In_opt_ const hlsl::options::DxcOpts *pSharedOpts,
+    _In_opt_ const std::string *pSharedCacheOptionsKey,
+    _In_opt_ dxc::DxcDllSupport *pSharedValidatorDll,
+    _COM_Outptr_ IDxcOperationResult **ppResult) {
     *ppResult = nullptr;
 
     HRESULT hr = S_OK;
@@ -1972,6 +2581,7 @@ public:
       CComPtr<IMalloc> pMalloc;
       CComPtr<AbstractMemoryStream> pOutputStream;
       CComPtr<IDxcBlob> pOutputBlob;
+      CComPtr<IDxcBlob> pDebugBlob;
       DxcArgsFileSystem *msfPtr;
       IFT(CreateDxcArgsFileSystem(utf8Source, pSourceName, pIncludeHandler, &msfPtr));
       std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
@@ -1986,13 +2596,16 @@ public:
       int argCountInt;
       IFT(UIntToInt(argCount, &argCountInt));
       hlsl::options::MainArgs mainArgs(argCountInt, pArguments, 0);
-      hlsl::options::DxcOpts opts;
-      bool finished;
-      ReadOptsAndValidate(mainArgs, opts, pOutputStream, ppResult, finished);
-      if (finished) {
-        hr = S_OK;
-        goto Cleanup;
+      hlsl::options::DxcOpts localOpts;
+      if (pSharedOpts == nullptr) {
+        bool finished;
+        ReadOptsAndValidate(mainArgs, localOpts, pOutputStream, ppResult, finished);
+        if (finished) {
+          hr = S_OK;
+          goto Cleanup;
+        }
       }
+      const hlsl::options::DxcOpts &opts = pSharedOpts ? *pSharedOpts : localOpts;
       if (opts.DisplayIncludeProcess)
         msfPtr->EnableDisplayIncludeProcess();
 
@@ -2010,27 +2623,85 @@ public:
         }
       }
 
+      // Record the time spent in each phase when a trace is requested; the
+      // outermost interval covers the whole compilation.
+      std::unique_ptr<llvm::TimeTraceProfiler> pProfiler;
+      if (!opts.TimeTrace.empty()) {
+        pProfiler.reset(new llvm::TimeTraceProfiler());
+        pProfiler->begin("Compile", std::string(pUtf8EntryPoint.m_psz) + " " +
+                                        pUtf8TargetProfile.m_psz);
+      }
+      llvm::TimeTraceProfilerActivation profilerActivation(pProfiler.get());
+
       IFT(msfPtr->RegisterOutputStream(L"output.bc", pOutputStream));
       IFT(msfPtr->CreateStdStreams(pMalloc));
 
-      StringRef Data((LPSTR)utf8Source->GetBufferPointer(),
-                     utf8Source->GetBufferSize());
-      std::unique_ptr<llvm::MemoryBuffer> pBuffer(
-          llvm::MemoryBuffer::getMemBufferCopy(Data, pUtf8SourceName));
-
       // Not very efficient but also not very important.
       std::vector<std::string> defines;
       CreateDefineStrings(pDefines, defineCount, defines);
       CreateDefineStrings(opts.Defines.data(), opts.Defines.size(), defines);
 
-      // Setup a compiler instance.
+      CComPtr<IDxcBlob> pTokenCache;
+      LoadTokenCache(opts, pIncludeHandler, pTokenCache);
+
+      // NOTE: this calls the validation component from dxil.dll; the built-in
+      // validator can be used as a fallback.
+      bool needsValidation = !opts.CodeGenHighLevel && !opts.CompileLibrary &&
+                             !opts.DisableValidation;
+
+      // The validator a result is validated with is part of its cache key,
+      // so it is set up before looking for one.
       std::string warnings;
       raw_string_ostream w(warnings);
+      bool internalValidator = false;
+      dxc::DxcDllSupport localValidatorDll;
+      CComPtr<IDxcValidator> pValidator;
+      DxcCompileCache::ValidatorInfo validator;
+      if (needsValidation) {
+        if (pSharedValidatorDll == nullptr) {
+          localValidatorDll.InitializeForDll(L"dxil.dll", "DxcCreateInstance");
+          pSharedValidatorDll = &localValidatorDll;
+        }
+        CreateValidator(*pSharedValidatorDll, w, pValidator, validator);
+        internalValidator = validator.Internal;
+      }
+
+      // Look for a cached result before setting up the compiler. Keys on
+      // preprocessed tokens need the compiler, so they are computed once the
+      // source file has begun, below. Debug information records the source
+      // and defines, so it can't be shared between permutations. Include
+      // handler answers read on a miss are handed to the file system, so the
+      // compilation doesn't ask for them again.
+      std::string cacheKey;
+      bool useCompileCache = CanUseCompileCache(opts);
+      bool keyOnTokens = useCompileCache && opts.CachePreprocessed &&
+                         !opts.DebugInfo;
+      bool keyedOnTokens = false;
+      std::string cacheOptionsKey;
+      if (useCompileCache)
+        cacheOptionsKey = pSharedCacheOptionsKey ? *pSharedCacheOptionsKey
+                                                 : ComputeCacheOptionsKey(opts);
+      DxcCompileCacheSources cacheSources;
+      DxcCompileCacheClaim cacheClaim;
+      if (useCompileCache && !keyOnTokens) {
+        cacheKey = ComputeCompileCacheKey(
+            utf8Source, pUtf8SourceName, pEntryPoint, pTargetProfile, defines,
+            cacheOptionsKey, validator, pTokenCache);
+        if (TryGetCachedResult(cacheKey, opts, pIncludeHandler, cacheSources,
+                               cacheClaim, ppResult)) {
+          FinishTrace(pProfiler.get(), ppResult);
+          hr = S_OK;
+          goto Cleanup;
+        }
+        msfPtr->SetPreloadedSources(std::move(cacheSources));
+      }
+
+      // Setup a compiler instance.
       raw_stream_ostream outStream(pOutputStream.p);
       CompilerInstance compiler;
       std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
           std::make_unique<TextDiagnosticPrinter>(w, &compiler.getDiagnosticOpts());
-      SetupCompilerForCompile(compiler, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), defines, opts, pArguments, argCount);
+      SetupCompilerForCompile(compiler, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), defines, opts, pArguments, argCount, pTokenCache);
       msfPtr->SetupForCompilerInstance(compiler);
 
       // The clang entry point (cc1_main) would now create a compiler invocation
@@ -2047,33 +2718,8 @@ public:
 
       compiler.getCodeGenOpts().HLSLEntryFunction = pUtf8EntryPoint.m_psz;
       compiler.getCodeGenOpts().HLSLProfile = pUtf8TargetProfile.m_psz;
-
-      // NOTE: this calls the validation component from dxil.dll; the built-in
-      // validator can be used as a fallback.
-      bool needsValidation = !opts.CodeGenHighLevel && !opts.DisableValidation;
-      bool internalValidator = false;
-      dxc::DxcDllSupport lib;
-      CComPtr<IDxcValidator> pValidator;
-      CComPtr<IDxcOperationResult> pValResult;
-      if (needsValidation) {
-        if (SUCCEEDED(lib.InitializeForDll(L"dxil.dll", "DxcCreateInstance"))) {
-          // If the DLL is found but doesn't work, warn.
-          if (FAILED(lib.CreateInstance(CLSID_DxcValidator, &pValidator))) {
-            w << "Unable to create validator from dxil.dll, fallback to built-in.";
-          }
-        }
-        if (pValidator == nullptr) {
-          IFT(CreateDxcValidator(IID_PPV_ARGS(&pValidator)));
-          internalValidator = true;
-        }
-        CComPtr<IDxcVersionInfo> pVersionInfo;
-        if (SUCCEEDED(pValidator.QueryInterface(&pVersionInfo))) {
-          UINT32 majorVer, minorVer;
-          IFT(pVersionInfo->GetVersion(&majorVer, &minorVer));
-          compiler.getCodeGenOpts().HLSLValidatorMajorVer = majorVer;
-          compiler.getCodeGenOpts().HLSLValidatorMinorVer = minorVer;
-        }
-      }
+      compiler.getCodeGenOpts().HLSLValidatorMajorVer = validator.MajorVer;
+      compiler.getCodeGenOpts().HLSLValidatorMinorVer = validator.MinorVer;
 
       if (opts.AstDump) {
         clang::ASTDumpAction dumpAction;
@@ -2094,11 +2740,44 @@ public:
         action.EndSourceFile();
         outStream.flush();
       }
+      else if (opts.EmitTokenCache) {
+        EmitTokenCacheAction action;
+        FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
+        action.BeginSourceFile(compiler, file);
+        action.Execute();
+        action.EndSourceFile();
+        outStream.write(action.TokenCache.data(), action.TokenCache.size());
+        outStream.flush();
+      }
       else {
         llvm::LLVMContext llvmContext;
         EmitBCAction action(&llvmContext);
         FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
         action.BeginSourceFile(compiler, file);
+        // A token key preprocesses the whole source; on a miss, the parser
+        // takes the same tokens rather than preprocessing it again.
+        std::vector<Token> preprocessedTokens;
+        if (keyOnTokens) {
+          if (compiler.hasPreprocessor())
+            keyedOnTokens = ComputePreprocessedCacheKey(
+                compiler, utf8SourceName, pEntryPoint, pTargetProfile,
+                cacheOptionsKey, validator, preprocessedTokens, cacheKey);
+          if (!keyedOnTokens)
+            cacheKey = ComputeCompileCacheKey(
+                utf8Source, pUtf8SourceName, pEntryPoint, pTargetProfile,
+                defines, cacheOptionsKey, validator, pTokenCache);
+          if (TryGetCachedResult(cacheKey, opts, pIncludeHandler,
+                                 cacheSources, cacheClaim, ppResult)) {
+            action.EndSourceFile();
+            FinishTrace(pProfiler.get(), ppResult);
+            hr = S_OK;
+            goto Cleanup;
+          }
+          if (!preprocessedTokens.empty())
+            compiler.getPreprocessor().EnterTokenStream(
+                preprocessedTokens.data(), preprocessedTokens.size(),
+                /*DisableMacroExpansion*/ true, /*OwnsTokens*/ false);
+        }
         action.Execute();
         action.EndSourceFile();
         outStream.flush();
@@ -2106,64 +2785,14 @@ public:
         // Don't do work to put in a container if an error has occurred
         bool compileOK = !compiler.getDiagnostics().hasErrorOccurred();
         if (compileOK) {
-          HRESULT valHR = S_OK;
-
           // Take ownership of the module from the action.
           DxilCompilerLLVMModuleOutput llvmModule(action.takeModule());
-
-          // If using the internal validator, we'll use the modules directly.
-          // In this case, we'll want to make a clone to avoid SerializeDxilContainerForModule
-          // stripping all the debug info. The debug info will be stripped from the orginal
-          // module, but preserved in the cloned module.
-          if (internalValidator && opts.DebugInfo)
-            llvmModule.CloneForDebugInfo();
-
-          // Do not create a container when there is only a a high-level representation in the module.
-          if (!opts.CodeGenHighLevel)
-            llvmModule.WrapModuleInDxilContainer(pMalloc, pOutputStream, pOutputBlob);
-
-          if (needsValidation) {
-            // Important: in-place edit is required so the blob is reused and thus
-            // dxil.dll can be released.
-            if (internalValidator) {
-              IFT(RunInternalValidator(
-                pValidator, llvmModule.get(), llvmModule.getWithDebugInfo(), pOutputBlob,
-                DxcValidatorFlags_InPlaceEdit, &pValResult));
-            }
-            else {
-              IFT(pValidator->Validate(
-                pOutputBlob, DxcValidatorFlags_InPlaceEdit, &pValResult));
-            }
-            IFT(pValResult->GetStatus(&valHR));
-            if (FAILED(valHR)) {
-              CComPtr<IDxcBlobEncoding> pErrors;
-              CComPtr<IDxcBlobEncoding> pErrorsUtf8;
-              IFT(pValResult->GetErrorBuffer(&pErrors));
-              IFT(hlsl::DxcGetBlobAsUtf8(pErrors, &pErrorsUtf8));
-              StringRef errRef((const char *)pErrorsUtf8->GetBufferPointer(),
-                pErrorsUtf8->GetBufferSize());
-              DiagnosticsEngine &D = compiler.getDiagnostics();
-              unsigned DiagID = D.getCustomDiagID(DiagnosticsEngine::Error,
-                "validation errors\r\n%0");
-              D.Report(DiagID) << errRef;
-            }
-            CComPtr<IDxcBlob> pValidatedBlob;
-            IFT(pValResult->GetResult(&pValidatedBlob));
-            if (pValidatedBlob != nullptr) {
-              std::swap(pOutputBlob, pValidatedBlob);
-            }
-            pValidator.Release();
-          }
-          // Callback after valid DXIL is produced
-          if (SUCCEEDED(valHR)) {
-            CComPtr<IDxcBlob> pTargetBlob;
-            if (m_pDxcContainerEventsHandler != nullptr) {
-              HRESULT hr = m_pDxcContainerEventsHandler->OnDxilContainerBuilt(pOutputBlob, &pTargetBlob);
-              if (SUCCEEDED(hr) && pTargetBlob != nullptr) {
-                std::swap(pOutputBlob, pTargetBlob);
-              }
-            }
-          }
+          ProduceDxilContainer(llvmModule, opts, pMalloc, pOutputStream,
+                               pValidator, internalValidator,
+                               compiler.getDiagnostics(), pOutputBlob,
+                               pDebugBlob);
+          // Important: release the validator so dxil.dll can be unloaded.
+          pValidator.Release();
         }
       }
 
@@ -2172,10 +2801,418 @@ public:
 
       CreateOperationResultFromOutputs(pOutputBlob, msfPtr, warnings,
                                        compiler.getDiagnostics(), ppResult);
+      AttachDebugInfoToResult(pDebugBlob, ppResult);
+
+      if (useCompileCache && !compiler.getDiagnostics().hasErrorOccurred()) {
+        CComPtr<IDxcBlobEncoding> pErrors;
+        IFT((*ppResult)->GetErrorBuffer(&pErrors));
+        StringRef diagnostics;
+        if (pErrors != nullptr)
+          diagnostics = StringRef((const char *)pErrors->GetBufferPointer(),
+                                  pErrors->GetBufferSize());
+        // Included contents are already part of a token key. Diagnostics
+        // aren't: their notes and source excerpts can name macros and quote
+        // lines that differ between permutations with the same tokens, so
+        // only results without any are shared that way.
+        std::vector<DxcCompileCacheDependency> dependencies;
+        if (!keyedOnTokens)
+          msfPtr->GetIncludeDependencies(dependencies);
+        if (!keyedOnTokens || diagnostics.empty())
+          DxcCompileCache::Get().Store(cacheKey, opts.CacheDir, pOutputBlob,
+                                       diagnostics, std::move(dependencies));
+      }
+      FinishTrace(pProfiler.get(), ppResult);
+      hr = S_OK;
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+  Cleanup:
+    DxcEtw_DXCompilerCompile_Stop(hr);
+    return hr;
+  }
+
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  DXC_LANGEXTENSIONS_HELPER_IMPL(m_langExtensionsHelper)
+
+  __override HRESULT STDMETHODCALLTYPE RegisterDxilContainerEventHandler(IDxcContainerEventsHandler *pHandler, UINT64 *pCookie) {
+    DXASSERT(m_pDxcContainerEventsHandler == nullptr, "else events handler is already registered");
+    *pCookie = 1; // Only one EventsHandler supported 
+    m_pDxcContainerEventsHandler = pHandler;
+    return S_OK;
+  };
+  __override HRESULT STDMETHODCALLTYPE UnRegisterDxilContainerEventHandler(UINT64 cookie) {
+    DXASSERT(m_pDxcContainerEventsHandler != nullptr, "else unregister should not have been called");
+    m_pDxcContainerEventsHandler.Release();
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
+    return DoBasicQueryInterface4<IDxcCompiler, IDxcLangExtensions, IDxcContainerEvent, IDxcCompilerBatch>(this, iid, ppvObject);
+  }
+
+  // Compile a single entry point to the target shader model
+  __override HRESULT STDMETHODCALLTYPE Compile(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // entry point name
+    _In_ LPCWSTR pTargetProfile,                  // shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _COM_Outptr_ IDxcOperationResult **ppResult   // Compiler output status, buffer, and errors
+    ) {
+    if (pSource == nullptr || ppResult == nullptr ||
+        (defineCount > 0 && pDefines == nullptr) ||
+        (argCount > 0 && pArguments == nullptr) || pEntryPoint == nullptr ||
+        pTargetProfile == nullptr)
+      return E_INVALIDARG;
+    return CompileWithOpts(pSource, pSourceName, pEntryPoint, pTargetProfile,
+                           pArguments, argCount, pDefines, defineCount,
+                           pIncludeHandler, nullptr, nullptr, nullptr,
+                           ppResult);
+  }
+
+  // Compile a number of entry points concurrently
+  __override HRESULT STDMETHODCALLTYPE CompileBatch(
+    _In_count_(jobCount) const DxcCompileJob *pJobs, // Jobs to compile
+    _In_ UINT32 jobCount,                            // Number of jobs
+    _In_count_(argCount) LPCWSTR *pArguments,        // Array of pointers to arguments, shared by all jobs
+    _In_ UINT32 argCount,                            // Number of arguments
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,    // user-provided interface to handle #include directives (optional)
+    _Out_writes_(jobCount) IDxcOperationResult **ppResults // One compiler output per job
+    ) {
+    if (ppResults == nullptr || (jobCount > 0 && pJobs == nullptr) ||
+        (argCount > 0 && pArguments == nullptr))
+      return E_INVALIDARG;
+    for (UINT32 i = 0; i < jobCount; ++i) {
+      const DxcCompileJob &job = pJobs[i];
+      if (job.pSource == nullptr || job.pEntryPoint == nullptr ||
+          job.pTargetProfile == nullptr ||
+          (job.defineCount > 0 && job.pDefines == nullptr))
+        return E_INVALIDARG;
+      ppResults[i] = nullptr;
+    }
+
+    HRESULT hr = S_OK;
+    try {
+      // Options are parsed once and shared, read-only, by all jobs.
+      CComPtr<IMalloc> pMalloc;
+      CComPtr<AbstractMemoryStream> pOutputStream;
+      IFT(CoGetMalloc(1, &pMalloc));
+      IFT(CreateMemoryStream(pMalloc, &pOutputStream));
+      int argCountInt;
+      IFT(UIntToInt(argCount, &argCountInt));
+      hlsl::options::MainArgs mainArgs(argCountInt, pArguments, 0);
+      hlsl::options::DxcOpts opts;
+      CComPtr<IDxcOperationResult> pOptsResult;
+      bool finished;
+      ReadOptsAndValidate(mainArgs, opts, pOutputStream, &pOptsResult, finished);
+      if (finished) {
+        for (UINT32 i = 0; i < jobCount; ++i) {
+          ppResults[i] = pOptsResult;
+          ppResults[i]->AddRef();
+        }
+        return S_OK;
+      }
+
+      // Arguments can't be rendered concurrently, so the part of the cache
+      // key they contribute is computed once for all jobs.
+      std::string cacheOptionsKey;
+      if (CanUseCompileCache(opts))
+        cacheOptionsKey = ComputeCacheOptionsKey(opts);
+
+      // Load dxil.dll once; if it isn't available, each job falls back to
+      // the built-in validator.
+      dxc::DxcDllSupport validatorDll;
+      validatorDll.InitializeForDll(L"dxil.dll", "DxcCreateInstance");
+
+      // Jobs share an include cache, so each file is loaded and converted to
+      // UTF-8 once, and calls into the caller's handler are serialized as it
+      // need not be thread-safe.
+      CComPtr<IDxcIncludeHandler> pBatchIncludeHandler;
+      CComPtr<IDxcIncludeCache> pIncludeCache;
+      if (pIncludeHandler != nullptr &&
+          FAILED(pIncludeHandler->QueryInterface(&pIncludeCache))) {
+        IFT(CreateDxcIncludeCache(IID_PPV_ARGS(&pIncludeCache)));
+        IFT(pIncludeCache->SetIncludeHandler(pIncludeHandler));
+      }
+      if (pIncludeCache != nullptr)
+        IFT(pIncludeCache.QueryInterface(&pBatchIncludeHandler));
+
+      std::atomic<UINT32> nextJob(0);
+      auto worker = [&]() {
+        for (UINT32 i = nextJob++; i < jobCount; i = nextJob++) {
+          const DxcCompileJob &job = pJobs[i];
+          HRESULT jobHR = CompileWithOpts(
+              job.pSource, job.pSourceName, job.pEntryPoint,
+              job.pTargetProfile, pArguments, argCount, job.pDefines,
+              job.defineCount, pBatchIncludeHandler, &opts, &cacheOptionsKey,
+              &validatorDll, &ppResults[i]);
+          if (FAILED(jobHR)) {
+            // Report the failure through the job's result; if even that
+            // can't be allocated, the whole batch fails below.
+            DxcOperationResult::CreateFromResultErrorStatus(nullptr, nullptr,
+                                                            jobHR, &ppResults[i]);
+          }
+        }
+      };
+
+      // The calling thread works on jobs too.
+      unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+      threadCount = std::min<unsigned>(threadCount, jobCount);
+      std::vector<std::thread> threads;
+      try {
+        for (unsigned i = 1; i < threadCount; ++i)
+          threads.emplace_back(worker);
+      }
+      catch (const std::system_error &) {
+        // Continue with the threads that could be started.
+      }
+      worker();
+      for (std::thread &t : threads)
+        t.join();
+
+      for (UINT32 i = 0; i < jobCount; ++i) {
+        if (ppResults[i] == nullptr)
+          throw std::bad_alloc();
+      }
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+
+    if (FAILED(hr)) {
+      for (UINT32 i = 0; i < jobCount; ++i) {
+        if (ppResults[i] != nullptr) {
+          ppResults[i]->Release();
+          ppResults[i] = nullptr;
+        }
+      }
+    }
+    return hr;
+  }
+
+  // Compile several entry points of the same source, parsing it only once
+  __override HRESULT STDMETHODCALLTYPE CompileEntryPoints(
+    _In_ IDxcBlob *pSource,                          // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                    // Optional file name for pSource. Used in errors and include handlers.
+    _In_count_(entryCount) LPCWSTR *pEntryPoints,    // entry point names
+    _In_count_(entryCount) LPCWSTR *pTargetProfiles, // shader profile to compile each entry point to
+    _In_ UINT32 entryCount,                          // Number of entry points
+    _In_count_(argCount) LPCWSTR *pArguments,        // Array of pointers to arguments
+    _In_ UINT32 argCount,                            // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines, // Array of defines
+    _In_ UINT32 defineCount,                         // Number of defines
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,    // user-provided interface to handle #include directives (optional)
+    _Out_writes_(entryCount) IDxcOperationResult **ppResults // One compiler output per entry point
+    ) {
+    if (pSource == nullptr || ppResults == nullptr ||
+        (entryCount > 0 &&
+         (pEntryPoints == nullptr || pTargetProfiles == nullptr)) ||
+        (defineCount > 0 && pDefines == nullptr) ||
+        (argCount > 0 && pArguments == nullptr))
+      return E_INVALIDARG;
+    for (UINT32 i = 0; i < entryCount; ++i) {
+      if (pEntryPoints[i] == nullptr || pTargetProfiles[i] == nullptr)
+        return E_INVALIDARG;
+      ppResults[i] = nullptr;
+    }
+    if (entryCount == 0)
+      return S_OK;
+
+    HRESULT hr = S_OK;
+    CComPtr<IDxcBlobEncoding> utf8Source;
+    // Entry points that couldn't be generated because an earlier one failed.
+    std::vector<UINT32> retryEntries;
+    DxcEtw_DXCompilerCompile_Start();
+    IFC(hlsl::DxcGetBlobAsUtf8(pSource, &utf8Source));
+
+    try {
+      CComPtr<IMalloc> pMalloc;
+      CComPtr<AbstractMemoryStream> pOutputStream;
+      CComPtr<IDxcBlob> pEmptyBlob;
+      DxcArgsFileSystem *msfPtr;
+      IFT(CreateDxcArgsFileSystem(utf8Source, pSourceName, pIncludeHandler, &msfPtr));
+      std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+      ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+      IFTLLVM(pts.error_code());
+
+      IFT(CoGetMalloc(1, &pMalloc));
+      IFT(CreateMemoryStream(pMalloc, &pOutputStream));
+      IFT(pOutputStream.QueryInterface(&pEmptyBlob));
+
+      int argCountInt;
+      IFT(UIntToInt(argCount, &argCountInt));
+      hlsl::options::MainArgs mainArgs(argCountInt, pArguments, 0);
+      hlsl::options::DxcOpts opts;
+      CComPtr<IDxcOperationResult> pOptsResult;
+      bool finished;
+      ReadOptsAndValidate(mainArgs, opts, pOutputStream, &pOptsResult, finished);
+      if (finished) {
+        for (UINT32 i = 0; i < entryCount; ++i) {
+          ppResults[i] = pOptsResult;
+          ppResults[i]->AddRef();
+        }
+        hr = S_OK;
+        goto Cleanup;
+      }
+      // Dumps are produced for a single entry point only.
+      if (opts.AstDump || opts.OptDump || opts.EmitTokenCache)
+        throw hlsl::Exception(E_INVALIDARG);
+      if (opts.DisplayIncludeProcess)
+        msfPtr->EnableDisplayIncludeProcess();
+
+      CW2A utf8SourceName(pSourceName, CP_UTF8);
+      IFT(msfPtr->CreateStdStreams(pMalloc));
+
+      // All entry points share the parse, so they share a single trace.
+      std::unique_ptr<llvm::TimeTraceProfiler> pProfiler;
+      if (!opts.TimeTrace.empty()) {
+        pProfiler.reset(new llvm::TimeTraceProfiler());
+        pProfiler->begin("Compile", utf8SourceName.m_psz ? utf8SourceName.m_psz : "");
+      }
+      llvm::TimeTraceProfilerActivation profilerActivation(pProfiler.get());
+
+      std::vector<std::string> defines;
+      CreateDefineStrings(pDefines, defineCount, defines);
+      CreateDefineStrings(opts.Defines.data(), opts.Defines.size(), defines);
+
+      CComPtr<IDxcBlob> pTokenCache;
+      LoadTokenCache(opts, pIncludeHandler, pTokenCache);
+
+      // Setup a compiler instance; the first entry point stands in for all
+      // of them in the shared options.
+      std::string warnings;
+      raw_string_ostream w(warnings);
+      CompilerInstance compiler;
+      std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
+          std::make_unique<TextDiagnosticPrinter>(w, &compiler.getDiagnosticOpts());
+      SetupCompilerForCompile(compiler, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), defines, opts, pArguments, argCount, pTokenCache);
+      msfPtr->SetupForCompilerInstance(compiler);
+      compiler.getCodeGenOpts().HLSLEntryFunction = CW2A(pEntryPoints[0], CP_UTF8).m_psz;
+      compiler.getCodeGenOpts().HLSLProfile = CW2A(pTargetProfiles[0], CP_UTF8).m_psz;
+
+      bool needsValidation = !opts.CodeGenHighLevel && !opts.CompileLibrary &&
+                             !opts.DisableValidation;
+      bool internalValidator = false;
+      dxc::DxcDllSupport validatorDll;
+      CComPtr<IDxcValidator> pValidator;
+      if (needsValidation) {
+        validatorDll.InitializeForDll(L"dxil.dll", "DxcCreateInstance");
+        SetupValidator(validatorDll, compiler.getCodeGenOpts(), w, pValidator,
+                       internalValidator);
+      }
+
+      // Each entry point gets its own code generation options, bitcode and
+      // diagnostics; only those of the shared parse go to every result.
+      std::vector<EmitBCForEntryPointsAction::EntryPoint> entryPoints(entryCount);
+      std::vector<SmallVector<char, 0>> bitcode(entryCount);
+      std::vector<std::unique_ptr<raw_svector_ostream>> bitcodeStreams;
+      std::vector<std::string> entryDiagnostics(entryCount);
+      std::vector<std::unique_ptr<raw_string_ostream>> entryDiagStreams;
+      std::vector<std::unique_ptr<TextDiagnosticPrinter>> entryDiagPrinters;
+      for (UINT32 i = 0; i < entryCount; ++i) {
+        EmitBCForEntryPointsAction::EntryPoint &entry = entryPoints[i];
+        entry.CodeGenOpts = compiler.getCodeGenOpts();
+        entry.CodeGenOpts.HLSLEntryFunction = CW2A(pEntryPoints[i], CP_UTF8).m_psz;
+        entry.CodeGenOpts.HLSLProfile = CW2A(pTargetProfiles[i], CP_UTF8).m_psz;
+        bitcodeStreams.emplace_back(new raw_svector_ostream(bitcode[i]));
+        entry.OS = bitcodeStreams.back().get();
+        entryDiagStreams.emplace_back(new raw_string_ostream(entryDiagnostics[i]));
+        entryDiagPrinters.emplace_back(new TextDiagnosticPrinter(
+            *entryDiagStreams.back(), &compiler.getDiagnosticOpts()));
+        entry.DiagClient = entryDiagPrinters.back().get();
+      }
+
+      llvm::LLVMContext llvmContext;
+      EmitBCForEntryPointsAction action(llvmContext, entryPoints);
+      FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
+      action.BeginSourceFile(compiler, file);
+      action.Execute();
+      action.EndSourceFile();
+
+      std::vector<CComPtr<IDxcBlob>> outputBlobs(entryCount);
+      std::vector<CComPtr<IDxcBlob>> debugBlobs(entryCount);
+      std::vector<HRESULT> statuses(entryCount, E_FAIL);
+      bool earlierEntryFailed = false;
+      for (UINT32 i = 0; i < entryCount; ++i) {
+        EmitBCForEntryPointsAction::EntryPoint &entry = entryPoints[i];
+        outputBlobs[i] = pEmptyBlob;
+        if (entry.Module != nullptr && !entry.HasErrors) {
+          bitcodeStreams[i]->flush();
+          CComPtr<AbstractMemoryStream> pBitcodeStream;
+          ULONG cbWritten;
+          IFT(CreateMemoryStream(pMalloc, &pBitcodeStream));
+          IFT(pBitcodeStream->Write(bitcode[i].data(), bitcode[i].size(),
+                                    &cbWritten));
+          outputBlobs[i].Release();
+          IFT(pBitcodeStream.QueryInterface(&outputBlobs[i]));
+          DxilCompilerLLVMModuleOutput llvmModule(std::move(entry.Module));
+          // Validation errors belong to this entry point alone.
+          DiagnosticsEngine &diags = compiler.getDiagnostics();
+          diags.setClient(entry.DiagClient, /*ShouldOwnClient*/ false);
+          statuses[i] = ProduceDxilContainer(
+              llvmModule, opts, pMalloc, pBitcodeStream, pValidator,
+              internalValidator, diags, outputBlobs[i], debugBlobs[i]);
+          diags.setClient(diagPrinter.get(), /*ShouldOwnClient*/ false);
+        }
+        else if (!entry.HasErrors && earlierEntryFailed) {
+          retryEntries.push_back(i);
+        }
+        if (entry.HasErrors)
+          earlierEntryFailed = true;
+      }
+      // Important: release the validator so dxil.dll can be unloaded.
+      pValidator.Release();
+
+      // Add std err to warnings.
+      msfPtr->WriteStdErrToStream(w);
+      w.flush();
+
+      for (UINT32 i = 0; i < entryCount; ++i) {
+        if (std::find(retryEntries.begin(), retryEntries.end(), i) !=
+            retryEntries.end())
+          continue;
+        entryDiagStreams[i]->flush();
+        CreateOperationResultFromOutputs(outputBlobs[i], msfPtr,
+                                         warnings + entryDiagnostics[i],
+                                         statuses[i], &ppResults[i]);
+        AttachDebugInfoToResult(debugBlobs[i], &ppResults[i]);
+      }
+      if (pProfiler) {
+        pProfiler->end();
+        CComPtr<IDxcBlobEncoding> pTrace;
+        CreateTraceBlob(*pProfiler, pTrace);
+        for (UINT32 i = 0; i < entryCount; ++i) {
+          if (ppResults[i] != nullptr)
+            AttachTraceToResult(pTrace, &ppResults[i]);
+        }
+      }
       hr = S_OK;
     }
     CATCH_CPP_ASSIGN_HRESULT();
+
+    // Entry points that were never generated are compiled on their own, now
+    // that this thread's file system is free again.
+    for (UINT32 i : retryEntries) {
+      if (FAILED(hr))
+        break;
+      hr = CompileWithOpts(pSource, pSourceName, pEntryPoints[i],
+                           pTargetProfiles[i], pArguments, argCount, pDefines,
+                           defineCount, pIncludeHandler, nullptr, nullptr,
+                           nullptr, &ppResults[i]);
+    }
+
   Cleanup:
+    if (FAILED(hr)) {
+      for (UINT32 i = 0; i < entryCount; ++i) {
+        if (ppResults[i] != nullptr) {
+          ppResults[i]->Release();
+          ppResults[i] = nullptr;
+        }
+      }
+    }
     DxcEtw_DXCompilerCompile_Stop(hr);
     return hr;
   }
@@ -2229,28 +3266,24 @@ public:
 
       // Prepare UTF8-encoded versions of API values.
       CW2A utf8SourceName(pSourceName, CP_UTF8);
-      const char *pUtf8SourceName = utf8SourceName.m_psz;
-      if (pUtf8SourceName == nullptr) {
-        if (opts.InputFile.empty()) {
-          pUtf8SourceName = "input.hlsl";
-        }
-        else {
-          pUtf8SourceName = opts.InputFile.data();
-        }
+
+      std::unique_ptr<llvm::TimeTraceProfiler> pProfiler;
+      if (!opts.TimeTrace.empty()) {
+        pProfiler.reset(new llvm::TimeTraceProfiler());
+        pProfiler->begin("Preprocess", utf8SourceName.m_psz ? utf8SourceName.m_psz : "");
       }
+      llvm::TimeTraceProfilerActivation profilerActivation(pProfiler.get());
 
       IFT(msfPtr->RegisterOutputStream(L"output.hlsl", pOutputStream));
       IFT(msfPtr->CreateStdStreams(pMalloc));
 
-      StringRef Data((LPSTR)utf8Source->GetBufferPointer(),
-        utf8Source->GetBufferSize());
-      std::unique_ptr<llvm::MemoryBuffer> pBuffer(
-        llvm::MemoryBuffer::getMemBufferCopy(Data, pUtf8SourceName));
-
       // Not very efficient but also not very important.
       std::vector<std::string> defines;
       CreateDefineStrings(pDefines, defineCount, defines);
 
+      CComPtr<IDxcBlob> pTokenCache;
+      LoadTokenCache(opts, pIncludeHandler, pTokenCache);
+
       // Setup a compiler instance.
       std::string warnings;
       raw_string_ostream w(warnings);
@@ -2258,7 +3291,7 @@ public:
       CompilerInstance compiler;
       std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
           std::make_unique<TextDiagnosticPrinter>(w, &compiler.getDiagnosticOpts());
-      SetupCompilerForCompile(compiler, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), defines, opts, pArguments, argCount);
+      SetupCompilerForCompile(compiler, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), defines, opts, pArguments, argCount, pTokenCache);
       msfPtr->SetupForCompilerInstance(compiler);
 
       // The clang entry point (cc1_main) would now create a compiler invocation
@@ -2291,6 +3324,7 @@ public:
 
       CreateOperationResultFromOutputs(pOutputStream, msfPtr, warnings,
         compiler.getDiagnostics(), ppResult);
+      FinishTrace(pProfiler.get(), ppResult);
       hr = S_OK;
     }
     CATCH_CPP_ASSIGN_HRESULT();
@@ -2325,11 +3359,22 @@ public:
       // Accept a bitcode buffer, a DXIL container or a part.
       const char *pIL = (const char*)pProgram->GetBufferPointer();
       uint32_t pILLength = pProgram->GetBufferSize();
+      CComPtr<AbstractMemoryStream> pExpandedStream;
       if (const DxilContainerHeader *pContainer =
               IsDxilContainerLike(pIL, pILLength)) {
         if (!IsValidDxilContainer(pContainer, pILLength)) {
           IFC(DXC_E_CONTAINER_INVALID);
         }
+        if (HasCompressedDxilParts(pContainer)) {
+          CComPtr<IMalloc> pMalloc;
+          IFT(CoGetMalloc(1, &pMalloc));
+          IFT(CreateMemoryStream(pMalloc, &pExpandedStream));
+          if (!DecompressDxilContainer(pContainer, pExpandedStream)) {
+            IFC(DXC_E_CONTAINER_INVALID);
+          }
+          pContainer = reinterpret_cast<const DxilContainerHeader *>(
+              pExpandedStream->GetPtr());
+        }
 
         DxilPartIterator it = std::find_if(begin(pContainer), end(pContainer),
                                            DxilPartIsType(DFCC_FeatureInfo));
@@ -2404,31 +3449,15 @@ public:
       llvm::DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
       llvmContext.setDiagnosticHandler(PrintDiagnosticHandler, &DiagPrinter,
                                        true);
-      std::unique_ptr<llvm::MemoryBuffer> pBitcodeBuf(
-          llvm::MemoryBuffer::getMemBuffer(llvm::StringRef(pIL, pILLength), "",
-                                           false));
-      ErrorOr<std::unique_ptr<llvm::Module>> pModule(llvm::parseBitcodeFile(
-          pBitcodeBuf->getMemBufferRef(), llvmContext));
+      // Function bodies are read as they are printed, so peak memory scales
+      // with the largest function rather than the whole module.
+      ErrorOr<std::unique_ptr<llvm::Module>> pModule(
+          LoadLazyDxilModule(llvm::StringRef(pIL, pILLength), llvmContext));
       if (std::error_code ec = pModule.getError()) {
         IFC(DXC_E_IR_VERIFICATION_FAILED);
       }
 
-      if (pModule->get()->getNamedMetadata("dx.version")) {
-        DxilModule &dxilModule = pModule->get()->GetOrCreateDxilModule();
-        PrintDxilSignature("Input",
-                                 dxilModule.GetInputSignature(), Stream,
-                                 /*comment*/ ";");
-        PrintDxilSignature("Output",
-                                 dxilModule.GetOutputSignature(), Stream,
-                                 /*comment*/ ";");
-        PrintDxilSignature("Patch Constant signature",
-                                 dxilModule.GetPatchConstantSignature(), Stream,
-                                 /*comment*/ ";");
-        PrintBufferDefinitions(dxilModule, Stream, /*comment*/ ";");
-        PrintResourceBindings(dxilModule, Stream, /*comment*/ ";");
-      }
-      DxcAssemblyAnnotationWriter w;
-      pModule.get()->print(Stream, &w);
+      PrintDxilModule(pModule->get(), Stream);
       Stream.flush();
 
       IFT(DxcCreateBlobWithEncodingOnHeapCopy(
@@ -2446,9 +3475,10 @@ public:
                                _In_ DxcLangExtensionsHelper *helper,
                                _In_ LPCSTR pMainFile, _In_ TextDiagnosticPrinter *diagPrinter,
                                _In_ std::vector<std::string>& defines,
-                               _In_ hlsl::options::DxcOpts &Opts,
+                               _In_ const hlsl::options::DxcOpts &Opts,
                                _In_count_(argCount) LPCWSTR *pArguments,
-                               _In_ UINT32 argCount) {
+                               _In_ UINT32 argCount,
+                               _In_opt_ IDxcBlob *pTokenCache) {
     // Setup a compiler instance.
     std::shared_ptr<TargetOptions> targetOptions(new TargetOptions);
     targetOptions->Triple = "dxil-ms-dx";
@@ -2474,6 +3504,13 @@ public:
     for (size_t i = 0; i < defines.size(); ++i) {
       PPOpts.addMacroDef(defines[i]);
     }
+    if (!Opts.TokenCache.empty()) {
+      PPOpts.TokenCache = Opts.TokenCache;
+      if (pTokenCache != nullptr)
+        PPOpts.TokenCacheData =
+            StringRef((const char *)pTokenCache->GetBufferPointer(),
+                      pTokenCache->GetBufferSize());
+    }
 
     // Pick additional arguments.
     clang::HeaderSearchOptions &HSOpts = compiler.getHeaderSearchOpts();
@@ -2511,15 +3548,12 @@ public:
     if (Opts.IEEEStrict)
       compiler.getCodeGenOpts().UnsafeFPMath = true;
 
-    if (Opts.DisableOptimizations)
-      compiler.getCodeGenOpts().DisableLLVMOpts = true;
-
-    compiler.getCodeGenOpts().OptimizationLevel = Opts.OptLevel;
-    if (Opts.OptLevel >= 3)
-      compiler.getCodeGenOpts().UnrollLoops = true;
+    SetupCodeGenOptsForOptimization(Opts, compiler.getCodeGenOpts());
 
-    compiler.getCodeGenOpts().HLSLHighLevel = Opts.CodeGenHighLevel;
+    compiler.getCodeGenOpts().HLSLHighLevel = Opts.CodeGenHighLevel || Opts.CompileLibrary;
+    compiler.getCodeGenOpts().HLSLLibrary = Opts.CompileLibrary;
     compiler.getCodeGenOpts().HLSLAllResourcesBound = Opts.AllResourcesBound;
+    compiler.getCodeGenOpts().HLSLSignaturePackingBudget = Opts.PackOptimized ? Opts.PackBudget : 0;
     compiler.getCodeGenOpts().HLSLDefaultRowMajor = Opts.DefaultRowMajor;
     compiler.getCodeGenOpts().HLSLPreferControlFlow = Opts.PreferFlowControl;
     compiler.getCodeGenOpts().HLSLAvoidControlFlow = Opts.AvoidFlowControl;
@@ -2530,16 +3564,6 @@ public:
     for (UINT32 i = 0; i != argCount; ++i) {
       compiler.getCodeGenOpts().HLSLArguments.emplace_back(Unicode::UTF16ToUTF8StringOrThrow(pArguments[i]));
     }
-    // Overrding default set of loop unroll.
-    if (Opts.PreferFlowControl)
-      compiler.getCodeGenOpts().UnrollLoops = false;
-    if (Opts.AvoidFlowControl)
-      compiler.getCodeGenOpts().UnrollLoops = true;
-
-    // always inline for hlsl
-    compiler.getCodeGenOpts().setInlining(
-        clang::CodeGenOptions::OnlyAlwaysInlining);
-
     compiler.getCodeGenOpts().HLSLExtensionsCodegen = std::make_shared<HLSLExtensionsCodegenHelperImpl>(compiler, m_langExtensionsHelper);
   }
 };
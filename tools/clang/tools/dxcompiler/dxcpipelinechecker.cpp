@@ -0,0 +1,505 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcpipelinechecker.cpp                                                    //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the linkage checker for the stages of graphics pipelines.      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "dxc/Support/WinIncludes.h"  // For DxilPipelineStateValidation.h
+#include "dxc/HLSL/DxilConstants.h"
+#include "dxc/HLSL/DxilContainer.h"
+#include "dxc/HLSL/DxilPipelineStateValidation.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/microcom.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/dxcapi.impl.h"
+#include "dxc/dxcapi.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <exception>
+#include <thread>
+#include <unordered_map>
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace {
+
+enum class PipelineStage { Vertex, Hull, Domain, Geometry, Pixel, NumStages };
+
+struct SignatureElement {
+  StringRef Name;
+  uint32_t Index;
+  uint32_t Stream;
+  DxilProgramSigSemantic SystemValue;
+  DxilProgramSigCompType CompType;
+  uint32_t Register;
+  uint8_t Mask;
+};
+
+// The parts of a container that take part in pipeline linkage. Names point
+// into the container, which the caller keeps alive during a check.
+struct StageContainer {
+  std::vector<SignatureElement> Inputs;
+  std::vector<SignatureElement> Outputs;
+  std::vector<SignatureElement> PatchConstants;
+  PSVRuntimeInfo0 RuntimeInfo;
+  std::vector<PSVResourceBindInfo0> Bindings;
+  std::string Error; // Set if the container can't be checked.
+};
+
+} // namespace
+
+static const unsigned kNumPipelineStages = (unsigned)PipelineStage::NumStages;
+static const char *kStageNames[kNumPipelineStages] = { "VS", "HS", "DS", "GS",
+                                                       "PS" };
+
+static bool ReadSignaturePart(const DxilContainerHeader *pContainer,
+                              DxilFourCC fourCC,
+                              std::vector<SignatureElement> &elements) {
+  const DxilPartHeader *pPart = GetDxilPartByType(pContainer, fourCC);
+  if (pPart == nullptr)
+    return false;
+  const char *pData = GetDxilPartData(pPart);
+  uint32_t size = pPart->PartSize;
+  if (size < sizeof(DxilProgramSignature))
+    return false;
+  const DxilProgramSignature *pSig =
+      reinterpret_cast<const DxilProgramSignature *>(pData);
+  if (pSig->ParamOffset > size ||
+      pSig->ParamCount > (size - pSig->ParamOffset) /
+                             sizeof(DxilProgramSignatureElement))
+    return false;
+  const DxilProgramSignatureElement *pElements =
+      reinterpret_cast<const DxilProgramSignatureElement *>(pData +
+                                                            pSig->ParamOffset);
+  elements.reserve(pSig->ParamCount);
+  for (uint32_t i = 0; i < pSig->ParamCount; ++i) {
+    const DxilProgramSignatureElement &E = pElements[i];
+    // Semantic names are offsets from the start of the part.
+    if (E.SemanticName >= size)
+      return false;
+    const char *pName = pData + E.SemanticName;
+    const void *pEnd = memchr(pName, '\0', size - E.SemanticName);
+    if (pEnd == nullptr)
+      return false;
+    SignatureElement element;
+    element.Name = StringRef(pName, (const char *)pEnd - pName);
+    element.Index = E.SemanticIndex;
+    element.Stream = E.Stream;
+    element.SystemValue = E.SystemValue;
+    element.CompType = E.CompType;
+    element.Register = E.Register;
+    element.Mask = E.Mask;
+    elements.push_back(element);
+  }
+  return true;
+}
+
+static void ReadStageContainer(IDxcBlob *pBlob, PipelineStage stage,
+                               StageContainer &container) {
+  const DxilContainerHeader *pContainer =
+      IsDxilContainerLike(pBlob->GetBufferPointer(), pBlob->GetBufferSize());
+  if (pContainer == nullptr ||
+      !IsValidDxilContainer(pContainer, pBlob->GetBufferSize())) {
+    container.Error = "is not a valid container";
+    return;
+  }
+
+  // Signature and PSV0 parts are never compressed, so compressed containers
+  // are read in place.
+  bool hasPatchConstants =
+      stage == PipelineStage::Hull || stage == PipelineStage::Domain;
+  if (!ReadSignaturePart(pContainer, DFCC_InputSignature, container.Inputs) ||
+      !ReadSignaturePart(pContainer, DFCC_OutputSignature,
+                         container.Outputs) ||
+      (hasPatchConstants &&
+       !ReadSignaturePart(pContainer, DFCC_PatchConstantSignature,
+                          container.PatchConstants))) {
+    container.Error = "has missing or malformed signature parts";
+    return;
+  }
+
+  const DxilPartHeader *pPSVPart =
+      GetDxilPartByType(pContainer, DFCC_PipelineStateValidation);
+  DxilPipelineStateValidation PSV;
+  if (pPSVPart == nullptr ||
+      !PSV.InitFromPSV0(GetDxilPartData(pPSVPart), pPSVPart->PartSize)) {
+    container.Error = "has a missing or malformed PSV0 part";
+    return;
+  }
+  memcpy(&container.RuntimeInfo, PSV.GetPSVRuntimeInfo0(),
+         sizeof(container.RuntimeInfo));
+  container.Bindings.resize(PSV.GetBindCount());
+  for (UINT i = 0; i < PSV.GetBindCount(); ++i)
+    memcpy(&container.Bindings[i], PSV.GetPSVResourceBindInfo0(i),
+           sizeof(PSVResourceBindInfo0));
+}
+
+static std::string MaskToString(uint8_t mask) {
+  std::string result;
+  for (unsigned i = 0; i < 4; ++i)
+    if (mask & (1 << i))
+      result += "xyzw"[i];
+  return result;
+}
+
+// Values the pipeline generates for a stage when the previous stage doesn't
+// write them.
+static bool IsSystemGeneratedInput(DxilProgramSigSemantic systemValue) {
+  switch (systemValue) {
+  case DxilProgramSigSemantic::VertexID:
+  case DxilProgramSigSemantic::InstanceID:
+  case DxilProgramSigSemantic::PrimitiveID:
+  case DxilProgramSigSemantic::IsFrontFace:
+  case DxilProgramSigSemantic::SampleIndex:
+  case DxilProgramSigSemantic::Coverage:
+  case DxilProgramSigSemantic::InnerCoverage:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Checks that every element consumer reads is written by producer at the
+// same register and components, with the same type.
+static void CheckSignatureLinkage(const char *producerName,
+                                  const std::vector<SignatureElement> &outputs,
+                                  const char *consumerName,
+                                  const std::vector<SignatureElement> &inputs,
+                                  const char *signatureName,
+                                  raw_ostream &errors) {
+  for (const SignatureElement &in : inputs) {
+    // Elements outside of registers, such as SV_Coverage, don't link.
+    if (in.Register == UINT_MAX)
+      continue;
+    // The pixel shader reads the stream the geometry shader rasterizes;
+    // without stream output that is stream 0.
+    auto found = std::find_if(
+        outputs.begin(), outputs.end(), [&](const SignatureElement &out) {
+          return out.Stream == 0 && out.Index == in.Index &&
+                 out.Name.equals_lower(in.Name);
+        });
+    if (found == outputs.end()) {
+      if (!IsSystemGeneratedInput(in.SystemValue))
+        errors << consumerName << " " << signatureName << " " << in.Name
+               << in.Index << " is not written by " << producerName << "\n";
+      continue;
+    }
+    const SignatureElement &out = *found;
+    if (out.Register != in.Register) {
+      errors << consumerName << " " << signatureName << " " << in.Name
+             << in.Index << " is read from register " << in.Register
+             << " but " << producerName << " writes it to register "
+             << out.Register << "\n";
+      continue;
+    }
+    if ((in.Mask & ~out.Mask) != 0) {
+      errors << consumerName << " " << signatureName << " " << in.Name
+             << in.Index << " reads components ." << MaskToString(in.Mask)
+             << " but " << producerName << " writes ."
+             << MaskToString(out.Mask) << "\n";
+    }
+    if (in.CompType != out.CompType &&
+        in.CompType != DxilProgramSigCompType::Unknown &&
+        out.CompType != DxilProgramSigCompType::Unknown) {
+      errors << consumerName << " " << signatureName << " " << in.Name
+             << in.Index << " has component type " << (unsigned)in.CompType
+             << " but " << producerName << " writes component type "
+             << (unsigned)out.CompType << "\n";
+    }
+  }
+}
+
+static char GetRegisterClass(PSVResourceType type) {
+  switch (type) {
+  case PSVResourceType::Sampler:
+    return 's';
+  case PSVResourceType::CBV:
+    return 'b';
+  case PSVResourceType::SRVTyped:
+  case PSVResourceType::SRVRaw:
+  case PSVResourceType::SRVStructured:
+    return 't';
+  default:
+    return 'u';
+  }
+}
+
+static const char *GetResourceTypeName(PSVResourceType type) {
+  switch (type) {
+  case PSVResourceType::Sampler:                  return "sampler";
+  case PSVResourceType::CBV:                      return "constant buffer";
+  case PSVResourceType::SRVTyped:                 return "typed SRV";
+  case PSVResourceType::SRVRaw:                   return "raw SRV";
+  case PSVResourceType::SRVStructured:            return "structured SRV";
+  case PSVResourceType::UAVTyped:                 return "typed UAV";
+  case PSVResourceType::UAVRaw:                   return "raw UAV";
+  case PSVResourceType::UAVStructured:            return "structured UAV";
+  case PSVResourceType::UAVStructuredWithCounter: return "structured UAV with counter";
+  default:                                        return "unknown resource";
+  }
+}
+
+// Stages share one root signature, so a register that two stages bind must
+// hold the same kind of resource in both.
+static void CheckBindingConflicts(const StageContainer *const *ppStages,
+                                  raw_ostream &errors) {
+  for (unsigned i = 0; i < kNumPipelineStages; ++i) {
+    if (ppStages[i] == nullptr)
+      continue;
+    for (unsigned j = i + 1; j < kNumPipelineStages; ++j) {
+      if (ppStages[j] == nullptr)
+        continue;
+      for (const PSVResourceBindInfo0 &a : ppStages[i]->Bindings) {
+        for (const PSVResourceBindInfo0 &b : ppStages[j]->Bindings) {
+          PSVResourceType typeA = (PSVResourceType)a.ResType;
+          PSVResourceType typeB = (PSVResourceType)b.ResType;
+          if (typeA == typeB || a.Space != b.Space ||
+              GetRegisterClass(typeA) != GetRegisterClass(typeB) ||
+              a.UpperBound < b.LowerBound || b.UpperBound < a.LowerBound)
+            continue;
+          errors << kStageNames[i] << " binds " << GetRegisterClass(typeA)
+                 << std::max(a.LowerBound, b.LowerBound) << ", space"
+                 << a.Space << " as a " << GetResourceTypeName(typeA)
+                 << " but " << kStageNames[j] << " binds it as a "
+                 << GetResourceTypeName(typeB) << "\n";
+        }
+      }
+    }
+  }
+}
+
+static bool IsTessellatorOutputCompatible(UINT tessellatorOutput,
+                                          UINT gsInput) {
+  typedef DXIL::TessellatorOutputPrimitive TessOutput;
+  typedef DXIL::InputPrimitive GSInput;
+  switch ((TessOutput)tessellatorOutput) {
+  case TessOutput::Point:
+    return (GSInput)gsInput == GSInput::Point;
+  case TessOutput::Line:
+    return (GSInput)gsInput == GSInput::Line;
+  case TessOutput::TriangleCW:
+  case TessOutput::TriangleCCW:
+    return (GSInput)gsInput == GSInput::Triangle;
+  default:
+    return true;
+  }
+}
+
+static void CheckPipelineStages(const StageContainer *const *ppStages,
+                                raw_ostream &errors) {
+  const StageContainer *pHS = ppStages[(unsigned)PipelineStage::Hull];
+  const StageContainer *pDS = ppStages[(unsigned)PipelineStage::Domain];
+  const StageContainer *pGS = ppStages[(unsigned)PipelineStage::Geometry];
+  if (ppStages[(unsigned)PipelineStage::Vertex] == nullptr) {
+    errors << "pipeline has no VS\n";
+    return;
+  }
+  if ((pHS == nullptr) != (pDS == nullptr)) {
+    errors << "pipeline has "
+           << (pHS ? "an HS without a DS" : "a DS without an HS") << "\n";
+    return;
+  }
+
+  bool unreadable = false;
+  for (unsigned i = 0; i < kNumPipelineStages; ++i) {
+    if (ppStages[i] != nullptr && !ppStages[i]->Error.empty()) {
+      errors << kStageNames[i] << " container " << ppStages[i]->Error << "\n";
+      unreadable = true;
+    }
+  }
+  if (unreadable)
+    return;
+
+  unsigned producer = (unsigned)PipelineStage::Vertex;
+  for (unsigned consumer = producer + 1; consumer < kNumPipelineStages;
+       ++consumer) {
+    if (ppStages[consumer] == nullptr)
+      continue;
+    CheckSignatureLinkage(kStageNames[producer], ppStages[producer]->Outputs,
+                          kStageNames[consumer], ppStages[consumer]->Inputs,
+                          "input", errors);
+    producer = consumer;
+  }
+
+  if (pHS != nullptr) {
+    CheckSignatureLinkage("HS", pHS->PatchConstants, "DS", pDS->PatchConstants,
+                          "patch constant", errors);
+    const PSVRuntimeInfo0 &HSInfo = pHS->RuntimeInfo;
+    const PSVRuntimeInfo0 &DSInfo = pDS->RuntimeInfo;
+    if (HSInfo.HS.OutputControlPointCount != DSInfo.DS.InputControlPointCount)
+      errors << "HS outputs " << HSInfo.HS.OutputControlPointCount
+             << " control points but DS reads "
+             << DSInfo.DS.InputControlPointCount << "\n";
+    if (HSInfo.HS.TessellatorDomain != DSInfo.DS.TessellatorDomain)
+      errors << "HS domain " << HSInfo.HS.TessellatorDomain
+             << " doesn't match DS domain " << DSInfo.DS.TessellatorDomain
+             << "\n";
+    if (pGS != nullptr &&
+        !IsTessellatorOutputCompatible(HSInfo.HS.TessellatorOutputPrimitive,
+                                       pGS->RuntimeInfo.GS.InputPrimitive))
+      errors << "HS output primitive "
+             << HSInfo.HS.TessellatorOutputPrimitive
+             << " doesn't match GS input primitive "
+             << pGS->RuntimeInfo.GS.InputPrimitive << "\n";
+  }
+
+  CheckBindingConflicts(ppStages, errors);
+}
+
+static void GetStageBlobs(const DxcPipelineStages &stages,
+                          IDxcBlob *(&blobs)[kNumPipelineStages]) {
+  blobs[(unsigned)PipelineStage::Vertex] = stages.pVS;
+  blobs[(unsigned)PipelineStage::Hull] = stages.pHS;
+  blobs[(unsigned)PipelineStage::Domain] = stages.pDS;
+  blobs[(unsigned)PipelineStage::Geometry] = stages.pGS;
+  blobs[(unsigned)PipelineStage::Pixel] = stages.pPS;
+}
+
+class DxcPipelineChecker : public IDxcPipelineChecker {
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  DxcPipelineChecker() : m_dwRef(0) {}
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
+    return DoBasicQueryInterface<IDxcPipelineChecker>(this, iid, ppvObject);
+  }
+
+  __override HRESULT STDMETHODCALLTYPE CheckPipeline(
+    _In_ const DxcPipelineStages *pStages,
+    _COM_Outptr_ IDxcOperationResult **ppResult) {
+    if (pStages == nullptr || ppResult == nullptr)
+      return E_INVALIDARG;
+    return CheckPipelines(pStages, 1, ppResult);
+  }
+
+  __override HRESULT STDMETHODCALLTYPE CheckPipelines(
+    _In_count_(pipelineCount) const DxcPipelineStages *pPipelines,
+    _In_ UINT32 pipelineCount,
+    _Out_writes_(pipelineCount) IDxcOperationResult **ppResults);
+};
+
+HRESULT STDMETHODCALLTYPE DxcPipelineChecker::CheckPipelines(
+    _In_count_(pipelineCount) const DxcPipelineStages *pPipelines,
+    _In_ UINT32 pipelineCount,
+    _Out_writes_(pipelineCount) IDxcOperationResult **ppResults) {
+  if (pipelineCount > 0 && (pPipelines == nullptr || ppResults == nullptr))
+    return E_INVALIDARG;
+  for (UINT32 i = 0; i < pipelineCount; ++i)
+    ppResults[i] = nullptr;
+
+  HRESULT hr = S_OK;
+  try {
+    // Pipelines typically share most of their containers; read each one
+    // once, up front, so the workers only compare.
+    typedef std::pair<IDxcBlob *, PipelineStage> ContainerKey;
+    struct ContainerKeyHash {
+      size_t operator()(const ContainerKey &key) const {
+        return std::hash<IDxcBlob *>()(key.first) ^ (size_t)key.second;
+      }
+    };
+    std::unordered_map<ContainerKey, StageContainer, ContainerKeyHash>
+        containers;
+    for (UINT32 i = 0; i < pipelineCount; ++i) {
+      IDxcBlob *blobs[kNumPipelineStages];
+      GetStageBlobs(pPipelines[i], blobs);
+      for (unsigned s = 0; s < kNumPipelineStages; ++s) {
+        if (blobs[s] == nullptr)
+          continue;
+        auto inserted = containers.insert(
+            std::make_pair(ContainerKey(blobs[s], (PipelineStage)s),
+                           StageContainer()));
+        if (inserted.second)
+          ReadStageContainer(blobs[s], (PipelineStage)s,
+                             inserted.first->second);
+      }
+    }
+
+    // Exceptions can't leave a thread, so each pipeline keeps its own and
+    // the first is rethrown on the calling thread once all have finished.
+    std::vector<std::exception_ptr> exceptions(pipelineCount);
+    std::atomic<UINT32> nextPipeline(0);
+    auto worker = [&]() {
+      for (UINT32 i = nextPipeline++; i < pipelineCount;
+           i = nextPipeline++) {
+        try {
+          IDxcBlob *blobs[kNumPipelineStages];
+          GetStageBlobs(pPipelines[i], blobs);
+          const StageContainer *stages[kNumPipelineStages];
+          for (unsigned s = 0; s < kNumPipelineStages; ++s)
+            stages[s] = blobs[s] == nullptr
+                            ? nullptr
+                            : &containers.at(
+                                  ContainerKey(blobs[s], (PipelineStage)s));
+
+          std::string errors;
+          raw_string_ostream errorStream(errors);
+          CheckPipelineStages(stages, errorStream);
+          errorStream.flush();
+          HRESULT status =
+              errors.empty() ? S_OK : DXC_E_PIPELINE_LINKAGE_MISMATCH;
+          IFT(DxcOperationResult::CreateFromUtf8Strings(
+              errors.empty() ? nullptr : errors.c_str(), nullptr, status,
+              &ppResults[i]));
+        }
+        catch (...) {
+          exceptions[i] = std::current_exception();
+        }
+      }
+    };
+
+    // The calling thread checks pipelines too.
+    unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = std::min<unsigned>(threadCount, pipelineCount);
+    std::vector<std::thread> threads;
+    try {
+      for (unsigned i = 1; i < threadCount; ++i)
+        threads.emplace_back(worker);
+    }
+    catch (const std::system_error &) {
+      // Continue with the threads that could be started.
+    }
+    worker();
+    for (std::thread &t : threads)
+      t.join();
+
+    for (const std::exception_ptr &exception : exceptions) {
+      if (exception)
+        std::rethrow_exception(exception);
+    }
+  }
+  CATCH_CPP_ASSIGN_HRESULT();
+
+  if (FAILED(hr)) {
+    for (UINT32 i = 0; i < pipelineCount; ++i) {
+      if (ppResults[i] != nullptr) {
+        ppResults[i]->Release();
+        ppResults[i] = nullptr;
+      }
+    }
+  }
+  return hr;
+}
+
+HRESULT CreateDxcPipelineChecker(_In_ REFIID riid, _Out_ LPVOID *ppv) {
+  CComPtr<DxcPipelineChecker> result = new (std::nothrow) DxcPipelineChecker();
+  if (result == nullptr) {
+    *ppv = nullptr;
+    return E_OUTOFMEMORY;
+  }
+
+  return result.p->QueryInterface(riid, ppv);
+}
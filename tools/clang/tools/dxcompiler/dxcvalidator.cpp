@@ -181,6 +181,7 @@ HRESULT DxcValidator::RunValidation(
   raw_stream_ostream DiagStream(pDiagStream);
   llvm::DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
   PrintDiagnosticContext DiagContext(DiagPrinter);
+  CComPtr<AbstractMemoryStream> pExpandedStream;
   if (pModule == nullptr) {
     DXASSERT_NOMSG(pDebugModule == nullptr);
     // Accept a bitcode buffer or a DXIL container.
@@ -193,6 +194,16 @@ HRESULT DxcValidator::RunValidation(
       if (!IsValidDxilContainer(pContainer, pILLength)) {
         IFR(DXC_E_CONTAINER_INVALID);
       }
+      if (HasCompressedDxilParts(pContainer)) {
+        CComPtr<IMalloc> pMalloc;
+        IFR(CoGetMalloc(1, &pMalloc));
+        IFR(CreateMemoryStream(pMalloc, &pExpandedStream));
+        if (!DecompressDxilContainer(pContainer, pExpandedStream)) {
+          IFR(DXC_E_CONTAINER_INVALID);
+        }
+        pContainer = reinterpret_cast<const DxilContainerHeader *>(
+            pExpandedStream->GetPtr());
+      }
 
       DxilPartIterator it = std::find_if(begin(pContainer), end(pContainer),
         DxilPartIsType(DFCC_DXIL));
@@ -271,11 +282,11 @@ HRESULT DxcValidator::RunValidation(
 HRESULT RunInternalValidator(_In_ IDxcValidator *pValidator,
                              _In_ llvm::Module *pModule,
                              _In_ llvm::Module *pDebugModule,
-                             _In_ IDxcBlob *pShader, UINT32 Flags,
+                             _In_opt_ IDxcBlob *pShader, UINT32 Flags,
                              _COM_Outptr_ IDxcOperationResult **ppResult) {
+  // The shader blob is only read when no module is given.
   DXASSERT_NOMSG(pValidator != nullptr);
   DXASSERT_NOMSG(pModule != nullptr);
-  DXASSERT_NOMSG(pShader != nullptr);
   DXASSERT_NOMSG(ppResult != nullptr);
 
   DxcValidator *pInternalValidator = (DxcValidator *)pValidator;
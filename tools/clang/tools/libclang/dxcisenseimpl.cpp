@@ -381,6 +381,41 @@ HRESULT SetupUnsavedFiles(
   return hr;
 }
 
+// Owns the files created by SetupUnsavedFiles and frees them when it goes out
+// of scope, including when an exception is thrown.
+class UnsavedFilesHolder
+{
+public:
+  UnsavedFilesHolder() : m_files(nullptr), m_count(0) { }
+  ~UnsavedFilesHolder() { Reset(); }
+
+  HRESULT Setup(
+    _In_count_(num_unsaved_files) IDxcUnsavedFile** unsaved_files,
+    unsigned num_unsaved_files)
+  {
+    Reset();
+    HRESULT hr = SetupUnsavedFiles(unsaved_files, num_unsaved_files, &m_files);
+    if (SUCCEEDED(hr)) m_count = num_unsaved_files;
+    return hr;
+  }
+
+  void Reset() throw()
+  {
+    if (m_files != nullptr) CleanupUnsavedFiles(m_files, m_count);
+    m_files = nullptr;
+    m_count = 0;
+  }
+
+  CXUnsavedFile* GetFiles() const { return m_files; }
+
+private:
+  CXUnsavedFile* m_files;
+  unsigned m_count;
+
+  UnsavedFilesHolder(const UnsavedFilesHolder&) = delete;
+  UnsavedFilesHolder& operator=(const UnsavedFilesHolder&) = delete;
+};
+
 struct PagedCursorVisitorContext
 {
   unsigned skip;                // References to skip at the beginning.
@@ -603,6 +638,147 @@ HRESULT DxcBasicUnsavedFile::GetLength(unsigned* pLength)
 
 ///////////////////////////////////////////////////////////////////////////////
 
+DxcCodeCompleteResults::DxcCodeCompleteResults() : m_ccr(nullptr), m_dwRef(0)
+{
+}
+
+DxcCodeCompleteResults::~DxcCodeCompleteResults()
+{
+  if (m_ccr != nullptr)
+  {
+    clang_disposeCodeCompleteResults(m_ccr);
+    m_ccr = nullptr;
+  }
+}
+
+void DxcCodeCompleteResults::Initialize(CXCodeCompleteResults* ccr)
+{
+  m_ccr = ccr;
+}
+
+_Use_decl_annotations_
+HRESULT DxcCodeCompleteResults::GetNumResults(unsigned* pResult)
+{
+  if (pResult == nullptr) return E_POINTER;
+  *pResult = m_ccr->NumResults;
+  return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DxcCodeCompleteResults::GetResultAt(unsigned index, IDxcCompletionResult** pResult)
+{
+  if (pResult == nullptr) return E_POINTER;
+  *pResult = nullptr;
+  if (index >= m_ccr->NumResults) return E_INVALIDARG;
+  return DxcCompletionResult::Create(this, m_ccr->Results[index], pResult);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+DxcCompletionResult::DxcCompletionResult() : m_dwRef(0)
+{
+}
+
+DxcCompletionResult::~DxcCompletionResult()
+{
+}
+
+void DxcCompletionResult::Initialize(IDxcCodeCompleteResults* results, const CXCompletionResult& cr)
+{
+  m_results = results;
+  m_cr = cr;
+}
+
+_Use_decl_annotations_
+HRESULT DxcCompletionResult::Create(
+  IDxcCodeCompleteResults* results,
+  const CXCompletionResult& cr,
+  IDxcCompletionResult** pObject)
+{
+  if (pObject == nullptr) return E_POINTER;
+  *pObject = nullptr;
+  DxcCompletionResult* local = new (std::nothrow) DxcCompletionResult();
+  if (local == nullptr) return E_OUTOFMEMORY;
+  local->Initialize(results, cr);
+  local->AddRef();
+  *pObject = local;
+  return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DxcCompletionResult::GetCursorKind(DxcCursorKind* pResult)
+{
+  if (pResult == nullptr) return E_POINTER;
+  *pResult = (DxcCursorKind)m_cr.CursorKind;
+  return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DxcCompletionResult::GetCompletionString(IDxcCompletionString** pResult)
+{
+  return DxcCompletionString::Create(m_results, m_cr.CompletionString, pResult);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+DxcCompletionString::DxcCompletionString() : m_dwRef(0)
+{
+}
+
+DxcCompletionString::~DxcCompletionString()
+{
+}
+
+void DxcCompletionString::Initialize(IDxcCodeCompleteResults* results, const CXCompletionString& cs)
+{
+  m_results = results;
+  m_cs = cs;
+}
+
+_Use_decl_annotations_
+HRESULT DxcCompletionString::Create(
+  IDxcCodeCompleteResults* results,
+  const CXCompletionString& cs,
+  IDxcCompletionString** pObject)
+{
+  if (pObject == nullptr) return E_POINTER;
+  *pObject = nullptr;
+  DxcCompletionString* local = new (std::nothrow) DxcCompletionString();
+  if (local == nullptr) return E_OUTOFMEMORY;
+  local->Initialize(results, cs);
+  local->AddRef();
+  *pObject = local;
+  return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DxcCompletionString::GetNumCompletionChunks(unsigned* pResult)
+{
+  if (pResult == nullptr) return E_POINTER;
+  *pResult = clang_getNumCompletionChunks(m_cs);
+  return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DxcCompletionString::GetCompletionChunkKind(unsigned chunkNumber, DxcCompletionChunkKind* pResult)
+{
+  if (pResult == nullptr) return E_POINTER;
+  if (chunkNumber >= clang_getNumCompletionChunks(m_cs)) return E_INVALIDARG;
+  *pResult = (DxcCompletionChunkKind)clang_getCompletionChunkKind(m_cs, chunkNumber);
+  return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DxcCompletionString::GetCompletionChunkText(unsigned chunkNumber, LPSTR* pResult)
+{
+  if (pResult == nullptr) return E_POINTER;
+  *pResult = nullptr;
+  if (chunkNumber >= clang_getNumCompletionChunks(m_cs)) return E_INVALIDARG;
+  return CXStringToAnsiAndDispose(clang_getCompletionChunkText(m_cs, chunkNumber), pResult);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 DxcCursor::DxcCursor() : m_dwRef(0)
 {
 }
@@ -1760,6 +1936,52 @@ HRESULT DxcTranslationUnit::GetInclusionList(unsigned *pResultCount,
   return S_OK;
 }
 
+_Use_decl_annotations_
+HRESULT DxcTranslationUnit::CodeCompleteAt(
+  const char* fileName, unsigned line, unsigned column,
+  IDxcUnsavedFile** pUnsavedFiles, unsigned numUnsavedFiles,
+  DxcCodeCompleteFlags options,
+  IDxcCodeCompleteResults** pResult)
+{
+  if (fileName == nullptr) return E_INVALIDARG;
+  if (pResult == nullptr) return E_POINTER;
+  *pResult = nullptr;
+
+  try
+  {
+    UnsavedFilesHolder files;
+    HRESULT hr = files.Setup(pUnsavedFiles, numUnsavedFiles);
+    if (FAILED(hr)) return hr;
+
+    // TODO: until an interface to file access is defined and implemented, simply fall back to pure Win32/CRT calls.
+    ::llvm::sys::fs::MSFileSystem* msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::auto_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+    CXCodeCompleteResults* ccr = clang_codeCompleteAt(
+      m_tu, fileName, line, column, files.GetFiles(), numUnsavedFiles, options);
+    files.Reset();
+    if (ccr == nullptr)
+    {
+      return E_FAIL;
+    }
+
+    CComPtr<DxcCodeCompleteResults> localResults = new (std::nothrow) DxcCodeCompleteResults();
+    if (localResults == nullptr)
+    {
+      clang_disposeCodeCompleteResults(ccr);
+      return E_OUTOFMEMORY;
+    }
+    localResults->Initialize(ccr);
+    *pResult = localResults.Detach();
+
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 DxcType::DxcType() : m_dwRef(0)
@@ -19,6 +19,9 @@
 #include "dxc/Support/DxcLangExtensionsHelper.h"
 
 // Forward declarations.
+class DxcCodeCompleteResults;
+class DxcCompletionResult;
+class DxcCompletionString;
 class DxcCursor;
 class DxcDiagnostic;
 class DxcFile;
@@ -29,6 +32,72 @@ class DxcSourceRange;
 class DxcTranslationUnit;
 class DxcToken;
 
+class DxcCodeCompleteResults : public IDxcCodeCompleteResults
+{
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  CXCodeCompleteResults* m_ccr;
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject)
+  {
+    return DoBasicQueryInterface<IDxcCodeCompleteResults>(this, iid, ppvObject);
+  }
+
+  DxcCodeCompleteResults();
+  ~DxcCodeCompleteResults();
+  void Initialize(CXCodeCompleteResults* ccr);
+
+  __override HRESULT STDMETHODCALLTYPE GetNumResults(_Out_ unsigned* pResult);
+  __override HRESULT STDMETHODCALLTYPE GetResultAt(unsigned index, _Outptr_result_nullonfailure_ IDxcCompletionResult** pResult);
+};
+
+class DxcCompletionResult : public IDxcCompletionResult
+{
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  // Keeps the results alive, as they own the completion string.
+  CComPtr<IDxcCodeCompleteResults> m_results;
+  CXCompletionResult m_cr;
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject)
+  {
+    return DoBasicQueryInterface<IDxcCompletionResult>(this, iid, ppvObject);
+  }
+
+  DxcCompletionResult();
+  ~DxcCompletionResult();
+  void Initialize(IDxcCodeCompleteResults* results, const CXCompletionResult& cr);
+  static HRESULT Create(IDxcCodeCompleteResults* results, const CXCompletionResult& cr, _Outptr_result_nullonfailure_ IDxcCompletionResult** pObject);
+
+  __override HRESULT STDMETHODCALLTYPE GetCursorKind(_Out_ DxcCursorKind* pResult);
+  __override HRESULT STDMETHODCALLTYPE GetCompletionString(_Outptr_result_nullonfailure_ IDxcCompletionString** pResult);
+};
+
+class DxcCompletionString : public IDxcCompletionString
+{
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  CComPtr<IDxcCodeCompleteResults> m_results;
+  CXCompletionString m_cs;
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject)
+  {
+    return DoBasicQueryInterface<IDxcCompletionString>(this, iid, ppvObject);
+  }
+
+  DxcCompletionString();
+  ~DxcCompletionString();
+  void Initialize(IDxcCodeCompleteResults* results, const CXCompletionString& cs);
+  static HRESULT Create(IDxcCodeCompleteResults* results, const CXCompletionString& cs, _Outptr_result_nullonfailure_ IDxcCompletionString** pObject);
+
+  __override HRESULT STDMETHODCALLTYPE GetNumCompletionChunks(_Out_ unsigned* pResult);
+  __override HRESULT STDMETHODCALLTYPE GetCompletionChunkKind(unsigned chunkNumber, _Out_ DxcCompletionChunkKind* pResult);
+  __override HRESULT STDMETHODCALLTYPE GetCompletionChunkText(unsigned chunkNumber, _Outptr_result_maybenull_ LPSTR* pResult);
+};
+
 class DxcCursor : public IDxcCursor
 {
 private:
@@ -337,6 +406,12 @@ public:
       _Out_ unsigned* errorLength,
       _Out_ BSTR* errorMessage);
     __override HRESULT STDMETHODCALLTYPE GetInclusionList(_Out_ unsigned* pResultCount, _Outptr_result_buffer_(*pResultCount) IDxcInclusion*** pResult);
+    __override HRESULT STDMETHODCALLTYPE CodeCompleteAt(
+      _In_ const char* fileName, unsigned line, unsigned column,
+      _In_count_(numUnsavedFiles) IDxcUnsavedFile** pUnsavedFiles,
+      unsigned numUnsavedFiles,
+      DxcCodeCompleteFlags options,
+      _Outptr_result_nullonfailure_ IDxcCodeCompleteResults** pResult);
 };
 
 class DxcType : public IDxcType
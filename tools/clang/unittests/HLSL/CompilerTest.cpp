@@ -19,6 +19,7 @@
 #include <cassert>
 #include <sstream>
 #include <algorithm>
+#include "dxc/HLSL/DxilCompression.h"
 #include "dxc/HLSL/DxilContainer.h"
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/dxcapi.h"
@@ -268,12 +269,15 @@ public:
   TEST_CLASS_SETUP(InitSupport);
 
   TEST_METHOD(CompileWhenDebugThenDIPresent)
+  TEST_METHOD(CompileWhenDebugThenLinesFoundByAddress)
 
   TEST_METHOD(CompileWhenDefinesThenApplied)
   TEST_METHOD(CompileWhenDefinesManyThenApplied)
   TEST_METHOD(CompileWhenEmptyThenFails)
   TEST_METHOD(CompileWhenIncorrectThenFails)
   TEST_METHOD(CompileWhenWorksThenDisassembleWorks)
+  TEST_METHOD(DisassembleWhenLazyThenMatchesLoadedModule)
+  TEST_METHOD(DisassembleWhenLazyAndStructOnlyInBodyThenSameTypeOrder)
 
   TEST_METHOD(CompileWhenIncludeThenLoadInvoked)
   TEST_METHOD(CompileWhenIncludeThenLoadUsed)
@@ -283,10 +287,29 @@ public:
   TEST_METHOD(CompileWhenIncludeSystemMissingThenLoadAttempt)
   TEST_METHOD(CompileWhenIncludeFlagsThenIncludeUsed)
   TEST_METHOD(CompileWhenIncludeMissingThenFail)
+  TEST_METHOD(CompileWhenCacheThenIncludeChangeInvalidates)
+  TEST_METHOD(CompileBatchWhenManyJobsThenAllSucceed)
+  TEST_METHOD(CompileBatchWhenCacheThenJobsShareResult)
+  TEST_METHOD(CompileEntryPointsWhenTwoEntriesThenBothSucceed)
+  TEST_METHOD(CompileEntryPointsWhenOneEntryFailsThenOtherIsClean)
+  TEST_METHOD(CompileWhenIncludeCacheThenIncludeLoadedOnce)
+  TEST_METHOD(CompileWhenTokenCacheThenIncludeNotLexed)
+  TEST_METHOD(CompileWhenCachePreprocessedThenPermutationsShareResult)
 
   TEST_METHOD(CompileWhenODumpThenPassConfig)
   TEST_METHOD(CompileWhenODumpThenOptimizerMatch)
+  TEST_METHOD(ModuleSessionWhenLoadedThenValidatesAndDisassembles)
   TEST_METHOD(CompileWhenVdThenProducesDxilContainer)
+  TEST_METHOD(CompileWhenTimeTraceThenResultHasTrace)
+  TEST_METHOD(CompileWhenCompressThenPartsReadable)
+  TEST_METHOD(DecompressWhenStreamMalformedThenFails)
+  TEST_METHOD(CompileWhenSplitDebugThenDebugContainerSeparate)
+  TEST_METHOD(LoadDataForExeWhenSplitDebugThenFindsDebugContainer)
+  TEST_METHOD(LinkWhenLibrariesCompiledThenShaderValid)
+  TEST_METHOD(LinkWhenLibrariesShareHeaderThenHelpersMerged)
+  TEST_METHOD(LinkWhenHelperDefinedDifferentlyThenFail)
+  TEST_METHOD(LinkWhenArgumentUnsupportedThenFail)
+  TEST_METHOD(CheckPipelinesWhenStagesMismatchThenFail)
 
   TEST_METHOD(CompileWhenShaderModelMismatchAttributeThenFail)
   TEST_METHOD(CompileBadHlslThenFail)
@@ -456,6 +479,7 @@ public:
   TEST_METHOD(CodeGenShare_Mem2)
   TEST_METHOD(CodeGenShare_Mem2Dim)
   TEST_METHOD(CodeGenShift)
+  TEST_METHOD(CodeGenSignaturePackingOptimized)
   TEST_METHOD(CodeGenSimpleDS1)
   TEST_METHOD(CodeGenSimpleGS1)
   TEST_METHOD(CodeGenSimpleGS2)
@@ -746,6 +770,9 @@ public:
   TEST_METHOD(CodeGenDx12MiniEngineTonemapcs)
   TEST_METHOD(CodeGenDx12MiniEngineUpsampleandblurcs)
   TEST_METHOD(DxilGen_StoreOutput)
+  TEST_METHOD(DxilCost_UnknownTripCount)
+  TEST_METHOD(DxilCost_ConstantTripCount)
+  TEST_METHOD(DxilCost_ConstantTripCountHeaderExit)
 
   dxc::DxcDllSupport m_dllSupport;
   bool m_CompilerPreservesBBNames;
@@ -1159,7 +1186,6 @@ TEST_F(CompilerTest, CompileWhenDebugThenDIPresent) {
     //WEX::Logging::Log::Comment(disTextW);
   }
 
-  // CONSIDER: have the dia data source look for the part if passed a whole container.
   CComPtr<IDiaDataSource> pDiaSource;
   CComPtr<IStream> pProgramStream;
   CComPtr<IDxcLibrary> pLib;
@@ -1218,6 +1244,74 @@ TEST_F(CompilerTest, CompileWhenDebugThenDIPresent) {
 #endif
 }
 
+TEST_F(CompilerTest, CompileWhenDebugThenLinesFoundByAddress) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pProgram;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main(float4 pos : SV_Position) : SV_Target {\r\n"
+    "  float4 local = abs(pos);\r\n"
+    "  return local;\r\n"
+    "}", &pSource);
+  LPCWSTR args[] = { L"/Zi" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", args, _countof(args), nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+
+  CComPtr<IDxcLibrary> pLib;
+  CComPtr<IStream> pProgramStream;
+  CComPtr<IDiaDataSource> pDiaSource;
+  CComPtr<IDiaSession> pSession;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcLibrary, &pLib));
+  VERIFY_SUCCEEDED(pLib->CreateStreamFromBlobReadOnly(pProgram, &pProgramStream));
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcDiaDataSource, &pDiaSource));
+  VERIFY_SUCCEEDED(pDiaSource->loadDataFromIStream(pProgramStream));
+  VERIFY_SUCCEEDED(pDiaSource->openSession(&pSession));
+
+  CComPtr<IDiaEnumSourceFiles> pFiles;
+  CComPtr<IDiaSourceFile> pFile;
+  LONG count;
+  VERIFY_SUCCEEDED(pSession->findFile(nullptr, L"source.hlsl", nsNone, &pFiles));
+  VERIFY_SUCCEEDED(pFiles->get_Count(&count));
+  VERIFY_ARE_EQUAL(1L, count);
+  VERIFY_SUCCEEDED(pFiles->Item(0, &pFile));
+
+  // Look up the code for line 2 by line number.
+  CComPtr<IDiaEnumLineNumbers> pByLine;
+  CComPtr<IDiaLineNumber> pLine;
+  DWORD lineNumber, rva, length;
+  VERIFY_SUCCEEDED(pSession->findLinesByLinenum(nullptr, pFile, 2, 0, &pByLine));
+  VERIFY_SUCCEEDED(pByLine->get_Count(&count));
+  VERIFY_IS_TRUE(count > 0);
+  VERIFY_SUCCEEDED(pByLine->Item(0, &pLine));
+  VERIFY_SUCCEEDED(pLine->get_lineNumber(&lineNumber));
+  VERIFY_ARE_EQUAL((DWORD)2, lineNumber);
+  VERIFY_SUCCEEDED(pLine->get_relativeVirtualAddress(&rva));
+  VERIFY_SUCCEEDED(pLine->get_length(&length));
+  VERIFY_IS_TRUE(length > 0);
+
+  // Any address within the line's range maps back to it.
+  CComPtr<IDiaEnumLineNumbers> pByRVA;
+  CComPtr<IDiaLineNumber> pRVALine;
+  DWORD foundRVA;
+  VERIFY_SUCCEEDED(pSession->findLinesByRVA(rva + length - 1, 1, &pByRVA));
+  VERIFY_SUCCEEDED(pByRVA->get_Count(&count));
+  VERIFY_ARE_EQUAL(1L, count);
+  VERIFY_SUCCEEDED(pByRVA->Item(0, &pRVALine));
+  VERIFY_SUCCEEDED(pRVALine->get_relativeVirtualAddress(&foundRVA));
+  VERIFY_ARE_EQUAL(rva, foundRVA);
+  VERIFY_SUCCEEDED(pRVALine->get_lineNumber(&lineNumber));
+  VERIFY_ARE_EQUAL((DWORD)2, lineNumber);
+
+  CComPtr<IDiaSymbol> pSymbol;
+  DWORD symTag;
+  VERIFY_ARE_EQUAL(S_OK, pSession->findSymbolByRVA(rva, SymTagNull, &pSymbol));
+  VERIFY_SUCCEEDED(pSymbol->get_symTag(&symTag));
+  VERIFY_ARE_EQUAL((DWORD)SymTagCompiland, symTag);
+}
+
 TEST_F(CompilerTest, CompileWhenDefinesThenApplied) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -1336,6 +1430,98 @@ TEST_F(CompilerTest, CompileWhenWorksThenDisassembleWorks) {
   // WEX::Logging::Log::Comment(disassembleStringW.m_psz);
 }
 
+TEST_F(CompilerTest, DisassembleWhenLazyThenMatchesLoadedModule) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pProgram;
+  CComPtr<IDxcModuleSession> pSession;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main(float4 pos : SV_Position) : SV_Target {\r\n"
+    "  return abs(pos) + 1;\r\n"
+    "}", &pSource);
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", nullptr, 0, nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+
+  // Disassemble reads each function body as it prints it; the module session
+  // has the whole module loaded. The module text must be the same.
+  CComPtr<IDxcBlobEncoding> pLazyDisassembly;
+  VERIFY_SUCCEEDED(pCompiler->Disassemble(pProgram, &pLazyDisassembly));
+  std::string lazyText = BlobToUtf8(pLazyDisassembly);
+
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcModuleSession, &pSession));
+  VERIFY_SUCCEEDED(pSession->Load(pProgram));
+  CComPtr<IDxcBlobEncoding> pLoadedDisassembly;
+  VERIFY_SUCCEEDED(pSession->Disassemble(&pLoadedDisassembly));
+  std::string loadedText = BlobToUtf8(pLoadedDisassembly);
+
+  VERIFY_ARE_EQUAL(string::npos, lazyText.find("; Materializable"));
+  VERIFY_IS_TRUE(lazyText.size() >= loadedText.size());
+  VERIFY_ARE_EQUAL_STR(
+      loadedText.c_str(),
+      lazyText.substr(lazyText.size() - loadedText.size()).c_str());
+}
+
+TEST_F(CompilerTest, DisassembleWhenLazyAndStructOnlyInBodyThenSameTypeOrder) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcAssembler> pAssembler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pProgram;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcAssembler, &pAssembler));
+  CreateBlobFromText("cbuffer C { float4 scale; };\r\n"
+    "float4 main(float4 pos : SV_Position) : SV_Target {\r\n"
+    "  return abs(pos) * scale;\r\n"
+    "}", &pSource);
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", nullptr, 0, nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+
+  // Add a function whose body is the only user of a struct type. A fully
+  // loaded module finds the type while walking that body, ahead of the types
+  // only referenced from named metadata.
+  CComPtr<IDxcBlobEncoding> pDisassembly;
+  VERIFY_SUCCEEDED(pCompiler->Disassemble(pProgram, &pDisassembly));
+  std::string text = BlobToUtf8(pDisassembly);
+  text += "\n%struct.OnlyInBody = type { float, i32 }\n"
+          "\n"
+          "define void @only_in_body() {\n"
+          "  %local = alloca %struct.OnlyInBody\n"
+          "  ret void\n"
+          "}\n";
+  CComPtr<IDxcBlobEncoding> pText;
+  CComPtr<IDxcOperationResult> pAssembleResult;
+  CComPtr<IDxcBlob> pAssembled;
+  CreateBlobFromText(text.c_str(), &pText);
+  VERIFY_SUCCEEDED(pAssembler->AssembleToContainer(pText, &pAssembleResult));
+  VerifyOperationSucceeded(pAssembleResult);
+  VERIFY_SUCCEEDED(pAssembleResult->GetResult(&pAssembled));
+
+  CComPtr<IDxcBlobEncoding> pLazyDisassembly;
+  VERIFY_SUCCEEDED(pCompiler->Disassemble(pAssembled, &pLazyDisassembly));
+  std::string lazyText = BlobToUtf8(pLazyDisassembly);
+
+  CComPtr<IDxcModuleSession> pSession;
+  CComPtr<IDxcBlobEncoding> pLoadedDisassembly;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcModuleSession, &pSession));
+  VERIFY_SUCCEEDED(pSession->Load(pAssembled));
+  VERIFY_SUCCEEDED(pSession->Disassemble(&pLoadedDisassembly));
+  std::string loadedText = BlobToUtf8(pLoadedDisassembly);
+
+  VERIFY_ARE_NOT_EQUAL(string::npos,
+                       loadedText.find("%struct.OnlyInBody = type"));
+  VERIFY_IS_TRUE(lazyText.size() >= loadedText.size());
+  VERIFY_ARE_EQUAL_STR(
+      loadedText.c_str(),
+      lazyText.substr(lazyText.size() - loadedText.size()).c_str());
+}
+
 TEST_F(CompilerTest, CompileWhenIncludeThenLoadInvoked) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -1376,6 +1562,319 @@ TEST_F(CompilerTest, CompileWhenIncludeThenLoadUsed) {
   VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
 }
 
+TEST_F(CompilerTest, CompileWhenCacheThenIncludeChangeInvalidates) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  LPCWSTR args[] = { L"/cache" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "// CompileWhenCacheThenIncludeChangeInvalidates\r\n"
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return VAL; }", &pSource);
+
+  auto compile = [&](TestIncludeHandler *pInclude, IDxcBlob **ppProgram) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", args, _countof(args), nullptr, 0, pInclude, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(ppProgram));
+  };
+  auto sameBlob = [](IDxcBlob *pA, IDxcBlob *pB) {
+    return pA->GetBufferSize() == pB->GetBufferSize() &&
+      0 == memcmp(pA->GetBufferPointer(), pB->GetBufferPointer(), pA->GetBufferSize());
+  };
+
+  // The first compilation populates the cache.
+  CComPtr<TestIncludeHandler> pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define VAL 1");
+  CComPtr<IDxcBlob> pFirst;
+  compile(pInclude, &pFirst);
+
+  // The second only has the include handler re-queried to validate the entry.
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define VAL 1");
+  CComPtr<IDxcBlob> pSecond;
+  compile(pInclude, &pSecond);
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
+  VERIFY_IS_TRUE(sameBlob(pFirst, pSecond));
+
+  // A changed include is detected, and the shader is compiled again from
+  // the contents read to check the entry, without asking the handler twice.
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define VAL 2");
+  CComPtr<IDxcBlob> pThird;
+  compile(pInclude, &pThird);
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
+  VERIFY_IS_FALSE(sameBlob(pFirst, pThird));
+}
+
+TEST_F(CompilerTest, CompileBatchWhenManyJobsThenAllSucceed) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerBatch> pBatch;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<TestIncludeHandler> pInclude;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pBatch));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return ZERO + VAL; }", &pSource);
+
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define ZERO 0");
+
+  static const UINT32 JobCount = 8;
+  std::vector<std::wstring> values(JobCount);
+  std::vector<DxcDefine> defines(JobCount);
+  std::vector<DxcCompileJob> jobs(JobCount);
+  for (UINT32 i = 0; i < JobCount; ++i) {
+    values[i] = std::to_wstring(i);
+    defines[i].Name = L"VAL";
+    defines[i].Value = values[i].c_str();
+    jobs[i].pSource = pSource;
+    jobs[i].pSourceName = L"source.hlsl";
+    jobs[i].pEntryPoint = L"main";
+    jobs[i].pTargetProfile = L"ps_6_0";
+    jobs[i].pDefines = &defines[i];
+    jobs[i].defineCount = 1;
+  }
+
+  IDxcOperationResult *results[JobCount];
+  VERIFY_SUCCEEDED(pBatch->CompileBatch(jobs.data(), JobCount, nullptr, 0,
+                                        pInclude, results));
+  for (UINT32 i = 0; i < JobCount; ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    pResult.Attach(results[i]);
+    VerifyOperationSucceeded(pResult);
+  }
+
+  // The include handler is shared by all jobs and queried only once.
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
+}
+
+TEST_F(CompilerTest, CompileBatchWhenCacheThenJobsShareResult) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerBatch> pBatch;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pBatch));
+  CreateBlobFromText(
+    "// CompileBatchWhenCacheThenJobsShareResult\r\n"
+    "float4 main() : SV_Target { return 1; }", &pSource);
+
+  // Identical jobs, run concurrently, all key the same options.
+  static const UINT32 JobCount = 8;
+  std::vector<DxcCompileJob> jobs(JobCount);
+  for (UINT32 i = 0; i < JobCount; ++i) {
+    jobs[i].pSource = pSource;
+    jobs[i].pSourceName = L"source.hlsl";
+    jobs[i].pEntryPoint = L"main";
+    jobs[i].pTargetProfile = L"ps_6_0";
+    jobs[i].pDefines = nullptr;
+    jobs[i].defineCount = 0;
+  }
+
+  LPCWSTR args[] = { L"/cache", L"/O3" };
+  IDxcOperationResult *results[JobCount];
+  VERIFY_SUCCEEDED(pBatch->CompileBatch(jobs.data(), JobCount, args,
+                                        _countof(args), nullptr, results));
+  CComPtr<IDxcBlob> pFirst;
+  for (UINT32 i = 0; i < JobCount; ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    pResult.Attach(results[i]);
+    VerifyOperationSucceeded(pResult);
+    CComPtr<IDxcBlob> pProgram;
+    VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+    if (pFirst == nullptr) {
+      pFirst = pProgram;
+      continue;
+    }
+    VERIFY_ARE_EQUAL(pFirst->GetBufferSize(), pProgram->GetBufferSize());
+    VERIFY_IS_TRUE(0 == memcmp(pFirst->GetBufferPointer(),
+                               pProgram->GetBufferPointer(),
+                               pFirst->GetBufferSize()));
+  }
+}
+
+TEST_F(CompilerTest, CompileEntryPointsWhenTwoEntriesThenBothSucceed) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerBatch> pBatch;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<TestIncludeHandler> pInclude;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pBatch));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 VSMain(float4 pos : POSITION) : SV_Position { return pos + ZERO; }\r\n"
+    "float4 PSMain() : SV_Target { return ZERO; }", &pSource);
+
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define ZERO 0");
+
+  LPCWSTR entryPoints[] = { L"VSMain", L"PSMain" };
+  LPCWSTR profiles[] = { L"vs_6_0", L"ps_6_0" };
+  IDxcOperationResult *results[_countof(entryPoints)];
+  VERIFY_SUCCEEDED(pBatch->CompileEntryPoints(
+    pSource, L"source.hlsl", entryPoints, profiles, _countof(entryPoints),
+    nullptr, 0, nullptr, 0, pInclude, results));
+  for (IDxcOperationResult *pRawResult : results) {
+    CComPtr<IDxcOperationResult> pResult;
+    pResult.Attach(pRawResult);
+    VerifyOperationSucceeded(pResult);
+  }
+
+  // The source is parsed, and the include loaded, only once.
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
+}
+
+TEST_F(CompilerTest, CompileEntryPointsWhenOneEntryFailsThenOtherIsClean) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerBatch> pBatch;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pBatch));
+  CreateBlobFromText("float4 PSMain() : SV_Target { return 0; }", &pSource);
+
+  // The second entry point parses fine but fails code generation.
+  LPCWSTR entryPoints[] = { L"PSMain", L"Missing" };
+  LPCWSTR profiles[] = { L"ps_6_0", L"ps_6_0" };
+  IDxcOperationResult *results[_countof(entryPoints)];
+  VERIFY_SUCCEEDED(pBatch->CompileEntryPoints(
+    pSource, L"source.hlsl", entryPoints, profiles, _countof(entryPoints),
+    nullptr, 0, nullptr, 0, nullptr, results));
+  CComPtr<IDxcOperationResult> pGood, pBad;
+  pGood.Attach(results[0]);
+  pBad.Attach(results[1]);
+
+  VerifyOperationSucceeded(pGood);
+  CComPtr<IDxcBlobEncoding> pGoodErrors;
+  VERIFY_SUCCEEDED(pGood->GetErrorBuffer(&pGoodErrors));
+  VERIFY_ARE_EQUAL_STR("", BlobToUtf8(pGoodErrors).c_str());
+
+  std::string badErrors = VerifyOperationFailed(pBad);
+  VERIFY_IS_TRUE(badErrors.find("cannot find entry function") !=
+                 std::string::npos);
+}
+
+TEST_F(CompilerTest, CompileWhenIncludeCacheThenIncludeLoadedOnce) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcIncludeCache> pIncludeCache;
+  CComPtr<IDxcIncludeHandler> pCachedInclude;
+  CComPtr<TestIncludeHandler> pInclude;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return ZERO; }", &pSource);
+
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define ZERO 0");
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcIncludeCache, &pIncludeCache));
+  VERIFY_SUCCEEDED(pIncludeCache->SetIncludeHandler(pInclude));
+  VERIFY_SUCCEEDED(pIncludeCache.QueryInterface(&pCachedInclude));
+
+  for (int i = 0; i < 2; ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", nullptr, 0, nullptr, 0, pCachedInclude, &pResult));
+    VerifyOperationSucceeded(pResult);
+  }
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
+
+  // Once cleared, the file is loaded again.
+  VERIFY_SUCCEEDED(pIncludeCache->Clear());
+  pInclude->CallResults.emplace_back("#define ZERO 0");
+  CComPtr<IDxcOperationResult> pResult;
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", nullptr, 0, nullptr, 0, pCachedInclude, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;./helper.h;", pInclude->GetAllFileNames().c_str());
+}
+
+TEST_F(CompilerTest, CompileWhenTokenCacheThenIncludeNotLexed) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pHeaders;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pTokenCache;
+  CComPtr<TestIncludeHandler> pInclude;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("#include \"helper.h\"", &pHeaders);
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("float4 GetColor() { return ZERO; }");
+  LPCWSTR EmitArgs[] = { L"/emit-token-cache" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pHeaders, L"common.hlsl", L"main",
+    L"ps_6_0", EmitArgs, _countof(EmitArgs), nullptr, 0, pInclude, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pTokenCache));
+
+  // The cache is loaded through the include handler. The header is still
+  // loaded, but its tokens come from the cache, so the new text is ignored.
+  CreateBlobFromText(
+    "#define ZERO 0\r\n"
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return GetColor(); }", &pSource);
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("");
+  pInclude->CallResults.back().source.assign(
+    (const char *)pTokenCache->GetBufferPointer(), pTokenCache->GetBufferSize());
+  pInclude->CallResults.emplace_back("#error helper.h was lexed");
+  LPCWSTR Args[] = { L"/token-cache", L"common.tokens" };
+  pResult.Release();
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", Args, _countof(Args), nullptr, 0, pInclude, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_ARE_EQUAL_WSTR(L"common.tokens;./helper.h;", pInclude->GetAllFileNames().c_str());
+}
+
+TEST_F(CompilerTest, CompileWhenCachePreprocessedThenPermutationsShareResult) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  LPCWSTR args[] = { L"/cache-preprocessed", L"-ftime-trace", L"trace.json" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "// CompileWhenCachePreprocessedThenPermutationsShareResult\r\n"
+    "float4 main() : SV_Target { return VAL; }", &pSource);
+
+  // Returns whether the shader was compiled rather than taken from the cache.
+  auto compile = [&](LPCWSTR pVal, LPCWSTR pUnused) {
+    DxcDefine defines[] = { { L"VAL", pVal }, { L"UNUSED", pUnused } };
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", args, _countof(args), defines, _countof(defines), nullptr,
+      &pResult));
+    VerifyOperationSucceeded(pResult);
+    CComPtr<IDxcOperationResultTrace> pResultTrace;
+    VERIFY_SUCCEEDED(pResult->QueryInterface(&pResultTrace));
+    CComPtr<IDxcBlobEncoding> pTrace;
+    VERIFY_SUCCEEDED(pResultTrace->GetTrace(&pTrace));
+    return BlobToUtf8(pTrace).find("\"Frontend\"") != std::string::npos;
+  };
+
+  VERIFY_IS_TRUE(compile(L"1", L"1"));
+  // A macro the shader doesn't use leaves the tokens, and so the key, as is.
+  VERIFY_IS_FALSE(compile(L"1", L"2"));
+  // One it does use changes them.
+  VERIFY_IS_TRUE(compile(L"2", L"1"));
+
+  // Results with warnings aren't shared, as their text can differ between
+  // permutations with the same tokens.
+  pSource.Release();
+  CreateBlobFromText(
+    "// CompileWhenCachePreprocessedThenPermutationsShareResult warning\r\n"
+    "float4 main() : SV_Target { float2 v = float4(VAL, 0, 0, 0); return v.xyxy; }",
+    &pSource);
+  VERIFY_IS_TRUE(compile(L"1", L"1"));
+  VERIFY_IS_TRUE(compile(L"1", L"2"));
+}
+
 TEST_F(CompilerTest, CompileWhenIncludeAbsoluteThenLoadAbsolute) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -1544,6 +2043,561 @@ TEST_F(CompilerTest, CompileWhenVdThenProducesDxilContainer) {
   VERIFY_IS_TRUE(hlsl::IsValidDxilContainer(reinterpret_cast<hlsl::DxilContainerHeader *>(pResultBlob->GetBufferPointer()), pResultBlob->GetBufferSize()));
 }
 
+TEST_F(CompilerTest, CompileWhenTimeTraceThenResultHasTrace) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(EmptyCompute, &pSource);
+
+  // Without the option, results don't expose a trace.
+  CComPtr<IDxcOperationResultTrace> pResultTrace;
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"cs_6_0", nullptr, 0, nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_FAILED(pResult->QueryInterface(&pResultTrace));
+  pResult.Release();
+
+  LPCWSTR Args[] = { L"-ftime-trace", L"trace.json" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"cs_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->QueryInterface(&pResultTrace));
+  CComPtr<IDxcBlobEncoding> pTrace;
+  VERIFY_SUCCEEDED(pResultTrace->GetTrace(&pTrace));
+  std::string trace = BlobToUtf8(pTrace);
+  VERIFY_IS_TRUE(trace.find("\"traceEvents\"") != std::string::npos);
+  LPCSTR Phases[] = { "\"Compile\"", "\"Frontend\"", "\"CodeGen\"",
+                      "\"DXIL Generator\"", "\"Container\"",
+                      "\"Validation\"" };
+  for (LPCSTR Phase : Phases)
+    VERIFY_IS_TRUE(trace.find(Phase) != std::string::npos);
+}
+
+TEST_F(CompilerTest, CompileWhenCompressThenPartsReadable) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main(float4 a : A) : SV_Target { return a * a; }",
+                     &pSource);
+
+  CComPtr<IDxcBlob> pPlain, pCompressed;
+  {
+    CComPtr<IDxcOperationResult> pResult;
+    LPCWSTR Args[] = { L"/Zi" };
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(&pPlain));
+  }
+  {
+    CComPtr<IDxcOperationResult> pResult;
+    LPCWSTR Args[] = { L"/Zi", L"/compress" };
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(&pCompressed));
+  }
+  VERIFY_IS_LESS_THAN(pCompressed->GetBufferSize(), pPlain->GetBufferSize());
+  const hlsl::DxilContainerHeader *pHeader =
+      reinterpret_cast<const hlsl::DxilContainerHeader *>(
+          pCompressed->GetBufferPointer());
+  VERIFY_IS_TRUE(hlsl::IsValidDxilContainer(pHeader,
+                                            pCompressed->GetBufferSize()));
+  VERIFY_IS_TRUE(hlsl::HasCompressedDxilParts(pHeader));
+  VERIFY_IS_NULL(hlsl::GetDxilPartByType(pHeader, hlsl::DFCC_DXIL));
+
+  // Reflection hands out the original part contents.
+  CComPtr<IDxcContainerReflection> pReflection;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcContainerReflection,
+                                               &pReflection));
+  VERIFY_SUCCEEDED(pReflection->Load(pCompressed));
+  UINT32 dxilIndex;
+  VERIFY_SUCCEEDED(pReflection->FindFirstPartKind(hlsl::DFCC_DXIL, &dxilIndex));
+  CComPtr<IDxcBlob> pPart;
+  VERIFY_SUCCEEDED(pReflection->GetPartContent(dxilIndex, &pPart));
+  const hlsl::DxilPartHeader *pPlainPart = hlsl::GetDxilPartByType(
+      reinterpret_cast<const hlsl::DxilContainerHeader *>(
+          pPlain->GetBufferPointer()), hlsl::DFCC_DXIL);
+  VERIFY_ARE_EQUAL(pPlainPart->PartSize, (uint32_t)pPart->GetBufferSize());
+  VERIFY_ARE_EQUAL(0, memcmp(hlsl::GetDxilPartData(pPlainPart),
+                             pPart->GetBufferPointer(), pPlainPart->PartSize));
+
+  CComPtr<IDxcBlobEncoding> pPlainText, pCompressedText;
+  VERIFY_SUCCEEDED(pCompiler->Disassemble(pPlain, &pPlainText));
+  VERIFY_SUCCEEDED(pCompiler->Disassemble(pCompressed, &pCompressedText));
+  VERIFY_ARE_EQUAL_STR(BlobToUtf8(pPlainText).c_str(),
+                       BlobToUtf8(pCompressedText).c_str());
+
+  CComPtr<IDxcValidator> pValidator;
+  CComPtr<IDxcOperationResult> pValResult;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcValidator,
+                                               &pValidator));
+  VERIFY_SUCCEEDED(pValidator->Validate(pCompressed, 0, &pValResult));
+  VerifyOperationSucceeded(pValResult);
+}
+
+TEST_F(CompilerTest, DecompressWhenStreamMalformedThenFails) {
+  const char Text[] = "abcdabcdabcdabcdabcdabcd0123456789";
+  const uint8_t *pText = reinterpret_cast<const uint8_t *>(Text);
+  const size_t TextSize = sizeof(Text) - 1;
+  std::vector<uint8_t> encoded;
+  hlsl::CompressLZ(pText, TextSize, encoded);
+  std::vector<uint8_t> decoded(TextSize);
+  VERIFY_IS_TRUE(hlsl::DecompressLZ(encoded.data(), encoded.size(),
+                                    decoded.data(), decoded.size()));
+  VERIFY_ARE_EQUAL(0, memcmp(pText, decoded.data(), TextSize));
+
+  // Every truncation of a valid stream is rejected.
+  for (size_t size = 0; size < encoded.size(); ++size) {
+    VERIFY_IS_FALSE(hlsl::DecompressLZ(encoded.data(), size, decoded.data(),
+                                       decoded.size()));
+  }
+
+  struct MalformedStream {
+    std::vector<uint8_t> Bytes;
+    size_t DstSize;
+  };
+  const MalformedStream Streams[] = {
+    // Match offsets reaching before the start of the output.
+    { { 0x00, 0x01, 0x00 }, 4 },
+    { { 0x10, 'a', 0x02, 0x00 }, 5 },
+    // A zero match offset.
+    { { 0x10, 'a', 0x00, 0x00 }, 5 },
+    // Literal length extension running past the end of the stream.
+    { { 0xF0, 0xFF, 0xFF }, 600 },
+    // Literal count larger than the remaining input.
+    { { 0x50, 'a', 'b' }, 5 },
+    // Literal count larger than the output.
+    { { 0x30, 'a', 'b', 'c' }, 2 },
+    // Match length extension running past the end of the stream.
+    { { 0x1F, 'a', 0x01, 0x00, 0xFF }, 300 },
+    // Match length larger than the remaining output.
+    { { 0x10, 'a', 0x01, 0x00, 0x00 }, 3 },
+    // The output is complete only after a match; the stream must end with
+    // literals.
+    { { 0x10, 'a', 0x01, 0x00 }, 5 },
+  };
+  for (const MalformedStream &stream : Streams) {
+    std::vector<uint8_t> dst(stream.DstSize);
+    VERIFY_IS_FALSE(hlsl::DecompressLZ(stream.Bytes.data(),
+                                       stream.Bytes.size(), dst.data(),
+                                       dst.size()));
+  }
+}
+
+TEST_F(CompilerTest, CompileWhenSplitDebugThenDebugContainerSeparate) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main(float4 pos : SV_Position) : SV_Target {\r\n"
+    "  float4 local = abs(pos);\r\n"
+    "  return local;\r\n"
+    "}", &pSource);
+
+  LPCWSTR Args[] = { L"/Zi", L"/Qsplit_debug" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  CComPtr<IDxcBlob> pProgram;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+  CComPtr<IDxcOperationResultDebugInfo> pResultDebugInfo;
+  VERIFY_SUCCEEDED(pResult->QueryInterface(&pResultDebugInfo));
+  CComPtr<IDxcBlob> pDebugInfo;
+  CComPtr<IDxcBlobEncoding> pDebugName;
+  VERIFY_SUCCEEDED(pResultDebugInfo->GetDebugInfo(&pDebugInfo));
+  VERIFY_SUCCEEDED(pResultDebugInfo->GetDebugName(&pDebugName));
+
+  // The runtime container only names the debug container that holds the
+  // debug part.
+  const hlsl::DxilContainerHeader *pContainer =
+      reinterpret_cast<const hlsl::DxilContainerHeader *>(
+          pProgram->GetBufferPointer());
+  const hlsl::DxilContainerHeader *pDebugContainer =
+      reinterpret_cast<const hlsl::DxilContainerHeader *>(
+          pDebugInfo->GetBufferPointer());
+  VERIFY_IS_TRUE(hlsl::IsValidDxilContainer(pDebugContainer,
+                                            pDebugInfo->GetBufferSize()));
+  VERIFY_IS_NULL(hlsl::GetDxilPartByType(pContainer,
+                                         hlsl::DFCC_ShaderDebugInfoDXIL));
+  VERIFY_IS_NOT_NULL(hlsl::GetDxilPartByType(pDebugContainer,
+                                             hlsl::DFCC_ShaderDebugInfoDXIL));
+  std::string name = BlobToUtf8(pDebugName);
+  VERIFY_ARE_EQUAL_STR(name.c_str(),
+                       hlsl::GetDxilShaderDebugName(pContainer));
+  VERIFY_ARE_EQUAL_STR(name.c_str(),
+                       hlsl::GetDxilShaderDebugName(pDebugContainer));
+
+  // The debug container loads directly into a DIA data source.
+  CComPtr<IDxcLibrary> pLib;
+  CComPtr<IStream> pDebugStream;
+  CComPtr<IDiaDataSource> pDiaSource;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcLibrary, &pLib));
+  VERIFY_SUCCEEDED(pLib->CreateStreamFromBlobReadOnly(pDebugInfo, &pDebugStream));
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcDiaDataSource, &pDiaSource));
+  VERIFY_SUCCEEDED(pDiaSource->loadDataFromIStream(pDebugStream));
+  std::wstring diaDump = GetDebugInfoAsText(pDiaSource).c_str();
+  VERIFY_IS_NOT_NULL(wcsstr(diaDump.c_str(), L"lineNumber: 2"));
+}
+
+TEST_F(CompilerTest, LoadDataForExeWhenSplitDebugThenFindsDebugContainer) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main(float4 pos : SV_Position) : SV_Target {\r\n"
+    "  float4 local = abs(pos);\r\n"
+    "  return local;\r\n"
+    "}", &pSource);
+
+  LPCWSTR Args[] = { L"/Zi", L"/Qsplit_debug" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  CComPtr<IDxcBlob> pProgram;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+  CComPtr<IDxcOperationResultDebugInfo> pResultDebugInfo;
+  VERIFY_SUCCEEDED(pResult->QueryInterface(&pResultDebugInfo));
+  CComPtr<IDxcBlob> pDebugInfo;
+  CComPtr<IDxcBlobEncoding> pDebugName;
+  VERIFY_SUCCEEDED(pResultDebugInfo->GetDebugInfo(&pDebugInfo));
+  VERIFY_SUCCEEDED(pResultDebugInfo->GetDebugName(&pDebugName));
+
+  auto WriteToFile = [](const std::wstring &path, const void *pData,
+                        DWORD size) {
+    CHandle file(CreateNewFileForReadWrite(path.c_str()));
+    DWORD written = 0;
+    VERIFY_WIN32_BOOL_SUCCEEDED(WriteFile(file, pData, size, &written, NULL));
+    VERIFY_ARE_EQUAL(size, written);
+  };
+
+  // Write the debug container under its recorded name next to the shader.
+  wchar_t TempPath[MAX_PATH];
+  VERIFY_WIN32_BOOL_SUCCEEDED(GetTempPathW(MAX_PATH, TempPath) != 0);
+  std::wstring programPath = std::wstring(TempPath) + L"split_debug_test.cso";
+  std::wstring debugPath = std::wstring(TempPath) +
+      Unicode::UTF8ToUTF16StringOrThrow(BlobToUtf8(pDebugName).c_str());
+  WriteToFile(programPath, pProgram->GetBufferPointer(),
+              (DWORD)pProgram->GetBufferSize());
+  WriteToFile(debugPath, pDebugInfo->GetBufferPointer(),
+              (DWORD)pDebugInfo->GetBufferSize());
+
+  {
+    CComPtr<IDiaDataSource> pDiaSource;
+    VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcDiaDataSource,
+                                                 &pDiaSource));
+    VERIFY_SUCCEEDED(pDiaSource->loadDataForExe(programPath.c_str(), nullptr,
+                                                nullptr));
+    std::wstring diaDump = GetDebugInfoAsText(pDiaSource).c_str();
+    VERIFY_IS_NOT_NULL(wcsstr(diaDump.c_str(), L"lineNumber: 2"));
+  }
+
+  // A recorded name that would leave the searched directories is rejected.
+  std::vector<char> tampered(
+      (const char *)pProgram->GetBufferPointer(),
+      (const char *)pProgram->GetBufferPointer() + pProgram->GetBufferSize());
+  const char *pName = hlsl::GetDxilShaderDebugName(
+      reinterpret_cast<const hlsl::DxilContainerHeader *>(tampered.data()));
+  VERIFY_IS_NOT_NULL(pName);
+  VERIFY_IS_TRUE(strlen(pName) >= 3);
+  memcpy(tampered.data() + (pName - tampered.data()), "..\\", 3);
+  WriteToFile(programPath, tampered.data(), (DWORD)tampered.size());
+  {
+    CComPtr<IDiaDataSource> pDiaSource;
+    VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcDiaDataSource,
+                                                 &pDiaSource));
+    VERIFY_ARE_EQUAL(DXC_E_CONTAINER_INVALID,
+                     pDiaSource->loadDataForExe(programPath.c_str(), nullptr,
+                                                nullptr));
+  }
+
+  DeleteFileW(programPath.c_str());
+  DeleteFileW(debugPath.c_str());
+}
+
+TEST_F(CompilerTest, LinkWhenLibrariesCompiledThenShaderValid) {
+  CComPtr<IDxcCompiler> pCompiler;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  LPCWSTR Args[] = { L"/library" };
+
+  CComPtr<IDxcBlob> pUtilLib, pEntryLib;
+  {
+    CComPtr<IDxcBlobEncoding> pSource;
+    CComPtr<IDxcOperationResult> pResult;
+    CreateBlobFromText("float4 Scale(float4 v) { return v * 2; }", &pSource);
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"util.hlsl", L"",
+      L"ps_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(&pUtilLib));
+  }
+  {
+    CComPtr<IDxcBlobEncoding> pSource;
+    CComPtr<IDxcOperationResult> pResult;
+    CreateBlobFromText("float4 Scale(float4 v);\r\n"
+      "float4 main(float4 a : A) : SV_Target { return Scale(a); }", &pSource);
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"main.hlsl", L"main",
+      L"ps_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(&pEntryLib));
+  }
+  VERIFY_IS_NOT_NULL(hlsl::GetDxilPartByType(
+      reinterpret_cast<const hlsl::DxilContainerHeader *>(
+          pUtilLib->GetBufferPointer()), hlsl::DFCC_ShaderLibrary));
+
+  CComPtr<IDxcLinker> pLinker;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcLinker, &pLinker));
+  VERIFY_SUCCEEDED(pLinker->RegisterLibrary(L"util", pUtilLib));
+  VERIFY_SUCCEEDED(pLinker->RegisterLibrary(L"main", pEntryLib));
+
+  // A library that isn't registered fails the link without a result.
+  {
+    CComPtr<IDxcOperationResult> pResult;
+    LPCWSTR Libs[] = { L"main", L"missing" };
+    VERIFY_SUCCEEDED(pLinker->Link(L"main", L"ps_6_0", Libs, _countof(Libs),
+                                   nullptr, 0, &pResult));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_FAILED(status);
+  }
+
+  CComPtr<IDxcOperationResult> pResult;
+  LPCWSTR Libs[] = { L"util", L"main" };
+  VERIFY_SUCCEEDED(pLinker->Link(L"main", L"ps_6_0", Libs, _countof(Libs),
+                                 nullptr, 0, &pResult));
+  VerifyOperationSucceeded(pResult);
+  CComPtr<IDxcBlob> pProgram;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+  const hlsl::DxilContainerHeader *pContainer =
+      reinterpret_cast<const hlsl::DxilContainerHeader *>(
+          pProgram->GetBufferPointer());
+  VERIFY_IS_NOT_NULL(hlsl::GetDxilPartByType(pContainer, hlsl::DFCC_DXIL));
+  VERIFY_IS_NULL(hlsl::GetDxilPartByType(pContainer,
+                                         hlsl::DFCC_ShaderLibrary));
+
+  // The helper is inlined into the entry point like a single source.
+  CComPtr<IDxcBlobEncoding> pText;
+  VERIFY_SUCCEEDED(pCompiler->Disassemble(pProgram, &pText));
+  std::string text = BlobToUtf8(pText);
+  VERIFY_IS_TRUE(text.find("Scale") == std::string::npos);
+}
+
+TEST_F(CompilerTest, LinkWhenLibrariesShareHeaderThenHelpersMerged) {
+  CComPtr<IDxcCompiler> pCompiler;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  LPCWSTR Args[] = { L"/library" };
+  const char *pHeader = "float4 Brighten(float4 v) { return v * 2; }";
+
+  // Both libraries include the same non-static helper.
+  auto compile = [&](LPCSTR pText, LPCWSTR pName, LPCWSTR pEntry,
+                     IDxcBlob **ppLib) {
+    CComPtr<IDxcBlobEncoding> pSource;
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<TestIncludeHandler> pInclude;
+    pInclude = new TestIncludeHandler(m_dllSupport);
+    pInclude->CallResults.emplace_back(pHeader);
+    CreateBlobFromText(pText, &pSource);
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, pName, pEntry, L"ps_6_0",
+      Args, _countof(Args), nullptr, 0, pInclude, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(ppLib));
+  };
+  CComPtr<IDxcBlob> pUtilLib, pEntryLib;
+  compile("#include \"common.hlsli\"\r\n"
+          "float4 Shade(float4 v) { return Brighten(v) + 1; }",
+          L"util.hlsl", L"", &pUtilLib);
+  compile("#include \"common.hlsli\"\r\n"
+          "float4 Shade(float4 v);\r\n"
+          "float4 main(float4 a : A) : SV_Target {\r\n"
+          "  return Brighten(Shade(a));\r\n"
+          "}",
+          L"main.hlsl", L"main", &pEntryLib);
+
+  CComPtr<IDxcLinker> pLinker;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcLinker, &pLinker));
+  VERIFY_SUCCEEDED(pLinker->RegisterLibrary(L"util", pUtilLib));
+  VERIFY_SUCCEEDED(pLinker->RegisterLibrary(L"main", pEntryLib));
+  CComPtr<IDxcOperationResult> pResult;
+  LPCWSTR Libs[] = { L"util", L"main" };
+  VERIFY_SUCCEEDED(pLinker->Link(L"main", L"ps_6_0", Libs, _countof(Libs),
+                                 nullptr, 0, &pResult));
+  VerifyOperationSucceeded(pResult);
+  CComPtr<IDxcBlob> pProgram;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+  VERIFY_IS_NOT_NULL(hlsl::GetDxilPartByType(
+      reinterpret_cast<const hlsl::DxilContainerHeader *>(
+          pProgram->GetBufferPointer()), hlsl::DFCC_DXIL));
+}
+
+TEST_F(CompilerTest, LinkWhenHelperDefinedDifferentlyThenFail) {
+  CComPtr<IDxcCompiler> pCompiler;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  LPCWSTR Args[] = { L"/library" };
+  auto compile = [&](LPCSTR pText, LPCWSTR pEntry, IDxcBlob **ppLib) {
+    CComPtr<IDxcBlobEncoding> pSource;
+    CComPtr<IDxcOperationResult> pResult;
+    CreateBlobFromText(pText, &pSource);
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", pEntry,
+      L"ps_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(ppLib));
+  };
+
+  // Both libraries define a non-static Brighten, but not the same one.
+  CComPtr<IDxcBlob> pUtilLib, pEntryLib;
+  compile("float4 Brighten(float4 v) { return v * 3; }\r\n"
+          "float4 Shade(float4 v) { return Brighten(v) + 1; }",
+          L"", &pUtilLib);
+  compile("float4 Brighten(float4 v) { return v * 2; }\r\n"
+          "float4 Shade(float4 v);\r\n"
+          "float4 main(float4 a : A) : SV_Target {\r\n"
+          "  return Brighten(Shade(a));\r\n"
+          "}",
+          L"main", &pEntryLib);
+
+  CComPtr<IDxcLinker> pLinker;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcLinker, &pLinker));
+  VERIFY_SUCCEEDED(pLinker->RegisterLibrary(L"util", pUtilLib));
+  VERIFY_SUCCEEDED(pLinker->RegisterLibrary(L"main", pEntryLib));
+  CComPtr<IDxcOperationResult> pResult;
+  LPCWSTR Libs[] = { L"util", L"main" };
+  VERIFY_SUCCEEDED(pLinker->Link(L"main", L"ps_6_0", Libs, _countof(Libs),
+                                 nullptr, 0, &pResult));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_FAILED(status);
+  CComPtr<IDxcBlobEncoding> pErrors;
+  VERIFY_SUCCEEDED(pResult->GetErrorBuffer(&pErrors));
+  std::string errors = BlobToUtf8(pErrors);
+  VERIFY_IS_TRUE(errors.find("Brighten") != std::string::npos);
+  VERIFY_IS_TRUE(errors.find("defined differently by libraries main and "
+                             "util") != std::string::npos);
+}
+
+TEST_F(CompilerTest, LinkWhenArgumentUnsupportedThenFail) {
+  CComPtr<IDxcCompiler> pCompiler;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  LPCWSTR Args[] = { L"/library" };
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcOperationResult> pCompileResult;
+  CComPtr<IDxcBlob> pLib;
+  CreateBlobFromText(
+    "float4 main(float4 a : A) : SV_Target { return a; }", &pSource);
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"main.hlsl", L"main",
+    L"ps_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pCompileResult));
+  VerifyOperationSucceeded(pCompileResult);
+  VERIFY_SUCCEEDED(pCompileResult->GetResult(&pLib));
+
+  CComPtr<IDxcLinker> pLinker;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcLinker, &pLinker));
+  VERIFY_SUCCEEDED(pLinker->RegisterLibrary(L"main", pLib));
+  LPCWSTR Libs[] = { L"main" };
+
+  // Debug information comes from compiling the libraries, not linking.
+  {
+    CComPtr<IDxcOperationResult> pResult;
+    LPCWSTR LinkArgs[] = { L"/Zi" };
+    VERIFY_SUCCEEDED(pLinker->Link(L"main", L"ps_6_0", Libs, _countof(Libs),
+                                   LinkArgs, _countof(LinkArgs), &pResult));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_ARE_EQUAL(E_INVALIDARG, status);
+    CComPtr<IDxcBlobEncoding> pErrors;
+    VERIFY_SUCCEEDED(pResult->GetErrorBuffer(&pErrors));
+    std::string errors = BlobToUtf8(pErrors);
+    VERIFY_IS_TRUE(errors.find("/Zi") != std::string::npos);
+  }
+
+  // Optimization options apply to the link as they do to a compilation.
+  CComPtr<IDxcOperationResult> pResult;
+  LPCWSTR LinkArgs[] = { L"/Od", L"/Gfa" };
+  VERIFY_SUCCEEDED(pLinker->Link(L"main", L"ps_6_0", Libs, _countof(Libs),
+                                 LinkArgs, _countof(LinkArgs), &pResult));
+  VerifyOperationSucceeded(pResult);
+}
+
+TEST_F(CompilerTest, CheckPipelinesWhenStagesMismatchThenFail) {
+  CComPtr<IDxcCompiler> pCompiler;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  auto compile = [&](LPCSTR pText, LPCWSTR pProfile, IDxcBlob **ppBlob) {
+    CComPtr<IDxcBlobEncoding> pSource;
+    CComPtr<IDxcOperationResult> pResult;
+    CreateBlobFromText(pText, &pSource);
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      pProfile, nullptr, 0, nullptr, 0, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(ppBlob));
+  };
+
+  CComPtr<IDxcBlob> pVS, pPS, pPSMissingInput, pPSConflict;
+  compile("Texture2D t : register(t0);\r\n"
+          "struct VSOut { float4 pos : SV_Position; float2 uv : TEXCOORD0; };\r\n"
+          "VSOut main(float4 pos : POSITION) {\r\n"
+          "  VSOut o; o.pos = pos + t.Load(int3(0, 0, 0)); o.uv = pos.xy;\r\n"
+          "  return o;\r\n"
+          "}", L"vs_6_0", &pVS);
+  compile("Texture2D t : register(t0);\r\n"
+          "float4 main(float4 pos : SV_Position, float2 uv : TEXCOORD0) : SV_Target {\r\n"
+          "  return t.Load(int3(uv, 0));\r\n"
+          "}", L"ps_6_0", &pPS);
+  compile("float4 main(float4 pos : SV_Position, float2 uv : TEXCOORD0,\r\n"
+          "            float4 color : COLOR0) : SV_Target {\r\n"
+          "  return color * uv.x;\r\n"
+          "}", L"ps_6_0", &pPSMissingInput);
+  compile("StructuredBuffer<float4> s : register(t0);\r\n"
+          "float4 main(float4 pos : SV_Position, float2 uv : TEXCOORD0) : SV_Target {\r\n"
+          "  return s[(uint)uv.x];\r\n"
+          "}", L"ps_6_0", &pPSConflict);
+
+  CComPtr<IDxcPipelineChecker> pChecker;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcPipelineChecker,
+                                               &pChecker));
+  DxcPipelineStages pipelines[3] = {};
+  pipelines[0].pVS = pVS;
+  pipelines[0].pPS = pPS;
+  pipelines[1].pVS = pVS;
+  pipelines[1].pPS = pPSMissingInput;
+  pipelines[2].pVS = pVS;
+  pipelines[2].pPS = pPSConflict;
+  IDxcOperationResult *results[_countof(pipelines)];
+  VERIFY_SUCCEEDED(pChecker->CheckPipelines(pipelines, _countof(pipelines),
+                                            results));
+  CComPtr<IDxcOperationResult> pLinked, pMissingInput, pConflict;
+  pLinked.Attach(results[0]);
+  pMissingInput.Attach(results[1]);
+  pConflict.Attach(results[2]);
+
+  VerifyOperationSucceeded(pLinked);
+  HRESULT status;
+  VERIFY_SUCCEEDED(pMissingInput->GetStatus(&status));
+  VERIFY_ARE_EQUAL(DXC_E_PIPELINE_LINKAGE_MISMATCH, status);
+  VERIFY_SUCCEEDED(pConflict->GetStatus(&status));
+  VERIFY_ARE_EQUAL(DXC_E_PIPELINE_LINKAGE_MISMATCH, status);
+  CComPtr<IDxcBlobEncoding> pErrors;
+  VERIFY_SUCCEEDED(pMissingInput->GetErrorBuffer(&pErrors));
+  std::string errors = BlobToUtf8(pErrors);
+  VERIFY_IS_TRUE(errors.find("PS input COLOR0 is not written by VS") !=
+                 std::string::npos);
+  pErrors.Release();
+  VERIFY_SUCCEEDED(pConflict->GetErrorBuffer(&pErrors));
+  errors = BlobToUtf8(pErrors);
+  VERIFY_IS_TRUE(errors.find("VS binds t0, space0 as a typed SRV but PS "
+                             "binds it as a structured SRV") !=
+                 std::string::npos);
+
+  // A pipeline without a vertex shader never links.
+  DxcPipelineStages noVS = {};
+  noVS.pPS = pPS;
+  CComPtr<IDxcOperationResult> pNoVS;
+  VERIFY_SUCCEEDED(pChecker->CheckPipeline(&noVS, &pNoVS));
+  VERIFY_SUCCEEDED(pNoVS->GetStatus(&status));
+  VERIFY_FAILED(status);
+
+  // An empty batch has nothing to check.
+  VERIFY_SUCCEEDED(pChecker->CheckPipelines(nullptr, 0, nullptr));
+}
+
 TEST_F(CompilerTest, CompileWhenODumpThenOptimizerMatch) {
   LPCWSTR OptLevels[] = { L"/Od", L"/O1", L"/O2" };
   CComPtr<IDxcCompiler> pCompiler;
@@ -1632,6 +2686,43 @@ TEST_F(CompilerTest, CompileWhenODumpThenOptimizerMatch) {
   }
 }
 
+TEST_F(CompilerTest, ModuleSessionWhenLoadedThenValidatesAndDisassembles) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pProgram;
+  CComPtr<IDxcModuleSession> pSession;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main() : SV_Target { return 1; }", &pSource);
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", nullptr, 0, nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcModuleSession, &pSession));
+  VERIFY_SUCCEEDED(pSession->Load(pProgram));
+
+  // The same module is validated, optimized and validated again without
+  // being serialized in between.
+  pResult.Release();
+  VERIFY_SUCCEEDED(pSession->Validate(&pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pSession->RunOptimizer(nullptr, 0, nullptr));
+  pResult.Release();
+  VERIFY_SUCCEEDED(pSession->Validate(&pResult));
+  VerifyOperationSucceeded(pResult);
+
+  CComPtr<IDxcBlobEncoding> pDisassembly;
+  VERIFY_SUCCEEDED(pSession->Disassemble(&pDisassembly));
+  std::string disassembly = BlobToUtf8(pDisassembly);
+  VERIFY_ARE_NOT_EQUAL(string::npos, disassembly.find("define void @main()"));
+
+  CComPtr<IDxcBlob> pModule;
+  VERIFY_SUCCEEDED(pSession->GetModule(&pModule));
+  VERIFY_IS_TRUE(pModule->GetBufferSize() > 0);
+}
+
 TEST_F(CompilerTest, CompileWhenShaderModelMismatchAttributeThenFail) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -2320,6 +3411,10 @@ TEST_F(CompilerTest, CodeGenShift) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\shift.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenSignaturePackingOptimized) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\signature_packing_optimized.hlsl");
+}
+
 TEST_F(CompilerTest, CodeGenSimpleDS1) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\SimpleDS1.hlsl");
 }
@@ -3456,6 +4551,18 @@ TEST_F(CompilerTest, DxilGen_StoreOutput) {
   CodeGenTestCheck(L"..\\CodeGenHLSL\\dxilgen_storeoutput.hlsl");
 }
 
+TEST_F(CompilerTest, DxilCost_UnknownTripCount) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\dxil_cost.hlsl");
+}
+
+TEST_F(CompilerTest, DxilCost_ConstantTripCount) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\dxil_cost_trip_count.hlsl");
+}
+
+TEST_F(CompilerTest, DxilCost_ConstantTripCountHeaderExit) {
+  CodeGenTestCheck(L"..\\CodeGenHLSL\\dxil_cost_trip_count_od.hlsl");
+}
+
 TEST_F(CompilerTest, PreprocessWhenValidThenOK) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -76,6 +76,8 @@ protected:
     EXPECT_STREQW(expectedDecl, name);// << "declaration text at " << line << ":" << col;
   }
 
+  TEST_METHOD(CompletionWhenMemberAccessThenFieldsAvailable);
+
   TEST_METHOD(CursorWhenCBufferRefThenFound);
   TEST_METHOD(CursorWhenFieldRefThenSimpleNames);
   TEST_METHOD(CursorWhenFindAtBodyCallThenMatch);
@@ -106,6 +108,7 @@ protected:
   TEST_METHOD(TUWhenRegionInactiveThenEndIsBeforeEndifHash);
   TEST_METHOD(TUWhenRegionInactiveThenStartIsAtIfdefEol);
   TEST_METHOD(TUWhenUnsaveFileThenOK);
+  TEST_METHOD(TUWhenReparseWithPreambleThenHeaderChangesSeen);
 
   TEST_METHOD(QualifiedNameClass);
   TEST_METHOD(QualifiedNameVariable);
@@ -152,6 +155,49 @@ TEST_F(DXIntellisenseTest, CursorWhenCBufferRefThenFound) {
   VERIFY_ARE_EQUAL(2, line);
 }
 
+TEST_F(DXIntellisenseTest, CompletionWhenMemberAccessThenFieldsAvailable) {
+  char program[] =
+    "struct S { float fieldA; int fieldB; };\r\n"
+    "float main() : SV_Target { S s; return s. ; }";
+  CompilationResult result(CompilationResult::CreateForProgram(program, _countof(program)));
+
+  CComPtr<IDxcUnsavedFile> unsavedFile;
+  CComPtr<IDxcCodeCompleteResults> results;
+  unsigned numResults;
+  VERIFY_SUCCEEDED(TrivialDxcUnsavedFile::Create(CompilationResult::getDefaultFileName(), program, &unsavedFile));
+  // Complete right after 's.' on the second line.
+  VERIFY_SUCCEEDED(result.TU->CodeCompleteAt(CompilationResult::getDefaultFileName(), 2, 42,
+    &unsavedFile.p, 1, DxcCodeCompleteFlags_None, &results));
+  VERIFY_SUCCEEDED(results->GetNumResults(&numResults));
+
+  std::vector<std::string> names;
+  for (unsigned i = 0; i < numResults; ++i) {
+    CComPtr<IDxcCompletionResult> completion;
+    CComPtr<IDxcCompletionString> completionString;
+    DxcCursorKind kind;
+    unsigned numChunks;
+    VERIFY_SUCCEEDED(results->GetResultAt(i, &completion));
+    VERIFY_SUCCEEDED(completion->GetCursorKind(&kind));
+    if (kind != DxcCursor_FieldDecl)
+      continue;
+    VERIFY_SUCCEEDED(completion->GetCompletionString(&completionString));
+    VERIFY_SUCCEEDED(completionString->GetNumCompletionChunks(&numChunks));
+    for (unsigned c = 0; c < numChunks; ++c) {
+      DxcCompletionChunkKind chunkKind;
+      VERIFY_SUCCEEDED(completionString->GetCompletionChunkKind(c, &chunkKind));
+      if (chunkKind != DxcCompletionChunk_TypedText)
+        continue;
+      CComHeapPtr<char> text;
+      VERIFY_SUCCEEDED(completionString->GetCompletionChunkText(c, &text));
+      names.push_back(text.m_pData);
+    }
+  }
+  std::sort(names.begin(), names.end());
+  VERIFY_ARE_EQUAL(2, names.size());
+  VERIFY_ARE_EQUAL_STR("fieldA", names[0].c_str());
+  VERIFY_ARE_EQUAL_STR("fieldB", names[1].c_str());
+}
+
 TEST_F(DXIntellisenseTest, InclusionWhenValidThenAvailable) {
   CComPtr<IDxcIntelliSense> isense;
   CComPtr<IDxcIndex> index;
@@ -415,6 +461,48 @@ TEST_F(DXIntellisenseTest, TUWhenUnsaveFileThenOK) {
   }
 }
 
+TEST_F(DXIntellisenseTest, TUWhenReparseWithPreambleThenHeaderChangesSeen) {
+  // The first reparse builds the header token cache, the second one uses it,
+  // and the third one must notice that the header changed.
+  CComPtr<IDxcIntelliSense> isense;
+  CComPtr<IDxcIndex> index;
+  CComPtr<IDxcTranslationUnit> TU;
+  const char main_text[] = "#include \"inc.h\"\r\nfloat4 main() : SV_Target { return FOO; }";
+  const char main_edit_text[] = "#include \"inc.h\"\r\nfloat4 main() : SV_Target { return FOO + 1; }";
+  const char main_bar_text[] = "#include \"inc.h\"\r\nfloat4 main() : SV_Target { return BAR; }";
+  const char inc_text[] = "#define FOO 1";
+  const char inc_bar_text[] = "#define BAR 2";
+  unsigned diagCount;
+  VERIFY_SUCCEEDED(CompilationResult::DefaultHlslSupport->CreateIntellisense(&isense));
+  VERIFY_SUCCEEDED(isense->CreateIndex(&index));
+
+  CComPtr<IDxcUnsavedFile> unsaved[2];
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("./inc.h", inc_text, strlen(inc_text), &unsaved[0]));
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("file.hlsl", main_text, strlen(main_text), &unsaved[1]));
+  VERIFY_SUCCEEDED(index->ParseTranslationUnit("file.hlsl", nullptr, 0, &unsaved[0].p, 2,
+    (DxcTranslationUnitFlags)(DxcTranslationUnitFlags_PrecompiledPreamble | DxcTranslationUnitFlags_UseCallerThread), &TU));
+  VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(0, diagCount);
+
+  VERIFY_SUCCEEDED(TU->Reparse(&unsaved[0].p, 2));
+  VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(0, diagCount);
+
+  unsaved[1].Release();
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("file.hlsl", main_edit_text, strlen(main_edit_text), &unsaved[1]));
+  VERIFY_SUCCEEDED(TU->Reparse(&unsaved[0].p, 2));
+  VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(0, diagCount);
+
+  unsaved[0].Release();
+  unsaved[1].Release();
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("./inc.h", inc_bar_text, strlen(inc_bar_text), &unsaved[0]));
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("file.hlsl", main_bar_text, strlen(main_bar_text), &unsaved[1]));
+  VERIFY_SUCCEEDED(TU->Reparse(&unsaved[0].p, 2));
+  VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(0, diagCount);
+}
+
 TEST_F(DXIntellisenseTest, QualifiedNameClass) {
   char program[] =
     "class TheClass {\r\n"
@@ -65,6 +65,7 @@ public:
   END_TEST_CLASS()
 
   TEST_METHOD(CompileWhenOKThenIncludesFeatureInfo)
+  TEST_METHOD(CompileWhenOKThenReflectionIncludesInstructionStats)
   TEST_METHOD(CompileWhenOKThenIncludesSignatures)
   TEST_METHOD(CompileWhenSigSquareThenIncludeSplit)
   TEST_METHOD(DisassemblyWhenMissingThenFails)
@@ -531,6 +532,37 @@ TEST_F(DxilContainerTest, CompileWhenOKThenIncludesFeatureInfo) {
   VERIFY_ARE_EQUAL(0, *(uint64_t *)hlsl::GetDxilPartData(*pPartIter));
 }
 
+TEST_F(DxilContainerTest, CompileWhenOKThenReflectionIncludesInstructionStats) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pProgram;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<ID3D12ShaderReflection> pReflection;
+  D3D12_SHADER_DESC desc;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "Texture2D t; SamplerState s; RWBuffer<uint> u;\r\n"
+    "float4 main(float2 uv : TEXCOORD, uint i : INDEX) : SV_Target {\r\n"
+    "  float4 c = t.Sample(s, uv);\r\n"
+    "  if (c.x > 0.5) { InterlockedAdd(u[i], 1); }\r\n"
+    "  return c * 2;\r\n"
+    "}", &pSource);
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"hlsl.hlsl", L"main", L"ps_6_0",
+    nullptr, 0, nullptr, 0, nullptr,
+    &pResult));
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+  CreateReflectionFromBlob(pProgram, &pReflection);
+
+  VERIFY_SUCCEEDED(pReflection->GetDesc(&desc));
+  VERIFY_ARE_NOT_EQUAL(0, desc.InstructionCount);
+  VERIFY_ARE_EQUAL(1, desc.TextureNormalInstructions);
+  VERIFY_ARE_EQUAL(1, desc.cInterlockedInstructions);
+  VERIFY_ARE_NOT_EQUAL(0, desc.FloatInstructionCount);
+  VERIFY_ARE_NOT_EQUAL(0, desc.DynamicFlowControlCount);
+  VERIFY_ARE_EQUAL(0, desc.EmitInstructionCount);
+}
+
 TEST_F(DxilContainerTest, DisassemblyWhenBCInvalidThenFails) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcBlobEncoding> pSource;
@@ -9,6 +9,7 @@ set TEST_CLANG=1
 set TEST_EXEC=1
 set TEST_CLANG_VERIF=0
 set TEST_EXTRAS=1
+set TEST_BENCH=0
 set BUILD_CONFIG=Debug
 
 if "%1"=="clean" (
@@ -47,6 +48,14 @@ if "%1"=="extras" (
   shift /1
 )
 
+if "%1"=="bench" (
+  set TEST_CLANG=0
+  set TEST_EXEC=0
+  set TEST_EXTRAS=0
+  set TEST_BENCH=1
+  shift /1
+)
+
 if "%1"=="none" (
   set TEST_CLANG=0
   set TEST_EXEC=0
@@ -149,6 +158,16 @@ if "%TEST_CLANG_VERIF%"=="1" (
   )
 )
 
+if "%TEST_BENCH%"=="1" (
+  echo Running compile benchmark ...
+  %TEST_DIR%\dxc-bench.exe -corpus=%HLSL_SRC_DIR%\tools\clang\tools\dxc-bench\corpus.txt -root=%HLSL_SRC_DIR%\tools\clang\test\CodeGenHLSL -o=%TEST_DIR%\dxc-bench.json
+  if errorlevel 1 (
+    echo Failed - %TEST_DIR%\dxc-bench.exe
+    exit /b 1
+  )
+  echo Benchmark results written to %TEST_DIR%\dxc-bench.json
+)
+
 if exist "%HCT_EXTRAS%\hcttest-extras.cmd" (
   if "%TEST_EXTRAS%"=="1" (
     echo Running extra tests ...
@@ -184,6 +203,7 @@ echo.
 echo 'clang' will only run clang tests.
 echo 'exec' will only run execution tests.
 echo 'v' will run the clang tests that are verified-based.
+echo 'bench' will only run the compile benchmark and write dxc-bench.json.
 echo.
 echo Use the HCT_EXTRAS environment variable to add hcttest-before and hcttest-after hooks.
 echo.
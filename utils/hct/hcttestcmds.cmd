@@ -78,6 +78,35 @@ if %errorlevel% neq 0 (
   exit /b 1
 )
 
+echo Smoke test for dxc.exe server mode...
+echo 1 /T ps_6_0 smoke.hlsl /Fo smoke.server.cso> smoke.requests
+echo 2 /T ps_6_0 smoke.hlsl /E missing>> smoke.requests
+dxc.exe -server < smoke.requests > smoke.responses
+if %errorlevel% neq 0 (
+  echo Failed to run server mode - %CD%\dxc.exe -server ^< %CD%\smoke.requests
+  exit /b 1
+)
+findstr /b /c:"1 0 " smoke.responses 1>nul
+if %errorlevel% neq 0 (
+  echo Failed to find a successful response for request 1 in %CD%\smoke.responses
+  exit /b 1
+)
+findstr /b /c:"2 " smoke.responses 1>nul
+if %errorlevel% neq 0 (
+  echo Failed to find a response for request 2 in %CD%\smoke.responses
+  exit /b 1
+)
+findstr /b /c:"2 0 " smoke.responses 1>nul
+if %errorlevel% equ 0 (
+  echo Failed to report an error for request 2 in %CD%\smoke.responses
+  exit /b 1
+)
+if not exist smoke.server.cso (
+  echo Failed to find %CD%\smoke.server.cso written by server mode
+  exit /b 1
+)
+del smoke.requests smoke.responses smoke.server.cso
+
 echo Smoke test for dxa command line program ...
 dxa.exe smoke.cso -listfiles 1> nul
 if %errorlevel% neq 0 (